@@ -0,0 +1,24 @@
+#ifndef AUDIO_AUDIO_CLOCK_H_
+#define AUDIO_AUDIO_CLOCK_H_
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+/** \brief Frequency of the audio clock in Hz.
+ * \details TIM2 counts the timer clock of APB1 (2 x 36 MHz), so the device side of the audio runs from the crystal
+ * of the device, while the host sends SOF from its own crystal: the two drift apart by some ppm. To follow the master
+ * clock of a codec instead, TIM2 would count it on its ETR pin (external clock mode 2).
+ */
+#define AUDIO_CLOCK_HZ 72000000
+
+void audio_clock_initialize();
+uint32_t audio_clock_sof_timestamp();
+
+/** \brief Returns the current value of the audio clock (wraps around after ~59 seconds).
+ */
+inline static uint32_t audio_clock_now()
+{
+	return TIM2->CNT;
+}
+
+#endif /* AUDIO_AUDIO_CLOCK_H_ */
@@ -0,0 +1,30 @@
+#ifndef AUDIO_AUDIO_DSP_H_
+#define AUDIO_AUDIO_DSP_H_
+
+#include <stdint.h>
+
+/** \file
+ * \brief Sample format conversion and mixing kernels using the DSP extension of the Cortex-M4 (two 16-bit subframes
+ * per instruction, with saturation).
+ * \details The samples are stereo 16-bit PCM, the left subframe first (one sample is one word). All buffers must be
+ * word aligned.
+ */
+
+/// \brief Count of fractional bits of the gains (Q2.14: -2.0 to +2.0).
+#define AUDIO_DSP_GAIN_FRACTIONAL_BITS 14
+/// \brief Gain that keeps the samples as they are.
+#define AUDIO_DSP_UNITY_GAIN (1 << AUDIO_DSP_GAIN_FRACTIONAL_BITS)
+/// \brief Lowest gain of `audio_dsp_mix_weighted` (just above -2.0, so the sum of both streams fits in 32 bits).
+#define AUDIO_DSP_MIN_MIX_GAIN (-INT16_MAX)
+
+void audio_dsp_pack_24(uint8_t *output, int16_t const *input, uint32_t subframe_count);
+void audio_dsp_unpack_24(int16_t *output, uint8_t const *input, uint32_t subframe_count);
+void audio_dsp_interleave(int16_t *output, int16_t const *left, int16_t const *right, uint32_t sample_count);
+void audio_dsp_deinterleave(int16_t *left, int16_t *right, int16_t const *input, uint32_t sample_count);
+void audio_dsp_apply_gain(int16_t *samples, uint32_t sample_count, int16_t left_gain, int16_t right_gain);
+void audio_dsp_mix(int16_t *output, int16_t const *input, uint32_t sample_count);
+void audio_dsp_mix_weighted(int16_t *output, int16_t const *first, int16_t const *second, uint32_t sample_count,
+	int16_t first_gain, int16_t second_gain);
+void audio_dsp_run_benchmark();
+
+#endif /* AUDIO_AUDIO_DSP_H_ */
@@ -0,0 +1,141 @@
+#ifndef AUDIO_USB_AUDIO_STANDARDS_H_
+#define AUDIO_USB_AUDIO_STANDARDS_H_
+
+#include <stdint.h>
+
+/** \addtogroup USB_AUDIO USB audio class
+ * \brief Audio 1.0 definitions
+ * \details Based on [Audio Devices 1.0](https://www.usb.org/document-library/audio-device-document-10) and
+ * [Audio Data Formats 1.0](https://www.usb.org/document-library/audio-data-formats-10)
+ * @{ */
+
+/**\name Subclass codes (the class is \ref USB_CLASS_AUDIO)
+ * @{ */
+#define USB_AUDIO_SUBCLASS_AUDIOCONTROL 0x01 /**<\brief Audio control interface (topology and controls).*/
+#define USB_AUDIO_SUBCLASS_AUDIOSTREAMING 0x02 /**<\brief Audio streaming interface (isochronous data).*/
+/** @} */
+
+/**\name Class specific descriptor types and subtypes
+ * @{ */
+#define USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE 0x24
+#define USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT 0x25
+
+#define USB_AUDIO_AC_HEADER 0x01
+#define USB_AUDIO_AC_INPUT_TERMINAL 0x02
+#define USB_AUDIO_AC_OUTPUT_TERMINAL 0x03
+
+#define USB_AUDIO_AS_GENERAL 0x01
+#define USB_AUDIO_AS_FORMAT_TYPE 0x02
+
+#define USB_AUDIO_EP_GENERAL 0x01
+/** @} */
+
+/**\name Terminal types
+ * @{ */
+#define USB_AUDIO_TERMINAL_USB_STREAMING 0x0101
+#define USB_AUDIO_TERMINAL_MICROPHONE 0x0201
+#define USB_AUDIO_TERMINAL_SPEAKER 0x0301
+/** @} */
+
+#define USB_AUDIO_FORMAT_TYPE_I 0x01
+#define USB_AUDIO_FORMAT_PCM 0x0001
+
+/**\name Endpoint attributes of the streaming endpoints (bmAttributes)
+ * @{ */
+#define USB_AUDIO_ENDPOINT_ASYNCHRONOUS (1 << 2) /**<\brief The device clock sets the rate (ISO + asynchronous).*/
+#define USB_AUDIO_ENDPOINT_FEEDBACK (1 << 4) /**<\brief Explicit feedback endpoint (usage type).*/
+/** @} */
+
+/**\name Class requests
+ * @{ */
+#define USB_AUDIO_SET_CUR 0x01
+#define USB_AUDIO_GET_CUR 0x81
+#define USB_AUDIO_GET_MIN 0x82
+#define USB_AUDIO_GET_MAX 0x83
+#define USB_AUDIO_GET_RES 0x84
+/** @} */
+
+/// \brief Endpoint control: sampling frequency (3 bytes, in Hz).
+#define USB_AUDIO_SAMPLING_FREQ_CONTROL 0x01
+
+/** \brief Audio class endpoint descriptor (the standard one, with the 2 bytes of the audio class). */
+typedef struct {
+	uint8_t  bLength; /**<\brief Size of the descriptor (9 bytes). */
+	uint8_t  bDescriptorType; /**<\brief Endpoint descriptor. */
+	uint8_t  bEndpointAddress; /**<\brief Logical address of the endpoint including direction mask. */
+	uint8_t  bmAttributes; /**<\brief Type, synchronization and usage. */
+	uint16_t wMaxPacketSize; /**<\brief Maximum packet size of the endpoint. */
+	uint8_t  bInterval; /**<\brief Polling interval (1 for isochronous endpoints). */
+	uint8_t  bRefresh; /**<\brief Feedback endpoint: the feedback is updated every 2^bRefresh frames. */
+	uint8_t  bSynchAddress; /**<\brief Data endpoint: address of its feedback endpoint. */
+} __attribute__((__packed__)) UsbAudioEndpointDescriptor;
+
+/** \brief Audio control interface header, for two streaming interfaces. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AC_HEADER. */
+	uint16_t bcdADC; /**<\brief 0x0100. */
+	uint16_t wTotalLength; /**<\brief Size of the class specific audio control descriptors. */
+	uint8_t  bInCollection; /**<\brief Count of streaming interfaces. */
+	uint8_t  baInterfaceNr[2]; /**<\brief The streaming interfaces. */
+} __attribute__((__packed__)) UsbAudioControlHeaderDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AC_INPUT_TERMINAL. */
+	uint8_t  bTerminalID;
+	uint16_t wTerminalType; /**<\brief USB_AUDIO_TERMINAL_*. */
+	uint8_t  bAssocTerminal;
+	uint8_t  bNrChannels;
+	uint16_t wChannelConfig; /**<\brief Spatial locations of the channels (bit 0: left front, bit 1: right front). */
+	uint8_t  iChannelNames;
+	uint8_t  iTerminal;
+} __attribute__((__packed__)) UsbAudioInputTerminalDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AC_OUTPUT_TERMINAL. */
+	uint8_t  bTerminalID;
+	uint16_t wTerminalType; /**<\brief USB_AUDIO_TERMINAL_*. */
+	uint8_t  bAssocTerminal;
+	uint8_t  bSourceID; /**<\brief The unit or terminal connected to the output terminal. */
+	uint8_t  iTerminal;
+} __attribute__((__packed__)) UsbAudioOutputTerminalDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AS_GENERAL. */
+	uint8_t  bTerminalLink; /**<\brief The terminal connected to the endpoint of the interface. */
+	uint8_t  bDelay; /**<\brief Delay of the data path (frames). */
+	uint16_t wFormatTag; /**<\brief \ref USB_AUDIO_FORMAT_PCM. */
+} __attribute__((__packed__)) UsbAudioStreamingGeneralDescriptor;
+
+/** \brief Type I format descriptor, with one discrete sampling frequency. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AS_FORMAT_TYPE. */
+	uint8_t  bFormatType; /**<\brief \ref USB_AUDIO_FORMAT_TYPE_I. */
+	uint8_t  bNrChannels;
+	uint8_t  bSubframeSize; /**<\brief Bytes per sample of a channel. */
+	uint8_t  bBitResolution;
+	uint8_t  bSamFreqType; /**<\brief Count of discrete sampling frequencies (1). */
+	uint8_t  tSamFreq[3]; /**<\brief The sampling frequency in Hz (little endian). */
+} __attribute__((__packed__)) UsbAudioFormatTypeIDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_EP_GENERAL. */
+	uint8_t  bmAttributes; /**<\brief Bit 0: sampling frequency control, bit 7: packets padded to wMaxPacketSize. */
+	uint8_t  bLockDelayUnits;
+	uint16_t wLockDelay;
+} __attribute__((__packed__)) UsbAudioStreamingEndpointDescriptor;
+
+/** @} */
+
+#endif /* AUDIO_USB_AUDIO_STANDARDS_H_ */
@@ -0,0 +1,27 @@
+#ifndef AUDIO_USBD_AUDIO_H_
+#define AUDIO_USBD_AUDIO_H_
+
+#include "usbd_class.h"
+
+/// \brief Sampling frequency of the speaker and of the microphone in Hz.
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNEL_COUNT 2
+/// \brief Size of the sample of one channel in bytes (16-bit PCM).
+#define AUDIO_SUBFRAME_SIZE 2
+/// \brief Size of a sample of all the channels in bytes.
+#define AUDIO_SAMPLE_SIZE (AUDIO_CHANNEL_COUNT * AUDIO_SUBFRAME_SIZE)
+/// \brief Count of samples in a frame at the nominal rate.
+#define AUDIO_SAMPLES_PER_FRAME (AUDIO_SAMPLE_RATE / 1000)
+/// \brief Size of the largest packet (a sample more than nominal: the rates differ by less than one sample per frame).
+#define AUDIO_MAX_PACKET_SIZE ((AUDIO_SAMPLES_PER_FRAME + 1) * AUDIO_SAMPLE_SIZE)
+/// \brief The feedback is updated every 2^AUDIO_FEEDBACK_REFRESH frames (bRefresh of the feedback endpoint).
+#define AUDIO_FEEDBACK_REFRESH 5
+
+/** \brief Audio 1.0 function with a speaker (isochronous OUT) and a microphone (isochronous IN), both asynchronous.
+ * \details The speaker plays at the rate of the audio clock of the device (see `audio_clock.h`); its feedback endpoint
+ * tells the host how many samples to send per frame. The microphone records the speaker (loopback), or a 1 kHz tone
+ * while the speaker is idle.
+ */
+extern const UsbClass usbd_audio_class;
+
+#endif /* AUDIO_USBD_AUDIO_H_ */
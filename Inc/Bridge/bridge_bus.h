@@ -0,0 +1,36 @@
+#ifndef BRIDGE_BRIDGE_BUS_H_
+#define BRIDGE_BRIDGE_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+	BRIDGE_BUS_DONE, ///< The last operation completed.
+	BRIDGE_BUS_BUSY, ///< The last operation is still running.
+	BRIDGE_BUS_ERROR ///< The last operation failed (e.g. an I2C device did not acknowledge).
+} BridgeBusStatus;
+
+/** \brief The peripherals behind the bridge function.
+ * \details The transfers are asynchronous: they only start the operation (e.g. a DMA), then `status` is polled until
+ * the operation is over, so the bridge keeps serving USB meanwhile. The buffers stay valid until then.
+ * \note `initialize` is optional (can be NULL). The callbacks are called from the main loop.
+ */
+typedef struct
+{
+	/// \brief Called once when the function starts using the bus; returns false if the bus cannot be used.
+	bool (*initialize)();
+	/// \brief Drives the chip select of the SPI device (completes at once).
+	void (*spi_select)(bool selected);
+	/// \brief Starts a full duplex SPI transfer; `tx` may be NULL (0xFF is sent), `rx` may be NULL (the bytes received
+	/// are dropped).
+	void (*spi_transfer)(void const *tx, void *rx, uint16_t size);
+	/// \brief Starts an I2C write (START, address, data, STOP).
+	void (*i2c_write)(uint8_t address, void const *data, uint16_t size);
+	/// \brief Starts an I2C read (START, address, data, STOP).
+	void (*i2c_read)(uint8_t address, void *data, uint16_t size);
+	/// \brief Advances the operation in progress and returns its status.
+	BridgeBusStatus (*status)();
+} BridgeBus;
+
+#endif /* BRIDGE_BRIDGE_BUS_H_ */
@@ -0,0 +1,17 @@
+#ifndef BRIDGE_BRIDGE_LOOPBACK_H_
+#define BRIDGE_BRIDGE_LOOPBACK_H_
+
+#include "Bridge/bridge_bus.h"
+
+/// \brief Address of the memory on the I2C bus of the loopback.
+#define BRIDGE_LOOPBACK_I2C_ADDRESS 0x50
+/// \brief Size of the memory in bytes.
+#define BRIDGE_LOOPBACK_MEMORY_SIZE 256
+
+/** \brief A bus without hardware, for tests: SPI MISO is wired to MOSI (a transfer receives what it sends), and the
+ * I2C bus has one memory like a 24C02 EEPROM (a write sets the address with its first byte, then stores the rest; a
+ * read continues from the address). The other I2C addresses do not acknowledge.
+ */
+extern const BridgeBus bridge_loopback;
+
+#endif /* BRIDGE_BRIDGE_LOOPBACK_H_ */
@@ -0,0 +1,19 @@
+#ifndef BRIDGE_BRIDGE_PERIPHERALS_H_
+#define BRIDGE_BRIDGE_PERIPHERALS_H_
+
+#include "Bridge/bridge_bus.h"
+
+/// \brief Clock of SPI1 in Hz (APB2 / 8).
+#define BRIDGE_SPI_CLOCK 9000000
+/// \brief Clock of I2C1 in Hz (fast mode).
+#define BRIDGE_I2C_CLOCK 400000
+/// \brief Longest I2C operation before the bus is declared stuck (1 KiB takes 23 ms at 400 kHz).
+#define BRIDGE_I2C_TIMEOUT_US 50000
+
+/** \brief The bus of the board: SPI1 in mode 0 (SCK PA5, MISO PA6, MOSI PA7, chip select PA4) through DMA2 streams 2
+ * and 3, and I2C1 (SCL PB8, SDA PB9, external pull-ups) through DMA1 streams 0 and 6. The CPU only starts and ends
+ * each operation.
+ */
+extern const BridgeBus bridge_peripherals;
+
+#endif /* BRIDGE_BRIDGE_PERIPHERALS_H_ */
@@ -0,0 +1,84 @@
+#ifndef BRIDGE_USBD_BRIDGE_H_
+#define BRIDGE_USBD_BRIDGE_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+#include "Bridge/bridge_bus.h"
+
+/** \addtogroup BRIDGE USB to SPI/I2C bridge
+ * \brief Vendor function running batches of bus operations sent by the host.
+ * \details The host writes a batch to the bulk OUT endpoint (0x01): a `BridgeBatchHeader`, then the commands below.
+ * The device runs the commands in order and answers on the bulk IN endpoint (0x81) with a `BridgeResponseHeader`,
+ * then the bytes read by the commands, in order. One batch replaces one control transfer per operation: reading a
+ * page of a SPI flash (select, command, read, release) is one OUT and one IN transfer.
+ *
+ * Two batches and two responses are buffered: the bus runs a batch (with DMA) while the next batch is received and
+ * the previous response is sent. The integers are little endian.
+ * @{ */
+
+/// \brief Maximum packet size of the bulk endpoints.
+#define BRIDGE_PACKET_SIZE 64
+/// \brief Largest batch (header included) in bytes.
+#define BRIDGE_BATCH_SIZE 1024
+/// \brief Largest response (header included) in bytes.
+#define BRIDGE_RESPONSE_SIZE 1024
+
+/**\name Commands (opcode, then the parameters)
+ * @{ */
+#define BRIDGE_SPI_SELECT 0x01 /**<\brief u8: 1 asserts the chip select, 0 releases it.*/
+#define BRIDGE_SPI_TRANSFER 0x02 /**<\brief u16 size, size bytes to send; the bytes received go to the response.*/
+#define BRIDGE_SPI_READ 0x03 /**<\brief u16 size; sends 0xFF, the bytes received go to the response.*/
+#define BRIDGE_SPI_WRITE 0x04 /**<\brief u16 size, size bytes to send; the bytes received are dropped.*/
+#define BRIDGE_DELAY 0x05 /**<\brief u16 µs to wait.*/
+#define BRIDGE_I2C_WRITE 0x06 /**<\brief u8 7-bit address, u16 size, size bytes to send.*/
+#define BRIDGE_I2C_READ 0x07 /**<\brief u8 7-bit address, u16 size; the bytes read go to the response.*/
+/** @} */
+
+/**\name Vendor requests (recipient: device)
+ * @{ */
+#define BRIDGE_RESET 0x01 /**<\brief Drops the batches and responses in progress (the chip select is released); the status stage waits for the end of the bus operation in progress.*/
+/** @} */
+
+typedef enum
+{
+	BRIDGE_STATUS_OK = 0,
+	BRIDGE_STATUS_BAD_COMMAND = 1, ///< Unknown opcode, or a command cut by the end of the batch.
+	BRIDGE_STATUS_RESPONSE_FULL = 2, ///< The bytes read do not fit in the response.
+	BRIDGE_STATUS_BUS_ERROR = 3 ///< The bus failed (e.g. no acknowledge on I2C).
+} BridgeStatus;
+
+typedef struct
+{
+	/// \brief Size of the commands that follow.
+	uint16_t length;
+	/// \brief Copied to the response.
+	uint8_t sequence;
+	uint8_t reserved;
+} BridgeBatchHeader;
+
+/** \brief Header of a response: the batch stops at its first failing command, and the chip select is released.
+ */
+typedef struct
+{
+	/// \brief Size of the bytes read that follow.
+	uint16_t length;
+	/// \brief The sequence of the batch.
+	uint8_t sequence;
+	/// \brief `BridgeStatus`.
+	uint8_t status;
+	/// \brief Count of commands that completed.
+	uint16_t completed_commands;
+	/// \brief Offset of the failing command in the commands (meaningful when the status is not OK).
+	uint16_t error_offset;
+} BridgeResponseHeader;
+
+_Static_assert(sizeof(BridgeBatchHeader) == 4, "The header is received as it is stored");
+_Static_assert(sizeof(BridgeResponseHeader) == 8, "The header is sent as it is stored");
+
+/** @} */
+
+extern const UsbClass usbd_bridge_class;
+
+void usbd_bridge_set_bus(BridgeBus const *bus);
+
+#endif /* BRIDGE_USBD_BRIDGE_H_ */
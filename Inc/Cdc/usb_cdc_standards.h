@@ -0,0 +1,197 @@
+#ifndef CDC_USB_CDC_STANDARDS_H_
+#define CDC_USB_CDC_STANDARDS_H_
+
+#include <stdint.h>
+
+/** \addtogroup USB_CDC USB CDC class
+ * \brief Communications Device Class definitions
+ * \details Based on
+ * + [Class definitions for Communication Devices 1.2](https://www.usb.org/document-library/class-definitions-communication-devices-12)
+ * + [PSTN Devices 1.2] (the ACM subclass)
+ * + [Network Control Model Devices 1.0](https://www.usb.org/document-library/network-control-model-devices-specification-v10-and-errata-and-adopters-agreement) (the NCM subclass)
+ * @{ */
+
+/**\name Class, subclass and protocol codes
+ * @{ */
+#define USB_CLASS_CDC 0x02 /**<\brief Communications interface class (also device class).*/
+#define USB_CLASS_CDC_DATA 0x0A /**<\brief Data interface class.*/
+#define USB_CDC_SUBCLASS_ACM 0x02 /**<\brief Abstract Control Model.*/
+#define USB_CDC_SUBCLASS_NCM 0x0D /**<\brief Network Control Model.*/
+#define USB_CDC_PROTOCOL_NONE 0x00 /**<\brief No class specific protocol.*/
+#define USB_CDC_PROTOCOL_V25TER 0x01 /**<\brief AT commands (V.250).*/
+#define USB_CDC_DATA_PROTOCOL_NCM 0x01 /**<\brief Network Transfer Blocks (protocol of the NCM data interface).*/
+/** @} */
+
+/**\name Functional descriptor subtypes
+ * @{ */
+#define USB_CDC_SUBTYPE_HEADER 0x00 /**<\brief Header functional descriptor.*/
+#define USB_CDC_SUBTYPE_CALL_MANAGEMENT 0x01 /**<\brief Call management functional descriptor.*/
+#define USB_CDC_SUBTYPE_ACM 0x02 /**<\brief Abstract control management functional descriptor.*/
+#define USB_CDC_SUBTYPE_UNION 0x06 /**<\brief Union functional descriptor.*/
+#define USB_CDC_SUBTYPE_ETHERNET 0x0F /**<\brief Ethernet networking functional descriptor.*/
+#define USB_CDC_SUBTYPE_NCM 0x1A /**<\brief NCM functional descriptor.*/
+/** @} */
+
+/**\name Class requests
+ * @{ */
+#define USB_CDC_SEND_ENCAPSULATED_COMMAND 0x00 /**<\brief Issues a command in the format of the control protocol.*/
+#define USB_CDC_GET_ENCAPSULATED_RESPONSE 0x01 /**<\brief Requests a response in the format of the control protocol.*/
+#define USB_CDC_SET_LINE_CODING 0x20 /**<\brief Sets the asynchronous serial line parameters.*/
+#define USB_CDC_GET_LINE_CODING 0x21 /**<\brief Returns the asynchronous serial line parameters.*/
+#define USB_CDC_SET_CONTROL_LINE_STATE 0x22 /**<\brief Sets the RS-232 control signals (DTR, RTS).*/
+#define USB_CDC_SEND_BREAK 0x23 /**<\brief Sends a break (RS-232 style).*/
+#define USB_CDC_SET_ETHERNET_PACKET_FILTER 0x43 /**<\brief Selects the frames the device forwards (broadcast, multicast...).*/
+#define USB_CDC_GET_NTB_PARAMETERS 0x80 /**<\brief Returns `UsbCdcNtbParameters`.*/
+#define USB_CDC_GET_NTB_FORMAT 0x83 /**<\brief Returns the NTB format (0: 16-bit, 1: 32-bit).*/
+#define USB_CDC_SET_NTB_FORMAT 0x84 /**<\brief Selects the NTB format.*/
+#define USB_CDC_GET_NTB_INPUT_SIZE 0x85 /**<\brief Returns the maximum size of the IN NTBs (4 bytes).*/
+#define USB_CDC_SET_NTB_INPUT_SIZE 0x86 /**<\brief Sets the maximum size of the IN NTBs (4 bytes).*/
+/** @} */
+
+/**\name Notifications
+ * @{ */
+#define USB_CDC_NOTIFICATION_NETWORK_CONNECTION 0x00 /**<\brief Network connection status changed.*/
+#define USB_CDC_NOTIFICATION_SERIAL_STATE 0x20 /**<\brief Serial line state changed.*/
+#define USB_CDC_NOTIFICATION_CONNECTION_SPEED_CHANGE 0x2A /**<\brief Network link speed changed.*/
+/** @} */
+
+/**\name SET_CONTROL_LINE_STATE bits (wValue)
+ * @{ */
+#define USB_CDC_CONTROL_LINE_DTR (1 << 0) /**<\brief Data terminal ready (the host opened the port).*/
+#define USB_CDC_CONTROL_LINE_RTS (1 << 1) /**<\brief Request to send.*/
+/** @} */
+
+/**\name SERIAL_STATE notification bits
+ * @{ */
+#define USB_CDC_SERIAL_STATE_DCD (1 << 0) /**<\brief Data carrier detect.*/
+#define USB_CDC_SERIAL_STATE_DSR (1 << 1) /**<\brief Data set ready.*/
+#define USB_CDC_SERIAL_STATE_BREAK (1 << 2) /**<\brief Break detected.*/
+#define USB_CDC_SERIAL_STATE_RING (1 << 3) /**<\brief Ring signal detected.*/
+#define USB_CDC_SERIAL_STATE_FRAMING (1 << 4) /**<\brief Framing error.*/
+#define USB_CDC_SERIAL_STATE_PARITY (1 << 5) /**<\brief Parity error.*/
+#define USB_CDC_SERIAL_STATE_OVERRUN (1 << 6) /**<\brief Received data was discarded (buffer overrun).*/
+/** @} */
+
+/** \brief Header functional descriptor. */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_HEADER. */
+	uint16_t bcdCDC; /**<\brief BCD encoded version of the CDC specification. */
+} __attribute__((__packed__)) UsbCdcHeaderDescriptor;
+
+/** \brief Call management functional descriptor. */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_CALL_MANAGEMENT. */
+	uint8_t bmCapabilities; /**<\brief Call management capabilities (0: the device does not handle calls). */
+	uint8_t bDataInterface; /**<\brief Number of the data interface used for call management. */
+} __attribute__((__packed__)) UsbCdcCallManagementDescriptor;
+
+/** \brief Abstract control management functional descriptor. */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_ACM. */
+	uint8_t bmCapabilities; /**<\brief Supported requests (bit 1: line coding and control line state, bit 2: break). */
+} __attribute__((__packed__)) UsbCdcAcmDescriptor;
+
+/** \brief Union functional descriptor (groups the communications interface with its data interface). */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_UNION. */
+	uint8_t bMasterInterface0; /**<\brief Number of the communications interface. */
+	uint8_t bSlaveInterface0; /**<\brief Number of the data interface. */
+} __attribute__((__packed__)) UsbCdcUnionDescriptor;
+
+/** \brief Line coding (data of SET_LINE_CODING and GET_LINE_CODING). */
+typedef struct {
+	uint32_t dwDTERate; /**<\brief Data terminal rate (bits per second). */
+	uint8_t bCharFormat; /**<\brief Stop bits: 0 = 1, 1 = 1.5, 2 = 2. */
+	uint8_t bParityType; /**<\brief Parity: 0 = none, 1 = odd, 2 = even, 3 = mark, 4 = space. */
+	uint8_t bDataBits; /**<\brief Data bits (5, 6, 7, 8 or 16). */
+} __attribute__((__packed__)) UsbCdcLineCoding;
+
+/** \brief SERIAL_STATE notification (sent on the notification interrupt IN endpoint). */
+typedef struct {
+	uint8_t bmRequestType; /**<\brief 0xA1: class, interface, device to host. */
+	uint8_t bNotification; /**<\brief \ref USB_CDC_NOTIFICATION_SERIAL_STATE. */
+	uint16_t wValue; /**<\brief 0. */
+	uint16_t wIndex; /**<\brief Number of the communications interface. */
+	uint16_t wLength; /**<\brief Size of the data (2). */
+	uint16_t wSerialState; /**<\brief The serial state bits. */
+} __attribute__((__packed__)) UsbCdcSerialStateNotification;
+
+/** \brief Ethernet networking functional descriptor. */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_ETHERNET. */
+	uint8_t iMACAddress; /**<\brief Index of the string descriptor of the MAC address (12 hexadecimal digits). */
+	uint32_t bmEthernetStatistics; /**<\brief Statistics the device collects (0: none). */
+	uint16_t wMaxSegmentSize; /**<\brief Largest Ethernet frame without the CRC (1514 bytes). */
+	uint16_t wNumberMCFilters; /**<\brief Count of multicast filters (0: none). */
+	uint8_t bNumberPowerFilters; /**<\brief Count of wake-up pattern filters. */
+} __attribute__((__packed__)) UsbCdcEthernetDescriptor;
+
+/** \brief NCM functional descriptor. */
+typedef struct {
+	uint8_t bFunctionLength; /**<\brief Size of the descriptor (bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t bDescriptorSubType; /**<\brief \ref USB_CDC_SUBTYPE_NCM. */
+	uint16_t bcdNcmVersion; /**<\brief 0x0100. */
+	uint8_t bmNetworkCapabilities; /**<\brief Supported requests (bit 0: SET_ETHERNET_PACKET_FILTER). */
+} __attribute__((__packed__)) UsbCdcNcmDescriptor;
+
+/** \brief Data of the GET_NTB_PARAMETERS request. */
+typedef struct {
+	uint16_t wLength; /**<\brief Size of the structure (28 bytes). */
+	uint16_t bmNtbFormatsSupported; /**<\brief Bit 0: 16-bit NTBs, bit 1: 32-bit NTBs. */
+	uint32_t dwNtbInMaxSize; /**<\brief Largest IN NTB the device can send. */
+	uint16_t wNdpInDivisor; /**<\brief The IN datagrams start at offsets n * divisor + remainder. */
+	uint16_t wNdpInPayloadRemainder; /**<\brief See `wNdpInDivisor`. */
+	uint16_t wNdpInAlignment; /**<\brief Alignment of the IN NDPs. */
+	uint16_t wReserved;
+	uint32_t dwNtbOutMaxSize; /**<\brief Largest OUT NTB the device can receive. */
+	uint16_t wNdpOutDivisor; /**<\brief The host starts the OUT datagrams at offsets n * divisor + remainder. */
+	uint16_t wNdpOutPayloadRemainder; /**<\brief See `wNdpOutDivisor`. */
+	uint16_t wNdpOutAlignment; /**<\brief Alignment of the OUT NDPs. */
+	uint16_t wNtbOutMaxDatagrams; /**<\brief Most datagrams in an OUT NTB (0: no limit). */
+} __attribute__((__packed__)) UsbCdcNtbParameters;
+
+#define USB_CDC_NTH16_SIGNATURE 0x484D434E /**<\brief "NCMH".*/
+#define USB_CDC_NDP16_SIGNATURE 0x304D434E /**<\brief "NCM0" (datagrams without CRC).*/
+
+/** \brief NTB header (16-bit NTB), at the start of each NTB. */
+typedef struct {
+	uint32_t dwSignature; /**<\brief \ref USB_CDC_NTH16_SIGNATURE. */
+	uint16_t wHeaderLength; /**<\brief Size of the header (12 bytes). */
+	uint16_t wSequence; /**<\brief Sequence number of the NTB. */
+	uint16_t wBlockLength; /**<\brief Size of the NTB. */
+	uint16_t wNdpIndex; /**<\brief Offset of the first NDP. */
+} __attribute__((__packed__)) UsbCdcNth16;
+
+/** \brief NTB datagram pointer table (16-bit NTB); the (wDatagramIndex, wDatagramLength) pairs follow, the last one
+ * is (0, 0). */
+typedef struct {
+	uint32_t dwSignature; /**<\brief \ref USB_CDC_NDP16_SIGNATURE. */
+	uint16_t wLength; /**<\brief Size of the table (a multiple of 4, at least 16). */
+	uint16_t wNextNdpIndex; /**<\brief Offset of the next NDP (0: the last one). */
+} __attribute__((__packed__)) UsbCdcNdp16;
+
+/** \brief NETWORK_CONNECTION and CONNECTION_SPEED_CHANGE notifications (the latter carries the 2 speeds). */
+typedef struct {
+	uint8_t bmRequestType; /**<\brief 0xA1: class, interface, device to host. */
+	uint8_t bNotification; /**<\brief USB_CDC_NOTIFICATION_*. */
+	uint16_t wValue; /**<\brief NETWORK_CONNECTION: 1 when connected. */
+	uint16_t wIndex; /**<\brief Number of the communications interface. */
+	uint16_t wLength; /**<\brief Size of the data (0, or 8 for the speeds). */
+	uint32_t dwDLBitRate; /**<\brief Speed from the device to the host (bits per second). */
+	uint32_t dwULBitRate; /**<\brief Speed from the host to the device (bits per second). */
+} __attribute__((__packed__)) UsbCdcNetworkNotification;
+
+/** @} */
+
+#endif /* CDC_USB_CDC_STANDARDS_H_ */
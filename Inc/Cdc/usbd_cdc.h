@@ -0,0 +1,97 @@
+#ifndef CDC_USBD_CDC_H_
+#define CDC_USBD_CDC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_standards.h"
+#include "Cdc/usb_cdc_standards.h"
+#include "Helpers/ring_buffer.h"
+
+/// \brief Maximum packet size of the bulk data endpoints (the largest full speed bulk packet).
+#define USB_CDC_DATA_PACKET_SIZE 64
+/// \brief Maximum packet size of the notification interrupt endpoint.
+#define USB_CDC_NOTIFICATION_PACKET_SIZE 16
+/// \brief Polling interval (in frames) of the notification interrupt endpoint.
+#define USB_CDC_NOTIFICATION_INTERVAL 16
+
+/** \brief An ACM port (a communications interface and its data interface) handled by the `usbd_cdc_*` functions.
+ * \details The data passes through two single producer, single consumer ring buffers: the application writes `tx`
+ * and reads `rx`, the USB side does the opposite. When `rx` cannot take a full packet anymore, the bulk OUT
+ * endpoint NAKs the host until the application has read enough data.
+ */
+typedef struct
+{
+	/// \brief Number of the communications interface (the wIndex of the class requests).
+	uint8_t comm_interface_number;
+	/// \brief Number of the notification interrupt IN endpoint.
+	uint8_t notification_endpoint_number;
+	/// \brief Number of the bulk IN endpoint.
+	uint8_t data_in_endpoint_number;
+	/// \brief Number of the bulk OUT endpoint.
+	uint8_t data_out_endpoint_number;
+	/// \brief Data received from the host (the storage is set by the function).
+	RingBuffer rx;
+	/// \brief Data to send to the host (the storage is set by the function).
+	RingBuffer tx;
+	/// \brief Maximum size of an IN transfer in bytes: the depth of the TxFIFO of the bulk IN endpoint (set by the function).
+	uint16_t transfer_size;
+	/// \brief Whether the function decides when the port transmits (with `usbd_cdc_transmit()`), instead of the port
+	/// transmitting as soon as its bulk IN endpoint is free.
+	bool scheduled;
+
+	/// \brief The line coding set by the host.
+	UsbCdcLineCoding line_coding;
+	/// \brief Receives the data stage of SET_LINE_CODING.
+	UsbCdcLineCoding received_line_coding;
+	/// \brief The control signals set by the host (\ref USB_CDC_CONTROL_LINE_DTR, \ref USB_CDC_CONTROL_LINE_RTS).
+	uint16_t control_line_state;
+	/// \brief The serial state bits reported to the host.
+	uint16_t serial_state;
+	/// \brief Whether `serial_state` changed since it was last notified.
+	bool serial_state_changed;
+
+	/// \brief Whether the endpoints are configured (no packet is written before).
+	bool configured;
+	/// \brief Whether a data packet is in the TxFIFO waiting for the host to collect it.
+	bool data_in_busy;
+	/// \brief Whether a notification is in the TxFIFO waiting for the host to collect it.
+	bool notification_busy;
+	/// \brief Whether the bulk OUT endpoint NAKs the host because `rx` is full.
+	bool rx_nak;
+	/// \brief Size of the transfer in the TxFIFO (one whose last packet is full must be followed by more data or a ZLP).
+	uint16_t last_transfer_size;
+	/// \brief The notification in the TxFIFO.
+	UsbCdcSerialStateNotification notification __attribute__((aligned(4)));
+	/// \brief Holds a packet that wraps around the end of a ring buffer.
+	uint8_t packet[USB_CDC_DATA_PACKET_SIZE] __attribute__((aligned(4)));
+
+	/// \brief Bytes received from the host since the counters were last reset.
+	uint32_t received_bytes;
+	/// \brief Bytes collected by the host since the counters were last reset.
+	uint32_t sent_bytes;
+	/// \brief Bytes dropped because `rx` was full since the counters were last reset.
+	uint32_t dropped_bytes;
+	/// \brief Times the bulk OUT endpoint started NAKing since the counters were last reset.
+	uint32_t nak_count;
+	/// \brief Largest count of bytes waiting in `rx` since the counters were last reset.
+	uint32_t rx_depth_peak;
+	/// \brief Largest count of bytes waiting in `tx` since the counters were last reset.
+	uint32_t tx_depth_peak;
+} UsbCdcAcmPort;
+
+void usbd_cdc_reset(UsbCdcAcmPort *port);
+void usbd_cdc_configure(UsbCdcAcmPort *port);
+bool usbd_cdc_process_request(UsbCdcAcmPort *port, UsbRequest const *request);
+bool usbd_cdc_process_control_data(UsbCdcAcmPort *port, UsbRequest const *request);
+bool usbd_cdc_out_data_received(UsbCdcAcmPort *port, uint8_t endpoint_number, uint16_t byte_count);
+bool usbd_cdc_in_transfer_completed(UsbCdcAcmPort *port, uint8_t endpoint_number);
+bool usbd_cdc_transmit(UsbCdcAcmPort *port, uint16_t max_size);
+bool usbd_cdc_can_transmit(UsbCdcAcmPort const *port);
+void usbd_cdc_poll(UsbCdcAcmPort *port);
+uint32_t usbd_cdc_write(UsbCdcAcmPort *port, void const *data, uint32_t size);
+uint32_t usbd_cdc_read(UsbCdcAcmPort *port, void *data, uint32_t size);
+void usbd_cdc_loop_back(UsbCdcAcmPort *port);
+void usbd_cdc_set_serial_state(UsbCdcAcmPort *port, uint16_t serial_state);
+void usbd_cdc_reset_counters(UsbCdcAcmPort *port);
+
+#endif /* CDC_USBD_CDC_H_ */
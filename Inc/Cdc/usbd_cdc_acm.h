@@ -0,0 +1,23 @@
+#ifndef CDC_USBD_CDC_ACM_H_
+#define CDC_USBD_CDC_ACM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+#include "Cdc/usb_cdc_standards.h"
+
+/// \brief Size of the receive ring buffer in bytes (a power of two).
+#define CDC_ACM_RX_BUFFER_SIZE 1024
+/// \brief Size of the transmit ring buffer in bytes (a power of two).
+#define CDC_ACM_TX_BUFFER_SIZE 1024
+
+extern const UsbClass usbd_cdc_acm_class;
+
+uint32_t usbd_cdc_acm_write(void const *data, uint32_t size);
+uint32_t usbd_cdc_acm_read(void *data, uint32_t size);
+UsbCdcLineCoding const *usbd_cdc_acm_get_line_coding();
+bool usbd_cdc_acm_is_open();
+void usbd_cdc_acm_set_serial_state(uint16_t serial_state);
+void usbd_cdc_acm_set_receiver(void (*receiver)());
+
+#endif /* CDC_USBD_CDC_ACM_H_ */
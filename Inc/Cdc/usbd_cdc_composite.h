@@ -0,0 +1,28 @@
+#ifndef CDC_USBD_CDC_COMPOSITE_H_
+#define CDC_USBD_CDC_COMPOSITE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+#include "Cdc/usb_cdc_standards.h"
+
+/// \brief Count of ACM ports (each one takes two IN endpoints and one OUT endpoint).
+#define CDC_COMPOSITE_PORT_COUNT 2
+/// \brief Size of the receive ring buffer of each port in bytes (a power of two).
+#define CDC_COMPOSITE_RX_BUFFER_SIZE 1024
+/// \brief Size of the transmit ring buffer of each port in bytes (a power of two).
+#define CDC_COMPOSITE_TX_BUFFER_SIZE 1024
+/// \brief Bytes a port may transmit per scheduling round (deficit round robin quantum).
+#define CDC_COMPOSITE_QUANTUM 256
+/// \brief Largest TxFIFO given to the bulk IN endpoint of a port, in bytes (a multiple of 64).
+#define CDC_COMPOSITE_MAX_TXFIFO_SIZE 512
+
+extern const UsbClass usbd_cdc_composite_class;
+
+uint32_t usbd_cdc_composite_write(uint8_t port_number, void const *data, uint32_t size);
+uint32_t usbd_cdc_composite_read(uint8_t port_number, void *data, uint32_t size);
+UsbCdcLineCoding const *usbd_cdc_composite_get_line_coding(uint8_t port_number);
+bool usbd_cdc_composite_is_open(uint8_t port_number);
+void usbd_cdc_composite_set_receiver(void (*receiver)(uint8_t port_number));
+
+#endif /* CDC_USBD_CDC_COMPOSITE_H_ */
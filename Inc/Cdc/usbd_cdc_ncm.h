@@ -0,0 +1,29 @@
+#ifndef CDC_USBD_CDC_NCM_H_
+#define CDC_USBD_CDC_NCM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+#include "Cdc/usb_cdc_standards.h"
+
+/// \brief Largest NTB in each direction in bytes (the host may ask for smaller IN NTBs with SET_NTB_INPUT_SIZE).
+#define CDC_NCM_NTB_MAX_SIZE 4096
+/// \brief Smallest IN NTB size the host may set (the minimum of the NCM specification).
+#define CDC_NCM_NTB_MIN_SIZE 2048
+/// \brief Most datagrams in an IN NTB.
+#define CDC_NCM_MAX_DATAGRAMS 32
+/// \brief Largest Ethernet frame (without the CRC).
+#define CDC_NCM_MAX_FRAME_SIZE 1514
+/// \brief Default time a datagram waits for more datagrams to share its NTB (µs).
+#define CDC_NCM_DEFAULT_AGGREGATION_TIMEOUT_US 300
+
+/** \brief Network Control Model function: carries Ethernet frames in NTBs (Network Transfer Blocks) that aggregate
+ * many datagrams, so the per packet overhead of USB is shared by all the frames of a block.
+ */
+extern const UsbClass usbd_cdc_ncm_class;
+
+bool usbd_cdc_ncm_send(void const *frame, uint16_t size);
+void usbd_cdc_ncm_set_receiver(bool (*receiver)(void const *frame, uint16_t size));
+void usbd_cdc_ncm_set_aggregation_timeout(uint32_t timeout_us);
+
+#endif /* CDC_USBD_CDC_NCM_H_ */
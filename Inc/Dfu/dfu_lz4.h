@@ -0,0 +1,31 @@
+#ifndef DFU_DFU_LZ4_H_
+#define DFU_DFU_LZ4_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief Decoder of a LZ4 block (the raw block format, without the frame) that arrives in pieces.
+ * \details There is no window in RAM: matches are copied from the decoded stream itself, i.e. from the flash for
+ * what is already programmed, and from the output buffer for the rest. So the matches can use the whole 64 KB
+ * distance of LZ4, and the decoder needs a few bytes of state.
+ */
+typedef struct
+{
+	/// \brief The decoded stream (what is already stored).
+	uint8_t const *history;
+	/// \brief Count of decoded bytes.
+	uint32_t size;
+	/// \brief Bytes of the current literal run or match left to copy.
+	uint32_t length;
+	uint16_t offset;
+	uint8_t token;
+	uint8_t state;
+	bool failed;
+} DfuLz4Decoder;
+
+void dfu_lz4_reset(DfuLz4Decoder *decoder, uint8_t const *history);
+uint32_t dfu_lz4_decode(DfuLz4Decoder *decoder, uint8_t const *input, uint32_t input_size,
+	uint8_t *output, uint32_t output_start, uint32_t output_capacity);
+bool dfu_lz4_is_complete(DfuLz4Decoder const *decoder);
+
+#endif /* DFU_DFU_LZ4_H_ */
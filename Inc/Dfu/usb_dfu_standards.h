@@ -0,0 +1,88 @@
+#ifndef DFU_USB_DFU_STANDARDS_H_
+#define DFU_USB_DFU_STANDARDS_H_
+
+#include <stdint.h>
+
+/** \addtogroup USB_DFU USB device firmware upgrade class
+ * \brief Device Firmware Upgrade definitions
+ * \details Based on [Device Firmware Upgrade 1.1](https://www.usb.org/document-library/device-firmware-upgrade-11-new-version-31-aug-2004)
+ * @{ */
+
+/**\name Subclass and protocol codes (the class is \ref USB_CLASS_APP_SPEC)
+ * @{ */
+#define USB_DFU_SUBCLASS 0x01 /**<\brief Device firmware upgrade.*/
+#define USB_DFU_PROTOCOL_RUNTIME 0x01 /**<\brief The interface of the application (run-time mode).*/
+#define USB_DFU_PROTOCOL_DFU_MODE 0x02 /**<\brief The only interface of the device in DFU mode.*/
+/** @} */
+
+#define USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL 0x21
+
+/**\name DFU attributes (bmAttributes of the functional descriptor)
+ * @{ */
+#define USB_DFU_ATTRIBUTE_CAN_DNLOAD (1 << 0) /**<\brief The host can download firmware.*/
+#define USB_DFU_ATTRIBUTE_CAN_UPLOAD (1 << 1) /**<\brief The host can upload firmware.*/
+#define USB_DFU_ATTRIBUTE_MANIFESTATION_TOLERANT (1 << 2) /**<\brief The device answers requests after the manifestation.*/
+#define USB_DFU_ATTRIBUTE_WILL_DETACH (1 << 3) /**<\brief The device detaches itself on DFU_DETACH.*/
+/** @} */
+
+/**\name Class requests
+ * @{ */
+#define USB_DFU_DETACH 0x00 /**<\brief Switches to DFU mode (run-time mode only).*/
+#define USB_DFU_DNLOAD 0x01 /**<\brief Sends a block of firmware (a block of 0 bytes ends the download).*/
+#define USB_DFU_UPLOAD 0x02 /**<\brief Reads a block of firmware.*/
+#define USB_DFU_GETSTATUS 0x03 /**<\brief Returns `UsbDfuStatus` (and moves the state machine on).*/
+#define USB_DFU_CLRSTATUS 0x04 /**<\brief Leaves the dfuERROR state.*/
+#define USB_DFU_GETSTATE 0x05 /**<\brief Returns the state.*/
+#define USB_DFU_ABORT 0x06 /**<\brief Goes back to dfuIDLE.*/
+/** @} */
+
+/**\name States
+ * @{ */
+#define USB_DFU_STATE_APP_IDLE 0
+#define USB_DFU_STATE_APP_DETACH 1
+#define USB_DFU_STATE_IDLE 2
+#define USB_DFU_STATE_DNLOAD_SYNC 3
+#define USB_DFU_STATE_DNBUSY 4
+#define USB_DFU_STATE_DNLOAD_IDLE 5
+#define USB_DFU_STATE_MANIFEST_SYNC 6
+#define USB_DFU_STATE_MANIFEST 7
+#define USB_DFU_STATE_MANIFEST_WAIT_RESET 8
+#define USB_DFU_STATE_UPLOAD_IDLE 9
+#define USB_DFU_STATE_ERROR 10
+/** @} */
+
+/**\name Status codes
+ * @{ */
+#define USB_DFU_STATUS_OK 0x00
+#define USB_DFU_STATUS_ERR_TARGET 0x01
+#define USB_DFU_STATUS_ERR_FILE 0x02
+#define USB_DFU_STATUS_ERR_WRITE 0x03
+#define USB_DFU_STATUS_ERR_ERASE 0x04
+#define USB_DFU_STATUS_ERR_PROG 0x06
+#define USB_DFU_STATUS_ERR_VERIFY 0x07
+#define USB_DFU_STATUS_ERR_ADDRESS 0x08
+#define USB_DFU_STATUS_ERR_NOTDONE 0x09
+#define USB_DFU_STATUS_ERR_STALLEDPKT 0x0F
+/** @} */
+
+/** \brief DFU functional descriptor (follows the DFU interface descriptor). */
+typedef struct {
+	uint8_t bLength; /**<\brief Size of the descriptor (9 bytes). */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL. */
+	uint8_t bmAttributes; /**<\brief USB_DFU_ATTRIBUTE_*. */
+	uint16_t wDetachTimeOut; /**<\brief Time the device waits for a USB reset after DFU_DETACH (ms). */
+	uint16_t wTransferSize; /**<\brief Maximum size of a DNLOAD or UPLOAD block. */
+	uint16_t bcdDFUVersion; /**<\brief 0x0110. */
+} __attribute__((__packed__)) UsbDfuFunctionalDescriptor;
+
+/** \brief Data of the DFU_GETSTATUS request. */
+typedef struct {
+	uint8_t bStatus; /**<\brief USB_DFU_STATUS_*. */
+	uint8_t bwPollTimeout[3]; /**<\brief Time the host waits before the next GETSTATUS (ms, little endian). */
+	uint8_t bState; /**<\brief USB_DFU_STATE_* (the state after the request). */
+	uint8_t iString; /**<\brief String describing the status. */
+} __attribute__((__packed__)) UsbDfuStatus;
+
+/** @} */
+
+#endif /* DFU_USB_DFU_STANDARDS_H_ */
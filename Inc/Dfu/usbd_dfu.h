@@ -0,0 +1,42 @@
+#ifndef DFU_USBD_DFU_H_
+#define DFU_USBD_DFU_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+
+/// \brief Size of the DNLOAD and UPLOAD blocks in bytes (two blocks are buffered).
+#define DFU_TRANSFER_SIZE 1024
+/// \brief The first sector of the update slot (sectors 12 - 16: the start of bank 2, 128 KB).
+#define DFU_SLOT_FIRST_SECTOR 12
+/// \brief Count of sectors of the update slot.
+#define DFU_SLOT_SECTOR_COUNT 5
+/// \brief Size of the update slot in bytes.
+#define DFU_SLOT_SIZE (128 * 1024)
+
+/// \brief Magic number of `DfuImageHeader` ("DFUI").
+#define DFU_IMAGE_MAGIC 0x49554644
+/// \brief The image follows the header as a LZ4 block (the raw block format, without the frame).
+#define DFU_IMAGE_FLAG_LZ4 (1 << 0)
+
+/** \brief Optional header at the start of a download (a raw image without it is written as is, and not verified);
+ * host/dfu_pack.cpp writes it.
+ */
+typedef struct
+{
+	/// \brief \ref DFU_IMAGE_MAGIC.
+	uint32_t magic;
+	/// \brief DFU_IMAGE_FLAG_*.
+	uint32_t flags;
+	/// \brief Size of the image in bytes (once decompressed).
+	uint32_t image_size;
+	/// \brief CRC-32/MPEG-2 of the image padded with 0xFF to whole words, the words read in little endian (the CRC of
+	/// the STM32 CRC unit).
+	uint32_t crc;
+} DfuImageHeader;
+
+/** \brief Firmware update function: the host downloads an image into the update slot (installing it is up to a
+ * bootloader). The device starts in run-time mode and switches to DFU mode on DFU_DETACH.
+ */
+extern const UsbClass usbd_dfu_class;
+
+#endif /* DFU_USBD_DFU_H_ */
@@ -0,0 +1,10 @@
+#ifndef HELPERS_CRC_H_
+#define HELPERS_CRC_H_
+
+#include <stdint.h>
+
+void crc_reset();
+void crc_accumulate(void const *data, uint32_t size);
+uint32_t crc_value();
+
+#endif /* HELPERS_CRC_H_ */
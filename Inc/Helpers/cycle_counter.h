@@ -0,0 +1,43 @@
+#ifndef HELPERS_CYCLE_COUNTER_H_
+#define HELPERS_CYCLE_COUNTER_H_
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+/** \brief Enables the DWT cycle counter (counts core clock cycles).
+ */
+inline static void cycle_counter_initialize()
+{
+	// Enables the trace and debug blocks (DWT is one of them).
+	SET_BIT(CoreDebug->DEMCR, CoreDebug_DEMCR_TRCENA_Msk);
+
+	// Resets and starts the cycle counter.
+	WRITE_REG(DWT->CYCCNT, 0);
+	SET_BIT(DWT->CTRL, DWT_CTRL_CYCCNTENA_Msk);
+}
+
+/** \brief Returns the current value of the DWT cycle counter.
+ */
+inline static uint32_t cycle_counter_now()
+{
+	return DWT->CYCCNT;
+}
+
+/** \brief Converts a count of core clock cycles to microseconds.
+ * \param cycles The count of cycles.
+ */
+inline static uint32_t cycle_counter_to_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000);
+}
+
+/** \brief Returns the count of microseconds elapsed since a timestamp.
+ * \param timestamp A previous value of the cycle counter.
+ * \note The counter wraps around after ~59 seconds at 72 MHz.
+ */
+inline static uint32_t cycle_counter_elapsed_us(uint32_t timestamp)
+{
+	return cycle_counter_to_us(cycle_counter_now() - timestamp);
+}
+
+#endif /* HELPERS_CYCLE_COUNTER_H_ */
@@ -0,0 +1,27 @@
+#ifndef HELPERS_FLASH_H_
+#define HELPERS_FLASH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f4xx.h"
+
+/** \brief Count of sectors of the internal flash (2 MB: sectors 0 - 11 in bank 1, sectors 12 - 23 in bank 2).
+ * \note The firmware runs from bank 1, so erasing or programming bank 2 does not stall it.
+ */
+#define FLASH_SECTOR_COUNT 24
+
+/** \brief Returns whether an erase or a program is in progress.
+ */
+inline static bool flash_is_busy()
+{
+	return READ_BIT(FLASH->SR, FLASH_SR_BSY) != 0;
+}
+
+uint32_t flash_sector_address(uint8_t sector);
+uint32_t flash_sector_size(uint8_t sector);
+void flash_wait();
+void flash_start_erase(uint8_t sector);
+bool flash_complete_erase();
+bool flash_program(uint32_t address, void const *data, uint32_t size);
+
+#endif /* HELPERS_FLASH_H_ */
@@ -0,0 +1,31 @@
+#ifndef HELPERS_LATENCY_H_
+#define HELPERS_LATENCY_H_
+
+#include <stdint.h>
+
+/// \brief Width of one histogram bucket in microseconds.
+#define LATENCY_BUCKET_WIDTH_US 100
+/// \brief Count of histogram buckets (the last bucket also holds all larger samples).
+#define LATENCY_BUCKET_COUNT 32
+
+/// \brief Distribution of latency samples measured with the DWT cycle counter.
+typedef struct
+{
+	/// \brief Count of recorded samples.
+	uint32_t count;
+	/// \brief Shortest recorded latency (cycles).
+	uint32_t min;
+	/// \brief Longest recorded latency (cycles).
+	uint32_t max;
+	/// \brief Sum of all recorded latencies (cycles).
+	uint64_t total;
+	/// \brief Count of samples that fell in each \ref LATENCY_BUCKET_WIDTH_US wide bucket.
+	uint32_t buckets[LATENCY_BUCKET_COUNT];
+} LatencyStatistics;
+
+void latency_reset(LatencyStatistics *statistics);
+void latency_record(LatencyStatistics *statistics, uint32_t start_timestamp, uint32_t end_timestamp);
+uint32_t latency_percentile_us(LatencyStatistics const *statistics, uint8_t percentile);
+void latency_log(char const * const label, LatencyStatistics const *statistics);
+
+#endif /* HELPERS_LATENCY_H_ */
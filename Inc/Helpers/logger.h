@@ -1,16 +1,99 @@
+#ifndef HELPERS_LOGGER_H_
+#define HELPERS_LOGGER_H_
+
 #include <stdint.h>
 
+/** \name Levels as numbers, for the preprocessor (see \ref LOG_COMPILE_LEVEL)
+ * @{ */
+#define LOG_THRESHOLD_NONE -1
+#define LOG_THRESHOLD_ERROR 0
+#define LOG_THRESHOLD_INFORMATION 1
+#define LOG_THRESHOLD_DEBUG 2
+/** @} */
+
+/** \brief Most verbose level compiled in (e.g. `-DLOG_COMPILE_LEVEL=LOG_THRESHOLD_INFORMATION`).
+ * The logs above it are removed by the preprocessor: no code, no format in flash, no argument evaluated. Debug builds
+ * keep all the logs; other builds keep none, and the logger itself is left out.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#ifdef DEBUG
+#define LOG_COMPILE_LEVEL LOG_THRESHOLD_DEBUG
+#else
+#define LOG_COMPILE_LEVEL LOG_THRESHOLD_NONE
+#endif
+#endif
+
 typedef enum
 {
-    LOG_LEVEL_ERROR,
-    LOG_LEVEL_INFORMATION,
-    LOG_LEVEL_DEBUG
+    LOG_LEVEL_ERROR = LOG_THRESHOLD_ERROR,
+    LOG_LEVEL_INFORMATION = LOG_THRESHOLD_INFORMATION,
+    LOG_LEVEL_DEBUG = LOG_THRESHOLD_DEBUG
 } LogLevel;
 
 /// The global variable `system_log_level` should be defined and given the desired log level.
+/// It filters at run time the logs compiled in (see \ref LOG_COMPILE_LEVEL).
 extern LogLevel system_log_level;
 
-void log_error(char const * const format, ...);
-void log_info(char const * const format, ...);
-void log_debug(char const * const format, ...);
-void log_debug_array(char const * const label, void const *array, uint16_t const len);
\ No newline at end of file
+/// \brief Size of the ring buffer of the records in bytes (a power of two).
+#define LOG_BUFFER_SIZE 4096
+/// \brief Most arguments after the format of a log.
+#define LOG_MAX_ARGUMENTS 12
+/// \brief Most bytes of an array kept by `log_debug_array()` (the rest is counted, not shown).
+#define LOG_MAX_ARRAY_SIZE 64
+
+/// \brief Counts the arguments after the format (up to \ref LOG_MAX_ARGUMENTS).
+#define LOG_COUNT_ARGUMENTS(...) LOG_PICK_COUNT(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_PICK_COUNT(format, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, count, ...) count
+
+/// \brief A log compiled in: compares the level with `system_log_level` before the arguments are evaluated.
+#define LOG_WRITE(log_level, ...) do { \
+        if ((log_level) <= system_log_level) \
+            log_write((log_level), LOG_COUNT_ARGUMENTS(__VA_ARGS__), __VA_ARGS__); \
+    } while (0)
+/// \brief A log compiled out: only an operand of `sizeof`, so the call is still checked (and its variables are still
+/// used) but nothing is evaluated or emitted.
+#define LOG_DISCARD(call) ((void)sizeof((call, 0)))
+
+/** \name Logs
+ * \brief The logs are deferred: a call only stores the address of its format (the token) and its arguments as raw
+ * 32-bit words in a RAM ring buffer; `log_drain()` formats them later, when the main loop has time.
+ * \note The arguments are integers or pointers (no 64-bit or floating point values), and a `%s` argument must point to
+ * a string that outlives the log (e.g. a literal). The ring buffer has a single producer: log from the main loop, not
+ * from interrupts. The arguments may not be evaluated at all (see \ref LOG_COMPILE_LEVEL): no side effects.
+ * @{ */
+#if LOG_COMPILE_LEVEL >= LOG_THRESHOLD_ERROR
+#define log_error(...) LOG_WRITE(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define log_error(...) LOG_DISCARD(log_write(LOG_LEVEL_ERROR, 0, __VA_ARGS__))
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_THRESHOLD_INFORMATION
+#define log_info(...) LOG_WRITE(LOG_LEVEL_INFORMATION, __VA_ARGS__)
+#else
+#define log_info(...) LOG_DISCARD(log_write(LOG_LEVEL_INFORMATION, 0, __VA_ARGS__))
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_THRESHOLD_DEBUG
+#define log_debug(...) LOG_WRITE(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_debug_array(label, array, len) do { \
+        if (LOG_LEVEL_DEBUG <= system_log_level) \
+            log_write_array((label), (array), (len)); \
+    } while (0)
+#else
+#define log_debug(...) LOG_DISCARD(log_write(LOG_LEVEL_DEBUG, 0, __VA_ARGS__))
+#define log_debug_array(label, array, len) LOG_DISCARD(log_write_array((label), (array), (len)))
+#endif
+/** @} */
+
+void log_write(LogLevel const log_level, uint8_t const argument_count, char const * const format, ...);
+void log_write_array(char const * const label, void const *array, uint16_t const len);
+
+#if LOG_COMPILE_LEVEL >= LOG_THRESHOLD_ERROR
+void log_drain();
+void log_flush();
+#else
+#define log_drain() ((void)0)
+#define log_flush() ((void)0)
+#endif
+
+#endif /* HELPERS_LOGGER_H_ */
@@ -3,5 +3,6 @@
 #define HELPERS_MATH_H_
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
 
 #endif /* HELPERS_MATH_H_ */
@@ -0,0 +1,46 @@
+#ifndef HELPERS_RING_BUFFER_H_
+#define HELPERS_RING_BUFFER_H_
+
+#include <stdint.h>
+
+/** \brief Lock-free ring buffer with a single producer and a single consumer.
+ * \details The producer only writes `head` and the consumer only writes `tail`, so one side can run in an
+ * interrupt (or another loop) while the other one runs without any lock. Both indices count bytes since the
+ * initialization and wrap around naturally; the size must be a power of two.
+ */
+typedef struct
+{
+	/// \brief The storage of the data.
+	uint8_t *buffer;
+	/// \brief Size of `buffer` in bytes (a power of two).
+	uint32_t size;
+	/// \brief Count of bytes written since the initialization (written by the producer only).
+	volatile uint32_t head;
+	/// \brief Count of bytes read since the initialization (written by the consumer only).
+	volatile uint32_t tail;
+} RingBuffer;
+
+/** \brief Returns the count of bytes that can be read.
+ */
+inline static uint32_t ring_buffer_used(RingBuffer const *ring_buffer)
+{
+	return ring_buffer->head - ring_buffer->tail;
+}
+
+/** \brief Returns the count of bytes that can be written.
+ */
+inline static uint32_t ring_buffer_free(RingBuffer const *ring_buffer)
+{
+	return ring_buffer->size - ring_buffer_used(ring_buffer);
+}
+
+void ring_buffer_initialize(RingBuffer *ring_buffer, void *storage, uint32_t size);
+void ring_buffer_clear(RingBuffer *ring_buffer);
+uint32_t ring_buffer_write(RingBuffer *ring_buffer, void const *data, uint32_t size);
+uint32_t ring_buffer_read(RingBuffer *ring_buffer, void *data, uint32_t size);
+uint32_t ring_buffer_write_region(RingBuffer const *ring_buffer, void **region);
+void ring_buffer_commit_write(RingBuffer *ring_buffer, uint32_t size);
+uint32_t ring_buffer_read_region(RingBuffer const *ring_buffer, void const **region);
+void ring_buffer_commit_read(RingBuffer *ring_buffer, uint32_t size);
+
+#endif /* HELPERS_RING_BUFFER_H_ */
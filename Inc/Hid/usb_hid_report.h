@@ -0,0 +1,153 @@
+#ifndef HID_USB_HID_REPORT_H_
+#define HID_USB_HID_REPORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "usb_hid.h"
+
+/**\ingroup USB_HID
+ * \addtogroup USB_HID_REPORT HID report layouts
+ * \brief Declares a HID report once and derives both its report descriptor items and its packed C structure.
+ * \details A report layout is a macro that lists its fields in report order, each one as `FIELD(kind, name, ...)`:
+ *
+ * Kind            | Arguments                                                               | Member
+ * ----------------|-------------------------------------------------------------------------|-----------------
+ * VALUE           | name, type, page, usage, logical min, logical max, flags                | `type name`
+ * ARRAY           | name, type, count, page, usage min, usage max, logical min, logical max, flags | `type name[count]`
+ * BITMAP          | name, type, page, usage min, usage max, flags                           | `type name` (one bit per usage, all bits used)
+ * BITMAP_PADDED   | name, type, page, usage min, usage max, flags                           | `type name` (unused high bits are constant padding)
+ * BITMAP_ARRAY    | name, type, count, page, usage min, usage max, flags                    | `type name[count]` (all bits used)
+ * PADDING         | name, type                                                              | `type name` (constant)
+ *
+ * Every field is byte aligned and has the size of its C type, so encoding a report is a plain store to the member.
+ * \ref HID_REPORT_ASSERTS checks at compile time that the items and the structure agree.
+ *
+ * \code
+ * #define MOUSE_REPORT(FIELD) \
+ *     FIELD(VALUE, x, int8_t, HID_PAGE_DESKTOP, HID_DESKTOP_X, -127, 127, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE) \
+ *     FIELD(BITMAP_PADDED, buttons, uint8_t, HID_PAGE_BUTTON, 1, 3, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+ *
+ * HID_REPORT_STRUCT(MouseReport, MOUSE_REPORT);
+ * HID_REPORT_ASSERTS(MouseReport, MOUSE_REPORT);
+ *
+ * const uint8_t report_descriptor[] = {
+ *     ...
+ *     HID_REPORT_ITEMS(MOUSE_REPORT, INPUT)
+ *     ...
+ * };
+ * \endcode
+ *
+ * When an interface has several reports, each one is prefixed by its report ID: \ref HID_REPORT_WITH_ID wraps the
+ * structure of a layout and \ref HID_REPORT_ITEMS_WITH_ID emits the Report ID item before the items of the layout.
+ * @{ */
+
+/** \brief Declares the packed structure of a report layout.
+ * \param name Name of the structure type.
+ * \param FIELDS The report layout macro.
+ */
+#define HID_REPORT_STRUCT(name, FIELDS) \
+	typedef struct { FIELDS(_HID_REPORT_MEMBER) } __attribute__((__packed__)) name
+
+/** \brief Expands to the report descriptor items of a report layout (each item followed by a comma).
+ * \param FIELDS The report layout macro.
+ * \param main The main item of the fields: INPUT, OUTPUT or FEATURE.
+ */
+#define HID_REPORT_ITEMS(FIELDS, main) FIELDS(_HID_REPORT_ITEMS_##main)
+
+/** \brief Size of a report layout in bits, computed from its descriptor items.
+ * \param FIELDS The report layout macro.
+ */
+#define HID_REPORT_BITS(FIELDS) (0 FIELDS(_HID_REPORT_FIELD_BITS))
+
+/** \brief Compile-time checks that a report structure matches its descriptor items.
+ * \param name Name of the structure type.
+ * \param FIELDS The report layout macro.
+ */
+#define HID_REPORT_ASSERTS(name, FIELDS) \
+	FIELDS(_HID_REPORT_CHECK) \
+	_Static_assert(sizeof(name) * 8 == HID_REPORT_BITS(FIELDS), #name " does not match its report descriptor items")
+
+/** \brief Declares the structure of a report that is prefixed by its report ID.
+ * \param name Name of the structure type.
+ * \param report_type The structure of the report layout (declared with \ref HID_REPORT_STRUCT).
+ */
+#define HID_REPORT_WITH_ID(name, report_type) \
+	typedef struct { uint8_t report_id; report_type report; } __attribute__((__packed__)) name
+
+/** \brief Expands to the Report ID item followed by the report descriptor items of a report layout.
+ * \param report_id The report ID (1 - 255); all the reports of an interface must have one if any has.
+ * \param FIELDS The report layout macro.
+ * \param main The main item of the fields: INPUT, OUTPUT or FEATURE.
+ */
+#define HID_REPORT_ITEMS_WITH_ID(report_id, FIELDS, main) \
+	HID_REPORT_ID(report_id), HID_REPORT_ITEMS(FIELDS, main)
+
+/** \brief Byte offset of a field in a report structure. */
+#define HID_REPORT_OFFSET(name, field) offsetof(name, field)
+
+/* Private Interface - For use in this file only: */
+#if !defined(__DOXYGEN__)
+	#define _HID_REPORT_MEMBER(kind, ...)                       _HID_REPORT_MEMBER_##kind(__VA_ARGS__)
+	#define _HID_REPORT_MEMBER_VALUE(name, type, ...)           type name;
+	#define _HID_REPORT_MEMBER_ARRAY(name, type, count, ...)    type name[count];
+	#define _HID_REPORT_MEMBER_BITMAP(name, type, ...)          type name;
+	#define _HID_REPORT_MEMBER_BITMAP_PADDED(name, type, ...)   type name;
+	#define _HID_REPORT_MEMBER_BITMAP_ARRAY(name, type, count, ...) type name[count];
+	#define _HID_REPORT_MEMBER_PADDING(name, type)              type name;
+
+	#define _HID_REPORT_ITEMS_INPUT(kind, ...)                  _HID_REPORT_ITEMS_##kind(HID_RI_INPUT, __VA_ARGS__)
+	#define _HID_REPORT_ITEMS_OUTPUT(kind, ...)                 _HID_REPORT_ITEMS_##kind(HID_RI_OUTPUT, __VA_ARGS__)
+	#define _HID_REPORT_ITEMS_FEATURE(kind, ...)                _HID_REPORT_ITEMS_##kind(HID_RI_FEATURE, __VA_ARGS__)
+
+	#define _HID_REPORT_ITEMS_VALUE(main, name, type, page, usage, logical_min, logical_max, flags) \
+		HID_RI_USAGE_PAGE(16, page), HID_RI_USAGE(16, usage), \
+		HID_RI_LOGICAL_MINIMUM(32, logical_min), HID_RI_LOGICAL_MAXIMUM(32, logical_max), \
+		HID_REPORT_SIZE(sizeof(type) * 8), HID_REPORT_COUNT(1), main(8, flags),
+	#define _HID_REPORT_ITEMS_ARRAY(main, name, type, count, page, usage_min, usage_max, logical_min, logical_max, flags) \
+		HID_RI_USAGE_PAGE(16, page), HID_RI_USAGE_MINIMUM(16, usage_min), HID_RI_USAGE_MAXIMUM(16, usage_max), \
+		HID_RI_LOGICAL_MINIMUM(32, logical_min), HID_RI_LOGICAL_MAXIMUM(32, logical_max), \
+		HID_REPORT_SIZE(sizeof(type) * 8), HID_REPORT_COUNT(count), main(8, flags),
+	#define _HID_REPORT_ITEMS_BITMAP(main, name, type, page, usage_min, usage_max, flags) \
+		HID_RI_USAGE_PAGE(16, page), HID_RI_USAGE_MINIMUM(16, usage_min), HID_RI_USAGE_MAXIMUM(16, usage_max), \
+		HID_LOGICAL_MINIMUM(0), HID_LOGICAL_MAXIMUM(1), \
+		HID_REPORT_SIZE(1), HID_REPORT_COUNT((usage_max) - (usage_min) + 1), main(8, flags),
+	#define _HID_REPORT_ITEMS_BITMAP_PADDED(main, name, type, page, usage_min, usage_max, flags) \
+		_HID_REPORT_ITEMS_BITMAP(main, name, type, page, usage_min, usage_max, flags) \
+		HID_REPORT_COUNT(sizeof(type) * 8 - ((usage_max) - (usage_min) + 1)), main(8, HID_IOF_CONSTANT),
+	#define _HID_REPORT_ITEMS_BITMAP_ARRAY(main, name, type, count, page, usage_min, usage_max, flags) \
+		_HID_REPORT_ITEMS_BITMAP(main, name, type, page, usage_min, usage_max, flags)
+	#define _HID_REPORT_ITEMS_PADDING(main, name, type) \
+		HID_REPORT_SIZE(8), HID_REPORT_COUNT(sizeof(type)), main(8, HID_IOF_CONSTANT),
+
+	#define _HID_REPORT_FIELD_BITS(kind, ...)                   + _HID_REPORT_FIELD_BITS_##kind(__VA_ARGS__)
+	#define _HID_REPORT_FIELD_BITS_VALUE(name, type, ...)       (sizeof(type) * 8)
+	#define _HID_REPORT_FIELD_BITS_ARRAY(name, type, count, ...) (sizeof(type) * 8 * (count))
+	#define _HID_REPORT_FIELD_BITS_BITMAP(name, type, page, usage_min, usage_max, flags) \
+		((usage_max) - (usage_min) + 1)
+	#define _HID_REPORT_FIELD_BITS_BITMAP_PADDED(name, type, ...) (sizeof(type) * 8)
+	#define _HID_REPORT_FIELD_BITS_BITMAP_ARRAY(name, type, count, page, usage_min, usage_max, flags) \
+		((usage_max) - (usage_min) + 1)
+	#define _HID_REPORT_FIELD_BITS_PADDING(name, type)          (sizeof(type) * 8)
+
+	#define _HID_REPORT_CHECK(kind, ...)                        _HID_REPORT_CHECK_##kind(__VA_ARGS__)
+	#define _HID_REPORT_CHECK_VALUE(name, type, page, usage, logical_min, logical_max, flags) \
+		_Static_assert((type)(logical_min) == (logical_min) && (type)(logical_max) == (logical_max), \
+			"Logical range of " #name " does not fit in " #type);
+	#define _HID_REPORT_CHECK_ARRAY(name, type, count, page, usage_min, usage_max, logical_min, logical_max, flags) \
+		_Static_assert((type)(logical_min) == (logical_min) && (type)(logical_max) == (logical_max), \
+			"Logical range of " #name " does not fit in " #type);
+	#define _HID_REPORT_CHECK_BITMAP(name, type, page, usage_min, usage_max, flags) \
+		_Static_assert((usage_max) - (usage_min) + 1 == sizeof(type) * 8, \
+			"Usages of " #name " must fill all the bits of " #type " (use BITMAP_PADDED)");
+	#define _HID_REPORT_CHECK_BITMAP_PADDED(name, type, page, usage_min, usage_max, flags) \
+		_Static_assert((usage_max) - (usage_min) + 1 < sizeof(type) * 8, \
+			"Usages of " #name " must leave padding bits in " #type " (use BITMAP)");
+	#define _HID_REPORT_CHECK_BITMAP_ARRAY(name, type, count, page, usage_min, usage_max, flags) \
+		_Static_assert((usage_max) - (usage_min) + 1 == sizeof(type) * 8 * (count), \
+			"Usages of " #name " must fill all the bits of " #type "[" #count "]");
+	#define _HID_REPORT_CHECK_PADDING(name, type)
+#endif
+
+/** @} */
+
+#endif /* HID_USB_HID_REPORT_H_ */
@@ -3,8 +3,13 @@
 #define HID_USB_HID_STANDARDS_H_
 
 #include "usb_hid.h"
+#include "usb_hid_report.h"
 #include "usb_hid_usage_button.h"
 #include "usb_hid_usage_desktop.h"
+#include "usb_hid_usage_keyboard.h"
+#include "usb_hid_usage_led.h"
+#include "usb_hid_usage_consumer.h"
+#include "usb_hid_usage_digitizer.h"
 
 #define USB_DESCRIPTOR_TYPE_HID 0x21
 #define USB_DESCRIPTOR_TYPE_HID_REPORT 0x22
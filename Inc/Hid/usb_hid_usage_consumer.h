@@ -0,0 +1,51 @@
+/* This file is the part of the Lightweight USB device Stack for STM32 microcontrollers
+ *
+ * Copyright ©2016 Dmitry Filimonchuk <dmitrystu[at]gmail[dot]com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_HID_USAGE_CONSUMER_H_
+#define _USB_HID_USAGE_CONSUMER_H_
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**\ingroup USB_HID
+ * \addtogroup USB_HID_USAGES_CONSUMER HID Usage Tables for Consumer
+ * \brief Contains USB HID Usages definitions for Consumer Page
+ * \details This module based on
+ * + [HID Usage Tables Version 1.12](https://www.usb.org/sites/default/files/documents/hut1_12v2.pdf)
+ * @{ */
+
+#define HID_PAGE_CONSUMER         0x0C    /**<\brief HID usage page for Consumer controls */
+#define HID_PAGE_VENDOR           0xFF00  /**<\brief First vendor defined HID usage page */
+
+#define HID_CONSUMER_NONE                  0x00    /**<\brief No control active */
+#define HID_CONSUMER_CONTROL               0x01    /**<\brief Consumer Control (application collection) */
+#define HID_CONSUMER_SCAN_NEXT_TRACK       0xB5    /**<\brief Scan Next Track */
+#define HID_CONSUMER_SCAN_PREVIOUS_TRACK   0xB6    /**<\brief Scan Previous Track */
+#define HID_CONSUMER_STOP                  0xB7    /**<\brief Stop */
+#define HID_CONSUMER_PLAY_PAUSE            0xCD    /**<\brief Play/Pause */
+#define HID_CONSUMER_MUTE                  0xE2    /**<\brief Mute */
+#define HID_CONSUMER_VOLUME_INCREMENT      0xE9    /**<\brief Volume Increment */
+#define HID_CONSUMER_VOLUME_DECREMENT      0xEA    /**<\brief Volume Decrement */
+#define HID_CONSUMER_AL_CALCULATOR         0x192   /**<\brief AL Calculator */
+#define HID_CONSUMER_AC_HOME               0x223   /**<\brief AC Home */
+
+/** @}  */
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/* This file is the part of the Lightweight USB device Stack for STM32 microcontrollers
+ *
+ * Copyright ©2016 Dmitry Filimonchuk <dmitrystu[at]gmail[dot]com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_HID_USAGE_DIGITIZER_H_
+#define _USB_HID_USAGE_DIGITIZER_H_
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**\ingroup USB_HID
+ * \addtogroup USB_HID_USAGES_DIGITIZER HID Usage Tables for Digitizer
+ * \brief Contains USB HID Usages definitions for Digitizers Page
+ * \details This module based on
+ * + [HID Usage Tables Version 1.12](https://www.usb.org/sites/default/files/documents/hut1_12v2.pdf)
+ * @{ */
+
+#define HID_PAGE_DIGITIZER        0x0D    /**<\brief HID usage page for Digitizers */
+
+#define HID_DIGITIZER_TOUCH_SCREEN         0x04    /**<\brief CA Touch Screen */
+#define HID_DIGITIZER_TOUCH_PAD            0x05    /**<\brief CA Touch Pad */
+#define HID_DIGITIZER_FINGER               0x22    /**<\brief CL Finger */
+#define HID_DIGITIZER_DEVICE_SETTINGS      0x23    /**<\brief CL Device Settings */
+#define HID_DIGITIZER_IN_RANGE             0x32    /**<\brief MC In Range */
+#define HID_DIGITIZER_TIP_SWITCH           0x42    /**<\brief MC Tip Switch */
+#define HID_DIGITIZER_CONFIDENCE           0x47    /**<\brief DV Confidence */
+#define HID_DIGITIZER_WIDTH                0x48    /**<\brief DV Width */
+#define HID_DIGITIZER_HEIGHT               0x49    /**<\brief DV Height */
+#define HID_DIGITIZER_CONTACT_ID           0x51    /**<\brief DV Contact Identifier */
+#define HID_DIGITIZER_DEVICE_MODE          0x52    /**<\brief DV Device Mode */
+#define HID_DIGITIZER_CONTACT_COUNT        0x54    /**<\brief DV Contact Count */
+#define HID_DIGITIZER_CONTACT_COUNT_MAXIMUM 0x55    /**<\brief SV Contact Count Maximum */
+#define HID_DIGITIZER_SCAN_TIME            0x56    /**<\brief DV Scan Time */
+
+/** @}  */
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
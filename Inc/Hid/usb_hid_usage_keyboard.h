@@ -0,0 +1,129 @@
+/* This file is the part of the Lightweight USB device Stack for STM32 microcontrollers
+ *
+ * Copyright ©2016 Dmitry Filimonchuk <dmitrystu[at]gmail[dot]com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_HID_USAGE_KEYBOARD_H_
+#define _USB_HID_USAGE_KEYBOARD_H_
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**\ingroup USB_HID
+ * \addtogroup USB_HID_USAGES_KEYBOARD HID Usage Tables for Keyboard
+ * \brief Contains USB HID Usages definitions for Keyboard/Keypad Page
+ * \details This module based on
+ * + [HID Usage Tables Version 1.12](https://www.usb.org/sites/default/files/documents/hut1_12v2.pdf)
+ * @{ */
+
+#define HID_PAGE_KEYBOARD         0x07    /**<\brief HID usage page for Keyboard/Keypad */
+
+#define HID_KEYBOARD_NONE                  0x00    /**<\brief No key pressed */
+#define HID_KEYBOARD_ERROR_ROLLOVER        0x01    /**<\brief Too many keys pressed (phantom state) */
+#define HID_KEYBOARD_A                     0x04    /**<\brief Keyboard a and A */
+#define HID_KEYBOARD_B                     0x05    /**<\brief Keyboard b and B */
+#define HID_KEYBOARD_C                     0x06    /**<\brief Keyboard c and C */
+#define HID_KEYBOARD_D                     0x07    /**<\brief Keyboard d and D */
+#define HID_KEYBOARD_E                     0x08    /**<\brief Keyboard e and E */
+#define HID_KEYBOARD_F                     0x09    /**<\brief Keyboard f and F */
+#define HID_KEYBOARD_G                     0x0A    /**<\brief Keyboard g and G */
+#define HID_KEYBOARD_H                     0x0B    /**<\brief Keyboard h and H */
+#define HID_KEYBOARD_I                     0x0C    /**<\brief Keyboard i and I */
+#define HID_KEYBOARD_J                     0x0D    /**<\brief Keyboard j and J */
+#define HID_KEYBOARD_K                     0x0E    /**<\brief Keyboard k and K */
+#define HID_KEYBOARD_L                     0x0F    /**<\brief Keyboard l and L */
+#define HID_KEYBOARD_M                     0x10    /**<\brief Keyboard m and M */
+#define HID_KEYBOARD_N                     0x11    /**<\brief Keyboard n and N */
+#define HID_KEYBOARD_O                     0x12    /**<\brief Keyboard o and O */
+#define HID_KEYBOARD_P                     0x13    /**<\brief Keyboard p and P */
+#define HID_KEYBOARD_Q                     0x14    /**<\brief Keyboard q and Q */
+#define HID_KEYBOARD_R                     0x15    /**<\brief Keyboard r and R */
+#define HID_KEYBOARD_S                     0x16    /**<\brief Keyboard s and S */
+#define HID_KEYBOARD_T                     0x17    /**<\brief Keyboard t and T */
+#define HID_KEYBOARD_U                     0x18    /**<\brief Keyboard u and U */
+#define HID_KEYBOARD_V                     0x19    /**<\brief Keyboard v and V */
+#define HID_KEYBOARD_W                     0x1A    /**<\brief Keyboard w and W */
+#define HID_KEYBOARD_X                     0x1B    /**<\brief Keyboard x and X */
+#define HID_KEYBOARD_Y                     0x1C    /**<\brief Keyboard y and Y */
+#define HID_KEYBOARD_Z                     0x1D    /**<\brief Keyboard z and Z */
+#define HID_KEYBOARD_1                     0x1E    /**<\brief Keyboard 1 */
+#define HID_KEYBOARD_2                     0x1F    /**<\brief Keyboard 2 */
+#define HID_KEYBOARD_3                     0x20    /**<\brief Keyboard 3 */
+#define HID_KEYBOARD_4                     0x21    /**<\brief Keyboard 4 */
+#define HID_KEYBOARD_5                     0x22    /**<\brief Keyboard 5 */
+#define HID_KEYBOARD_6                     0x23    /**<\brief Keyboard 6 */
+#define HID_KEYBOARD_7                     0x24    /**<\brief Keyboard 7 */
+#define HID_KEYBOARD_8                     0x25    /**<\brief Keyboard 8 */
+#define HID_KEYBOARD_9                     0x26    /**<\brief Keyboard 9 */
+#define HID_KEYBOARD_0                     0x27    /**<\brief Keyboard 0 */
+#define HID_KEYBOARD_ENTER                 0x28    /**<\brief Keyboard Return (ENTER) */
+#define HID_KEYBOARD_ESCAPE                0x29    /**<\brief Keyboard ESCAPE */
+#define HID_KEYBOARD_BACKSPACE             0x2A    /**<\brief Keyboard DELETE (Backspace) */
+#define HID_KEYBOARD_TAB                   0x2B    /**<\brief Keyboard Tab */
+#define HID_KEYBOARD_SPACE                 0x2C    /**<\brief Keyboard Spacebar */
+#define HID_KEYBOARD_MINUS                 0x2D    /**<\brief Keyboard - and (underscore) */
+#define HID_KEYBOARD_EQUAL                 0x2E    /**<\brief Keyboard = and + */
+#define HID_KEYBOARD_LEFT_BRACKET          0x2F    /**<\brief Keyboard [ and { */
+#define HID_KEYBOARD_RIGHT_BRACKET         0x30    /**<\brief Keyboard ] and } */
+#define HID_KEYBOARD_BACKSLASH             0x31    /**<\brief Keyboard \\ and | */
+#define HID_KEYBOARD_SEMICOLON             0x33    /**<\brief Keyboard ; and : */
+#define HID_KEYBOARD_APOSTROPHE            0x34    /**<\brief Keyboard ' and " */
+#define HID_KEYBOARD_GRAVE                 0x35    /**<\brief Keyboard Grave Accent and Tilde */
+#define HID_KEYBOARD_COMMA                 0x36    /**<\brief Keyboard , and < */
+#define HID_KEYBOARD_DOT                   0x37    /**<\brief Keyboard . and > */
+#define HID_KEYBOARD_SLASH                 0x38    /**<\brief Keyboard / and ? */
+#define HID_KEYBOARD_CAPS_LOCK             0x39    /**<\brief Keyboard Caps Lock */
+#define HID_KEYBOARD_F1                    0x3A    /**<\brief Keyboard F1 */
+#define HID_KEYBOARD_F2                    0x3B    /**<\brief Keyboard F2 */
+#define HID_KEYBOARD_F3                    0x3C    /**<\brief Keyboard F3 */
+#define HID_KEYBOARD_F4                    0x3D    /**<\brief Keyboard F4 */
+#define HID_KEYBOARD_F5                    0x3E    /**<\brief Keyboard F5 */
+#define HID_KEYBOARD_F6                    0x3F    /**<\brief Keyboard F6 */
+#define HID_KEYBOARD_F7                    0x40    /**<\brief Keyboard F7 */
+#define HID_KEYBOARD_F8                    0x41    /**<\brief Keyboard F8 */
+#define HID_KEYBOARD_F9                    0x42    /**<\brief Keyboard F9 */
+#define HID_KEYBOARD_F10                   0x43    /**<\brief Keyboard F10 */
+#define HID_KEYBOARD_F11                   0x44    /**<\brief Keyboard F11 */
+#define HID_KEYBOARD_F12                   0x45    /**<\brief Keyboard F12 */
+#define HID_KEYBOARD_PRINT_SCREEN          0x46    /**<\brief Keyboard PrintScreen */
+#define HID_KEYBOARD_SCROLL_LOCK           0x47    /**<\brief Keyboard Scroll Lock */
+#define HID_KEYBOARD_PAUSE                 0x48    /**<\brief Keyboard Pause */
+#define HID_KEYBOARD_INSERT                0x49    /**<\brief Keyboard Insert */
+#define HID_KEYBOARD_HOME                  0x4A    /**<\brief Keyboard Home */
+#define HID_KEYBOARD_PAGE_UP               0x4B    /**<\brief Keyboard PageUp */
+#define HID_KEYBOARD_DELETE                0x4C    /**<\brief Keyboard Delete Forward */
+#define HID_KEYBOARD_END                   0x4D    /**<\brief Keyboard End */
+#define HID_KEYBOARD_PAGE_DOWN             0x4E    /**<\brief Keyboard PageDown */
+#define HID_KEYBOARD_RIGHT_ARROW           0x4F    /**<\brief Keyboard RightArrow */
+#define HID_KEYBOARD_LEFT_ARROW            0x50    /**<\brief Keyboard LeftArrow */
+#define HID_KEYBOARD_DOWN_ARROW            0x51    /**<\brief Keyboard DownArrow */
+#define HID_KEYBOARD_UP_ARROW              0x52    /**<\brief Keyboard UpArrow */
+#define HID_KEYBOARD_NUM_LOCK              0x53    /**<\brief Keypad Num Lock and Clear */
+#define HID_KEYBOARD_APPLICATION           0x65    /**<\brief Keyboard Application */
+#define HID_KEYBOARD_LEFT_CTRL             0xE0    /**<\brief Keyboard Left Control */
+#define HID_KEYBOARD_LEFT_SHIFT            0xE1    /**<\brief Keyboard Left Shift */
+#define HID_KEYBOARD_LEFT_ALT              0xE2    /**<\brief Keyboard Left Alt */
+#define HID_KEYBOARD_LEFT_GUI              0xE3    /**<\brief Keyboard Left GUI */
+#define HID_KEYBOARD_RIGHT_CTRL            0xE4    /**<\brief Keyboard Right Control */
+#define HID_KEYBOARD_RIGHT_SHIFT           0xE5    /**<\brief Keyboard Right Shift */
+#define HID_KEYBOARD_RIGHT_ALT             0xE6    /**<\brief Keyboard Right Alt */
+#define HID_KEYBOARD_RIGHT_GUI             0xE7    /**<\brief Keyboard Right GUI */
+
+/** @}  */
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+/* This file is the part of the Lightweight USB device Stack for STM32 microcontrollers
+ *
+ * Copyright ©2016 Dmitry Filimonchuk <dmitrystu[at]gmail[dot]com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_HID_USAGE_LED_H_
+#define _USB_HID_USAGE_LED_H_
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+
+/**\ingroup USB_HID
+ * \addtogroup USB_HID_USAGES_LED HID Usage Tables for LED
+ * \brief Contains USB HID Usages definitions for LED Page
+ * \details This module based on
+ * + [HID Usage Tables Version 1.12](https://www.usb.org/sites/default/files/documents/hut1_12v2.pdf)
+ * @{ */
+
+#define HID_PAGE_LED              0x08    /**<\brief HID usage page for LEDs */
+
+#define HID_LED_NUM_LOCK                   0x01    /**<\brief Num Lock */
+#define HID_LED_CAPS_LOCK                  0x02    /**<\brief Caps Lock */
+#define HID_LED_SCROLL_LOCK                0x03    /**<\brief Scroll Lock */
+#define HID_LED_COMPOSE                    0x04    /**<\brief Compose */
+#define HID_LED_KANA                       0x05    /**<\brief Kana */
+
+/** @}  */
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef HID_USBD_HID_H_
+#define HID_USBD_HID_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_standards.h"
+#include "Hid/usb_hid_standards.h"
+
+/**\name Values of GET_PROTOCOL and SET_PROTOCOL requests
+ * @{ */
+#define USB_HID_PROTOCOL_BOOT 0x00 /**<\brief Boot protocol (fixed report format understood by BIOS hosts).*/
+#define USB_HID_PROTOCOL_REPORT 0x01 /**<\brief Report protocol (report format defined by the report descriptor).*/
+/** @} */
+
+/** \brief Duration (in 4 ms units) of the idle rate of keyboards until the host sets it (500 ms).
+ */
+#define USB_HID_KEYBOARD_DEFAULT_IDLE_RATE 125
+
+/** \brief Highest report ID with an idle rate of its own (SET_IDLE and GET_IDLE for a higher ID are stalled).
+ */
+#define USB_HID_MAX_REPORT_ID 4
+
+/** \brief A HID interface whose class requests are handled by \ref usbd_hid_process_request.
+ */
+typedef struct
+{
+	/// \brief Number of the interface (the wIndex of the requests addressed to it).
+	uint8_t interface_number;
+	/// \brief HID class descriptor of the interface (inside the configuration descriptor).
+	UsbHidDescriptor const *hid_descriptor;
+	/// \brief Report descriptor of the interface.
+	uint8_t const *report_descriptor;
+	/// \brief Size of `report_descriptor` in bytes.
+	uint16_t report_descriptor_size;
+	/** \brief Returns the current report of a type and ID (GET_REPORT).
+	 * \returns The size of the report, or 0 if there is no such report.
+	 */
+	uint16_t (*get_report)(uint8_t report_type, uint8_t report_id, void const **report);
+	/// \brief Handles an output or feature report received with SET_REPORT (NULL if there is none).
+	void (*set_report)(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size);
+	/// \brief Buffer that receives the data stage of SET_REPORT.
+	void *set_report_buffer;
+	/// \brief Size of `set_report_buffer` in bytes.
+	uint16_t set_report_buffer_size;
+
+	/// \brief The selected protocol (\ref USB_HID_PROTOCOL_BOOT or \ref USB_HID_PROTOCOL_REPORT).
+	uint8_t protocol;
+	/// \brief The idle rate of each input report ID in 4 ms units (0 means reports are only sent on change); an
+	/// interface without report IDs only uses `idle_rates[0]`.
+	uint8_t idle_rates[USB_HID_MAX_REPORT_ID + 1];
+	/// \brief Report IDs whose idle rate was changed since the function last looked at it (bit `n` for report ID `n`).
+	uint8_t idle_rate_changes;
+} UsbHidInterface;
+
+void usbd_hid_reset(UsbHidInterface *hid, uint8_t default_idle_rate);
+bool usbd_hid_process_request(UsbHidInterface *hid, UsbRequest const *request);
+bool usbd_hid_process_control_data(UsbHidInterface *hid, UsbRequest const *request);
+
+#endif /* HID_USBD_HID_H_ */
@@ -0,0 +1,23 @@
+#ifndef HID_USBD_HID_COMPOSITE_H_
+#define HID_USBD_HID_COMPOSITE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the interrupt IN endpoint shared by all the reports.
+#define HID_COMPOSITE_POLLING_INTERVAL 1
+/// \brief Size of the payload of the vendor reports in bytes.
+#define HID_COMPOSITE_VENDOR_REPORT_SIZE 31
+
+extern const UsbClass usbd_hid_composite_class;
+
+void usbd_hid_composite_mouse_move(int8_t x, int8_t y, uint8_t buttons);
+void usbd_hid_composite_keyboard_press(uint8_t usage);
+void usbd_hid_composite_keyboard_release(uint8_t usage);
+uint8_t usbd_hid_composite_keyboard_leds();
+void usbd_hid_composite_consumer_set(uint16_t usage);
+bool usbd_hid_composite_vendor_send(void const *data, uint16_t size);
+void usbd_hid_composite_set_vendor_receiver(void (*receiver)(void const *data, uint16_t size));
+
+#endif /* HID_USBD_HID_COMPOSITE_H_ */
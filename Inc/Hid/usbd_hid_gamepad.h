@@ -0,0 +1,25 @@
+#ifndef HID_USBD_HID_GAMEPAD_H_
+#define HID_USBD_HID_GAMEPAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the gamepad interrupt IN endpoint.
+#define HID_GAMEPAD_POLLING_INTERVAL 1
+/// \brief Count of axes (X, Y, Z, Rx, Ry and Rz).
+#define HID_GAMEPAD_AXIS_COUNT 6
+/// \brief Count of buttons.
+#define HID_GAMEPAD_BUTTON_COUNT 32
+/// \brief Hat switch value when no direction is pressed (0 - 7 are N, NE, E, SE, S, SW, W and NW).
+#define HID_GAMEPAD_HAT_CENTERED 8
+/// \brief Gain of an axis that keeps the raw value (gains are in Q12 format).
+#define HID_GAMEPAD_UNITY_GAIN 4096
+
+extern const UsbClass usbd_hid_gamepad_class;
+
+void usbd_hid_gamepad_calibrate(uint8_t axis, int16_t center, int16_t gain, uint16_t deadband);
+void usbd_hid_gamepad_set_threshold(uint16_t threshold);
+void usbd_hid_gamepad_update(int16_t const raw_axes[HID_GAMEPAD_AXIS_COUNT], uint8_t hat, uint32_t buttons);
+
+#endif /* HID_USBD_HID_GAMEPAD_H_ */
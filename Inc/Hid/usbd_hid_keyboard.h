@@ -0,0 +1,17 @@
+#ifndef HID_USBD_HID_KEYBOARD_H_
+#define HID_USBD_HID_KEYBOARD_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the keyboard interrupt IN endpoint.
+#define HID_KEYBOARD_POLLING_INTERVAL 1
+
+extern const UsbClass usbd_hid_keyboard_class;
+
+void usbd_hid_keyboard_press(uint8_t usage);
+void usbd_hid_keyboard_release(uint8_t usage);
+void usbd_hid_keyboard_release_all();
+uint8_t usbd_hid_keyboard_leds();
+
+#endif /* HID_USBD_HID_KEYBOARD_H_ */
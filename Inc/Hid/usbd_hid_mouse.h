@@ -0,0 +1,15 @@
+#ifndef HID_USBD_HID_MOUSE_H_
+#define HID_USBD_HID_MOUSE_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the mouse interrupt IN endpoint.
+#define HID_MOUSE_POLLING_INTERVAL 1
+
+extern const UsbClass usbd_hid_mouse_class;
+
+void usbd_hid_mouse_move(int8_t x, int8_t y, uint8_t buttons);
+void usbd_hid_mouse_set_sampler(void (*sampler)());
+
+#endif /* HID_USBD_HID_MOUSE_H_ */
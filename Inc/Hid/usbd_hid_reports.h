@@ -0,0 +1,81 @@
+#ifndef HID_USBD_HID_REPORTS_H_
+#define HID_USBD_HID_REPORTS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Hid/usb_hid_standards.h"
+#include "Helpers/math.h"
+
+/** \brief Report layouts shared by the HID functions (single report interfaces and the composite one).
+ */
+
+/// \brief Layout of the mouse input report.
+#define HID_MOUSE_REPORT(FIELD) \
+	FIELD(VALUE, x, int8_t, HID_PAGE_DESKTOP, HID_DESKTOP_X, -127, 127, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE) \
+	FIELD(VALUE, y, int8_t, HID_PAGE_DESKTOP, HID_DESKTOP_Y, -127, 127, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_RELATIVE) \
+	FIELD(BITMAP_PADDED, buttons, uint8_t, HID_PAGE_BUTTON, 1, 3, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Count of key usages (0x00 - 0x67) reported by the N-key rollover keyboard report.
+#define HID_KEYBOARD_KEY_COUNT 104
+
+/** \brief Layout of the keyboard input report (N-key rollover).
+ * \details Every key has its own bit, so any count of keys can be pressed at the same time.
+ */
+#define HID_KEYBOARD_REPORT(FIELD) \
+	FIELD(BITMAP, modifiers, uint8_t, HID_PAGE_KEYBOARD, HID_KEYBOARD_LEFT_CTRL, HID_KEYBOARD_RIGHT_GUI, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE) \
+	FIELD(BITMAP_ARRAY, keys, uint8_t, HID_KEYBOARD_KEY_COUNT / 8, HID_PAGE_KEYBOARD, 0, HID_KEYBOARD_KEY_COUNT - 1, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the keyboard LED output report.
+#define HID_KEYBOARD_LED_REPORT(FIELD) \
+	FIELD(BITMAP_PADDED, leds, uint8_t, HID_PAGE_LED, HID_LED_NUM_LOCK, HID_LED_KANA, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the consumer control input report (one active control at a time).
+#define HID_CONSUMER_REPORT(FIELD) \
+	FIELD(ARRAY, usage, uint16_t, 1, HID_PAGE_CONSUMER, 0, 0x3FF, 0, 0x3FF, HID_IOF_DATA | HID_IOF_ARRAY | HID_IOF_ABSOLUTE)
+
+HID_REPORT_STRUCT(HidMouseReport, HID_MOUSE_REPORT);
+HID_REPORT_ASSERTS(HidMouseReport, HID_MOUSE_REPORT);
+HID_REPORT_STRUCT(HidKeyboardReport, HID_KEYBOARD_REPORT);
+HID_REPORT_ASSERTS(HidKeyboardReport, HID_KEYBOARD_REPORT);
+HID_REPORT_STRUCT(HidKeyboardLedReport, HID_KEYBOARD_LED_REPORT);
+HID_REPORT_ASSERTS(HidKeyboardLedReport, HID_KEYBOARD_LED_REPORT);
+HID_REPORT_STRUCT(HidConsumerReport, HID_CONSUMER_REPORT);
+HID_REPORT_ASSERTS(HidConsumerReport, HID_CONSUMER_REPORT);
+
+/** \brief Accumulates a relative movement into a mouse report (saturated to the logical range of the report).
+ */
+inline static void hid_mouse_report_move(HidMouseReport *report, int8_t x, int8_t y, uint8_t buttons)
+{
+	report->x = MAX(-127, MIN(127, report->x + x));
+	report->y = MAX(-127, MIN(127, report->y + y));
+	report->buttons = buttons;
+}
+
+/** \brief Sets or clears the bit of a key in a keyboard report.
+ * \param usage Usage of the key in the keyboard page (e.g. `HID_KEYBOARD_A` or `HID_KEYBOARD_LEFT_SHIFT`).
+ * \param pressed Whether the key is pressed.
+ */
+inline static void hid_keyboard_report_set_key(HidKeyboardReport *report, uint8_t usage, bool pressed)
+{
+	uint8_t *bits;
+	uint8_t mask;
+
+	if (usage >= HID_KEYBOARD_LEFT_CTRL && usage <= HID_KEYBOARD_RIGHT_GUI)
+	{
+		bits = &report->modifiers;
+		mask = 1 << (usage - HID_KEYBOARD_LEFT_CTRL);
+	}
+	else if (usage < HID_KEYBOARD_KEY_COUNT)
+	{
+		bits = &report->keys[usage / 8];
+		mask = 1 << (usage % 8);
+	}
+	else
+	{
+		return;
+	}
+
+	*bits = pressed ? (*bits | mask) : (*bits & ~mask);
+}
+
+#endif /* HID_USBD_HID_REPORTS_H_ */
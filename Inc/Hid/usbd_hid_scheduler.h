@@ -0,0 +1,51 @@
+#ifndef HID_USBD_HID_SCHEDULER_H_
+#define HID_USBD_HID_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief A report that shares an interrupt IN endpoint with other reports.
+ */
+typedef struct
+{
+	/// \brief The report (starting with its report ID).
+	void const *report;
+	/// \brief Size of the report in bytes.
+	uint16_t size;
+	/// \brief Priority of the report (the higher, the sooner it is sent).
+	uint8_t priority;
+
+	/// \brief Whether the report has changed since it was last sent.
+	bool pending;
+	/// \brief The scheduler frame in which the report became pending.
+	uint32_t pending_since;
+	/// \brief Count of times the report was sent.
+	uint32_t sent_count;
+	/// \brief The longest time (in frames) the report waited to be sent.
+	uint32_t max_wait_frames;
+} HidScheduledReport;
+
+/** \brief Picks which of the pending reports goes into the next IN transaction of a shared endpoint.
+ * \details A report gains one priority level for every `aging_frames` frames it waits, so it is sent before
+ * reports of higher priority that keep changing every frame (e.g. the pointer movement) once it is old enough.
+ * The reports of equal (aged) priority are sent oldest first.
+ */
+typedef struct
+{
+	/// \brief The reports sharing the endpoint.
+	HidScheduledReport *reports;
+	/// \brief Count of `reports`.
+	uint8_t report_count;
+	/// \brief Count of frames a pending report waits to gain one priority level.
+	uint8_t aging_frames;
+	/// \brief Count of frames since the scheduler was reset.
+	uint32_t frame;
+} HidReportScheduler;
+
+void usbd_hid_scheduler_reset(HidReportScheduler *scheduler);
+void usbd_hid_scheduler_mark_pending(HidReportScheduler *scheduler, HidScheduledReport *report);
+void usbd_hid_scheduler_frame_elapsed(HidReportScheduler *scheduler);
+HidScheduledReport *usbd_hid_scheduler_next(HidReportScheduler *scheduler);
+void usbd_hid_scheduler_log(HidReportScheduler const *scheduler);
+
+#endif /* HID_USBD_HID_SCHEDULER_H_ */
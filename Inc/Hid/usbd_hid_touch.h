@@ -0,0 +1,37 @@
+#ifndef HID_USBD_HID_TOUCH_H_
+#define HID_USBD_HID_TOUCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the digitizer interrupt IN endpoint.
+#define HID_TOUCH_POLLING_INTERVAL 1
+/// \brief Maximum count of simultaneous contacts.
+#define HID_TOUCH_MAX_CONTACTS 10
+/// \brief Count of contacts carried by one report (hybrid mode: a frame with more contacts spans several reports).
+#define HID_TOUCH_CONTACTS_PER_REPORT 5
+/// \brief Count of reports that can wait for the host to collect them.
+#define HID_TOUCH_QUEUE_LENGTH 4
+/// \brief Largest logical coordinate on both axes.
+#define HID_TOUCH_LOGICAL_MAXIMUM 4095
+
+/** \brief The state of one contact in a touch frame.
+ */
+typedef struct
+{
+	/// \brief Identifier of the contact (stays the same while the finger touches).
+	uint8_t id;
+	/// \brief Whether the finger touches the surface (false in the frame where it is lifted).
+	bool touching;
+	/// \brief Position on the X axis (0 - \ref HID_TOUCH_LOGICAL_MAXIMUM).
+	uint16_t x;
+	/// \brief Position on the Y axis (0 - \ref HID_TOUCH_LOGICAL_MAXIMUM).
+	uint16_t y;
+} HidTouchContactState;
+
+extern const UsbClass usbd_hid_touch_class;
+
+bool usbd_hid_touch_push_frame(HidTouchContactState const *contacts, uint8_t contact_count);
+
+#endif /* HID_USBD_HID_TOUCH_H_ */
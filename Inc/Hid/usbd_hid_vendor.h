@@ -0,0 +1,20 @@
+#ifndef HID_USBD_HID_VENDOR_H_
+#define HID_USBD_HID_VENDOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+
+/// \brief Polling interval (in frames) of the interrupt IN and OUT endpoints.
+#define HID_VENDOR_POLLING_INTERVAL 1
+/// \brief Size of the vendor reports in bytes (one full speed interrupt packet).
+#define HID_VENDOR_REPORT_SIZE 64
+/// \brief Count of input reports that can wait for the host to collect them.
+#define HID_VENDOR_QUEUE_LENGTH 4
+
+extern const UsbClass usbd_hid_vendor_class;
+
+bool usbd_hid_vendor_send(void const *data, uint16_t size);
+void usbd_hid_vendor_set_receiver(void (*receiver)(void const *data, uint16_t size));
+
+#endif /* HID_USBD_HID_VENDOR_H_ */
@@ -0,0 +1,12 @@
+#ifndef LOGIC_LOGIC_GPIO_H_
+#define LOGIC_LOGIC_GPIO_H_
+
+#include "Logic/logic_source.h"
+
+/** \brief PE0 to PE7 sampled by DMA2 stream 5 (channel 6: TIM1_UP), which copies the low byte of GPIOE->IDR to the
+ * buffer (circular mode) on each update of TIM1; no CPU work per sample. The shortest period is 9 ticks (8 MHz);
+ * above ~1 MHz the raw stream is faster than the bus, only the compression of idle periods keeps up.
+ */
+extern const LogicSource logic_gpio;
+
+#endif /* LOGIC_LOGIC_GPIO_H_ */
@@ -0,0 +1,31 @@
+#ifndef LOGIC_LOGIC_SOURCE_H_
+#define LOGIC_LOGIC_SOURCE_H_
+
+#include <stdint.h>
+
+/// \brief Clock the sample periods are counted in (the timers and the cycle counter run at 72 MHz).
+#define LOGIC_CLOCK_HZ 72000000
+
+/** \brief A producer of 8-bit samples of the logic inputs (the acquisition behind the logic analyzer function).
+ * \details Once started, the source writes sample `n` to `buffer[n % size]`, endlessly, like a DMA in circular mode:
+ * it never waits for the consumer, so samples not sent before the source comes back to them are overwritten (an
+ * overrun).
+ * \note `poll` is optional (can be NULL). The callbacks are called from the main loop.
+ */
+typedef struct
+{
+	/// \brief Shortest sample period (in ticks of \ref LOGIC_CLOCK_HZ) the source keeps up with.
+	uint16_t min_sample_period;
+
+	/// \brief Starts the acquisition: one sample every `sample_period` ticks of \ref LOGIC_CLOCK_HZ (`size` is a power
+	/// of two).
+	void (*start)(uint8_t *buffer, uint16_t size, uint16_t sample_period);
+	/// \brief Stops the acquisition.
+	void (*stop)();
+	/// \brief Returns the count of samples written since the start (it wraps around at 2^32, a multiple of `size`).
+	uint32_t (*written_samples)();
+	/// \brief Called on every poll of the framework while the acquisition runs.
+	void (*poll)();
+} LogicSource;
+
+#endif /* LOGIC_LOGIC_SOURCE_H_ */
@@ -0,0 +1,20 @@
+#ifndef LOGIC_LOGIC_SYNTHETIC_H_
+#define LOGIC_LOGIC_SYNTHETIC_H_
+
+#include "Logic/logic_source.h"
+
+/** \brief Sample `n` since the start of the synthetic source: a burst of activity (channel `i` toggles every
+ * `2^(i+1)` samples) in the first 4096 samples of every 65536, idle (all low) in between, so both the raw stream and
+ * the compression of idle periods can be checked by the host.
+ */
+inline static uint8_t logic_synthetic_sample(uint32_t n)
+{
+	return (n & 0xFFFF) < 4096 ? (uint8_t)(n >> 1) : 0;
+}
+
+/** \brief A source without hardware, producing \ref logic_synthetic_sample in real time (from the cycle counter) when
+ * it is polled (host/logic_simulation.cpp also streams it on the host, without a device).
+ */
+extern const LogicSource logic_synthetic;
+
+#endif /* LOGIC_LOGIC_SYNTHETIC_H_ */
@@ -0,0 +1,81 @@
+#ifndef LOGIC_USBD_LOGIC_H_
+#define LOGIC_USBD_LOGIC_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+#include "Logic/logic_source.h"
+
+/** \addtogroup LOGIC Logic analyzer function
+ * \brief Vendor function streaming the samples of a \ref LogicSource over a bulk IN endpoint (0x81).
+ * \details The source writes 8-bit samples into a large circular buffer; the function writes them to the endpoint
+ * straight from the buffer, as fast as the host takes them. The requests follow the fx2lafw firmware of sigrok: the
+ * sample rate is part of \ref LOGIC_START, and the stream is a plain sequence of samples (one byte each) unless the
+ * compression is on.
+ *
+ * With \ref LOGIC_START_FLAGS_RLE, idle periods are compressed (channels 0 to 6 only, like the RLE of SUMP): a byte
+ * with bit 7 clear is a sample; a run of bytes with bit 7 set is a count `c0, c1...` (7 bits each, least significant
+ * first) of extra repetitions of the previous sample.
+ *
+ * If the host falls behind for more than the buffer, the acquisition stops (a trace with a hole would lie): the
+ * stream ends with a short packet, and \ref LOGIC_GET_STATISTICS shows the overrun.
+ * @{ */
+
+/// \brief Maximum packet size of the bulk IN endpoint.
+#define LOGIC_PACKET_SIZE 64
+/// \brief Largest transfer, and the depth of the TxFIFO.
+#define LOGIC_TRANSFER_SIZE 1024
+/// \brief Size of the circular buffer of samples (a power of two).
+#define LOGIC_BUFFER_SIZE 32768
+
+/**\name Vendor requests (recipient: device)
+ * @{ */
+#define LOGIC_GET_VERSION 0xB0 /**<\brief Returns `LogicVersion`.*/
+#define LOGIC_START 0xB1 /**<\brief Receives `LogicStartCommand` and starts the acquisition.*/
+#define LOGIC_STOP 0xB3 /**<\brief Stops the acquisition (the samples taken are still sent).*/
+#define LOGIC_GET_STATISTICS 0xB4 /**<\brief Returns `LogicStatistics`.*/
+/** @} */
+
+/// \brief Compresses the idle periods (see above).
+#define LOGIC_START_FLAGS_RLE 0x01
+
+typedef struct
+{
+	uint8_t major;
+	uint8_t minor;
+} LogicVersion;
+
+/** \brief Data of \ref LOGIC_START, laid out as in fx2lafw: the sample rate is \ref LOGIC_CLOCK_HZ / (delay + 1).
+ */
+typedef struct
+{
+	uint8_t flags;
+	uint8_t sample_delay_h;
+	uint8_t sample_delay_l;
+} LogicStartCommand;
+
+/** \brief Counters returned by \ref LOGIC_GET_STATISTICS (little endian, no padding).
+ */
+typedef struct
+{
+	/// \brief Samples per second of the last acquisition.
+	uint32_t sample_rate;
+	/// \brief Samples the source took.
+	uint32_t written_samples;
+	/// \brief Samples sent (compressed or not).
+	uint32_t sent_samples;
+	/// \brief Bytes written to the endpoint.
+	uint32_t sent_bytes;
+	/// \brief 1 if the acquisition stopped because the host fell behind.
+	uint32_t overrun;
+} LogicStatistics;
+
+_Static_assert(sizeof(LogicStartCommand) == 3, "The command is received as it is stored");
+_Static_assert(sizeof(LogicStatistics) == 5 * 4, "The statistics are sent as they are stored");
+
+/** @} */
+
+extern const UsbClass usbd_logic_class;
+
+void usbd_logic_set_source(LogicSource const *source);
+
+#endif /* LOGIC_USBD_LOGIC_H_ */
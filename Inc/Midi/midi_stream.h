@@ -0,0 +1,43 @@
+#ifndef MIDI_MIDI_STREAM_H_
+#define MIDI_MIDI_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Midi/usb_midi_standards.h"
+
+/** \brief Converts a MIDI byte stream (e.g. from a UART) into USB-MIDI event packets.
+ * \details Handles running status (data bytes without a status byte repeat the last channel status), system exclusive
+ * messages of any length, and real time bytes interleaved anywhere (even inside another message).
+ */
+typedef struct
+{
+	/// \brief The cable number of the events.
+	uint8_t cable;
+	/// \brief The running status (a channel status, or 0 after a system message).
+	uint8_t running_status;
+	/// \brief The bytes of the message being parsed.
+	uint8_t message[3];
+	/// \brief Count of bytes in `message`.
+	uint8_t length;
+	/// \brief Count of bytes the message being parsed has (0 when no status byte was received).
+	uint8_t expected_length;
+	/// \brief Whether a system exclusive message is being parsed.
+	bool sysex;
+} MidiStreamEncoder;
+
+/** \brief Converts USB-MIDI event packets back to a MIDI byte stream.
+ */
+typedef struct
+{
+	/// \brief The last channel status sent (0 after a system message).
+	uint8_t running_status;
+	/// \brief Whether the status of a channel message is left out when it repeats `running_status`.
+	bool use_running_status;
+} MidiStreamDecoder;
+
+void midi_stream_encoder_reset(MidiStreamEncoder *encoder, uint8_t cable);
+bool midi_stream_encode(MidiStreamEncoder *encoder, uint8_t byte, UsbMidiEventPacket *event);
+void midi_stream_decoder_reset(MidiStreamDecoder *decoder, bool use_running_status);
+uint8_t midi_stream_decode(MidiStreamDecoder *decoder, UsbMidiEventPacket const *event, uint8_t bytes[3]);
+
+#endif /* MIDI_MIDI_STREAM_H_ */
@@ -0,0 +1,97 @@
+#ifndef MIDI_USB_MIDI_STANDARDS_H_
+#define MIDI_USB_MIDI_STANDARDS_H_
+
+#include <stdint.h>
+#include "Audio/usb_audio_standards.h"
+
+/** \addtogroup USB_MIDI USB MIDI streaming
+ * \brief MIDI 1.0 definitions (a subclass of the audio class)
+ * \details Based on [MIDI Devices 1.0](https://www.usb.org/document-library/usb-midi-devices-10)
+ * @{ */
+
+#define USB_MIDI_SUBCLASS_MIDISTREAMING 0x03 /**<\brief MIDI streaming interface (bulk event packets).*/
+
+/**\name Class specific descriptor subtypes
+ * @{ */
+#define USB_MIDI_MS_HEADER 0x01
+#define USB_MIDI_MS_IN_JACK 0x02
+#define USB_MIDI_MS_OUT_JACK 0x03
+#define USB_MIDI_MS_GENERAL 0x01 /**<\brief Class specific endpoint descriptor.*/
+/** @} */
+
+/**\name Jack types
+ * @{ */
+#define USB_MIDI_JACK_EMBEDDED 0x01 /**<\brief The jack connects to the host through an endpoint.*/
+#define USB_MIDI_JACK_EXTERNAL 0x02 /**<\brief The jack is a physical connector of the device.*/
+/** @} */
+
+/**\name Code Index Numbers (the low nibble of the first byte of an event packet, the cable number is the high nibble)
+ * @{ */
+#define USB_MIDI_CIN_SYSTEM_COMMON_2 0x2 /**<\brief Two byte system common message (MTC quarter frame, song select).*/
+#define USB_MIDI_CIN_SYSTEM_COMMON_3 0x3 /**<\brief Three byte system common message (song position pointer).*/
+#define USB_MIDI_CIN_SYSEX_START 0x4 /**<\brief Three bytes of a system exclusive message that continues.*/
+#define USB_MIDI_CIN_SYSEX_END_1 0x5 /**<\brief System exclusive ending with one byte, or single byte system common message.*/
+#define USB_MIDI_CIN_SYSEX_END_2 0x6 /**<\brief System exclusive ending with two bytes.*/
+#define USB_MIDI_CIN_SYSEX_END_3 0x7 /**<\brief System exclusive ending with three bytes.*/
+#define USB_MIDI_CIN_SINGLE_BYTE 0xF /**<\brief A single byte (system real time messages).*/
+/** @} */
+
+/** \brief USB-MIDI event packet: a MIDI message (or part of a system exclusive message) in 4 bytes. */
+typedef struct {
+	uint8_t header; /**<\brief Cable number (high nibble) and Code Index Number (low nibble). */
+	uint8_t midi[3]; /**<\brief The MIDI bytes, padded with 0. */
+} __attribute__((__packed__)) UsbMidiEventPacket;
+
+/** \brief Audio control interface header, for one streaming interface. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_AUDIO_AC_HEADER. */
+	uint16_t bcdADC; /**<\brief 0x0100. */
+	uint16_t wTotalLength; /**<\brief Size of the class specific audio control descriptors. */
+	uint8_t  bInCollection; /**<\brief Count of streaming interfaces (1). */
+	uint8_t  baInterfaceNr; /**<\brief The MIDI streaming interface. */
+} __attribute__((__packed__)) UsbMidiAudioControlHeaderDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_MIDI_MS_HEADER. */
+	uint16_t bcdMSC; /**<\brief 0x0100. */
+	uint16_t wTotalLength; /**<\brief Size of the class specific MIDI streaming descriptors (jacks and endpoints). */
+} __attribute__((__packed__)) UsbMidiStreamingHeaderDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_MIDI_MS_IN_JACK. */
+	uint8_t  bJackType; /**<\brief USB_MIDI_JACK_*. */
+	uint8_t  bJackID;
+	uint8_t  iJack;
+} __attribute__((__packed__)) UsbMidiInJackDescriptor;
+
+/** \brief MIDI OUT jack, with one input pin. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_MIDI_MS_OUT_JACK. */
+	uint8_t  bJackType; /**<\brief USB_MIDI_JACK_*. */
+	uint8_t  bJackID;
+	uint8_t  bNrInputPins; /**<\brief 1. */
+	uint8_t  baSourceID; /**<\brief The jack connected to the input pin. */
+	uint8_t  baSourcePin; /**<\brief The output pin of that jack (1). */
+	uint8_t  iJack;
+} __attribute__((__packed__)) UsbMidiOutJackDescriptor;
+
+/** \brief Class specific endpoint descriptor, with one embedded jack. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_MIDI_MS_GENERAL. */
+	uint8_t  bNumEmbMIDIJack; /**<\brief 1. */
+	uint8_t  baAssocJackID; /**<\brief The embedded jack of the endpoint. */
+} __attribute__((__packed__)) UsbMidiStreamingEndpointDescriptor;
+
+/** @} */
+
+#endif /* MIDI_USB_MIDI_STANDARDS_H_ */
@@ -0,0 +1,29 @@
+#ifndef MIDI_USBD_MIDI_H_
+#define MIDI_USBD_MIDI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usbd_class.h"
+#include "Midi/usb_midi_standards.h"
+
+/// \brief Maximum packet size of the bulk endpoints (16 event packets).
+#define MIDI_PACKET_SIZE 64
+/// \brief Size of the receive and of the transmit ring buffers in bytes (a power of two, a multiple of the event size).
+#define MIDI_BUFFER_SIZE 512
+/// \brief Count of frames an event waits at most for more events to fill its packet.
+#define MIDI_FLUSH_DEADLINE_FRAMES 1
+
+/** \brief MIDI 1.0 streaming function with one embedded IN and one embedded OUT jack (cable 0).
+ * \details The events to the host are batched: a packet goes out as soon as it is full (16 events), otherwise at the
+ * start of the frame after its first event (\ref MIDI_FLUSH_DEADLINE_FRAMES), so dense traffic takes one transaction
+ * per 16 events and sparse traffic waits at most a frame.
+ */
+extern const UsbClass usbd_midi_class;
+
+bool usbd_midi_send_event(UsbMidiEventPacket const *event);
+uint32_t usbd_midi_write(void const *data, uint32_t size);
+bool usbd_midi_receive_event(UsbMidiEventPacket *event);
+uint32_t usbd_midi_read(void *data, uint32_t size);
+void usbd_midi_set_receiver(void (*receiver)());
+
+#endif /* MIDI_USBD_MIDI_H_ */
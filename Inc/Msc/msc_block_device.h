@@ -0,0 +1,39 @@
+#ifndef MSC_MSC_BLOCK_DEVICE_H_
+#define MSC_MSC_BLOCK_DEVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/// \brief Size of the blocks of the block devices in bytes (the logical block size reported to the host).
+#define MSC_BLOCK_SIZE 512
+
+/** \brief A block device (the storage behind the mass storage function).
+ * \note The callbacks other than `read_block` and `write_block` are optional (can be NULL). All of them are called
+ * from the main loop, never while a USB event is being handled.
+ */
+typedef struct
+{
+	/// \brief Count of blocks of \ref MSC_BLOCK_SIZE bytes.
+	uint32_t block_count;
+	/// \brief Whether the host may only read the blocks.
+	bool write_protected;
+
+	/// \brief Called once when the function starts using the device; returns false if the device cannot be used.
+	bool (*initialize)();
+	/// \brief Returns whether the medium can be accessed (false makes TEST UNIT READY fail with NOT READY).
+	bool (*is_ready)();
+	/// \brief Copies a block to a buffer; returns false on a read error.
+	bool (*read_block)(uint32_t block, void *buffer);
+	/// \brief Stores a block from a buffer; returns false on a write error.
+	bool (*write_block)(uint32_t block, void const *buffer);
+	/// \brief Writes the cached blocks to the medium (SYNCHRONIZE CACHE); returns false on a write error.
+	/// \note It may stop once `is_busy` returns true: it is called again when the device is no longer busy.
+	bool (*flush)();
+	/// \brief Called on every poll of the framework while the device has no command to process (background work).
+	void (*poll)();
+	/// \brief Returns whether accessing a block now would stall the firmware (e.g. the medium is being erased): the
+	/// transfer then waits (the host gets NAKs) and asks again at the next poll.
+	bool (*is_busy)();
+} MscBlockDevice;
+
+#endif /* MSC_MSC_BLOCK_DEVICE_H_ */
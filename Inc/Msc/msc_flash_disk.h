@@ -0,0 +1,17 @@
+#ifndef MSC_MSC_FLASH_DISK_H_
+#define MSC_MSC_FLASH_DISK_H_
+
+#include "Msc/msc_block_device.h"
+
+/// \brief Count of blocks of the flash disk (512 KB; the rest of the flash area is spare room for the log).
+#define MSC_FLASH_DISK_BLOCK_COUNT 1024
+
+/** \brief A block device in the internal flash (sectors 17 to 23, the 128 KB sectors of bank 2).
+ * \details The blocks are appended to a log (a block is never rewritten in place), a RAM write-back cache coalesces
+ * the writes, and the sectors whose blocks were all rewritten are erased in the background.
+ */
+extern const MscBlockDevice msc_flash_disk;
+
+void msc_flash_disk_run_benchmark(uint16_t block_count);
+
+#endif /* MSC_MSC_FLASH_DISK_H_ */
@@ -0,0 +1,11 @@
+#ifndef MSC_MSC_RAM_DISK_H_
+#define MSC_MSC_RAM_DISK_H_
+
+#include "Msc/msc_block_device.h"
+
+/// \brief Count of blocks of the RAM disk (64 KB, enough for the host to format it with FAT12).
+#define MSC_RAM_DISK_BLOCK_COUNT 128
+
+extern const MscBlockDevice msc_ram_disk;
+
+#endif /* MSC_MSC_RAM_DISK_H_ */
@@ -0,0 +1,132 @@
+#ifndef MSC_USB_MSC_STANDARDS_H_
+#define MSC_USB_MSC_STANDARDS_H_
+
+#include <stdint.h>
+
+/** \addtogroup USB_MSC USB mass storage class
+ * \brief Mass Storage Class definitions (Bulk-Only Transport and the SCSI commands it carries)
+ * \details Based on
+ * + [Mass Storage Class Bulk-Only Transport 1.0](https://www.usb.org/document-library/mass-storage-bulk-only-10)
+ * + SCSI Primary Commands (SPC-2) and SCSI Block Commands (SBC-2)
+ * @{ */
+
+/**\name Subclass and protocol codes
+ * @{ */
+#define USB_MSC_SUBCLASS_SCSI 0x06 /**<\brief SCSI transparent command set.*/
+#define USB_MSC_PROTOCOL_BBB 0x50 /**<\brief Bulk-Only Transport.*/
+/** @} */
+
+/**\name Class requests
+ * @{ */
+#define USB_MSC_GET_MAX_LUN 0xFE /**<\brief Returns the number of the last logical unit.*/
+#define USB_MSC_BULK_ONLY_RESET 0xFF /**<\brief Resets the transport (the host then clears the halts of the bulk endpoints).*/
+/** @} */
+
+/**\name Command block wrapper and command status wrapper
+ * @{ */
+#define USB_MSC_CBW_SIGNATURE 0x43425355 /**<\brief "USBC" (little endian).*/
+#define USB_MSC_CSW_SIGNATURE 0x53425355 /**<\brief "USBS" (little endian).*/
+#define USB_MSC_CBW_DIRECTION_IN (1 << 7) /**<\brief bmCBWFlags: the data goes from the device to the host.*/
+#define USB_MSC_CSW_STATUS_PASSED 0x00 /**<\brief The command succeeded.*/
+#define USB_MSC_CSW_STATUS_FAILED 0x01 /**<\brief The command failed (the host reads the sense data).*/
+#define USB_MSC_CSW_STATUS_PHASE_ERROR 0x02 /**<\brief The host and the device disagree on the data stage.*/
+/** @} */
+
+/**\name SCSI operation codes
+ * @{ */
+#define SCSI_TEST_UNIT_READY 0x00
+#define SCSI_REQUEST_SENSE 0x03
+#define SCSI_INQUIRY 0x12
+#define SCSI_MODE_SENSE_6 0x1A
+#define SCSI_START_STOP_UNIT 0x1B
+#define SCSI_PREVENT_ALLOW_MEDIUM_REMOVAL 0x1E
+#define SCSI_READ_FORMAT_CAPACITIES 0x23
+#define SCSI_READ_CAPACITY_10 0x25
+#define SCSI_READ_10 0x28
+#define SCSI_WRITE_10 0x2A
+#define SCSI_VERIFY_10 0x2F
+#define SCSI_SYNCHRONIZE_CACHE_10 0x35
+#define SCSI_MODE_SENSE_10 0x5A
+/** @} */
+
+/**\name SCSI sense keys and additional sense codes
+ * @{ */
+#define SCSI_SENSE_NO_SENSE 0x00
+#define SCSI_SENSE_NOT_READY 0x02
+#define SCSI_SENSE_MEDIUM_ERROR 0x03
+#define SCSI_SENSE_ILLEGAL_REQUEST 0x05
+#define SCSI_SENSE_DATA_PROTECT 0x07
+
+#define SCSI_ASC_NONE 0x00
+#define SCSI_ASC_WRITE_FAULT 0x03
+#define SCSI_ASC_UNRECOVERED_READ_ERROR 0x11
+#define SCSI_ASC_INVALID_COMMAND_OPERATION_CODE 0x20
+#define SCSI_ASC_LBA_OUT_OF_RANGE 0x21
+#define SCSI_ASC_INVALID_FIELD_IN_CDB 0x24
+#define SCSI_ASC_WRITE_PROTECTED 0x27
+#define SCSI_ASC_MEDIUM_NOT_PRESENT 0x3A
+/** @} */
+
+/** \brief Command block wrapper (received on the bulk OUT endpoint). */
+typedef struct {
+	uint32_t dCBWSignature; /**<\brief \ref USB_MSC_CBW_SIGNATURE. */
+	uint32_t dCBWTag; /**<\brief Echoed in the status wrapper. */
+	uint32_t dCBWDataTransferLength; /**<\brief Bytes the host expects to transfer in the data stage. */
+	uint8_t bmCBWFlags; /**<\brief Direction of the data stage (\ref USB_MSC_CBW_DIRECTION_IN). */
+	uint8_t bCBWLUN; /**<\brief The logical unit. */
+	uint8_t bCBWCBLength; /**<\brief Valid bytes of `CBWCB` (1 - 16). */
+	uint8_t CBWCB[16]; /**<\brief The SCSI command descriptor block. */
+} __attribute__((__packed__)) UsbMscCommandBlockWrapper;
+
+/** \brief Command status wrapper (sent on the bulk IN endpoint). */
+typedef struct {
+	uint32_t dCSWSignature; /**<\brief \ref USB_MSC_CSW_SIGNATURE. */
+	uint32_t dCSWTag; /**<\brief The tag of the command. */
+	uint32_t dCSWDataResidue; /**<\brief Bytes of the data stage that were not transferred. */
+	uint8_t bCSWStatus; /**<\brief USB_MSC_CSW_STATUS_*. */
+} __attribute__((__packed__)) UsbMscCommandStatusWrapper;
+
+/** \brief Standard INQUIRY data. */
+typedef struct {
+	uint8_t peripheral_device_type; /**<\brief 0x00: direct access block device. */
+	uint8_t removable; /**<\brief Bit 7: removable medium. */
+	uint8_t version; /**<\brief 0x04: SPC-2. */
+	uint8_t response_data_format; /**<\brief 0x02. */
+	uint8_t additional_length; /**<\brief Bytes that follow (31). */
+	uint8_t flags[3]; /**<\brief Unused capabilities. */
+	char vendor_id[8]; /**<\brief Vendor name (padded with spaces). */
+	char product_id[16]; /**<\brief Product name (padded with spaces). */
+	char product_revision[4]; /**<\brief Product revision (padded with spaces). */
+} __attribute__((__packed__)) ScsiInquiryData;
+
+/** \brief Fixed format sense data (REQUEST SENSE). */
+typedef struct {
+	uint8_t response_code; /**<\brief 0x70: current errors, fixed format. */
+	uint8_t obsolete;
+	uint8_t sense_key; /**<\brief SCSI_SENSE_*. */
+	uint8_t information[4];
+	uint8_t additional_length; /**<\brief Bytes that follow (10). */
+	uint8_t command_specific_information[4];
+	uint8_t additional_sense_code; /**<\brief SCSI_ASC_*. */
+	uint8_t additional_sense_code_qualifier;
+	uint8_t field_replaceable_unit_code;
+	uint8_t sense_key_specific[3];
+} __attribute__((__packed__)) ScsiSenseData;
+
+/** \brief READ CAPACITY(10) data (big endian). */
+typedef struct {
+	uint32_t last_logical_block_address; /**<\brief Address of the last block. */
+	uint32_t block_length; /**<\brief Size of a block in bytes. */
+} __attribute__((__packed__)) ScsiReadCapacity10Data;
+
+/** \brief READ FORMAT CAPACITIES data with the current capacity descriptor (big endian). */
+typedef struct {
+	uint8_t reserved[3];
+	uint8_t capacity_list_length; /**<\brief Bytes of the descriptors that follow (8). */
+	uint32_t block_count; /**<\brief Count of blocks. */
+	uint32_t descriptor_type_block_length; /**<\brief Descriptor type (bits 25:24, 2: formatted media) and block length (bits 23:0). */
+} __attribute__((__packed__)) ScsiReadFormatCapacitiesData;
+
+/** @} */
+
+#endif /* MSC_USB_MSC_STANDARDS_H_ */
@@ -0,0 +1,15 @@
+#ifndef MSC_USBD_MSC_H_
+#define MSC_USBD_MSC_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+#include "Msc/msc_block_device.h"
+
+/// \brief Maximum packet size of the bulk endpoints (the largest full speed bulk packet).
+#define MSC_PACKET_SIZE 64
+
+extern const UsbClass usbd_msc_class;
+
+void usbd_msc_set_block_device(MscBlockDevice const *block_device);
+
+#endif /* MSC_USBD_MSC_H_ */
@@ -0,0 +1,14 @@
+#ifndef SENSOR_SENSOR_ADC_H_
+#define SENSOR_SENSOR_ADC_H_
+
+#include "Sensor/sensor_source.h"
+
+/// \brief Sampling frequency of the ADC in Hz.
+#define SENSOR_ADC_SAMPLE_RATE 100000
+
+/** \brief ADC1 sampling PA3 (channel 3) at \ref SENSOR_ADC_SAMPLE_RATE, triggered by TIM3; DMA2 stream 0 stores the
+ * 12-bit samples in the two buffers in double buffer mode, with no CPU work per sample.
+ */
+extern const SensorSource sensor_adc;
+
+#endif /* SENSOR_SENSOR_ADC_H_ */
@@ -0,0 +1,28 @@
+#ifndef SENSOR_SENSOR_SOURCE_H_
+#define SENSOR_SENSOR_SOURCE_H_
+
+#include <stdint.h>
+
+/** \brief A producer of samples (the acquisition behind the sensor streaming function).
+ * \details Once started, the source fills the two buffers in turn, endlessly, like a DMA in double buffer mode: it
+ * never waits for the consumer, so a buffer that is not sent before the source comes back to it is overwritten (an
+ * overrun).
+ * \note `poll` is optional (can be NULL). The callbacks are called from the main loop.
+ */
+typedef struct
+{
+	/// \brief Samples per second.
+	uint32_t sample_rate;
+
+	/// \brief Starts the acquisition into `buffers[0]`, then `buffers[1]`, then `buffers[0]` again...
+	void (*start)(uint16_t *buffers[2], uint16_t sample_count);
+	/// \brief Stops the acquisition.
+	void (*stop)();
+	/// \brief Returns the count of buffers completed since the start (block `n` is in `buffers[n % 2]`), and the value
+	/// of the audio clock when the last one completed.
+	uint32_t (*completed_blocks)(uint32_t *timestamp);
+	/// \brief Called on every poll of the framework while the acquisition runs.
+	void (*poll)();
+} SensorSource;
+
+#endif /* SENSOR_SENSOR_SOURCE_H_ */
@@ -0,0 +1,14 @@
+#ifndef SENSOR_SENSOR_SYNTHETIC_H_
+#define SENSOR_SENSOR_SYNTHETIC_H_
+
+#include "Sensor/sensor_source.h"
+
+/// \brief Sampling frequency of the synthetic source in Hz.
+#define SENSOR_SYNTHETIC_SAMPLE_RATE 100000
+
+/** \brief A source without hardware: sample `n` since the start is `n & 0xFFFF`, so the host can check that no sample
+ * is missing. The samples are produced in real time from the audio clock when the source is polled.
+ */
+extern const SensorSource sensor_synthetic;
+
+#endif /* SENSOR_SENSOR_SYNTHETIC_H_ */
@@ -0,0 +1,67 @@
+#ifndef SENSOR_USBD_SENSOR_H_
+#define SENSOR_USBD_SENSOR_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+#include "Sensor/sensor_source.h"
+
+/** \addtogroup SENSOR Sensor streaming function
+ * \brief Vendor function streaming the samples of a \ref SensorSource continuously over a bulk IN endpoint (0x81).
+ * \details The source fills two blocks in turn (ping-pong); a complete block is written to the endpoint straight
+ * from where the source put its samples, while the source fills the other one. Each block starts with a
+ * `SensorBlockHeader`; the host reads transfers of \ref SENSOR_BLOCK_SIZE bytes.
+ * @{ */
+
+/// \brief Maximum packet size of the bulk IN endpoint.
+#define SENSOR_PACKET_SIZE 64
+/// \brief Size of a block (header and samples) in bytes: one bulk transfer, and the depth of the TxFIFO.
+#define SENSOR_BLOCK_SIZE 1024
+
+/**\name Vendor requests (recipient: device)
+ * @{ */
+#define SENSOR_START 0x01 /**<\brief Starts the acquisition (the sequence numbers restart from 0).*/
+#define SENSOR_STOP 0x02 /**<\brief Stops the acquisition.*/
+#define SENSOR_GET_STATISTICS 0x03 /**<\brief Returns `SensorStatistics`.*/
+/** @} */
+
+/** \brief Header of each block (little endian, no padding).
+ */
+typedef struct
+{
+	/// \brief Number of the block since the start: a gap means lost blocks.
+	uint32_t sequence;
+	/// \brief Number of the last SOF before the end of the block (11 bits)...
+	uint16_t sof_frame_number;
+	/// \brief Count of samples in the block.
+	uint16_t sample_count;
+	/// \brief ...and the time from that SOF to the end of the block, in ticks of the 72 MHz audio clock.
+	uint32_t sof_offset;
+	/// \brief Count of blocks lost since the start (overruns).
+	uint32_t overruns;
+} SensorBlockHeader;
+
+/// \brief Count of 16-bit samples in a block.
+#define SENSOR_BLOCK_SAMPLE_COUNT ((SENSOR_BLOCK_SIZE - sizeof(SensorBlockHeader)) / 2)
+
+/** \brief Counters returned by \ref SENSOR_GET_STATISTICS (little endian, no padding).
+ */
+typedef struct
+{
+	/// \brief Blocks the source completed since the start.
+	uint32_t completed_blocks;
+	/// \brief Blocks written to the endpoint.
+	uint32_t sent_blocks;
+	/// \brief Blocks overwritten by the source before they could be sent.
+	uint32_t overruns;
+} SensorStatistics;
+
+_Static_assert(sizeof(SensorBlockHeader) == 16, "The header is sent as it is stored");
+_Static_assert(sizeof(SensorStatistics) == 3 * 4, "The statistics are sent as they are stored");
+
+/** @} */
+
+extern const UsbClass usbd_sensor_class;
+
+void usbd_sensor_set_source(SensorSource const *source);
+
+#endif /* SENSOR_USBD_SENSOR_H_ */
@@ -0,0 +1,73 @@
+#ifndef VENDOR_USBD_SOURCE_SINK_H_
+#define VENDOR_USBD_SOURCE_SINK_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+
+/** \addtogroup SOURCE_SINK Source/sink test function
+ * \brief Vendor function for throughput benchmarks (like the gadget-zero of Linux).
+ * \details Interface 0 has a bulk IN (0x81), a bulk OUT (0x01), an interrupt IN (0x82) and an interrupt OUT (0x02)
+ * endpoint. In the source/sink mode, the IN endpoints always have data (the selected pattern) and the OUT endpoints
+ * accept everything (and verify the pattern if asked to); in the loopback mode, the data received on an OUT endpoint
+ * is sent back on the IN endpoint of the same type. A host client selects the mode and the pattern with the vendor
+ * requests below (recipient: device), then reads `SourceSinkStatistics` to check the data the device received;
+ * `host/source_sink_benchmark.cpp` is such a client (it reports the MB/s and the latency percentiles).
+ * @{ */
+
+/// \brief Size of the packets of the bulk endpoints.
+#define SOURCE_SINK_BULK_PACKET_SIZE 64
+/// \brief Size of the packets of the interrupt endpoints.
+#define SOURCE_SINK_INTERRUPT_PACKET_SIZE 64
+/// \brief Size of the transfers written to the bulk IN endpoint (and of its TxFIFO).
+#define SOURCE_SINK_BULK_TRANSFER_SIZE 512
+/// \brief Size of the buffer of the control write and control read requests.
+#define SOURCE_SINK_CONTROL_BUFFER_SIZE 256
+
+/**\name Vendor requests
+ * @{ */
+#define SOURCE_SINK_SET_MODE 0x01 /**<\brief wValue: `SourceSinkMode`.*/
+#define SOURCE_SINK_SET_PATTERN 0x02 /**<\brief wValue: `SourceSinkPattern`.*/
+#define SOURCE_SINK_SET_VERIFY 0x03 /**<\brief wValue: 1 to check the pattern of the received data, 0 to only count it.*/
+#define SOURCE_SINK_GET_STATISTICS 0x04 /**<\brief Returns `SourceSinkStatistics`.*/
+#define SOURCE_SINK_RESET_STATISTICS 0x05 /**<\brief Clears the statistics.*/
+#define SOURCE_SINK_CONTROL_WRITE 0x5B /**<\brief Stores up to \ref SOURCE_SINK_CONTROL_BUFFER_SIZE bytes (as gadget-zero).*/
+#define SOURCE_SINK_CONTROL_READ 0x5C /**<\brief Returns the stored bytes (as gadget-zero).*/
+/** @} */
+
+typedef enum
+{
+	SOURCE_SINK_MODE_SOURCE_SINK = 0,
+	SOURCE_SINK_MODE_LOOPBACK = 1
+} SourceSinkMode;
+
+/** \brief Content of the packets (the pattern restarts with every packet).
+ */
+typedef enum
+{
+	SOURCE_SINK_PATTERN_ZERO = 0, ///< All bytes are 0.
+	SOURCE_SINK_PATTERN_MOD63 = 1, ///< Byte `i` of a packet is `i % 63` (63 does not divide the packet size).
+	SOURCE_SINK_PATTERN_SEQUENCE = 2 ///< MOD63, but the first 4 bytes hold a packet counter (detects lost packets).
+} SourceSinkPattern;
+
+/** \brief Counters returned by \ref SOURCE_SINK_GET_STATISTICS (little endian, no padding).
+ */
+typedef struct
+{
+	uint32_t bulk_sourced_bytes;
+	uint32_t bulk_sunk_bytes;
+	uint32_t interrupt_sourced_bytes;
+	uint32_t interrupt_sunk_bytes;
+	uint32_t looped_bytes;
+	/// \brief Received packets that did not match the pattern.
+	uint32_t pattern_errors;
+	/// \brief Packets missing from the sequence (\ref SOURCE_SINK_PATTERN_SEQUENCE).
+	uint32_t lost_packets;
+} SourceSinkStatistics;
+
+_Static_assert(sizeof(SourceSinkStatistics) == 7 * 4, "The statistics are sent as they are stored");
+
+/** @} */
+
+extern const UsbClass usbd_source_sink_class;
+
+#endif /* VENDOR_USBD_SOURCE_SINK_H_ */
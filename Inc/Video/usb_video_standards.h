@@ -0,0 +1,206 @@
+#ifndef VIDEO_USB_VIDEO_STANDARDS_H_
+#define VIDEO_USB_VIDEO_STANDARDS_H_
+
+#include <stdint.h>
+
+/** \addtogroup USB_VIDEO USB video class
+ * \brief Video 1.1 definitions
+ * \details Based on [Video Class 1.1](https://www.usb.org/document-library/video-class-v11-document-set), with the
+ * uncompressed and the MJPEG payload specifications.
+ * @{ */
+
+/**\name Subclass codes (the class is \ref USB_CLASS_VIDEO)
+ * @{ */
+#define USB_VIDEO_SUBCLASS_VIDEOCONTROL 0x01 /**<\brief Video control interface (topology and controls).*/
+#define USB_VIDEO_SUBCLASS_VIDEOSTREAMING 0x02 /**<\brief Video streaming interface (payloads).*/
+#define USB_VIDEO_SUBCLASS_INTERFACE_COLLECTION 0x03 /**<\brief The function (interface association).*/
+/** @} */
+
+/**\name Class specific descriptor subtypes
+ * @{ */
+#define USB_VIDEO_VC_HEADER 0x01
+#define USB_VIDEO_VC_INPUT_TERMINAL 0x02
+#define USB_VIDEO_VC_OUTPUT_TERMINAL 0x03
+
+#define USB_VIDEO_VS_INPUT_HEADER 0x01
+#define USB_VIDEO_VS_FORMAT_UNCOMPRESSED 0x04
+#define USB_VIDEO_VS_FRAME_UNCOMPRESSED 0x05
+#define USB_VIDEO_VS_FORMAT_MJPEG 0x06
+#define USB_VIDEO_VS_FRAME_MJPEG 0x07
+/** @} */
+
+/**\name Terminal types
+ * @{ */
+#define USB_VIDEO_TERMINAL_STREAMING 0x0101
+#define USB_VIDEO_TERMINAL_CAMERA 0x0201
+/** @} */
+
+/**\name Class requests
+ * @{ */
+#define USB_VIDEO_SET_CUR 0x01
+#define USB_VIDEO_GET_CUR 0x81
+#define USB_VIDEO_GET_MIN 0x82
+#define USB_VIDEO_GET_MAX 0x83
+#define USB_VIDEO_GET_RES 0x84
+#define USB_VIDEO_GET_LEN 0x85
+#define USB_VIDEO_GET_INFO 0x86
+#define USB_VIDEO_GET_DEF 0x87
+/** @} */
+
+/**\name Controls of the video streaming interface (high byte of wValue)
+ * @{ */
+#define USB_VIDEO_VS_PROBE_CONTROL 0x01 /**<\brief Parameters under negotiation.*/
+#define USB_VIDEO_VS_COMMIT_CONTROL 0x02 /**<\brief Parameters of the stream (setting them starts the stream).*/
+/** @} */
+
+/**\name GET_INFO capabilities of a control
+ * @{ */
+#define USB_VIDEO_INFO_GET (1 << 0)
+#define USB_VIDEO_INFO_SET (1 << 1)
+/** @} */
+
+/**\name Bits of bmHeaderInfo of the payload header
+ * @{ */
+#define USB_VIDEO_HEADER_FID (1 << 0) /**<\brief Frame ID: toggles at each new frame.*/
+#define USB_VIDEO_HEADER_EOF (1 << 1) /**<\brief The payload ends the frame.*/
+#define USB_VIDEO_HEADER_PTS (1 << 2) /**<\brief dwPresentationTime is present.*/
+#define USB_VIDEO_HEADER_SCR (1 << 3) /**<\brief scrSourceClock is present.*/
+#define USB_VIDEO_HEADER_STI (1 << 5) /**<\brief Still image.*/
+#define USB_VIDEO_HEADER_ERR (1 << 6) /**<\brief The frame has an error.*/
+#define USB_VIDEO_HEADER_EOH (1 << 7) /**<\brief End of the header.*/
+/** @} */
+
+/** \brief Video control interface header, for one streaming interface. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_CS_INTERFACE. */
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VC_HEADER. */
+	uint16_t bcdUVC; /**<\brief 0x0110. */
+	uint16_t wTotalLength; /**<\brief Size of the class specific video control descriptors. */
+	uint32_t dwClockFrequency; /**<\brief Frequency of the device clock of the timestamps in Hz (deprecated). */
+	uint8_t  bInCollection; /**<\brief Count of streaming interfaces. */
+	uint8_t  baInterfaceNr[1]; /**<\brief The streaming interface. */
+} __attribute__((__packed__)) UsbVideoControlHeaderDescriptor;
+
+/** \brief Camera terminal (an input terminal with 3 bytes of camera controls). */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VC_INPUT_TERMINAL. */
+	uint8_t  bTerminalID;
+	uint16_t wTerminalType; /**<\brief \ref USB_VIDEO_TERMINAL_CAMERA. */
+	uint8_t  bAssocTerminal;
+	uint8_t  iTerminal;
+	uint16_t wObjectiveFocalLengthMin;
+	uint16_t wObjectiveFocalLengthMax;
+	uint16_t wOcularFocalLength;
+	uint8_t  bControlSize; /**<\brief 3. */
+	uint8_t  bmControls[3]; /**<\brief Supported camera controls (none). */
+} __attribute__((__packed__)) UsbVideoCameraTerminalDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VC_OUTPUT_TERMINAL. */
+	uint8_t  bTerminalID;
+	uint16_t wTerminalType; /**<\brief \ref USB_VIDEO_TERMINAL_STREAMING. */
+	uint8_t  bAssocTerminal;
+	uint8_t  bSourceID; /**<\brief The unit or terminal connected to the output terminal. */
+	uint8_t  iTerminal;
+} __attribute__((__packed__)) UsbVideoOutputTerminalDescriptor;
+
+/** \brief Video streaming input header, for two formats. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VS_INPUT_HEADER. */
+	uint8_t  bNumFormats; /**<\brief Count of format descriptors. */
+	uint16_t wTotalLength; /**<\brief Size of the class specific video streaming descriptors. */
+	uint8_t  bEndpointAddress; /**<\brief The endpoint of the payloads. */
+	uint8_t  bmInfo; /**<\brief Bit 0: dynamic format change. */
+	uint8_t  bTerminalLink; /**<\brief The output terminal the interface is connected to. */
+	uint8_t  bStillCaptureMethod;
+	uint8_t  bTriggerSupport;
+	uint8_t  bTriggerUsage;
+	uint8_t  bControlSize; /**<\brief 1. */
+	uint8_t  bmaControls[2]; /**<\brief Controls of each format (none). */
+} __attribute__((__packed__)) UsbVideoStreamingInputHeaderDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VS_FORMAT_UNCOMPRESSED. */
+	uint8_t  bFormatIndex;
+	uint8_t  bNumFrameDescriptors;
+	uint8_t  guidFormat[16]; /**<\brief The pixel format (e.g. YUY2). */
+	uint8_t  bBitsPerPixel;
+	uint8_t  bDefaultFrameIndex;
+	uint8_t  bAspectRatioX;
+	uint8_t  bAspectRatioY;
+	uint8_t  bmInterlaceFlags;
+	uint8_t  bCopyProtect;
+} __attribute__((__packed__)) UsbVideoUncompressedFormatDescriptor;
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VS_FORMAT_MJPEG. */
+	uint8_t  bFormatIndex;
+	uint8_t  bNumFrameDescriptors;
+	uint8_t  bmFlags; /**<\brief Bit 0: fixed size samples. */
+	uint8_t  bDefaultFrameIndex;
+	uint8_t  bAspectRatioX;
+	uint8_t  bAspectRatioY;
+	uint8_t  bmInterlaceFlags;
+	uint8_t  bCopyProtect;
+} __attribute__((__packed__)) UsbVideoMjpegFormatDescriptor;
+
+/** \brief Frame descriptor (uncompressed or MJPEG), with 3 discrete frame intervals. */
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint8_t  bDescriptorSubtype; /**<\brief \ref USB_VIDEO_VS_FRAME_UNCOMPRESSED or \ref USB_VIDEO_VS_FRAME_MJPEG. */
+	uint8_t  bFrameIndex;
+	uint8_t  bmCapabilities;
+	uint16_t wWidth;
+	uint16_t wHeight;
+	uint32_t dwMinBitRate; /**<\brief Bits per second at the longest frame interval. */
+	uint32_t dwMaxBitRate; /**<\brief Bits per second at the shortest frame interval. */
+	uint32_t dwMaxVideoFrameBufferSize; /**<\brief Largest frame in bytes. */
+	uint32_t dwDefaultFrameInterval; /**<\brief In 100 ns units. */
+	uint8_t  bFrameIntervalType; /**<\brief Count of discrete frame intervals (3). */
+	uint32_t dwFrameInterval[3]; /**<\brief The frame intervals in 100 ns units, shortest first. */
+} __attribute__((__packed__)) UsbVideoFrameDescriptor;
+
+/** \brief Video probe and commit controls (34 bytes in version 1.1). */
+typedef struct {
+	uint16_t bmHint; /**<\brief The parameters the device must keep (bit 0: dwFrameInterval). */
+	uint8_t  bFormatIndex;
+	uint8_t  bFrameIndex;
+	uint32_t dwFrameInterval; /**<\brief In 100 ns units. */
+	uint16_t wKeyFrameRate;
+	uint16_t wPFrameRate;
+	uint16_t wCompQuality;
+	uint16_t wCompWindowSize;
+	uint16_t wDelay; /**<\brief Latency of the device from capture to the bus (ms). */
+	uint32_t dwMaxVideoFrameSize; /**<\brief Largest frame in bytes. */
+	uint32_t dwMaxPayloadTransferSize; /**<\brief Largest payload (header included) in bytes. */
+	uint32_t dwClockFrequency; /**<\brief Frequency of the clock of PTS and SCR in Hz. */
+	uint8_t  bmFramingInfo; /**<\brief Bit 0: FID is used, bit 1: EOF is used. */
+	uint8_t  bPreferedVersion;
+	uint8_t  bMinVersion;
+	uint8_t  bMaxVersion;
+} __attribute__((__packed__)) UsbVideoProbeCommitControl;
+
+/** \brief Payload header with the presentation time and the source clock reference (12 bytes). */
+typedef struct {
+	uint8_t  bHeaderLength; /**<\brief 12. */
+	uint8_t  bmHeaderInfo; /**<\brief USB_VIDEO_HEADER_*. */
+	uint32_t dwPresentationTime; /**<\brief Device clock when the capture of the frame started. */
+	uint32_t dwSourceTimeClock; /**<\brief Device clock at a SOF... */
+	uint16_t wSofCounter; /**<\brief ...and the number of that SOF (11 bits). */
+} __attribute__((__packed__)) UsbVideoPayloadHeader;
+
+/** @} */
+
+#endif /* VIDEO_USB_VIDEO_STANDARDS_H_ */
@@ -0,0 +1,27 @@
+#ifndef VIDEO_USBD_VIDEO_H_
+#define VIDEO_USBD_VIDEO_H_
+
+#include <stdint.h>
+#include "usbd_class.h"
+#include "Video/usb_video_standards.h"
+
+/// \brief Largest payload (header included) in bytes: the depth of the TxFIFO of the bulk IN endpoint.
+#define VIDEO_PAYLOAD_SIZE 1024
+/// \brief Size of the uncompressed frames (YUY2, 2 bytes per pixel).
+#define VIDEO_UNCOMPRESSED_WIDTH 160
+#define VIDEO_UNCOMPRESSED_HEIGHT 120
+/// \brief Size of the MJPEG frames.
+#define VIDEO_MJPEG_WIDTH 640
+#define VIDEO_MJPEG_HEIGHT 480
+/// \brief Size of the buffer of an MJPEG frame in bytes (the largest MJPEG frame).
+#define VIDEO_MJPEG_BUFFER_SIZE 8192
+
+/** \brief Video function streaming a test pattern (uncompressed YUY2 or MJPEG) over a bulk endpoint.
+ * \details A frame is sent as payloads of up to \ref VIDEO_PAYLOAD_SIZE bytes, each with a header that carries the
+ * presentation time of the frame and a source clock reference: both are values of the 72 MHz clock captured on a SOF
+ * by the hardware, so the host can measure the jitter of the stream. A frame pacer starts the frames at the frame
+ * interval committed by the host.
+ */
+extern const UsbClass usbd_video_class;
+
+#endif /* VIDEO_USBD_VIDEO_H_ */
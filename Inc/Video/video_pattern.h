@@ -0,0 +1,13 @@
+#ifndef VIDEO_VIDEO_PATTERN_H_
+#define VIDEO_VIDEO_PATTERN_H_
+
+#include <stdint.h>
+
+/** \brief Test pattern of the video function: 8 vertical color bars (white, yellow, cyan, green, magenta, red, blue,
+ * black) that scroll to the left, so dropped or repeated frames show on the host.
+ */
+
+void video_pattern_yuy2(uint8_t *data, uint32_t offset, uint32_t size, uint16_t width, uint16_t scroll);
+uint32_t video_pattern_mjpeg(uint8_t *buffer, uint32_t capacity, uint16_t width, uint16_t height, uint16_t scroll);
+
+#endif /* VIDEO_VIDEO_PATTERN_H_ */
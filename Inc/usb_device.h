@@ -3,9 +3,12 @@
 #define USB_DEVICE_H_
 
 #include "usb_standards.h"
+#include "usbd_class.h"
 
 typedef struct
 {
+	/// \brief The device class (function) exposed by the device.
+	UsbClass const *usb_class;
 	/// \brief The current USB device state.
 	UsbDeviceState device_state;
 	/// \brief The current control transfer stage (for endpoint0).
@@ -20,6 +23,11 @@ typedef struct
 	void const *ptr_in_buffer;
 	uint32_t in_data_size;
 	/**@}*/
+
+	/// \brief Where the data stage of a control OUT request is stored (the request stays in `ptr_out_buffer`).
+	void *ptr_out_data;
+	/// \brief Whether the IN data stage must end with a zero length packet (the data is shorter than requested).
+	bool in_zero_length_packet;
 } UsbDevice;
 
 #endif /* USB_DEVICE_H_ */
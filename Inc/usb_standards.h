@@ -15,7 +15,9 @@ typedef struct
 	void (*on_setup_data_received)(uint8_t endpoint_number, uint16_t bcnt);
 	void (*on_out_data_received)(uint8_t endpoint_number, uint16_t bcnt);
 	void (*on_in_transfer_completed)(uint8_t endpoint_number);
+	void (*on_in_transfer_incomplete)(uint8_t endpoint_number);
 	void (*on_out_transfer_completed)(uint8_t endpoint_number);
+	void (*on_sof_received)(uint16_t frame_number);
 	void (*on_usb_polled)();
 } UsbEvents;
 
@@ -81,6 +83,12 @@ typedef struct
 #define USB_STANDARD_SYNCH_FRAME 0x0C /**<\brief Sets and then reports an endpoint's synchronization frame.*/
 /** @} */
 
+/**\name USB standard feature selectors
+ * @{ */
+#define USB_FEATURE_ENDPOINT_HALT 0x00 /**<\brief Halt (stall) of an endpoint (recipient is an endpoint).*/
+#define USB_FEATURE_DEVICE_REMOTE_WAKEUP 0x01 /**<\brief Remote wake up (recipient is the device).*/
+/** @} */
+
 /** \name USB standard descriptor types
  * @{ */
 #define USB_DESCRIPTOR_TYPE_DEVICE 0x01
@@ -184,6 +192,27 @@ typedef struct {
 	uint8_t  bInterval; /**<\brief Polling interval of the endpoint (frames). */
 } __attribute__((__packed__)) UsbEndpointDescriptor;
 
+/**\brief String descriptor 0: the languages of the other string descriptors (one language). */
+typedef struct {
+	uint8_t  bLength; /**<\brief Size of the descriptor, in bytes (4). */
+	uint8_t  bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_STRING descriptor. */
+	uint16_t wLANGID; /**<\brief The language ID (\ref USB_LANGUAGE_ID_ENGLISH_US). */
+} __attribute__((__packed__)) UsbLanguageDescriptor;
+
+#define USB_LANGUAGE_ID_ENGLISH_US 0x0409
+
+/**\brief USB interface association descriptor (groups the interfaces of one function of a composite device). */
+typedef struct {
+	uint8_t bLength; /**<\brief Size of the descriptor, in bytes. */
+	uint8_t bDescriptorType; /**<\brief \ref USB_DESCRIPTOR_TYPE_INTERFASEASSOC descriptor. */
+	uint8_t bFirstInterface; /**<\brief Number of the first interface of the function. */
+	uint8_t bInterfaceCount; /**<\brief Count of contiguous interfaces of the function. */
+	uint8_t bFunctionClass; /**<\brief Class ID of the function. */
+	uint8_t bFunctionSubClass; /**<\brief Subclass ID of the function. */
+	uint8_t bFunctionProtocol; /**<\brief Protocol ID of the function. */
+	uint8_t iFunction; /**<\brief Index of the string descriptor describing the function. */
+} __attribute__((__packed__)) UsbInterfaceAssociationDescriptor;
+
 /** \anchor USB_ENDPOINT_BMATTRIBUTES_TYPE
  * @{ */
 #define USB_ENDPOINT_TYPE_CONTROL 0x00 /**<\brief Control endpoint.*/
@@ -0,0 +1,52 @@
+#ifndef USBD_CLASS_H_
+#define USBD_CLASS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_standards.h"
+
+/** \brief A USB device class (function) plugged into the USB framework.
+ * \note All the callbacks are optional (can be NULL).
+ */
+typedef struct
+{
+	/// \brief Device descriptor of the function.
+	UsbDeviceDescriptor const *device_descriptor;
+	/// \brief Configuration descriptor followed by all the interface, class and endpoint descriptors.
+	void const *configuration_descriptor;
+	/// \brief Size of the configuration descriptor and all its sub descriptors in bytes.
+	uint16_t configuration_descriptor_size;
+	/// \brief String descriptors by index (index 0 is the `UsbLanguageDescriptor`), NULL if the function has none.
+	/// \details Each descriptor starts with its bLength; the UTF-16LE strings are not terminated.
+	void const * const *string_descriptors;
+	/// \brief Count of entries in `string_descriptors`.
+	uint8_t string_descriptor_count;
+
+	/// \brief Called on a USB reset; the function must forget its transfer state.
+	void (*on_reset)();
+	/// \brief Called when the host selects the configuration; the function must configure its endpoints.
+	void (*on_configure)();
+	/** \brief Called for every request the framework does not handle itself (class, vendor, interface and
+	 * endpoint requests). The function answers with `usbd_control_send()`, `usbd_control_receive()` or
+	 * `usbd_control_acknowledge()`, and returns false if it does not support the request (it will be stalled).
+	 * \note A request without data stage can also be answered later (e.g. from `on_poll`) with
+	 * `usbd_control_acknowledge()`: the status stage is NAKed until then.
+	 */
+	bool (*on_setup_request)(UsbRequest const *request);
+	/// \brief Called when the data stage of a request answered with `usbd_control_receive()` has completed.
+	void (*on_control_data_received)(UsbRequest const *request);
+	/// \brief Called on every start of frame (1 ms) while the device is configured.
+	void (*on_sof)(uint16_t frame_number);
+	/// \brief Called when an IN transfer of one of the function endpoints has completed.
+	void (*on_in_transfer_completed)(uint8_t endpoint_number);
+	/// \brief Called when the host did not collect an isochronous IN transfer in its frame (the transfer is dropped).
+	void (*on_in_transfer_incomplete)(uint8_t endpoint_number);
+	/// \brief Called when a packet was received on an OUT endpoint; the function must pop it with `read_packet()`.
+	void (*on_out_data_received)(uint8_t endpoint_number, uint16_t byte_count);
+	/// \brief Called when an OUT transfer of one of the function endpoints has completed.
+	void (*on_out_transfer_completed)(uint8_t endpoint_number);
+	/// \brief Called on every poll of the framework (from the main loop).
+	void (*on_poll)();
+} UsbClass;
+
+#endif /* USBD_CLASS_H_ */
@@ -4,6 +4,7 @@
 #ifndef USBD_DRIVER_H_
 #define USBD_DRIVER_H_
 
+#include <stdbool.h>
 #include "stm32f4xx.h"
 #include "usb_standards.h"
 
@@ -34,6 +35,8 @@ inline static __IO uint32_t *FIFO(uint8_t endpoint_number)
 
 /// \brief Total count of IN or OUT endpoints.
 #define ENDPOINT_COUNT 6
+/// \brief Size of the dedicated FIFO memory (shared by the RxFIFO and all TxFIFOs) in bytes.
+#define FIFO_MEMORY_SIZE 4096
 
 /// \brief USB driver functions exposed to USB framework.
 typedef struct
@@ -45,9 +48,19 @@ typedef struct
 	void (*disconnect)();
 	void (*flush_rxfifo)();
 	void (*flush_txfifo)(uint8_t endpoint_number);
+	void (*stop_in_endpoint)(uint8_t endpoint_number);
 	void (*configure_in_endpoint)(uint8_t endpoint_number, enum UsbEndpointType endpoint_type, uint16_t endpoint_size);
-	void (*read_packet)(void const *buffer, uint16_t size);
+	void (*configure_out_endpoint)(uint8_t endpoint_number, enum UsbEndpointType endpoint_type, uint16_t endpoint_size);
+	void (*stall_in_endpoint)(uint8_t endpoint_number);
+	void (*stall_out_endpoint)(uint8_t endpoint_number);
+	void (*clear_in_endpoint_stall)(uint8_t endpoint_number);
+	void (*clear_out_endpoint_stall)(uint8_t endpoint_number);
+	void (*set_out_endpoint_nak)(uint8_t endpoint_number, bool nak);
+	void (*read_packet)(void *buffer, uint16_t size);
 	void (*write_packet)(uint8_t endpoint_number, void const *buffer, uint16_t size);
+	void (*write_transfer)(uint8_t endpoint_number, void const *buffer, uint16_t size);
+	void (*configure_txfifo_size)(uint8_t endpoint_number, uint16_t size);
+	uint16_t (*get_free_fifo_size)();
 	void (*poll)();
 	// ToDO Add pointers to the other driver functions.
 } UsbDriver;
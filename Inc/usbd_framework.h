@@ -6,5 +6,9 @@
 
 void usbd_initialize();
 void usbd_poll();
+void usbd_control_send(void const *data, uint16_t size);
+void usbd_control_receive(void *buffer, uint16_t size);
+void usbd_control_acknowledge();
+void usbd_control_stall();
 
 #endif /* USBD_FRAMEWORK_H_ */
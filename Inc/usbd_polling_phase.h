@@ -0,0 +1,35 @@
+#ifndef USBD_POLLING_PHASE_H_
+#define USBD_POLLING_PHASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/// \brief Count of host polls that must be observed before the estimate is used.
+#define POLLING_PHASE_MINIMUM_SAMPLES 16
+/// \brief Time (in microseconds) reserved between sampling the inputs and the predicted host poll.
+#define POLLING_PHASE_LEAD_US 100
+
+/** \brief Learns where in the 1 ms frame the host polls an interrupt IN endpoint.
+ * All times are in DWT cycle counter units and the phase is relative to the last SOF.
+ */
+typedef struct
+{
+	/// \brief Cycle counter value when the last SOF was received.
+	uint32_t sof_timestamp;
+	/// \brief Measured length of one frame (cycles between two SOFs).
+	int32_t frame_cycles;
+	/// \brief Estimated time of the host poll after SOF.
+	int32_t phase;
+	/// \brief Mean absolute deviation of the observed polls from `phase` (the poll jitter).
+	int32_t deviation;
+	/// \brief Count of host polls observed since the last reset.
+	uint32_t sample_count;
+} PollingPhaseEstimator;
+
+void polling_phase_reset(PollingPhaseEstimator *estimator);
+void polling_phase_sof_received(PollingPhaseEstimator *estimator, uint32_t timestamp);
+void polling_phase_poll_observed(PollingPhaseEstimator *estimator, uint32_t timestamp);
+bool polling_phase_is_locked(PollingPhaseEstimator const *estimator);
+uint32_t polling_phase_sample_offset(PollingPhaseEstimator const *estimator);
+
+#endif /* USBD_POLLING_PHASE_H_ */
@@ -0,0 +1,41 @@
+#include "Audio/audio_clock.h"
+
+/** \brief Starts the audio clock, and the capture of its value on each SOF.
+ */
+void audio_clock_initialize()
+{
+	SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM2EN);
+
+	// Routes the SOF pulse of OTG_HS to the internal trigger 1 of TIM2 (the pulse must be enabled).
+	SET_BIT(USB_OTG_HS->GCCFG, USB_OTG_GCCFG_SOFOUTEN);
+	MODIFY_REG(TIM2->OR,
+		TIM_OR_ITR1_RMP,
+		TIM_OR_ITR1_RMP_0 | TIM_OR_ITR1_RMP_1
+	);
+
+	// Selects ITR1 as trigger (TRC), and captures the counter in CCR1 on each trigger: the timestamp of SOF has no
+	// software jitter.
+	CLEAR_BIT(TIM2->CCER, TIM_CCER_CC1E);
+	MODIFY_REG(TIM2->SMCR,
+		TIM_SMCR_TS | TIM_SMCR_SMS,
+		_VAL2FLD(TIM_SMCR_TS, 1)
+	);
+	MODIFY_REG(TIM2->CCMR1,
+		TIM_CCMR1_CC1S | TIM_CCMR1_IC1F | TIM_CCMR1_IC1PSC,
+		_VAL2FLD(TIM_CCMR1_CC1S, 3)
+	);
+	SET_BIT(TIM2->CCER, TIM_CCER_CC1E);
+
+	// Counts every tick of the timer clock on the whole 32 bits.
+	WRITE_REG(TIM2->PSC, 0);
+	WRITE_REG(TIM2->ARR, 0xFFFFFFFF);
+	WRITE_REG(TIM2->EGR, TIM_EGR_UG);
+	SET_BIT(TIM2->CR1, TIM_CR1_CEN);
+}
+
+/** \brief Returns the value of the audio clock at the last SOF.
+ */
+uint32_t audio_clock_sof_timestamp()
+{
+	return TIM2->CCR1;
+}
@@ -0,0 +1,368 @@
+#include "stdbool.h"
+#include "string.h"
+#include "stm32f4xx.h"
+#include "Audio/audio_dsp.h"
+#include "Audio/usbd_audio.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Added before the gains are shifted out (rounds to the nearest instead of down).
+#define AUDIO_DSP_GAIN_ROUNDING (1 << (AUDIO_DSP_GAIN_FRACTIONAL_BITS - 1))
+/// \brief Count of runs of each kernel in the benchmark (the fastest one is kept: it was not interrupted).
+#define AUDIO_DSP_BENCHMARK_RUNS 16
+
+/// \brief A word of the buffers (two subframes, or 4 bytes of packed 24-bit subframes); it may alias the samples.
+typedef uint32_t __attribute__((__may_alias__)) AudioDspWord;
+
+_Static_assert(AUDIO_CHANNEL_COUNT == 2 && AUDIO_SUBFRAME_SIZE == 2, "The kernels process stereo 16-bit samples");
+
+/** \brief Packs 16-bit subframes into 24-bit subframes (little endian, the low byte is 0), 4 subframes (12 bytes) per
+ * iteration.
+ * \param output 3 * subframe_count bytes.
+ */
+void audio_dsp_pack_24(uint8_t *output, int16_t const *input, uint32_t subframe_count)
+{
+	AudioDspWord const *in = (AudioDspWord const *)input;
+	AudioDspWord *out = (AudioDspWord *)output;
+	uint32_t i = 0;
+
+	for (; i + 4 <= subframe_count; i += 4)
+	{
+		uint32_t first = *in++;
+		uint32_t second = *in++;
+
+		// 0, s0, s0 | 0 | s1, s1, 0 | s2 | s2, 0, s3, s3 (bytes).
+		*out++ = (first << 16) >> 8;
+		*out++ = (first >> 16) | (second << 24);
+		*out++ = ((second >> 8) & 0xFF) | (second & 0xFFFF0000);
+	}
+
+	for (; i < subframe_count; i++)
+	{
+		output[i * 3] = 0;
+		output[i * 3 + 1] = input[i];
+		output[i * 3 + 2] = input[i] >> 8;
+	}
+}
+
+/** \brief Unpacks 24-bit subframes into 16-bit subframes (the low byte is truncated), 4 subframes per iteration.
+ * \param input 3 * subframe_count bytes.
+ */
+void audio_dsp_unpack_24(int16_t *output, uint8_t const *input, uint32_t subframe_count)
+{
+	AudioDspWord const *in = (AudioDspWord const *)input;
+	AudioDspWord *out = (AudioDspWord *)output;
+	uint32_t i = 0;
+
+	for (; i + 4 <= subframe_count; i += 4)
+	{
+		uint32_t first = *in++;
+		uint32_t second = *in++;
+		uint32_t third = *in++;
+
+		*out++ = __PKHBT(first >> 8, second, 16);
+		*out++ = __PKHBT((second >> 24) | (third << 8), third, 0);
+	}
+
+	for (; i < subframe_count; i++)
+	{
+		output[i] = input[i * 3 + 1] | (input[i * 3 + 2] << 8);
+	}
+}
+
+/** \brief Interleaves two mono channels into stereo samples, 2 samples per iteration.
+ */
+void audio_dsp_interleave(int16_t *output, int16_t const *left, int16_t const *right, uint32_t sample_count)
+{
+	AudioDspWord const *left_words = (AudioDspWord const *)left;
+	AudioDspWord const *right_words = (AudioDspWord const *)right;
+	AudioDspWord *out = (AudioDspWord *)output;
+	uint32_t i = 0;
+
+	for (; i + 2 <= sample_count; i += 2)
+	{
+		uint32_t l = *left_words++;
+		uint32_t r = *right_words++;
+
+		*out++ = __PKHBT(l, r, 16);
+		*out++ = __PKHTB(r, l, 16);
+	}
+
+	for (; i < sample_count; i++)
+	{
+		output[i * 2] = left[i];
+		output[i * 2 + 1] = right[i];
+	}
+}
+
+/** \brief Splits stereo samples into two mono channels, 2 samples per iteration.
+ */
+void audio_dsp_deinterleave(int16_t *left, int16_t *right, int16_t const *input, uint32_t sample_count)
+{
+	AudioDspWord const *in = (AudioDspWord const *)input;
+	AudioDspWord *left_words = (AudioDspWord *)left;
+	AudioDspWord *right_words = (AudioDspWord *)right;
+	uint32_t i = 0;
+
+	for (; i + 2 <= sample_count; i += 2)
+	{
+		uint32_t first = *in++;
+		uint32_t second = *in++;
+
+		*left_words++ = __PKHBT(first, second, 16);
+		*right_words++ = __PKHTB(second, first, 16);
+	}
+
+	for (; i < sample_count; i++)
+	{
+		left[i] = input[i * 2];
+		right[i] = input[i * 2 + 1];
+	}
+}
+
+/** \brief Scales the samples (in place) with a gain per channel, rounded and saturated.
+ * \param left_gain Gain of the left channel (Q2.14, see \ref AUDIO_DSP_UNITY_GAIN).
+ */
+void audio_dsp_apply_gain(int16_t *samples, uint32_t sample_count, int16_t left_gain, int16_t right_gain)
+{
+	AudioDspWord *words = (AudioDspWord *)samples;
+	// The other halfword of each gain operand is 0: the dual multiply keeps one channel.
+	uint32_t const left = (uint16_t)left_gain;
+	uint32_t const right = (uint32_t)(uint16_t)right_gain << 16;
+
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		uint32_t sample = words[i];
+		int32_t l = (int32_t)__SMLAD(sample, left, AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS;
+		int32_t r = (int32_t)__SMLAD(sample, right, AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS;
+
+		words[i] = __PKHBT(__SSAT(l, 16), __SSAT(r, 16), 16);
+	}
+}
+
+/** \brief Adds samples to the output with saturation (both channels in one instruction).
+ */
+void audio_dsp_mix(int16_t *output, int16_t const *input, uint32_t sample_count)
+{
+	AudioDspWord const *in = (AudioDspWord const *)input;
+	AudioDspWord *out = (AudioDspWord *)output;
+
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		out[i] = __QADD16(out[i], in[i]);
+	}
+}
+
+/** \brief Mixes two streams with a gain each, rounded and saturated.
+ * \details The subframes of a channel of both streams are packed in one word, so one dual multiply-accumulate computes
+ * first * first_gain + second * second_gain + rounding.
+ * \param first_gain Gain of the first stream (Q2.14, see \ref AUDIO_DSP_UNITY_GAIN). Gains below
+ * \ref AUDIO_DSP_MIN_MIX_GAIN are raised to it.
+ */
+void audio_dsp_mix_weighted(int16_t *output, int16_t const *first, int16_t const *second, uint32_t sample_count,
+	int16_t first_gain, int16_t second_gain)
+{
+	AudioDspWord const *first_words = (AudioDspWord const *)first;
+	AudioDspWord const *second_words = (AudioDspWord const *)second;
+	AudioDspWord *out = (AudioDspWord *)output;
+	// Note: With both gains at -2.0, two full scale negative subframes would sum to 2^31 (+ rounding), which wraps
+	// around in the 32-bit accumulator; one step above, the sum stays below INT32_MAX.
+	uint32_t const gains = __PKHBT(MAX(first_gain, AUDIO_DSP_MIN_MIX_GAIN), MAX(second_gain, AUDIO_DSP_MIN_MIX_GAIN), 16);
+
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		uint32_t a = first_words[i];
+		uint32_t b = second_words[i];
+		int32_t l = (int32_t)__SMLAD(__PKHBT(a, b, 16), gains, AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS;
+		int32_t r = (int32_t)__SMLAD(__PKHTB(b, a, 16), gains, AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS;
+
+		out[i] = __PKHBT(__SSAT(l, 16), __SSAT(r, 16), 16);
+	}
+}
+
+/** \brief Saturates to the 16-bit range (scalar reference).
+ */
+static int16_t saturate(int32_t value)
+{
+	return MAX(INT16_MIN, MIN(INT16_MAX, value));
+}
+
+static void pack_24_reference(uint8_t *output, int16_t const *input, uint32_t subframe_count)
+{
+	for (uint32_t i = 0; i < subframe_count; i++)
+	{
+		output[i * 3] = 0;
+		output[i * 3 + 1] = input[i];
+		output[i * 3 + 2] = input[i] >> 8;
+	}
+}
+
+static void unpack_24_reference(int16_t *output, uint8_t const *input, uint32_t subframe_count)
+{
+	for (uint32_t i = 0; i < subframe_count; i++)
+	{
+		output[i] = input[i * 3 + 1] | (input[i * 3 + 2] << 8);
+	}
+}
+
+static void interleave_reference(int16_t *output, int16_t const *left, int16_t const *right, uint32_t sample_count)
+{
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		output[i * 2] = left[i];
+		output[i * 2 + 1] = right[i];
+	}
+}
+
+static void deinterleave_reference(int16_t *left, int16_t *right, int16_t const *input, uint32_t sample_count)
+{
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		left[i] = input[i * 2];
+		right[i] = input[i * 2 + 1];
+	}
+}
+
+static void apply_gain_reference(int16_t *samples, uint32_t sample_count, int16_t left_gain, int16_t right_gain)
+{
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		samples[i * 2] = saturate((samples[i * 2] * left_gain + AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS);
+		samples[i * 2 + 1] = saturate((samples[i * 2 + 1] * right_gain + AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS);
+	}
+}
+
+static void mix_reference(int16_t *output, int16_t const *input, uint32_t sample_count)
+{
+	for (uint32_t i = 0; i < sample_count * 2; i++)
+	{
+		output[i] = saturate(output[i] + input[i]);
+	}
+}
+
+static void mix_weighted_reference(int16_t *output, int16_t const *first, int16_t const *second, uint32_t sample_count,
+	int16_t first_gain, int16_t second_gain)
+{
+	first_gain = MAX(first_gain, AUDIO_DSP_MIN_MIX_GAIN);
+	second_gain = MAX(second_gain, AUDIO_DSP_MIN_MIX_GAIN);
+
+	for (uint32_t i = 0; i < sample_count * 2; i++)
+	{
+		output[i] = saturate((first[i] * first_gain + second[i] * second_gain + AUDIO_DSP_GAIN_ROUNDING) >> AUDIO_DSP_GAIN_FRACTIONAL_BITS);
+	}
+}
+
+typedef enum
+{
+	AUDIO_DSP_KERNEL_PACK_24,
+	AUDIO_DSP_KERNEL_UNPACK_24,
+	AUDIO_DSP_KERNEL_INTERLEAVE,
+	AUDIO_DSP_KERNEL_DEINTERLEAVE,
+	AUDIO_DSP_KERNEL_APPLY_GAIN,
+	AUDIO_DSP_KERNEL_MIX,
+	AUDIO_DSP_KERNEL_MIX_WEIGHTED,
+	AUDIO_DSP_KERNEL_COUNT
+} AudioDspKernel;
+
+static char const * const kernel_names[AUDIO_DSP_KERNEL_COUNT] = {
+	"pack 24", "unpack 24", "interleave", "deinterleave", "gain", "mix", "weighted mix"
+};
+
+/// \brief One frame of samples of each stream (loud enough that the gains and the mixes saturate).
+static int16_t benchmark_inputs[2][AUDIO_SAMPLES_PER_FRAME * AUDIO_CHANNEL_COUNT] __attribute__((aligned(4)));
+/// \brief The outputs of the reference (0) and of the kernel (1), compared after each run.
+static int16_t benchmark_outputs[2][AUDIO_SAMPLES_PER_FRAME * AUDIO_CHANNEL_COUNT] __attribute__((aligned(4)));
+static uint8_t benchmark_packed[2][AUDIO_SAMPLES_PER_FRAME * AUDIO_CHANNEL_COUNT * 3] __attribute__((aligned(4)));
+
+/** \brief Runs a kernel (or its reference) on one frame and returns its duration in cycles.
+ */
+static uint32_t run_kernel(AudioDspKernel kernel, bool reference)
+{
+	uint32_t const count = AUDIO_SAMPLES_PER_FRAME;
+	int16_t *output = benchmark_outputs[!reference];
+	uint8_t *packed = benchmark_packed[!reference];
+	int16_t const gain = AUDIO_DSP_UNITY_GAIN * 3 / 2;
+	int16_t const attenuation = AUDIO_DSP_UNITY_GAIN / 3;
+
+	// The in place kernels start from the first input.
+	memcpy(output, benchmark_inputs[0], sizeof(benchmark_outputs[0]));
+	// The unpacking starts from the packed first input.
+	pack_24_reference(packed, benchmark_inputs[0], count * AUDIO_CHANNEL_COUNT);
+
+	uint32_t start = cycle_counter_now();
+
+	switch (kernel)
+	{
+	case AUDIO_DSP_KERNEL_PACK_24:
+		(reference ? pack_24_reference : audio_dsp_pack_24)(packed, benchmark_inputs[1], count * AUDIO_CHANNEL_COUNT);
+		break;
+	case AUDIO_DSP_KERNEL_UNPACK_24:
+		(reference ? unpack_24_reference : audio_dsp_unpack_24)(output, packed, count * AUDIO_CHANNEL_COUNT);
+		break;
+	case AUDIO_DSP_KERNEL_INTERLEAVE:
+		(reference ? interleave_reference : audio_dsp_interleave)(output, benchmark_inputs[0], benchmark_inputs[1], count);
+		break;
+	case AUDIO_DSP_KERNEL_DEINTERLEAVE:
+		(reference ? deinterleave_reference : audio_dsp_deinterleave)(output, output + count, benchmark_inputs[1], count);
+		break;
+	case AUDIO_DSP_KERNEL_APPLY_GAIN:
+		(reference ? apply_gain_reference : audio_dsp_apply_gain)(output, count, gain, -gain);
+		break;
+	case AUDIO_DSP_KERNEL_MIX:
+		(reference ? mix_reference : audio_dsp_mix)(output, benchmark_inputs[1], count);
+		break;
+	case AUDIO_DSP_KERNEL_MIX_WEIGHTED:
+		(reference ? mix_weighted_reference : audio_dsp_mix_weighted)(output, benchmark_inputs[0], benchmark_inputs[1], count, gain, attenuation);
+		break;
+	default:
+		break;
+	}
+
+	return cycle_counter_now() - start;
+}
+
+/** \brief Measures the cycles each kernel and its scalar reference take for one frame of samples (1 ms at the sampling
+ * frequency of the audio function), and checks the kernels return the same samples as the references.
+ * \note `main()` runs it at startup when built with `AUDIO_DSP_BENCHMARK` defined.
+ */
+void audio_dsp_run_benchmark()
+{
+	uint32_t totals[2] = { 0, 0 };
+	uint32_t random = 0x12345678;
+	uint32_t const frame_cycles = SystemCoreClock / 1000;
+
+	for (uint32_t i = 0; i < AUDIO_SAMPLES_PER_FRAME * AUDIO_CHANNEL_COUNT; i++)
+	{
+		random = random * 1664525 + 1013904223;
+		benchmark_inputs[0][i] = random >> 16;
+		benchmark_inputs[1][i] = random;
+	}
+
+	for (AudioDspKernel kernel = 0; kernel < AUDIO_DSP_KERNEL_COUNT; kernel++)
+	{
+		uint32_t cycles[2] = { UINT32_MAX, UINT32_MAX };
+
+		for (uint8_t run = 0; run < AUDIO_DSP_BENCHMARK_RUNS; run++)
+		{
+			for (uint8_t reference = 0; reference < 2; reference++)
+			{
+				cycles[reference] = MIN(cycles[reference], run_kernel(kernel, reference));
+			}
+		}
+
+		if (memcmp(benchmark_outputs[0], benchmark_outputs[1], sizeof(benchmark_outputs[0])) != 0
+			|| memcmp(benchmark_packed[0], benchmark_packed[1], sizeof(benchmark_packed[0])) != 0)
+		{
+			log_error("Audio DSP %s: the kernel and the reference differ.", kernel_names[kernel]);
+		}
+
+		totals[0] += cycles[0];
+		totals[1] += cycles[1];
+		log_info("Audio DSP %s: %lu cycles per frame (reference %lu cycles).", kernel_names[kernel], cycles[0], cycles[1]);
+	}
+
+	log_info("Audio DSP: all the kernels take %lu cycles per frame, %lu.%lu%% of the frame (reference %lu cycles, %lu.%lu%%).",
+		totals[0], totals[0] * 100 / frame_cycles, totals[0] * 1000 / frame_cycles % 10,
+		totals[1], totals[1] * 100 / frame_cycles, totals[1] * 1000 / frame_cycles % 10);
+}
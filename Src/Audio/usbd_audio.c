@@ -0,0 +1,775 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Audio/usbd_audio.h"
+#include "Audio/usb_audio_standards.h"
+#include "Audio/audio_clock.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/ring_buffer.h"
+
+/// \brief Count of frames between two logs of the statistics.
+#define AUDIO_REPORT_PERIOD 1000
+/// \brief Size of the buffer of the speaker (power of two, ~10 ms): it absorbs the jitter of the host.
+#define AUDIO_SPEAKER_BUFFER_SIZE 2048
+/// \brief Size of the buffer of the microphone (power of two, ~5 ms).
+#define AUDIO_MICROPHONE_BUFFER_SIZE 1024
+/// \brief Fill level the feedback keeps the speaker buffer at (bytes).
+#define AUDIO_SPEAKER_TARGET_FILL (AUDIO_SPEAKER_BUFFER_SIZE / 2)
+/// \brief Fill level the packet sizes keep the microphone buffer at (bytes).
+#define AUDIO_MICROPHONE_TARGET_FILL (2 * AUDIO_SAMPLES_PER_FRAME * AUDIO_SAMPLE_SIZE)
+/// \brief Ticks of the audio clock per sample.
+#define AUDIO_TICKS_PER_SAMPLE (AUDIO_CLOCK_HZ / AUDIO_SAMPLE_RATE)
+/// \brief One sample per frame in the 10.14 format of the full speed feedback.
+#define AUDIO_FEEDBACK_ONE_SAMPLE (1 << 14)
+/// \brief The speaker rate moves by 1 / AUDIO_FEEDBACK_FILL_GAIN sample per frame for each sample away from the target
+/// fill (a fill error of 256 samples asks for 1/16 sample per frame more or less).
+#define AUDIO_FEEDBACK_FILL_GAIN 4096
+/// \brief Largest correction of the feedback from the fill level (1/4 sample per frame).
+#define AUDIO_FEEDBACK_MAX_CORRECTION (AUDIO_FEEDBACK_ONE_SAMPLE / 4)
+/// \brief Count of samples the device side processes at once.
+#define AUDIO_PROCESSING_BLOCK_SIZE 16
+
+_Static_assert(AUDIO_CLOCK_HZ % AUDIO_SAMPLE_RATE == 0, "The audio clock is a multiple of the sampling frequency");
+_Static_assert((AUDIO_SPEAKER_BUFFER_SIZE & (AUDIO_SPEAKER_BUFFER_SIZE - 1)) == 0, "The speaker buffer size must be a power of two");
+_Static_assert((AUDIO_MICROPHONE_BUFFER_SIZE & (AUDIO_MICROPHONE_BUFFER_SIZE - 1)) == 0, "The microphone buffer size must be a power of two");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B5,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbAudioControlHeaderDescriptor header;
+	UsbAudioInputTerminalDescriptor speaker_input_terminal;
+	UsbAudioOutputTerminalDescriptor speaker_output_terminal;
+	UsbAudioInputTerminalDescriptor microphone_input_terminal;
+	UsbAudioOutputTerminalDescriptor microphone_output_terminal;
+} __attribute__((__packed__)) UsbAudioControlDescriptors;
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_control_interface_descriptor;
+	UsbAudioControlDescriptors usb_audio_control_descriptors;
+	UsbInterfaceDescriptor usb_speaker_interface_descriptor;
+	UsbInterfaceDescriptor usb_speaker_streaming_interface_descriptor;
+	UsbAudioStreamingGeneralDescriptor usb_speaker_general_descriptor;
+	UsbAudioFormatTypeIDescriptor usb_speaker_format_descriptor;
+	UsbAudioEndpointDescriptor usb_speaker_endpoint_descriptor;
+	UsbAudioStreamingEndpointDescriptor usb_speaker_streaming_endpoint_descriptor;
+	UsbAudioEndpointDescriptor usb_feedback_endpoint_descriptor;
+	UsbInterfaceDescriptor usb_microphone_interface_descriptor;
+	UsbInterfaceDescriptor usb_microphone_streaming_interface_descriptor;
+	UsbAudioStreamingGeneralDescriptor usb_microphone_general_descriptor;
+	UsbAudioFormatTypeIDescriptor usb_microphone_format_descriptor;
+	UsbAudioEndpointDescriptor usb_microphone_endpoint_descriptor;
+	UsbAudioStreamingEndpointDescriptor usb_microphone_streaming_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+#define AUDIO_CONTROL_INTERFACE 0
+#define AUDIO_SPEAKER_INTERFACE 1
+#define AUDIO_MICROPHONE_INTERFACE 2
+
+#define AUDIO_SPEAKER_INPUT_TERMINAL_ID 1
+#define AUDIO_SPEAKER_OUTPUT_TERMINAL_ID 2
+#define AUDIO_MICROPHONE_INPUT_TERMINAL_ID 3
+#define AUDIO_MICROPHONE_OUTPUT_TERMINAL_ID 4
+
+/// \brief Spatial locations of the two channels (left front, right front).
+#define AUDIO_CHANNEL_CONFIG 0x0003
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 3,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 50
+	},
+	.usb_control_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = AUDIO_CONTROL_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOCONTROL,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_audio_control_descriptors = {
+		.header = {
+			.bLength            = sizeof(UsbAudioControlHeaderDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_AUDIO_AC_HEADER,
+			.bcdADC             = 0x0100,
+			.wTotalLength       = sizeof(UsbAudioControlDescriptors),
+			.bInCollection      = 2,
+			.baInterfaceNr      = { AUDIO_SPEAKER_INTERFACE, AUDIO_MICROPHONE_INTERFACE }
+		},
+		.speaker_input_terminal = {
+			.bLength            = sizeof(UsbAudioInputTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_AUDIO_AC_INPUT_TERMINAL,
+			.bTerminalID        = AUDIO_SPEAKER_INPUT_TERMINAL_ID,
+			.wTerminalType      = USB_AUDIO_TERMINAL_USB_STREAMING,
+			.bAssocTerminal     = 0,
+			.bNrChannels        = AUDIO_CHANNEL_COUNT,
+			.wChannelConfig     = AUDIO_CHANNEL_CONFIG,
+			.iChannelNames      = 0,
+			.iTerminal          = 0
+		},
+		.speaker_output_terminal = {
+			.bLength            = sizeof(UsbAudioOutputTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_AUDIO_AC_OUTPUT_TERMINAL,
+			.bTerminalID        = AUDIO_SPEAKER_OUTPUT_TERMINAL_ID,
+			.wTerminalType      = USB_AUDIO_TERMINAL_SPEAKER,
+			.bAssocTerminal     = 0,
+			.bSourceID          = AUDIO_SPEAKER_INPUT_TERMINAL_ID,
+			.iTerminal          = 0
+		},
+		.microphone_input_terminal = {
+			.bLength            = sizeof(UsbAudioInputTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_AUDIO_AC_INPUT_TERMINAL,
+			.bTerminalID        = AUDIO_MICROPHONE_INPUT_TERMINAL_ID,
+			.wTerminalType      = USB_AUDIO_TERMINAL_MICROPHONE,
+			.bAssocTerminal     = 0,
+			.bNrChannels        = AUDIO_CHANNEL_COUNT,
+			.wChannelConfig     = AUDIO_CHANNEL_CONFIG,
+			.iChannelNames      = 0,
+			.iTerminal          = 0
+		},
+		.microphone_output_terminal = {
+			.bLength            = sizeof(UsbAudioOutputTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_AUDIO_AC_OUTPUT_TERMINAL,
+			.bTerminalID        = AUDIO_MICROPHONE_OUTPUT_TERMINAL_ID,
+			.wTerminalType      = USB_AUDIO_TERMINAL_USB_STREAMING,
+			.bAssocTerminal     = 0,
+			.bSourceID          = AUDIO_MICROPHONE_INPUT_TERMINAL_ID,
+			.iTerminal          = 0
+		}
+	},
+	.usb_speaker_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = AUDIO_SPEAKER_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOSTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_speaker_streaming_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = AUDIO_SPEAKER_INTERFACE,
+		.bAlternateSetting      = 1,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOSTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_speaker_general_descriptor = {
+		.bLength                = sizeof(UsbAudioStreamingGeneralDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+		.bDescriptorSubtype     = USB_AUDIO_AS_GENERAL,
+		.bTerminalLink          = AUDIO_SPEAKER_INPUT_TERMINAL_ID,
+		.bDelay                 = 1,
+		.wFormatTag             = USB_AUDIO_FORMAT_PCM
+	},
+	.usb_speaker_format_descriptor = {
+		.bLength                = sizeof(UsbAudioFormatTypeIDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+		.bDescriptorSubtype     = USB_AUDIO_AS_FORMAT_TYPE,
+		.bFormatType            = USB_AUDIO_FORMAT_TYPE_I,
+		.bNrChannels            = AUDIO_CHANNEL_COUNT,
+		.bSubframeSize          = AUDIO_SUBFRAME_SIZE,
+		.bBitResolution         = AUDIO_SUBFRAME_SIZE * 8,
+		.bSamFreqType           = 1,
+		.tSamFreq               = { AUDIO_SAMPLE_RATE & 0xFF, (AUDIO_SAMPLE_RATE >> 8) & 0xFF, AUDIO_SAMPLE_RATE >> 16 }
+	},
+	.usb_speaker_endpoint_descriptor = {
+		.bLength                = sizeof(UsbAudioEndpointDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+		.bEndpointAddress       = 0x01,
+		.bmAttributes           = USB_ENDPOINT_TYPE_ISOCHRONUS | USB_AUDIO_ENDPOINT_ASYNCHRONOUS,
+		.wMaxPacketSize         = AUDIO_MAX_PACKET_SIZE,
+		.bInterval              = 1,
+		.bRefresh               = 0,
+		.bSynchAddress          = 0x81
+	},
+	.usb_speaker_streaming_endpoint_descriptor = {
+		.bLength                = sizeof(UsbAudioStreamingEndpointDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT,
+		.bDescriptorSubtype     = USB_AUDIO_EP_GENERAL,
+		.bmAttributes           = 0,
+		.bLockDelayUnits        = 0,
+		.wLockDelay             = 0
+	},
+	.usb_feedback_endpoint_descriptor = {
+		.bLength                = sizeof(UsbAudioEndpointDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+		.bEndpointAddress       = 0x81,
+		.bmAttributes           = USB_ENDPOINT_TYPE_ISOCHRONUS | USB_AUDIO_ENDPOINT_FEEDBACK,
+		.wMaxPacketSize         = 3,
+		.bInterval              = 1,
+		.bRefresh               = AUDIO_FEEDBACK_REFRESH,
+		.bSynchAddress          = 0
+	},
+	.usb_microphone_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = AUDIO_MICROPHONE_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOSTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_microphone_streaming_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = AUDIO_MICROPHONE_INTERFACE,
+		.bAlternateSetting      = 1,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOSTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_microphone_general_descriptor = {
+		.bLength                = sizeof(UsbAudioStreamingGeneralDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+		.bDescriptorSubtype     = USB_AUDIO_AS_GENERAL,
+		.bTerminalLink          = AUDIO_MICROPHONE_OUTPUT_TERMINAL_ID,
+		.bDelay                 = 1,
+		.wFormatTag             = USB_AUDIO_FORMAT_PCM
+	},
+	.usb_microphone_format_descriptor = {
+		.bLength                = sizeof(UsbAudioFormatTypeIDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+		.bDescriptorSubtype     = USB_AUDIO_AS_FORMAT_TYPE,
+		.bFormatType            = USB_AUDIO_FORMAT_TYPE_I,
+		.bNrChannels            = AUDIO_CHANNEL_COUNT,
+		.bSubframeSize          = AUDIO_SUBFRAME_SIZE,
+		.bBitResolution         = AUDIO_SUBFRAME_SIZE * 8,
+		.bSamFreqType           = 1,
+		.tSamFreq               = { AUDIO_SAMPLE_RATE & 0xFF, (AUDIO_SAMPLE_RATE >> 8) & 0xFF, AUDIO_SAMPLE_RATE >> 16 }
+	},
+	.usb_microphone_endpoint_descriptor = {
+		.bLength                = sizeof(UsbAudioEndpointDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+		.bEndpointAddress       = 0x82,
+		.bmAttributes           = USB_ENDPOINT_TYPE_ISOCHRONUS | USB_AUDIO_ENDPOINT_ASYNCHRONOUS,
+		.wMaxPacketSize         = AUDIO_MAX_PACKET_SIZE,
+		.bInterval              = 1,
+		.bRefresh               = 0,
+		.bSynchAddress          = 0
+	},
+	.usb_microphone_streaming_endpoint_descriptor = {
+		.bLength                = sizeof(UsbAudioStreamingEndpointDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT,
+		.bDescriptorSubtype     = USB_AUDIO_EP_GENERAL,
+		.bmAttributes           = 0,
+		.bLockDelayUnits        = 0,
+		.wLockDelay             = 0
+	}
+};
+
+#define SPEAKER_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_speaker_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define FEEDBACK_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_feedback_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define MICROPHONE_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_microphone_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+typedef struct
+{
+	/// \brief Samples the speaker had to play while its buffer was empty (played as silence).
+	uint32_t underruns;
+	/// \brief Samples received while the speaker buffer was full (dropped).
+	uint32_t overruns;
+	/// \brief Microphone packets of one sample less, and of one sample more than nominal (the fill level control).
+	uint32_t short_packets, long_packets;
+	/// \brief Samples the microphone recorded while its buffer was full (dropped).
+	uint32_t microphone_overruns;
+	/// \brief IN packets the host did not collect in their frame (sent again in the next frame).
+	uint32_t missed_in_packets;
+	/// \brief Feedback measurements dropped because they were not plausible (e.g. SOF were missed).
+	uint32_t rejected_measurements;
+} AudioStatistics;
+
+static const int16_t tone[AUDIO_SAMPLES_PER_FRAME] = {
+	0, 1069, 2120, 3135, 4096, 4987, 5793, 6499, 7094, 7568, 7913, 8122, 8192, 8122, 7913, 7568,
+	7094, 6499, 5793, 4987, 4096, 3135, 2120, 1069, 0, -1069, -2120, -3135, -4096, -4987, -5793, -6499,
+	-7094, -7568, -7913, -8122, -8192, -8122, -7913, -7568, -7094, -6499, -5793, -4987, -4096, -3135, -2120, -1069
+};
+
+static bool configured;
+static uint8_t speaker_alternate_setting, microphone_alternate_setting;
+
+static uint8_t speaker_storage[AUDIO_SPEAKER_BUFFER_SIZE] __attribute__((aligned(4)));
+static RingBuffer speaker_buffer = { .buffer = speaker_storage, .size = sizeof(speaker_storage) };
+/// \brief Whether the speaker plays (it starts once its buffer reached the target fill, and stops on underrun).
+static bool speaker_playing;
+static uint8_t microphone_storage[AUDIO_MICROPHONE_BUFFER_SIZE] __attribute__((aligned(4)));
+static RingBuffer microphone_buffer = { .buffer = microphone_storage, .size = sizeof(microphone_storage) };
+
+/// \brief Receives the speaker packets.
+static uint8_t packet[AUDIO_MAX_PACKET_SIZE] __attribute__((aligned(4)));
+/// \brief The microphone packet in the TxFIFO (kept to send it again if the host misses it).
+static uint8_t microphone_packet[AUDIO_MAX_PACKET_SIZE] __attribute__((aligned(4)));
+static uint16_t microphone_packet_size;
+static uint8_t feedback_packet[4] __attribute__((aligned(4)));
+/// \brief Whether a packet is in the TxFIFO of the feedback and of the microphone endpoint.
+static bool feedback_in_busy, microphone_in_busy;
+
+/// \brief Samples per frame of the audio clock measured on the SOF (10.14), and the value sent to the host.
+static uint32_t measured_rate, feedback_rate;
+/// \brief Audio clock and frame number at the start of the measurement.
+static uint32_t measurement_start_timestamp;
+static uint16_t measurement_start_frame;
+static bool measuring;
+
+/// \brief Audio clock value of the next sample the device side plays and records.
+static uint32_t sample_timestamp;
+static uint8_t tone_index;
+
+static AudioStatistics statistics;
+static uint16_t report_frames;
+
+static bool is_speaker_streaming()
+{
+	return speaker_alternate_setting == 1;
+}
+
+static bool is_microphone_streaming()
+{
+	return microphone_alternate_setting == 1;
+}
+
+/** \brief Adds the correction of the fill level of the speaker buffer to the measured rate.
+ * \details The measured rate alone keeps the fill level where it is; the correction brings it back to the target (a
+ * proportional control, limited so the host never sends more than one sample more or less than nominal).
+ */
+static void update_feedback()
+{
+	int32_t error = (AUDIO_SPEAKER_TARGET_FILL - (int32_t)ring_buffer_used(&speaker_buffer)) / AUDIO_SAMPLE_SIZE;
+	int32_t correction = error * AUDIO_FEEDBACK_ONE_SAMPLE / AUDIO_FEEDBACK_FILL_GAIN;
+	int32_t nominal = AUDIO_SAMPLES_PER_FRAME * AUDIO_FEEDBACK_ONE_SAMPLE;
+
+	correction = MAX(-AUDIO_FEEDBACK_MAX_CORRECTION, MIN(AUDIO_FEEDBACK_MAX_CORRECTION, correction));
+	feedback_rate = MAX(nominal - AUDIO_FEEDBACK_ONE_SAMPLE, MIN(nominal + AUDIO_FEEDBACK_ONE_SAMPLE, (int32_t)measured_rate + correction));
+}
+
+/** \brief Measures the samples per frame of the audio clock: the ticks captured on SOF over 2^AUDIO_FEEDBACK_REFRESH
+ * frames.
+ * \details The measurements follow each other (the end of one is the start of the next), so no tick is lost and the
+ * rounding errors do not add up over time.
+ */
+static void measure_rate(uint16_t frame_number)
+{
+	uint32_t timestamp = audio_clock_sof_timestamp();
+	uint16_t frame_count = (frame_number - measurement_start_frame) & 0x7FF;
+
+	if (!measuring)
+	{
+		measuring = true;
+		measurement_start_timestamp = timestamp;
+		measurement_start_frame = frame_number;
+		return;
+	}
+
+	if (frame_count < (1 << AUDIO_FEEDBACK_REFRESH))
+		return;
+
+	uint32_t rate = ((uint64_t)(timestamp - measurement_start_timestamp) * AUDIO_FEEDBACK_ONE_SAMPLE)
+		/ ((uint64_t)AUDIO_TICKS_PER_SAMPLE * frame_count);
+
+	measurement_start_timestamp = timestamp;
+	measurement_start_frame = frame_number;
+
+	// Note: The crystals differ by some ppm, far less than a sample per frame.
+	if (rate < (AUDIO_SAMPLES_PER_FRAME - 1) * AUDIO_FEEDBACK_ONE_SAMPLE || rate > (AUDIO_SAMPLES_PER_FRAME + 1) * AUDIO_FEEDBACK_ONE_SAMPLE)
+	{
+		statistics.rejected_measurements++;
+		return;
+	}
+
+	measured_rate = rate;
+	update_feedback();
+}
+
+static void send_feedback()
+{
+	// Full speed feedback: 10.14 samples per frame on 3 bytes.
+	feedback_packet[0] = feedback_rate;
+	feedback_packet[1] = feedback_rate >> 8;
+	feedback_packet[2] = feedback_rate >> 16;
+
+	usb_driver.write_packet(FEEDBACK_IN_ENDPOINT_NUMBER, feedback_packet, 3);
+	feedback_in_busy = true;
+}
+
+/** \brief Sends the recorded samples: one sample more or less than nominal when the buffer is away from its target
+ * fill, so the buffer follows the drift between the audio clock and SOF.
+ */
+static void send_microphone_packet()
+{
+	uint32_t fill = ring_buffer_used(&microphone_buffer);
+	uint16_t sample_count = AUDIO_SAMPLES_PER_FRAME;
+
+	if (fill > AUDIO_MICROPHONE_TARGET_FILL + AUDIO_SAMPLES_PER_FRAME / 2 * AUDIO_SAMPLE_SIZE)
+	{
+		sample_count++;
+		statistics.long_packets++;
+	}
+	else if (fill < AUDIO_MICROPHONE_TARGET_FILL - AUDIO_SAMPLES_PER_FRAME / 2 * AUDIO_SAMPLE_SIZE)
+	{
+		sample_count--;
+		statistics.short_packets++;
+	}
+
+	microphone_packet_size = ring_buffer_read(&microphone_buffer, microphone_packet, MIN(sample_count * AUDIO_SAMPLE_SIZE, fill));
+	usb_driver.write_packet(MICROPHONE_IN_ENDPOINT_NUMBER, microphone_packet, microphone_packet_size);
+	microphone_in_busy = true;
+}
+
+/** \brief Plays and records the samples due at the rate of the audio clock (the device side of the audio).
+ * \details The speaker samples are looped back to the microphone; while the speaker does not play, the microphone
+ * records a 1 kHz tone.
+ */
+static void process_samples()
+{
+	uint32_t due = (audio_clock_now() - sample_timestamp) / AUDIO_TICKS_PER_SAMPLE;
+
+	sample_timestamp += due * AUDIO_TICKS_PER_SAMPLE;
+
+	while (due > 0)
+	{
+		int16_t samples[AUDIO_PROCESSING_BLOCK_SIZE][AUDIO_CHANNEL_COUNT];
+		uint32_t count = MIN(due, AUDIO_PROCESSING_BLOCK_SIZE);
+		uint32_t played = 0;
+
+		due -= count;
+
+		if (!speaker_playing && ring_buffer_used(&speaker_buffer) >= AUDIO_SPEAKER_TARGET_FILL)
+		{
+			speaker_playing = true;
+		}
+
+		if (speaker_playing)
+		{
+			played = ring_buffer_read(&speaker_buffer, samples, count * AUDIO_SAMPLE_SIZE) / AUDIO_SAMPLE_SIZE;
+
+			// Plays silence until the buffer is back to its target fill (rather than crackling at its bottom).
+			if (played < count)
+			{
+				statistics.underruns += count - played;
+				speaker_playing = false;
+			}
+		}
+
+		for (uint32_t i = played; i < count; i++)
+		{
+			for (uint8_t channel = 0; channel < AUDIO_CHANNEL_COUNT; channel++)
+			{
+				samples[i][channel] = is_speaker_streaming() ? 0 : tone[tone_index];
+			}
+
+			tone_index = (tone_index + 1) % AUDIO_SAMPLES_PER_FRAME;
+		}
+
+		if (is_microphone_streaming())
+		{
+			uint32_t recorded = ring_buffer_write(&microphone_buffer, samples, count * AUDIO_SAMPLE_SIZE) / AUDIO_SAMPLE_SIZE;
+
+			statistics.microphone_overruns += count - recorded;
+		}
+	}
+}
+
+/** \brief Configures the endpoints of both streaming interfaces, so all the FIFOs are sized once.
+ * \note Resizing a FIFO moves the FIFOs after it: this cannot happen on SET_INTERFACE, while the other interface may
+ * stream. The speaker endpoint NAKs (drops the packets) until its interface streams.
+ */
+static void configure_endpoints()
+{
+	usb_driver.configure_out_endpoint(
+		SPEAKER_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_speaker_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_speaker_endpoint_descriptor.wMaxPacketSize
+	);
+	usb_driver.set_out_endpoint_nak(SPEAKER_OUT_ENDPOINT_NUMBER, true);
+
+	usb_driver.configure_in_endpoint(
+		FEEDBACK_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_feedback_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_feedback_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_in_endpoint(
+		MICROPHONE_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_microphone_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_microphone_endpoint_descriptor.wMaxPacketSize
+	);
+}
+
+static void start_speaker()
+{
+	usb_driver.set_out_endpoint_nak(SPEAKER_OUT_ENDPOINT_NUMBER, false);
+	ring_buffer_clear(&speaker_buffer);
+	speaker_playing = false;
+	update_feedback();
+	send_feedback();
+}
+
+static void start_microphone()
+{
+	// Starts at the target fill (with silence), so the first packets are nominal.
+	ring_buffer_clear(&microphone_buffer);
+	memset(microphone_packet, 0, sizeof(microphone_packet));
+
+	for (uint32_t size = 0; size < AUDIO_MICROPHONE_TARGET_FILL; size += sizeof(microphone_packet))
+	{
+		ring_buffer_write(&microphone_buffer, microphone_packet, MIN(sizeof(microphone_packet), AUDIO_MICROPHONE_TARGET_FILL - size));
+	}
+
+	send_microphone_packet();
+}
+
+/** \brief Stops the IN endpoint of an interface (its packet in the TxFIFO is dropped).
+ */
+static void stop_in_endpoint(uint8_t endpoint_number, bool *busy)
+{
+	if (*busy)
+	{
+		usb_driver.stop_in_endpoint(endpoint_number);
+		*busy = false;
+	}
+}
+
+/** \brief Selects the alternate setting of a streaming interface (1 streams, 0 stops).
+ */
+static bool set_interface(uint8_t interface, uint8_t alternate_setting)
+{
+	if (interface == AUDIO_CONTROL_INTERFACE)
+		return alternate_setting == 0;
+
+	if ((interface != AUDIO_SPEAKER_INTERFACE && interface != AUDIO_MICROPHONE_INTERFACE) || alternate_setting > 1)
+		return false;
+
+	log_info("Audio interface %d: alternate setting %d selected.", interface, alternate_setting);
+
+	if (interface == AUDIO_SPEAKER_INTERFACE)
+	{
+		usb_driver.set_out_endpoint_nak(SPEAKER_OUT_ENDPOINT_NUMBER, true);
+		stop_in_endpoint(FEEDBACK_IN_ENDPOINT_NUMBER, &feedback_in_busy);
+		speaker_alternate_setting = alternate_setting;
+
+		if (is_speaker_streaming())
+		{
+			start_speaker();
+		}
+	}
+	else
+	{
+		stop_in_endpoint(MICROPHONE_IN_ENDPOINT_NUMBER, &microphone_in_busy);
+		microphone_alternate_setting = alternate_setting;
+
+		if (is_microphone_streaming())
+		{
+			start_microphone();
+		}
+	}
+
+	return true;
+}
+
+static void log_statistics()
+{
+	uint32_t measured_mhz = (uint64_t)measured_rate * 1000 * 1000 / AUDIO_FEEDBACK_ONE_SAMPLE;
+	uint32_t feedback_mhz = (uint64_t)feedback_rate * 1000 * 1000 / AUDIO_FEEDBACK_ONE_SAMPLE;
+
+	log_info("Audio clock %lu mHz, feedback %lu mHz, speaker buffer %lu B (%lu underruns, %lu overruns), microphone buffer %lu B (%lu short, %lu long packets, %lu overruns), %lu missed IN packets, %lu rejected measurements.",
+		measured_mhz, feedback_mhz, ring_buffer_used(&speaker_buffer), statistics.underruns, statistics.overruns,
+		ring_buffer_used(&microphone_buffer), statistics.short_packets, statistics.long_packets, statistics.microphone_overruns,
+		statistics.missed_in_packets, statistics.rejected_measurements);
+}
+
+static void reset()
+{
+	configured = false;
+	speaker_alternate_setting = microphone_alternate_setting = 0;
+	feedback_in_busy = microphone_in_busy = false;
+	measuring = false;
+	measured_rate = feedback_rate = AUDIO_SAMPLES_PER_FRAME * AUDIO_FEEDBACK_ONE_SAMPLE;
+}
+
+static void configure()
+{
+	configure_endpoints();
+	audio_clock_initialize();
+	sample_timestamp = audio_clock_now();
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+	configured = true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	static uint8_t alternate_setting;
+
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE))
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_STANDARD_SET_INTERFACE:
+		if (!set_interface(request->wIndex & 0xFF, request->wValue))
+			return false;
+
+		usbd_control_acknowledge();
+		return true;
+	case USB_STANDARD_GET_INTERFACE:
+		switch (request->wIndex & 0xFF)
+		{
+		case AUDIO_CONTROL_INTERFACE:
+			alternate_setting = 0;
+			break;
+		case AUDIO_SPEAKER_INTERFACE:
+			alternate_setting = speaker_alternate_setting;
+			break;
+		case AUDIO_MICROPHONE_INTERFACE:
+			alternate_setting = microphone_alternate_setting;
+			break;
+		default:
+			return false;
+		}
+
+		usbd_control_send(&alternate_setting, sizeof(alternate_setting));
+		return true;
+	}
+
+	return false;
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	uint16_t size = MIN(byte_count, sizeof(packet));
+
+	usb_driver.read_packet(packet, size);
+
+	// Note: The host never sends more than wMaxPacketSize.
+	if (endpoint_number != SPEAKER_OUT_ENDPOINT_NUMBER || !is_speaker_streaming())
+		return;
+
+	size -= size % AUDIO_SAMPLE_SIZE;
+	statistics.overruns += (size - ring_buffer_write(&speaker_buffer, packet, size)) / AUDIO_SAMPLE_SIZE;
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	// The next packet is armed at once, for the next frame.
+	if (endpoint_number == FEEDBACK_IN_ENDPOINT_NUMBER)
+	{
+		feedback_in_busy = false;
+
+		if (is_speaker_streaming())
+		{
+			send_feedback();
+		}
+	}
+	else if (endpoint_number == MICROPHONE_IN_ENDPOINT_NUMBER)
+	{
+		microphone_in_busy = false;
+
+		if (is_microphone_streaming())
+		{
+			send_microphone_packet();
+		}
+	}
+}
+
+static void in_transfer_incomplete(uint8_t endpoint_number)
+{
+	statistics.missed_in_packets++;
+
+	// Sends the same packet in the next frame (no recorded sample is lost).
+	if (endpoint_number == FEEDBACK_IN_ENDPOINT_NUMBER && is_speaker_streaming())
+	{
+		send_feedback();
+	}
+	else if (endpoint_number == MICROPHONE_IN_ENDPOINT_NUMBER && is_microphone_streaming())
+	{
+		usb_driver.write_packet(MICROPHONE_IN_ENDPOINT_NUMBER, microphone_packet, microphone_packet_size);
+	}
+	else
+	{
+		feedback_in_busy = endpoint_number == FEEDBACK_IN_ENDPOINT_NUMBER ? false : feedback_in_busy;
+		microphone_in_busy = endpoint_number == MICROPHONE_IN_ENDPOINT_NUMBER ? false : microphone_in_busy;
+	}
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	measure_rate(frame_number);
+
+	if (is_speaker_streaming() && !feedback_in_busy)
+	{
+		send_feedback();
+	}
+
+	if (is_microphone_streaming() && !microphone_in_busy)
+	{
+		send_microphone_packet();
+	}
+
+	if (++report_frames == AUDIO_REPORT_PERIOD)
+	{
+		report_frames = 0;
+		log_statistics();
+	}
+}
+
+static void polled()
+{
+	if (configured)
+	{
+		process_samples();
+	}
+}
+
+const UsbClass usbd_audio_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_in_transfer_incomplete = &in_transfer_incomplete,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
@@ -0,0 +1,82 @@
+#include "stddef.h"
+#include "string.h"
+#include "Bridge/bridge_loopback.h"
+
+static uint8_t memory[BRIDGE_LOOPBACK_MEMORY_SIZE];
+static uint8_t memory_address;
+static BridgeBusStatus last_status;
+
+static void spi_select(bool selected)
+{
+}
+
+static void spi_transfer(void const *tx, void *rx, uint16_t size)
+{
+	if (rx != NULL)
+	{
+		if (tx != NULL)
+		{
+			memmove(rx, tx, size);
+		}
+		else
+		{
+			memset(rx, 0xFF, size);
+		}
+	}
+
+	last_status = BRIDGE_BUS_DONE;
+}
+
+static void i2c_write(uint8_t address, void const *data, uint16_t size)
+{
+	uint8_t const *bytes = data;
+
+	if (address != BRIDGE_LOOPBACK_I2C_ADDRESS)
+	{
+		last_status = BRIDGE_BUS_ERROR;
+		return;
+	}
+
+	if (size != 0)
+	{
+		memory_address = bytes[0];
+	}
+
+	for (uint16_t i = 1; i < size; i++)
+	{
+		memory[memory_address++] = bytes[i];
+	}
+
+	last_status = BRIDGE_BUS_DONE;
+}
+
+static void i2c_read(uint8_t address, void *data, uint16_t size)
+{
+	uint8_t *bytes = data;
+
+	if (address != BRIDGE_LOOPBACK_I2C_ADDRESS)
+	{
+		last_status = BRIDGE_BUS_ERROR;
+		return;
+	}
+
+	for (uint16_t i = 0; i < size; i++)
+	{
+		bytes[i] = memory[memory_address++];
+	}
+
+	last_status = BRIDGE_BUS_DONE;
+}
+
+static BridgeBusStatus status()
+{
+	return last_status;
+}
+
+const BridgeBus bridge_loopback = {
+	.spi_select = &spi_select,
+	.spi_transfer = &spi_transfer,
+	.i2c_write = &i2c_write,
+	.i2c_read = &i2c_read,
+	.status = &status
+};
@@ -0,0 +1,301 @@
+#include "stddef.h"
+#include "stm32f4xx.h"
+#include "Bridge/bridge_peripherals.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Clock of I2C1 (APB1) in MHz.
+#define BRIDGE_I2C_PERIPHERAL_CLOCK_MHZ 36
+
+typedef enum
+{
+	BRIDGE_OPERATION_NONE,
+	BRIDGE_OPERATION_SPI,
+	BRIDGE_OPERATION_I2C_START,
+	BRIDGE_OPERATION_I2C_ADDRESS,
+	BRIDGE_OPERATION_I2C_DATA,
+	BRIDGE_OPERATION_I2C_LAST_BYTE
+} BridgeOperation;
+
+static BridgeOperation operation;
+static BridgeBusStatus last_status;
+
+/// \brief The I2C operation in progress.
+static uint8_t i2c_address;
+static bool i2c_reading;
+static uint8_t *i2c_data;
+static uint16_t i2c_size;
+static uint32_t i2c_timestamp;
+
+/// \brief What the DMA sends without data (0xFF), and where it drops the bytes it does not keep.
+static const uint8_t spi_fill = 0xFF;
+static uint8_t spi_drop;
+
+static bool initialize()
+{
+	SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_DMA1EN | RCC_AHB1ENR_DMA2EN);
+	SET_BIT(RCC->APB2ENR, RCC_APB2ENR_SPI1EN);
+	SET_BIT(RCC->APB1ENR, RCC_APB1ENR_I2C1EN);
+
+	// PA4 is the chip select (output, released high); PA5, PA6 and PA7 are SPI1 (AF5).
+	WRITE_REG(GPIOA->BSRR, GPIO_BSRR_BS4);
+	MODIFY_REG(GPIOA->MODER,
+		GPIO_MODER_MODER4 | GPIO_MODER_MODER5 | GPIO_MODER_MODER6 | GPIO_MODER_MODER7,
+		_VAL2FLD(GPIO_MODER_MODER4, 1) | _VAL2FLD(GPIO_MODER_MODER5, 2) | _VAL2FLD(GPIO_MODER_MODER6, 2) | _VAL2FLD(GPIO_MODER_MODER7, 2)
+	);
+	MODIFY_REG(GPIOA->OSPEEDR,
+		GPIO_OSPEEDR_OSPEED4 | GPIO_OSPEEDR_OSPEED5 | GPIO_OSPEEDR_OSPEED7,
+		_VAL2FLD(GPIO_OSPEEDR_OSPEED4, 2) | _VAL2FLD(GPIO_OSPEEDR_OSPEED5, 2) | _VAL2FLD(GPIO_OSPEEDR_OSPEED7, 2)
+	);
+	MODIFY_REG(GPIOA->AFR[0],
+		GPIO_AFRL_AFSEL5 | GPIO_AFRL_AFSEL6 | GPIO_AFRL_AFSEL7,
+		_VAL2FLD(GPIO_AFRL_AFSEL5, 5) | _VAL2FLD(GPIO_AFRL_AFSEL6, 5) | _VAL2FLD(GPIO_AFRL_AFSEL7, 5)
+	);
+
+	// PB8 and PB9 are I2C1 (AF4, open drain).
+	SET_BIT(GPIOB->OTYPER, GPIO_OTYPER_OT8 | GPIO_OTYPER_OT9);
+	MODIFY_REG(GPIOB->MODER,
+		GPIO_MODER_MODER8 | GPIO_MODER_MODER9,
+		_VAL2FLD(GPIO_MODER_MODER8, 2) | _VAL2FLD(GPIO_MODER_MODER9, 2)
+	);
+	MODIFY_REG(GPIOB->AFR[1],
+		GPIO_AFRH_AFSEL8 | GPIO_AFRH_AFSEL9,
+		_VAL2FLD(GPIO_AFRH_AFSEL8, 4) | _VAL2FLD(GPIO_AFRH_AFSEL9, 4)
+	);
+
+	// SPI1: master, mode 0, 8 bits, MSB first, clock = APB2 / 8, software chip select.
+	WRITE_REG(SPI1->CR1,
+		SPI_CR1_MSTR | _VAL2FLD(SPI_CR1_BR, 2) | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_SPE
+	);
+
+	// I2C1 in fast mode: CCR = 36 MHz / (3 * 400 kHz), rise time of 300 ns.
+	SET_BIT(I2C1->CR1, I2C_CR1_SWRST);
+	CLEAR_BIT(I2C1->CR1, I2C_CR1_SWRST);
+	WRITE_REG(I2C1->CR2, _VAL2FLD(I2C_CR2_FREQ, BRIDGE_I2C_PERIPHERAL_CLOCK_MHZ));
+	WRITE_REG(I2C1->CCR,
+		I2C_CCR_FS | _VAL2FLD(I2C_CCR_CCR, BRIDGE_I2C_PERIPHERAL_CLOCK_MHZ * 1000000 / (3 * BRIDGE_I2C_CLOCK))
+	);
+	WRITE_REG(I2C1->TRISE, BRIDGE_I2C_PERIPHERAL_CLOCK_MHZ * 300 / 1000 + 1);
+	SET_BIT(I2C1->CR1, I2C_CR1_PE);
+
+	operation = BRIDGE_OPERATION_NONE;
+	last_status = BRIDGE_BUS_DONE;
+	return true;
+}
+
+/** \brief Sets up a DMA stream for one transfer (the stream is disabled and its flags are cleared by the caller).
+ * \param increment Whether the memory address moves (false: the same byte is sent or overwritten).
+ */
+static void start_stream(DMA_Stream_TypeDef *stream, uint8_t channel, volatile void *peripheral, void const *memory,
+	uint16_t size, bool to_peripheral, bool increment)
+{
+	WRITE_REG(stream->PAR, (uint32_t)peripheral);
+	WRITE_REG(stream->M0AR, (uint32_t)memory);
+	WRITE_REG(stream->NDTR, size);
+	WRITE_REG(stream->CR,
+		_VAL2FLD(DMA_SxCR_CHSEL, channel) | _VAL2FLD(DMA_SxCR_PL, 1) | _VAL2FLD(DMA_SxCR_DIR, to_peripheral ? 1 : 0)
+		| (increment ? DMA_SxCR_MINC : 0) | DMA_SxCR_EN
+	);
+}
+
+static void stop_stream(DMA_Stream_TypeDef *stream)
+{
+	CLEAR_BIT(stream->CR, DMA_SxCR_EN);
+	while (READ_BIT(stream->CR, DMA_SxCR_EN));
+}
+
+static void spi_select(bool selected)
+{
+	WRITE_REG(GPIOA->BSRR, selected ? GPIO_BSRR_BR4 : GPIO_BSRR_BS4);
+}
+
+static void spi_transfer(void const *tx, void *rx, uint16_t size)
+{
+	if (size == 0)
+	{
+		last_status = BRIDGE_BUS_DONE;
+		return;
+	}
+
+	stop_stream(DMA2_Stream2);
+	stop_stream(DMA2_Stream3);
+	WRITE_REG(DMA2->LIFCR,
+		DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2
+		| DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3
+	);
+
+	// Stream 2 (channel 3: SPI1_RX) is enabled first, so no byte received is missed; stream 3 (channel 3: SPI1_TX)
+	// feeds the shift register.
+	start_stream(DMA2_Stream2, 3, &SPI1->DR, rx != NULL ? rx : &spi_drop, size, false, rx != NULL);
+	start_stream(DMA2_Stream3, 3, &SPI1->DR, tx != NULL ? tx : &spi_fill, size, true, tx != NULL);
+	SET_BIT(SPI1->CR2, SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+	operation = BRIDGE_OPERATION_SPI;
+	last_status = BRIDGE_BUS_BUSY;
+}
+
+static void start_i2c(uint8_t address, bool reading, uint8_t *data, uint16_t size)
+{
+	i2c_address = address;
+	i2c_reading = reading;
+	i2c_data = data;
+	i2c_size = size;
+	i2c_timestamp = cycle_counter_now();
+
+	SET_BIT(I2C1->CR1, I2C_CR1_START);
+	operation = BRIDGE_OPERATION_I2C_START;
+	last_status = BRIDGE_BUS_BUSY;
+}
+
+static void i2c_write(uint8_t address, void const *data, uint16_t size)
+{
+	start_i2c(address, false, (uint8_t *)data, size);
+}
+
+static void i2c_read(uint8_t address, void *data, uint16_t size)
+{
+	start_i2c(address, true, data, size);
+}
+
+static void end_operation(BridgeBusStatus status)
+{
+	operation = BRIDGE_OPERATION_NONE;
+	last_status = status;
+}
+
+static void stop_i2c(BridgeBusStatus status)
+{
+	SET_BIT(I2C1->CR1, I2C_CR1_STOP);
+	CLEAR_BIT(I2C1->CR2, I2C_CR2_DMAEN | I2C_CR2_LAST);
+	end_operation(status);
+}
+
+/** \brief The address was acknowledged: starts the data phase (the DMA moves the bytes).
+ * \note Reading SR2 after SR1 clears ADDR, which releases the clock: the DMA is ready before.
+ */
+static void start_i2c_data()
+{
+	DMA_Stream_TypeDef *stream = i2c_reading ? DMA1_Stream0 : DMA1_Stream6;
+
+	if (i2c_size == 0)
+	{
+		(void)I2C1->SR2;
+		stop_i2c(BRIDGE_BUS_DONE);
+		return;
+	}
+
+	if (i2c_reading && i2c_size == 1)
+	{
+		// One byte: NACK and STOP are set before the byte comes (the DMA is not needed).
+		CLEAR_BIT(I2C1->CR1, I2C_CR1_ACK);
+		(void)I2C1->SR2;
+		SET_BIT(I2C1->CR1, I2C_CR1_STOP);
+		operation = BRIDGE_OPERATION_I2C_LAST_BYTE;
+		return;
+	}
+
+	stop_stream(stream);
+	WRITE_REG(DMA1->LIFCR, DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0);
+	WRITE_REG(DMA1->HIFCR, DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6);
+
+	// Stream 0 (channel 1: I2C1_RX) or stream 6 (channel 1: I2C1_TX); LAST makes the peripheral NACK the last byte read.
+	start_stream(stream, 1, &I2C1->DR, i2c_data, i2c_size, !i2c_reading, true);
+	SET_BIT(I2C1->CR1, I2C_CR1_ACK);
+	SET_BIT(I2C1->CR2, I2C_CR2_DMAEN | (i2c_reading ? I2C_CR2_LAST : 0));
+	(void)I2C1->SR2;
+	operation = BRIDGE_OPERATION_I2C_DATA;
+}
+
+static void poll_i2c()
+{
+	uint32_t sr1 = READ_REG(I2C1->SR1);
+
+	if (READ_BIT(sr1, I2C_SR1_AF))
+	{
+		// No acknowledge (of the address, or of a byte written).
+		CLEAR_BIT(I2C1->SR1, I2C_SR1_AF);
+		stop_stream(i2c_reading ? DMA1_Stream0 : DMA1_Stream6);
+		stop_i2c(BRIDGE_BUS_ERROR);
+		return;
+	}
+
+	if (cycle_counter_elapsed_us(i2c_timestamp) > BRIDGE_I2C_TIMEOUT_US)
+	{
+		// The bus is stuck (e.g. a device holds SDA low): the peripheral starts over.
+		stop_stream(i2c_reading ? DMA1_Stream0 : DMA1_Stream6);
+		initialize();
+		end_operation(BRIDGE_BUS_ERROR);
+		return;
+	}
+
+	switch (operation)
+	{
+	case BRIDGE_OPERATION_I2C_START:
+		if (READ_BIT(sr1, I2C_SR1_SB))
+		{
+			WRITE_REG(I2C1->DR, (i2c_address << 1) | (i2c_reading ? 1 : 0));
+			operation = BRIDGE_OPERATION_I2C_ADDRESS;
+		}
+		break;
+	case BRIDGE_OPERATION_I2C_ADDRESS:
+		if (READ_BIT(sr1, I2C_SR1_ADDR))
+		{
+			start_i2c_data();
+		}
+		break;
+	case BRIDGE_OPERATION_I2C_DATA:
+		if (i2c_reading && READ_BIT(DMA1->LISR, DMA_LISR_TCIF0))
+		{
+			stop_i2c(BRIDGE_BUS_DONE);
+		}
+		// The last byte written must leave the shift register (BTF) before the STOP.
+		else if (!i2c_reading && READ_BIT(DMA1->HISR, DMA_HISR_TCIF6) && READ_BIT(sr1, I2C_SR1_BTF))
+		{
+			stop_i2c(BRIDGE_BUS_DONE);
+		}
+		break;
+	case BRIDGE_OPERATION_I2C_LAST_BYTE:
+		if (READ_BIT(sr1, I2C_SR1_RXNE))
+		{
+			i2c_data[0] = READ_REG(I2C1->DR);
+			end_operation(BRIDGE_BUS_DONE);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static BridgeBusStatus status()
+{
+	if (operation == BRIDGE_OPERATION_SPI)
+	{
+		if (READ_BIT(DMA2->LISR, DMA_LISR_TEIF2 | DMA_LISR_TEIF3))
+		{
+			stop_stream(DMA2_Stream2);
+			stop_stream(DMA2_Stream3);
+			CLEAR_BIT(SPI1->CR2, SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+			end_operation(BRIDGE_BUS_ERROR);
+		}
+		// The last byte received is the end of the transfer (the last byte sent is out by then).
+		else if (READ_BIT(DMA2->LISR, DMA_LISR_TCIF2))
+		{
+			CLEAR_BIT(SPI1->CR2, SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+			end_operation(BRIDGE_BUS_DONE);
+		}
+	}
+	else if (operation != BRIDGE_OPERATION_NONE)
+	{
+		poll_i2c();
+	}
+
+	return last_status;
+}
+
+const BridgeBus bridge_peripherals = {
+	.initialize = &initialize,
+	.spi_select = &spi_select,
+	.spi_transfer = &spi_transfer,
+	.i2c_write = &i2c_write,
+	.i2c_read = &i2c_read,
+	.status = &status
+};
@@ -0,0 +1,565 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Bridge/usbd_bridge.h"
+#include "Bridge/bridge_loopback.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Count of frames between two logs of the statistics.
+#define BRIDGE_REPORT_PERIOD 1000
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_VENDOR,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13BA,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_VENDOR,
+		.bInterfaceSubClass     = USB_SUBCLASS_VENDOR,
+		.bInterfaceProtocol     = USB_PROTOCOL_VENDOR,
+		.iInterface             = 0
+	},
+    .usb_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = BRIDGE_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = BRIDGE_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+#define BRIDGE_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define BRIDGE_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+typedef struct
+{
+	uint8_t data[BRIDGE_BATCH_SIZE];
+	/// \brief Count of bytes received.
+	uint16_t size;
+	/// \brief The batch is complete: it waits to run, or runs.
+	bool ready;
+} BridgeBatch;
+
+typedef struct
+{
+	uint8_t data[BRIDGE_RESPONSE_SIZE];
+	/// \brief The response is complete: it waits for the endpoint.
+	bool ready;
+} BridgeResponse;
+
+typedef struct
+{
+	uint32_t batches;
+	uint32_t failed_batches;
+	uint32_t commands;
+	uint32_t read_bytes;
+} BridgeStatistics;
+
+_Static_assert(BRIDGE_BATCH_SIZE % BRIDGE_PACKET_SIZE == 0, "A packet never crosses the end of a batch buffer");
+
+/** \brief Batch `i` runs into response `i`: while a batch runs on the bus, the other batch is received and the other
+ * response is sent.
+ */
+static BridgeBatch batches[2] __attribute__((aligned(4)));
+static BridgeResponse responses[2] __attribute__((aligned(4)));
+static uint8_t receiving_batch;
+static uint8_t running_batch;
+static uint8_t sending_response;
+
+static BridgeBus const *bus = &bridge_loopback;
+static bool bus_ready;
+
+static bool configured;
+/// \brief A BRIDGE_RESET waits for the end of the bus operation in progress (its status stage too).
+static bool reset_pending;
+static bool out_nak;
+static bool in_busy;
+static bool zlp_pending;
+
+/// \brief The batch running: the next command, the end of the commands, and the command in progress.
+static bool running;
+static uint16_t cursor;
+static uint16_t end;
+static uint16_t command_offset;
+static uint16_t completed_commands;
+/// \brief Count of bytes read into the response so far.
+static uint16_t response_size;
+/// \brief A bus operation is in progress, and the bytes it reads into the response.
+static bool bus_pending;
+static uint16_t pending_read_size;
+static bool delay_pending;
+static uint32_t delay_timestamp;
+static uint16_t delay_us;
+
+static BridgeStatistics statistics;
+static uint16_t report_frames;
+
+/** \brief Selects the peripherals behind the function (the loopback by default).
+ * \param new_bus The bus (e.g. `bridge_peripherals`); it takes effect at the next configuration.
+ */
+void usbd_bridge_set_bus(BridgeBus const *new_bus)
+{
+	bus = new_bus;
+}
+
+static uint16_t read_u16(uint8_t const *data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+static void finish_batch(BridgeStatus status)
+{
+	BridgeBatchHeader const *batch_header = (BridgeBatchHeader const *)batches[running_batch].data;
+
+	*(BridgeResponseHeader *)responses[running_batch].data = (BridgeResponseHeader){
+		.length = response_size,
+		.sequence = batch_header->sequence,
+		.status = status,
+		.completed_commands = completed_commands,
+		.error_offset = status == BRIDGE_STATUS_OK ? 0 : command_offset - sizeof(BridgeBatchHeader)
+	};
+
+	if (status != BRIDGE_STATUS_OK)
+	{
+		bus->spi_select(false);
+		statistics.failed_batches++;
+	}
+
+	statistics.batches++;
+	statistics.commands += completed_commands;
+	statistics.read_bytes += response_size;
+
+	responses[running_batch].ready = true;
+	batches[running_batch].ready = false;
+	batches[running_batch].size = 0;
+	running_batch ^= 1;
+	running = false;
+
+	// The batch is free: the host can send the next one.
+	if (out_nak)
+	{
+		usb_driver.set_out_endpoint_nak(BRIDGE_OUT_ENDPOINT_NUMBER, false);
+		out_nak = false;
+	}
+}
+
+/** \brief Starts the command at the cursor: it either completes at once, or leaves a bus operation or a delay pending.
+ */
+static BridgeStatus start_command()
+{
+	uint8_t const *command = batches[running_batch].data + cursor;
+	uint16_t available = end - cursor;
+	uint8_t *read_data = responses[running_batch].data + sizeof(BridgeResponseHeader) + response_size;
+	uint16_t read_space = BRIDGE_RESPONSE_SIZE - sizeof(BridgeResponseHeader) - response_size;
+	uint16_t size;
+
+	switch (command[0])
+	{
+	case BRIDGE_SPI_SELECT:
+		if (available < 2)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		bus->spi_select(command[1] != 0);
+		completed_commands++;
+		cursor += 2;
+		return BRIDGE_STATUS_OK;
+	case BRIDGE_SPI_TRANSFER:
+	case BRIDGE_SPI_READ:
+	case BRIDGE_SPI_WRITE:
+	{
+		if (available < 3)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		size = read_u16(command + 1);
+		uint16_t write_size = command[0] != BRIDGE_SPI_READ ? size : 0;
+		uint16_t read_size = command[0] != BRIDGE_SPI_WRITE ? size : 0;
+
+		if (available - 3 < write_size)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		if (read_size > read_space)
+			return BRIDGE_STATUS_RESPONSE_FULL;
+
+		// Note: The DMA reads the batch and writes the response in place (no copy on either side).
+		bus->spi_transfer(write_size != 0 ? command + 3 : NULL, read_size != 0 ? read_data : NULL, size);
+		pending_read_size = read_size;
+		bus_pending = true;
+		cursor += 3 + write_size;
+		return BRIDGE_STATUS_OK;
+	}
+	case BRIDGE_DELAY:
+		if (available < 3)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		delay_us = read_u16(command + 1);
+		delay_timestamp = cycle_counter_now();
+		delay_pending = true;
+		cursor += 3;
+		return BRIDGE_STATUS_OK;
+	case BRIDGE_I2C_WRITE:
+		if (available < 4)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		size = read_u16(command + 2);
+
+		if (available - 4 < size)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		bus->i2c_write(command[1], command + 4, size);
+		pending_read_size = 0;
+		bus_pending = true;
+		cursor += 4 + size;
+		return BRIDGE_STATUS_OK;
+	case BRIDGE_I2C_READ:
+		if (available < 4)
+			return BRIDGE_STATUS_BAD_COMMAND;
+
+		size = read_u16(command + 2);
+
+		if (size > read_space)
+			return BRIDGE_STATUS_RESPONSE_FULL;
+
+		bus->i2c_read(command[1], read_data, size);
+		pending_read_size = size;
+		bus_pending = true;
+		cursor += 4;
+		return BRIDGE_STATUS_OK;
+	}
+
+	return BRIDGE_STATUS_BAD_COMMAND;
+}
+
+/** \brief Starts the next batch if it is complete and its response buffer is free.
+ */
+static void start_batch()
+{
+	BridgeBatch const *batch = &batches[running_batch];
+	BridgeBatchHeader const *batch_header = (BridgeBatchHeader const *)batch->data;
+
+	if (running || !batch->ready || responses[running_batch].ready)
+		return;
+
+	running = true;
+	cursor = command_offset = sizeof(BridgeBatchHeader);
+	end = cursor + batch_header->length;
+	completed_commands = 0;
+	response_size = 0;
+	bus_pending = delay_pending = false;
+
+	// A batch cut short (or longer than the buffer) runs none of its commands.
+	// Note: The length is checked on its own, not through `end`: set by the host, it can make `end` wrap around.
+	if (batch->size < sizeof(BridgeBatchHeader) || batch_header->length > batch->size - sizeof(BridgeBatchHeader))
+	{
+		finish_batch(BRIDGE_STATUS_BAD_COMMAND);
+	}
+	else if (!bus_ready)
+	{
+		finish_batch(BRIDGE_STATUS_BUS_ERROR);
+	}
+}
+
+/** \brief Runs the commands of the batch until one has to wait (for the bus or a delay), or the batch ends.
+ */
+static void run_batch()
+{
+	BridgeStatus status;
+
+	while (running)
+	{
+		if (bus_pending)
+		{
+			BridgeBusStatus bus_status = bus->status();
+
+			if (bus_status == BRIDGE_BUS_BUSY)
+				return;
+
+			bus_pending = false;
+
+			if (bus_status == BRIDGE_BUS_ERROR)
+			{
+				finish_batch(BRIDGE_STATUS_BUS_ERROR);
+				return;
+			}
+
+			response_size += pending_read_size;
+			completed_commands++;
+		}
+
+		if (delay_pending)
+		{
+			if (cycle_counter_elapsed_us(delay_timestamp) < delay_us)
+				return;
+
+			delay_pending = false;
+			completed_commands++;
+		}
+
+		if (cursor == end)
+		{
+			finish_batch(BRIDGE_STATUS_OK);
+			return;
+		}
+
+		command_offset = cursor;
+		status = start_command();
+
+		if (status != BRIDGE_STATUS_OK)
+		{
+			finish_batch(status);
+			return;
+		}
+	}
+}
+
+/** \brief Writes the next response to the TxFIFO (at once: its buffer is free again when the call returns).
+ * \note A response that ends with a full packet is followed by a ZLP, unless it fills the largest response (the host
+ * reads responses into a buffer of \ref BRIDGE_RESPONSE_SIZE).
+ */
+static void transmit()
+{
+	BridgeResponse *response = &responses[sending_response];
+	uint16_t size;
+
+	if (in_busy || !response->ready)
+		return;
+
+	size = sizeof(BridgeResponseHeader) + ((BridgeResponseHeader const *)response->data)->length;
+	usb_driver.write_transfer(BRIDGE_IN_ENDPOINT_NUMBER, response->data, size);
+	zlp_pending = size % BRIDGE_PACKET_SIZE == 0 && size < BRIDGE_RESPONSE_SIZE;
+	in_busy = true;
+	response->ready = false;
+	sending_response ^= 1;
+}
+
+static void reset_data()
+{
+	// Note: A bus operation cannot be cancelled, it ends first (the I2C operations have a timeout). BRIDGE_RESET waits
+	// for it in `polled`; only a USB reset waits here.
+	if (bus_pending)
+	{
+		while (bus->status() == BRIDGE_BUS_BUSY);
+	}
+
+	if (bus_ready)
+	{
+		bus->spi_select(false);
+	}
+
+	if (in_busy)
+	{
+		usb_driver.stop_in_endpoint(BRIDGE_IN_ENDPOINT_NUMBER);
+	}
+
+	if (out_nak)
+	{
+		usb_driver.set_out_endpoint_nak(BRIDGE_OUT_ENDPOINT_NUMBER, false);
+	}
+
+	memset(batches, 0, sizeof(batches));
+	memset(responses, 0, sizeof(responses));
+	receiving_batch = running_batch = sending_response = 0;
+	running = bus_pending = delay_pending = false;
+	in_busy = zlp_pending = out_nak = false;
+}
+
+static void reset()
+{
+	reset_data();
+	reset_pending = false;
+	configured = false;
+}
+
+static void configure()
+{
+	usb_driver.configure_out_endpoint(
+		BRIDGE_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_in_endpoint(
+		BRIDGE_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// The largest response goes into the TxFIFO in one transfer.
+	usb_driver.configure_txfifo_size(BRIDGE_IN_ENDPOINT_NUMBER, BRIDGE_RESPONSE_SIZE);
+
+	bus_ready = bus->initialize == NULL || bus->initialize();
+
+	if (!bus_ready)
+	{
+		log_error("The bus of the bridge cannot be used: every batch fails.");
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+	configured = true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIPIENT_DEVICE))
+		return false;
+
+	switch (request->bRequest)
+	{
+	case BRIDGE_RESET:
+		// Acknowledged by `polled`, once the bus is free.
+		reset_pending = true;
+		return true;
+	}
+
+	return false;
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	BridgeBatch *batch = &batches[receiving_batch];
+	BridgeBatchHeader const *batch_header = (BridgeBatchHeader const *)batch->data;
+	uint16_t size = MIN(byte_count, sizeof(batch->data) - batch->size);
+
+	usb_driver.read_packet(batch->data + batch->size, size);
+
+	// Note: The rest of a packet that does not fit is popped and dropped (the batch fails as cut short).
+	if (size < byte_count)
+	{
+		static uint8_t packet[BRIDGE_PACKET_SIZE] __attribute__((aligned(4)));
+
+		usb_driver.read_packet(packet, byte_count - size);
+	}
+
+	batch->size += size;
+
+	// The batch ends at its length, at a short packet, or when the buffer is full.
+	if ((batch->size >= sizeof(BridgeBatchHeader) && batch->size >= sizeof(BridgeBatchHeader) + batch_header->length)
+		|| byte_count < BRIDGE_PACKET_SIZE || batch->size == sizeof(batch->data))
+	{
+		batch->ready = true;
+		receiving_batch ^= 1;
+
+		// Both batches wait: the host waits too, until one is done.
+		if (batches[receiving_batch].ready)
+		{
+			usb_driver.set_out_endpoint_nak(BRIDGE_OUT_ENDPOINT_NUMBER, true);
+			out_nak = true;
+		}
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (zlp_pending)
+	{
+		usb_driver.write_packet(BRIDGE_IN_ENDPOINT_NUMBER, NULL, 0);
+		zlp_pending = false;
+		return;
+	}
+
+	in_busy = false;
+	transmit();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++report_frames < BRIDGE_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are per second.
+	if (statistics.batches != 0)
+	{
+		log_info("Bridge: %lu batches/s (%lu failed), %lu commands/s, %lu B/s read.",
+			statistics.batches, statistics.failed_batches, statistics.commands, statistics.read_bytes);
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+}
+
+static void polled()
+{
+	if (reset_pending)
+	{
+		// Note: No batch starts meanwhile, and the batch running stops at its bus operation.
+		if (bus_pending && bus->status() == BRIDGE_BUS_BUSY)
+			return;
+
+		reset_data();
+		reset_pending = false;
+		log_info("Bridge reset.");
+		usbd_control_acknowledge();
+	}
+
+	if (!configured)
+		return;
+
+	// Note: The bus runs a batch while the endpoints move the others: each call only starts or ends operations.
+	start_batch();
+	run_batch();
+	transmit();
+
+	// A batch may be done at once (e.g. on the loopback): the next one starts without waiting for the next call.
+	start_batch();
+}
+
+const UsbClass usbd_bridge_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
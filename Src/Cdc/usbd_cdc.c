@@ -0,0 +1,356 @@
+#include "stddef.h"
+#include "Cdc/usbd_cdc.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Serial state bits that report events rather than states (they are cleared once notified).
+#define SERIAL_STATE_EVENTS (USB_CDC_SERIAL_STATE_BREAK | USB_CDC_SERIAL_STATE_RING | USB_CDC_SERIAL_STATE_FRAMING \
+	| USB_CDC_SERIAL_STATE_PARITY | USB_CDC_SERIAL_STATE_OVERRUN)
+
+/** \brief Restores the state of an ACM port after a USB reset (the buffered data is dropped).
+ * \param port The ACM port.
+ */
+void usbd_cdc_reset(UsbCdcAcmPort *port)
+{
+	port->configured = false;
+	port->data_in_busy = false;
+	port->notification_busy = false;
+	port->rx_nak = false;
+	port->last_transfer_size = 0;
+	ring_buffer_clear(&port->rx);
+	ring_buffer_clear(&port->tx);
+
+	// 115200 bauds, 8 data bits, no parity, 1 stop bit until the host sets the line coding.
+	port->line_coding = (UsbCdcLineCoding){
+		.dwDTERate = 115200,
+		.bCharFormat = 0,
+		.bParityType = 0,
+		.bDataBits = 8
+	};
+	port->control_line_state = 0;
+	port->serial_state = USB_CDC_SERIAL_STATE_DCD | USB_CDC_SERIAL_STATE_DSR;
+	port->serial_state_changed = false;
+}
+
+/** \brief Starts the transfers of an ACM port once the function has configured its endpoints.
+ * \param port The ACM port.
+ */
+void usbd_cdc_configure(UsbCdcAcmPort *port)
+{
+	port->data_in_busy = false;
+	port->notification_busy = false;
+	port->rx_nak = false;
+	port->last_transfer_size = 0;
+	// The host learns the initial state of the line (carrier and data set ready).
+	port->serial_state_changed = true;
+	port->configured = true;
+	usbd_cdc_reset_counters(port);
+}
+
+/** \brief Processes the class requests addressed to the communications interface of an ACM port.
+ * \param port The ACM port.
+ * \param request The received request.
+ * \returns false if the request is not addressed to the port or is not supported.
+ */
+bool usbd_cdc_process_request(UsbCdcAcmPort *port, UsbRequest const *request)
+{
+	uint8_t const request_type = request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK);
+
+	if (request_type != (USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE)
+		|| (request->wIndex & 0xFF) != port->comm_interface_number)
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_CDC_SET_LINE_CODING:
+		log_info("CDC Set Line Coding request received.");
+		usbd_control_receive(&port->received_line_coding, sizeof(port->received_line_coding));
+		return true;
+	case USB_CDC_GET_LINE_CODING:
+		log_info("CDC Get Line Coding request received.");
+		usbd_control_send(&port->line_coding, sizeof(port->line_coding));
+		return true;
+	case USB_CDC_SET_CONTROL_LINE_STATE:
+		log_info("CDC Set Control Line State request received (DTR: %d, RTS: %d).",
+			(request->wValue & USB_CDC_CONTROL_LINE_DTR) != 0, (request->wValue & USB_CDC_CONTROL_LINE_RTS) != 0);
+		port->control_line_state = request->wValue;
+		usbd_control_acknowledge();
+		return true;
+	case USB_CDC_SEND_BREAK:
+		log_info("CDC Send Break request received.");
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	return false;
+}
+
+/** \brief Applies the data stage of a SET_LINE_CODING request to an ACM port.
+ * \param port The ACM port.
+ * \param request The request whose data stage has completed.
+ * \returns false if the request is not a SET_LINE_CODING addressed to the port.
+ */
+bool usbd_cdc_process_control_data(UsbCdcAcmPort *port, UsbRequest const *request)
+{
+	if ((request->wIndex & 0xFF) != port->comm_interface_number || request->bRequest != USB_CDC_SET_LINE_CODING)
+		return false;
+
+	port->line_coding = port->received_line_coding;
+	log_info("CDC line coding: %lu bauds, %d data bits, parity %d, stop bits %d.",
+		port->line_coding.dwDTERate, port->line_coding.bDataBits, port->line_coding.bParityType, port->line_coding.bCharFormat);
+	return true;
+}
+
+/** \brief Stores a packet received on the bulk OUT endpoint of an ACM port in its `rx` ring buffer.
+ * \param port The ACM port.
+ * \param endpoint_number The endpoint that received the packet.
+ * \param byte_count Size of the packet (at most \ref USB_CDC_DATA_PACKET_SIZE bytes).
+ * \returns false if the endpoint is not the bulk OUT endpoint of the port (the packet was not popped).
+ */
+bool usbd_cdc_out_data_received(UsbCdcAcmPort *port, uint8_t endpoint_number, uint16_t byte_count)
+{
+	if (endpoint_number != port->data_out_endpoint_number)
+		return false;
+
+	void *region;
+
+	if (ring_buffer_write_region(&port->rx, &region) >= byte_count)
+	{
+		// Common case: the packet goes from the RxFIFO straight to the ring buffer.
+		usb_driver.read_packet(region, byte_count);
+		ring_buffer_commit_write(&port->rx, byte_count);
+	}
+	else
+	{
+		// The packet wraps around the end of the ring buffer (or does not fit, when the host ignored the NAK).
+		usb_driver.read_packet(port->packet, byte_count);
+		uint32_t written = ring_buffer_write(&port->rx, port->packet, byte_count);
+
+		if (written < byte_count)
+		{
+			port->dropped_bytes += byte_count - written;
+			port->serial_state |= USB_CDC_SERIAL_STATE_OVERRUN;
+			port->serial_state_changed = true;
+		}
+	}
+
+	port->received_bytes += byte_count;
+	port->rx_depth_peak = MAX(port->rx_depth_peak, ring_buffer_used(&port->rx));
+
+	// The next packet would not fit: the host is NAKed until the application has read the data.
+	if (!port->rx_nak && ring_buffer_free(&port->rx) < USB_CDC_DATA_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(port->data_out_endpoint_number, true);
+		port->rx_nak = true;
+		port->nak_count++;
+	}
+
+	return true;
+}
+
+/** \brief Writes the serial state notification of an ACM port, if it changed and the endpoint is free.
+ */
+static void notify_serial_state(UsbCdcAcmPort *port)
+{
+	if (!port->configured || port->notification_busy || !port->serial_state_changed)
+		return;
+
+	port->notification = (UsbCdcSerialStateNotification){
+		.bmRequestType = USB_BM_REQUEST_TYPE_DIRECTION_TOHOST | USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE,
+		.bNotification = USB_CDC_NOTIFICATION_SERIAL_STATE,
+		.wValue = 0,
+		.wIndex = port->comm_interface_number,
+		.wLength = sizeof(port->notification.wSerialState),
+		.wSerialState = port->serial_state
+	};
+
+	usb_driver.write_packet(port->notification_endpoint_number, &port->notification, sizeof(port->notification));
+
+	port->notification_busy = true;
+	port->serial_state_changed = false;
+	port->serial_state &= ~SERIAL_STATE_EVENTS;
+}
+
+/** \brief Returns whether an ACM port has a transfer to write (data or a ZLP) and its bulk IN endpoint is free.
+ */
+bool usbd_cdc_can_transmit(UsbCdcAcmPort const *port)
+{
+	if (!port->configured || port->data_in_busy)
+		return false;
+
+	return ring_buffer_used(&port->tx) != 0
+		|| (port->last_transfer_size != 0 && port->last_transfer_size % USB_CDC_DATA_PACKET_SIZE == 0);
+}
+
+/** \brief Writes the next transfer of an ACM port, if the bulk IN endpoint is free.
+ * \param port The ACM port.
+ * \param max_size Maximum size of the transfer in bytes (it is also limited by `transfer_size`).
+ * \returns true if a transfer (possibly a zero length packet) was written.
+ * \details The transfer takes what is waiting in `tx`: while the host collects a transfer the application keeps
+ * writing, so the packets are full under load. A transfer whose last packet is full is followed by a zero length
+ * packet when there is no more data, otherwise the host would wait for more.
+ */
+bool usbd_cdc_transmit(UsbCdcAcmPort *port, uint16_t max_size)
+{
+	if (!usbd_cdc_can_transmit(port))
+		return false;
+
+	uint32_t size = MIN(ring_buffer_used(&port->tx), MIN(max_size, port->transfer_size));
+
+	if (size == 0)
+	{
+		// Note: The data waits when the function allows no byte (`max_size` is 0).
+		if (ring_buffer_used(&port->tx) != 0)
+			return false;
+
+		usb_driver.write_packet(port->data_in_endpoint_number, NULL, 0);
+	}
+	else
+	{
+		void const *region;
+		uint32_t region_size = ring_buffer_read_region(&port->tx, &region);
+
+		// When the data wraps around the end of the ring buffer, the full packets before the end go first.
+		if (region_size < size && region_size >= USB_CDC_DATA_PACKET_SIZE)
+		{
+			size = region_size - region_size % USB_CDC_DATA_PACKET_SIZE;
+		}
+
+		if (region_size >= size)
+		{
+			// Common case: the data goes from the ring buffer straight to the TxFIFO.
+			usb_driver.write_transfer(port->data_in_endpoint_number, region, size);
+			ring_buffer_commit_read(&port->tx, size);
+		}
+		else
+		{
+			// The packet that wraps around the end of the ring buffer.
+			size = ring_buffer_read(&port->tx, port->packet, MIN(size, sizeof(port->packet)));
+			usb_driver.write_packet(port->data_in_endpoint_number, port->packet, size);
+		}
+	}
+
+	port->last_transfer_size = size;
+	port->data_in_busy = true;
+	return true;
+}
+
+/** \brief Continues the IN transfers of an ACM port once the host collected a packet.
+ * \param port The ACM port.
+ * \param endpoint_number The endpoint whose transfer has completed.
+ * \returns false if the endpoint is not one of the IN endpoints of the port.
+ */
+bool usbd_cdc_in_transfer_completed(UsbCdcAcmPort *port, uint8_t endpoint_number)
+{
+	if (endpoint_number == port->data_in_endpoint_number)
+	{
+		port->sent_bytes += port->last_transfer_size;
+		port->data_in_busy = false;
+
+		if (!port->scheduled)
+		{
+			usbd_cdc_transmit(port, port->transfer_size);
+		}
+
+		return true;
+	}
+
+	if (endpoint_number == port->notification_endpoint_number)
+	{
+		port->notification_busy = false;
+		notify_serial_state(port);
+		return true;
+	}
+
+	return false;
+}
+
+/** \brief Moves the data of an ACM port (called from the main loop).
+ * \param port The ACM port.
+ * \details Accepts OUT packets again once `rx` has room for a full packet, and writes the data (unless the port is
+ * scheduled by the function) and the notifications that were queued while the endpoints were idle.
+ */
+void usbd_cdc_poll(UsbCdcAcmPort *port)
+{
+	if (!port->configured)
+		return;
+
+	if (port->rx_nak && ring_buffer_free(&port->rx) >= USB_CDC_DATA_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(port->data_out_endpoint_number, false);
+		port->rx_nak = false;
+	}
+
+	if (!port->scheduled)
+	{
+		usbd_cdc_transmit(port, port->transfer_size);
+	}
+
+	notify_serial_state(port);
+}
+
+/** \brief Queues data to send to the host.
+ * \param port The ACM port.
+ * \param data The data.
+ * \param size Size of the data in bytes.
+ * \returns The count of bytes queued (less than `size` if `tx` is full).
+ */
+uint32_t usbd_cdc_write(UsbCdcAcmPort *port, void const *data, uint32_t size)
+{
+	size = ring_buffer_write(&port->tx, data, size);
+	port->tx_depth_peak = MAX(port->tx_depth_peak, ring_buffer_used(&port->tx));
+	return size;
+}
+
+/** \brief Takes data received from the host.
+ * \param port The ACM port.
+ * \param data Receives the data.
+ * \param size Size of `data` in bytes.
+ * \returns The count of bytes read.
+ */
+uint32_t usbd_cdc_read(UsbCdcAcmPort *port, void *data, uint32_t size)
+{
+	return ring_buffer_read(&port->rx, data, size);
+}
+
+/** \brief Sends the received data of an ACM port back, as much as its `tx` ring buffer can take.
+ * \param port The ACM port.
+ * \note Used as the default receiver of the functions (loopback for throughput benchmarks).
+ */
+void usbd_cdc_loop_back(UsbCdcAcmPort *port)
+{
+	void const *region;
+	uint32_t size = MIN(ring_buffer_read_region(&port->rx, &region), ring_buffer_free(&port->tx));
+
+	if (size == 0)
+		return;
+
+	usbd_cdc_write(port, region, size);
+	ring_buffer_commit_read(&port->rx, size);
+}
+
+/** \brief Updates the serial state bits of an ACM port; the host is notified of the change.
+ * \param port The ACM port.
+ * \param serial_state The serial state bits (USB_CDC_SERIAL_STATE_*); the event bits are sent once.
+ */
+void usbd_cdc_set_serial_state(UsbCdcAcmPort *port, uint16_t serial_state)
+{
+	if (serial_state == port->serial_state)
+		return;
+
+	port->serial_state = serial_state;
+	port->serial_state_changed = true;
+}
+
+/** \brief Resets the throughput and flow control counters of an ACM port.
+ */
+void usbd_cdc_reset_counters(UsbCdcAcmPort *port)
+{
+	port->received_bytes = 0;
+	port->sent_bytes = 0;
+	port->dropped_bytes = 0;
+	port->nak_count = 0;
+	port->rx_depth_peak = 0;
+	port->tx_depth_peak = 0;
+}
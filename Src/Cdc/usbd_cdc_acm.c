@@ -0,0 +1,304 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "Cdc/usbd_cdc_acm.h"
+#include "Cdc/usbd_cdc.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+
+/// \brief Count of frames between two logs of the port throughput.
+#define CDC_ACM_THROUGHPUT_REPORT_PERIOD 1000
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_CDC,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B0,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_comm_interface_descriptor;
+	UsbCdcHeaderDescriptor usb_cdc_header_descriptor;
+	UsbCdcCallManagementDescriptor usb_cdc_call_management_descriptor;
+	UsbCdcAcmDescriptor usb_cdc_acm_descriptor;
+	UsbCdcUnionDescriptor usb_cdc_union_descriptor;
+	UsbEndpointDescriptor usb_notification_endpoint_descriptor;
+	UsbInterfaceDescriptor usb_data_interface_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 2,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_comm_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_CDC,
+		.bInterfaceSubClass     = USB_CDC_SUBCLASS_ACM,
+		.bInterfaceProtocol     = USB_CDC_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+    .usb_cdc_header_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcHeaderDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_HEADER,
+        .bcdCDC                 = 0x0120
+    },
+    .usb_cdc_call_management_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcCallManagementDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_CALL_MANAGEMENT,
+        .bmCapabilities         = 0,
+        .bDataInterface         = 1
+    },
+    .usb_cdc_acm_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcAcmDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_ACM,
+        // Line coding, control line state and serial state, and send break.
+        .bmCapabilities         = 0x02 | 0x04
+    },
+    .usb_cdc_union_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcUnionDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_UNION,
+        .bMasterInterface0      = 0,
+        .bSlaveInterface0       = 1
+    },
+    .usb_notification_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x82,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = USB_CDC_NOTIFICATION_PACKET_SIZE,
+        .bInterval              = USB_CDC_NOTIFICATION_INTERVAL
+    },
+	.usb_data_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 1,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_CDC_DATA,
+		.bInterfaceSubClass     = USB_SUBCLASS_NONE,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+    .usb_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = USB_CDC_DATA_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = USB_CDC_DATA_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+/// \brief The number of the notification interrupt IN endpoint.
+#define CDC_NOTIFICATION_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_notification_endpoint_descriptor.bEndpointAddress & 0x0F)
+/// \brief The number of the bulk OUT endpoint.
+#define CDC_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+/// \brief The number of the bulk IN endpoint.
+#define CDC_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/// \brief Storage of the data received from the host.
+static uint8_t rx_buffer[CDC_ACM_RX_BUFFER_SIZE] __attribute__((aligned(4)));
+/// \brief Storage of the data to send to the host.
+static uint8_t tx_buffer[CDC_ACM_TX_BUFFER_SIZE] __attribute__((aligned(4)));
+
+_Static_assert((CDC_ACM_RX_BUFFER_SIZE & (CDC_ACM_RX_BUFFER_SIZE - 1)) == 0, "The RX buffer size must be a power of two");
+_Static_assert((CDC_ACM_TX_BUFFER_SIZE & (CDC_ACM_TX_BUFFER_SIZE - 1)) == 0, "The TX buffer size must be a power of two");
+
+static UsbCdcAcmPort acm_port = {
+	.comm_interface_number = 0,
+	.rx = { .buffer = rx_buffer, .size = sizeof(rx_buffer) },
+	.tx = { .buffer = tx_buffer, .size = sizeof(tx_buffer) }
+};
+
+/// \brief Processes the received data (called from the main loop when there is some).
+static void (*acm_receiver)();
+/// \brief Frames since the throughput was last logged.
+static uint16_t throughput_frames;
+
+/** \brief Queues data to send to the host; it is written to the bulk IN endpoint in packets of up to 64 bytes.
+ * \param data The data.
+ * \param size Size of the data in bytes.
+ * \returns The count of bytes queued (less than `size` if the transmit buffer is full).
+ */
+uint32_t usbd_cdc_acm_write(void const *data, uint32_t size)
+{
+	return usbd_cdc_write(&acm_port, data, size);
+}
+
+/** \brief Takes data received from the host.
+ * \param data Receives the data.
+ * \param size Size of `data` in bytes.
+ * \returns The count of bytes read.
+ * \note Reading makes room for the host to send more data (it is NAKed while the receive buffer is full).
+ */
+uint32_t usbd_cdc_acm_read(void *data, uint32_t size)
+{
+	return usbd_cdc_read(&acm_port, data, size);
+}
+
+/** \brief Returns the line coding set by the host (baud rate, data bits, parity and stop bits).
+ */
+UsbCdcLineCoding const *usbd_cdc_acm_get_line_coding()
+{
+	return &acm_port.line_coding;
+}
+
+/** \brief Returns whether a terminal opened the port (the host asserts DTR).
+ */
+bool usbd_cdc_acm_is_open()
+{
+	return (acm_port.control_line_state & USB_CDC_CONTROL_LINE_DTR) != 0;
+}
+
+/** \brief Updates the serial state reported to the host with the notification endpoint.
+ * \param serial_state The serial state bits (USB_CDC_SERIAL_STATE_*).
+ */
+void usbd_cdc_acm_set_serial_state(uint16_t serial_state)
+{
+	usbd_cdc_set_serial_state(&acm_port, serial_state);
+}
+
+/** \brief Registers the callback that processes the received data.
+ * \param receiver Function called from the main loop when there is data to read with `usbd_cdc_acm_read()`.
+ * \note Without a receiver, the received data is sent back (loopback for throughput benchmarks, see
+ * host/cdc_acm_benchmark.cpp).
+ */
+void usbd_cdc_acm_set_receiver(void (*receiver)())
+{
+	acm_receiver = receiver;
+}
+
+static void reset()
+{
+	acm_port.notification_endpoint_number = CDC_NOTIFICATION_ENDPOINT_NUMBER;
+	acm_port.data_in_endpoint_number = CDC_IN_ENDPOINT_NUMBER;
+	acm_port.data_out_endpoint_number = CDC_OUT_ENDPOINT_NUMBER;
+	acm_port.transfer_size = configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize;
+	usbd_cdc_reset(&acm_port);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		CDC_NOTIFICATION_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_notification_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_notification_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_in_endpoint(
+		CDC_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		CDC_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usbd_cdc_configure(&acm_port);
+	throughput_frames = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_cdc_process_request(&acm_port, request);
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	usbd_cdc_process_control_data(&acm_port, request);
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	usbd_cdc_out_data_received(&acm_port, endpoint_number, byte_count);
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	usbd_cdc_in_transfer_completed(&acm_port, endpoint_number);
+}
+
+static void polled()
+{
+	if (ring_buffer_used(&acm_port.rx) != 0)
+	{
+		if (acm_receiver != NULL)
+		{
+			acm_receiver();
+		}
+		else
+		{
+			usbd_cdc_loop_back(&acm_port);
+		}
+	}
+
+	usbd_cdc_poll(&acm_port);
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++throughput_frames < CDC_ACM_THROUGHPUT_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are bytes per second.
+	if (acm_port.received_bytes != 0 || acm_port.sent_bytes != 0)
+	{
+		log_info("CDC ACM throughput: %lu B/s OUT, %lu B/s IN (%lu NAK periods, %lu bytes dropped).",
+			acm_port.received_bytes, acm_port.sent_bytes, acm_port.nak_count, acm_port.dropped_bytes);
+	}
+
+	usbd_cdc_reset_counters(&acm_port);
+	throughput_frames = 0;
+}
+
+const UsbClass usbd_cdc_acm_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
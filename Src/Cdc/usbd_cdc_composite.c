@@ -0,0 +1,438 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "Cdc/usbd_cdc_composite.h"
+#include "Cdc/usbd_cdc.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Count of frames between two logs of the port counters.
+#define CDC_COMPOSITE_REPORT_PERIOD 1000
+
+_Static_assert(CDC_COMPOSITE_PORT_COUNT * 2 <= ENDPOINT_COUNT - 1, "Each port needs two IN endpoints");
+_Static_assert((CDC_COMPOSITE_RX_BUFFER_SIZE & (CDC_COMPOSITE_RX_BUFFER_SIZE - 1)) == 0, "The RX buffer size must be a power of two");
+_Static_assert((CDC_COMPOSITE_TX_BUFFER_SIZE & (CDC_COMPOSITE_TX_BUFFER_SIZE - 1)) == 0, "The TX buffer size must be a power of two");
+_Static_assert(CDC_COMPOSITE_MAX_TXFIFO_SIZE % USB_CDC_DATA_PACKET_SIZE == 0, "The TxFIFO must hold whole packets");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_IAD,
+    .bDeviceSubClass    = USB_SUBCLASS_IAD,
+    .bDeviceProtocol    = USB_PROTOCOL_IAD,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B1,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/** \brief The descriptors of one ACM function: the association of its two interfaces, then the interfaces.
+ */
+typedef struct {
+	UsbInterfaceAssociationDescriptor usb_interface_association_descriptor;
+	UsbInterfaceDescriptor usb_comm_interface_descriptor;
+	UsbCdcHeaderDescriptor usb_cdc_header_descriptor;
+	UsbCdcCallManagementDescriptor usb_cdc_call_management_descriptor;
+	UsbCdcAcmDescriptor usb_cdc_acm_descriptor;
+	UsbCdcUnionDescriptor usb_cdc_union_descriptor;
+	UsbEndpointDescriptor usb_notification_endpoint_descriptor;
+	UsbInterfaceDescriptor usb_data_interface_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbCdcFunctionDescriptors;
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbCdcFunctionDescriptors functions[CDC_COMPOSITE_PORT_COUNT];
+} UsbConfigurationDescriptorCombination;
+
+/** \brief Initializer of the descriptors of an ACM function.
+ * \param port The number of the port: its interfaces are 2 * port and 2 * port + 1, its data endpoints are
+ * 0x81 + port and 0x01 + port, and its notification endpoint comes after the data endpoints of all the ports.
+ */
+#define CDC_FUNCTION_DESCRIPTORS(port) { \
+	.usb_interface_association_descriptor = { \
+		.bLength                = sizeof(UsbInterfaceAssociationDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFASEASSOC, \
+		.bFirstInterface        = 2 * (port), \
+		.bInterfaceCount        = 2, \
+		.bFunctionClass         = USB_CLASS_CDC, \
+		.bFunctionSubClass      = USB_CDC_SUBCLASS_ACM, \
+		.bFunctionProtocol      = USB_CDC_PROTOCOL_NONE, \
+		.iFunction              = 0 \
+	}, \
+	.usb_comm_interface_descriptor = { \
+		.bLength                = sizeof(UsbInterfaceDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE, \
+		.bInterfaceNumber       = 2 * (port), \
+		.bAlternateSetting      = 0, \
+		.bNumEndpoints          = 1, \
+		.bInterfaceClass        = USB_CLASS_CDC, \
+		.bInterfaceSubClass     = USB_CDC_SUBCLASS_ACM, \
+		.bInterfaceProtocol     = USB_CDC_PROTOCOL_NONE, \
+		.iInterface             = 0 \
+	}, \
+	.usb_cdc_header_descriptor = { \
+		.bFunctionLength        = sizeof(UsbCdcHeaderDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE, \
+		.bDescriptorSubType     = USB_CDC_SUBTYPE_HEADER, \
+		.bcdCDC                 = 0x0120 \
+	}, \
+	.usb_cdc_call_management_descriptor = { \
+		.bFunctionLength        = sizeof(UsbCdcCallManagementDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE, \
+		.bDescriptorSubType     = USB_CDC_SUBTYPE_CALL_MANAGEMENT, \
+		.bmCapabilities         = 0, \
+		.bDataInterface         = 2 * (port) + 1 \
+	}, \
+	.usb_cdc_acm_descriptor = { \
+		.bFunctionLength        = sizeof(UsbCdcAcmDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE, \
+		.bDescriptorSubType     = USB_CDC_SUBTYPE_ACM, \
+		.bmCapabilities         = 0x02 | 0x04 \
+	}, \
+	.usb_cdc_union_descriptor = { \
+		.bFunctionLength        = sizeof(UsbCdcUnionDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE, \
+		.bDescriptorSubType     = USB_CDC_SUBTYPE_UNION, \
+		.bMasterInterface0      = 2 * (port), \
+		.bSlaveInterface0       = 2 * (port) + 1 \
+	}, \
+	.usb_notification_endpoint_descriptor = { \
+		.bLength                = sizeof(UsbEndpointDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT, \
+		.bEndpointAddress       = 0x81 + CDC_COMPOSITE_PORT_COUNT + (port), \
+		.bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT, \
+		.wMaxPacketSize         = USB_CDC_NOTIFICATION_PACKET_SIZE, \
+		.bInterval              = USB_CDC_NOTIFICATION_INTERVAL \
+	}, \
+	.usb_data_interface_descriptor = { \
+		.bLength                = sizeof(UsbInterfaceDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE, \
+		.bInterfaceNumber       = 2 * (port) + 1, \
+		.bAlternateSetting      = 0, \
+		.bNumEndpoints          = 2, \
+		.bInterfaceClass        = USB_CLASS_CDC_DATA, \
+		.bInterfaceSubClass     = USB_SUBCLASS_NONE, \
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE, \
+		.iInterface             = 0 \
+	}, \
+	.usb_out_endpoint_descriptor = { \
+		.bLength                = sizeof(UsbEndpointDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT, \
+		.bEndpointAddress       = 0x01 + (port), \
+		.bmAttributes           = USB_ENDPOINT_TYPE_BULK, \
+		.wMaxPacketSize         = USB_CDC_DATA_PACKET_SIZE, \
+		.bInterval              = 0 \
+	}, \
+	.usb_in_endpoint_descriptor = { \
+		.bLength                = sizeof(UsbEndpointDescriptor), \
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT, \
+		.bEndpointAddress       = 0x81 + (port), \
+		.bmAttributes           = USB_ENDPOINT_TYPE_BULK, \
+		.wMaxPacketSize         = USB_CDC_DATA_PACKET_SIZE, \
+		.bInterval              = 0 \
+	} \
+}
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 2 * CDC_COMPOSITE_PORT_COUNT,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.functions = {
+		CDC_FUNCTION_DESCRIPTORS(0),
+#if CDC_COMPOSITE_PORT_COUNT > 1
+		CDC_FUNCTION_DESCRIPTORS(1),
+#endif
+	}
+};
+
+/** \brief Counters of a port that the scheduler keeps (the port keeps its own throughput counters).
+ */
+typedef struct {
+	/// \brief Transfers written to the bulk IN endpoint.
+	uint32_t transfer_count;
+	/// \brief Sum of the bytes waiting in `tx`, sampled on every frame.
+	uint32_t tx_depth_sum;
+} CdcPortCounters;
+
+static uint8_t rx_buffers[CDC_COMPOSITE_PORT_COUNT][CDC_COMPOSITE_RX_BUFFER_SIZE] __attribute__((aligned(4)));
+static uint8_t tx_buffers[CDC_COMPOSITE_PORT_COUNT][CDC_COMPOSITE_TX_BUFFER_SIZE] __attribute__((aligned(4)));
+static UsbCdcAcmPort ports[CDC_COMPOSITE_PORT_COUNT];
+static CdcPortCounters port_counters[CDC_COMPOSITE_PORT_COUNT];
+
+/// \brief Bytes each port may still transmit in the current round (deficit round robin).
+static uint32_t deficits[CDC_COMPOSITE_PORT_COUNT];
+/// \brief The port served first in the next round (so that no port is always served first).
+static uint8_t round_start;
+/// \brief Processes the received data of a port (called from the main loop when there is some).
+static void (*composite_receiver)(uint8_t port_number);
+/// \brief Frames since the counters were last logged.
+static uint16_t report_frames;
+
+/** \brief Queues data to send to the host on a port.
+ * \param port_number The port (0 to \ref CDC_COMPOSITE_PORT_COUNT - 1).
+ * \param data The data.
+ * \param size Size of the data in bytes.
+ * \returns The count of bytes queued (less than `size` if the transmit buffer of the port is full).
+ */
+uint32_t usbd_cdc_composite_write(uint8_t port_number, void const *data, uint32_t size)
+{
+	return usbd_cdc_write(&ports[port_number], data, size);
+}
+
+/** \brief Takes data received from the host on a port.
+ * \param port_number The port (0 to \ref CDC_COMPOSITE_PORT_COUNT - 1).
+ * \param data Receives the data.
+ * \param size Size of `data` in bytes.
+ * \returns The count of bytes read.
+ */
+uint32_t usbd_cdc_composite_read(uint8_t port_number, void *data, uint32_t size)
+{
+	return usbd_cdc_read(&ports[port_number], data, size);
+}
+
+/** \brief Returns the line coding set by the host on a port.
+ * \param port_number The port (0 to \ref CDC_COMPOSITE_PORT_COUNT - 1).
+ */
+UsbCdcLineCoding const *usbd_cdc_composite_get_line_coding(uint8_t port_number)
+{
+	return &ports[port_number].line_coding;
+}
+
+/** \brief Returns whether a terminal opened a port (the host asserts DTR).
+ * \param port_number The port (0 to \ref CDC_COMPOSITE_PORT_COUNT - 1).
+ */
+bool usbd_cdc_composite_is_open(uint8_t port_number)
+{
+	return (ports[port_number].control_line_state & USB_CDC_CONTROL_LINE_DTR) != 0;
+}
+
+/** \brief Registers the callback that processes the received data.
+ * \param receiver Function called from the main loop with the number of a port that has data to read.
+ * \note Without a receiver, each port sends its received data back (loopback for throughput benchmarks).
+ */
+void usbd_cdc_composite_set_receiver(void (*receiver)(uint8_t port_number))
+{
+	composite_receiver = receiver;
+}
+
+/** \brief Refills the TxFIFOs of the ports whose bulk IN endpoint is free, with deficit round robin.
+ * \details Every round, a port that has data and a free endpoint earns \ref CDC_COMPOSITE_QUANTUM bytes, and
+ * transmits as much as it earned (up to its TxFIFO). A port with a deep queue therefore gets the same share as the
+ * others instead of refilling its endpoint as soon as it is free; a port that runs out of data loses its deficit.
+ */
+static void schedule_transfers()
+{
+	for (uint8_t i = 0; i < CDC_COMPOSITE_PORT_COUNT; i++)
+	{
+		uint8_t port_number = (round_start + i) % CDC_COMPOSITE_PORT_COUNT;
+		UsbCdcAcmPort *port = &ports[port_number];
+
+		if (!usbd_cdc_can_transmit(port))
+			continue;
+
+		deficits[port_number] = MIN(deficits[port_number] + CDC_COMPOSITE_QUANTUM, port->transfer_size);
+
+		if (usbd_cdc_transmit(port, deficits[port_number]))
+		{
+			deficits[port_number] -= port->last_transfer_size;
+			port_counters[port_number].transfer_count++;
+		}
+
+		if (ring_buffer_used(&port->tx) == 0)
+		{
+			deficits[port_number] = 0;
+		}
+	}
+
+	round_start = (round_start + 1) % CDC_COMPOSITE_PORT_COUNT;
+}
+
+static void reset()
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		UsbCdcFunctionDescriptors const *function = &configuration_descriptor_combination.functions[port_number];
+		UsbCdcAcmPort *port = &ports[port_number];
+
+		port->comm_interface_number = function->usb_comm_interface_descriptor.bInterfaceNumber;
+		port->notification_endpoint_number = function->usb_notification_endpoint_descriptor.bEndpointAddress & 0x0F;
+		port->data_in_endpoint_number = function->usb_in_endpoint_descriptor.bEndpointAddress & 0x0F;
+		port->data_out_endpoint_number = function->usb_out_endpoint_descriptor.bEndpointAddress & 0x0F;
+		port->transfer_size = function->usb_in_endpoint_descriptor.wMaxPacketSize;
+		port->scheduled = true;
+		ring_buffer_initialize(&port->rx, rx_buffers[port_number], sizeof(rx_buffers[port_number]));
+		ring_buffer_initialize(&port->tx, tx_buffers[port_number], sizeof(tx_buffers[port_number]));
+		usbd_cdc_reset(port);
+		deficits[port_number] = 0;
+	}
+
+	round_start = 0;
+}
+
+static void configure()
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		UsbCdcFunctionDescriptors const *function = &configuration_descriptor_combination.functions[port_number];
+
+		usb_driver.configure_in_endpoint(
+			ports[port_number].notification_endpoint_number,
+			(function->usb_notification_endpoint_descriptor.bmAttributes & 0x03),
+			function->usb_notification_endpoint_descriptor.wMaxPacketSize
+		);
+
+		usb_driver.configure_in_endpoint(
+			ports[port_number].data_in_endpoint_number,
+			(function->usb_in_endpoint_descriptor.bmAttributes & 0x03),
+			function->usb_in_endpoint_descriptor.wMaxPacketSize
+		);
+
+		usb_driver.configure_out_endpoint(
+			ports[port_number].data_out_endpoint_number,
+			(function->usb_out_endpoint_descriptor.bmAttributes & 0x03),
+			function->usb_out_endpoint_descriptor.wMaxPacketSize
+		);
+	}
+
+	// The FIFO memory left once all the endpoints have their minimum TxFIFO is shared evenly by the bulk IN endpoints,
+	// so that each one can hold a multi-packet transfer.
+	uint16_t free_fifo_size = usb_driver.get_free_fifo_size();
+	uint16_t share = (free_fifo_size / CDC_COMPOSITE_PORT_COUNT) & ~(USB_CDC_DATA_PACKET_SIZE - 1);
+
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		UsbCdcAcmPort *port = &ports[port_number];
+
+		port->transfer_size = MIN(port->transfer_size + share, CDC_COMPOSITE_MAX_TXFIFO_SIZE);
+		usb_driver.configure_txfifo_size(port->data_in_endpoint_number, port->transfer_size);
+		usbd_cdc_configure(port);
+		port_counters[port_number] = (CdcPortCounters){ 0 };
+	}
+
+	log_info("CDC composite: %d ports, %u bytes of free FIFO memory, %u bytes of TxFIFO per bulk IN endpoint.",
+		CDC_COMPOSITE_PORT_COUNT, free_fifo_size, ports[0].transfer_size);
+	report_frames = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		if (usbd_cdc_process_request(&ports[port_number], request))
+			return true;
+	}
+
+	return false;
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		if (usbd_cdc_process_control_data(&ports[port_number], request))
+			return;
+	}
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		if (usbd_cdc_out_data_received(&ports[port_number], endpoint_number, byte_count))
+			return;
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	// Note: The ports are scheduled, so the free endpoints are refilled by the next round.
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		if (usbd_cdc_in_transfer_completed(&ports[port_number], endpoint_number))
+			return;
+	}
+}
+
+static void polled()
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		UsbCdcAcmPort *port = &ports[port_number];
+
+		if (ring_buffer_used(&port->rx) != 0)
+		{
+			if (composite_receiver != NULL)
+			{
+				composite_receiver(port_number);
+			}
+			else
+			{
+				usbd_cdc_loop_back(port);
+			}
+		}
+
+		usbd_cdc_poll(port);
+	}
+
+	schedule_transfers();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		port_counters[port_number].tx_depth_sum += ring_buffer_used(&ports[port_number].tx);
+	}
+
+	if (++report_frames < CDC_COMPOSITE_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are per second.
+	for (uint8_t port_number = 0; port_number < CDC_COMPOSITE_PORT_COUNT; port_number++)
+	{
+		UsbCdcAcmPort *port = &ports[port_number];
+		CdcPortCounters *counters = &port_counters[port_number];
+
+		if (port->received_bytes != 0 || port->sent_bytes != 0)
+		{
+			log_info("CDC port %d: %lu B/s OUT, %lu B/s IN, %lu transfers/s, TX queue %lu B mean %lu B peak, "
+				"RX queue %lu B peak, %lu NAK periods, %lu bytes dropped.",
+				port_number, port->received_bytes, port->sent_bytes, counters->transfer_count,
+				counters->tx_depth_sum / CDC_COMPOSITE_REPORT_PERIOD, port->tx_depth_peak,
+				port->rx_depth_peak, port->nak_count, port->dropped_bytes);
+		}
+
+		usbd_cdc_reset_counters(port);
+		*counters = (CdcPortCounters){ 0 };
+	}
+
+	report_frames = 0;
+}
+
+const UsbClass usbd_cdc_composite_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
@@ -0,0 +1,824 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Cdc/usbd_cdc_ncm.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Count of frames between two logs of the statistics.
+#define CDC_NCM_REPORT_PERIOD 1000
+/// \brief Maximum packet size of the bulk data endpoints.
+#define CDC_NCM_DATA_PACKET_SIZE 64
+/// \brief Maximum size of an IN transfer: the depth of the TxFIFO of the bulk IN endpoint (an NTB takes several).
+#define CDC_NCM_IN_TRANSFER_SIZE 1024
+/// \brief Alignment of the datagrams and of the NDPs in both directions.
+#define CDC_NCM_ALIGNMENT 4
+/// \brief Speed reported to the host (full speed USB).
+#define CDC_NCM_BIT_RATE 12000000
+/// \brief No IN NTB is being sent.
+#define CDC_NCM_NO_BLOCK 0xFF
+
+_Static_assert(CDC_NCM_NTB_MAX_SIZE <= UINT16_MAX, "16-bit NTBs");
+_Static_assert(CDC_NCM_NTB_MAX_SIZE % CDC_NCM_DATA_PACKET_SIZE == 0, "An NTB of the maximum size ends with a full packet");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_CDC,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B7,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Index of the string descriptor of the MAC address.
+#define CDC_NCM_MAC_ADDRESS_STRING 1
+
+typedef struct {
+	uint8_t  bLength;
+	uint8_t  bDescriptorType;
+	uint16_t wString[12];
+} __attribute__((__packed__)) UsbMacAddressStringDescriptor;
+
+static const UsbLanguageDescriptor language_descriptor = {
+	.bLength                = sizeof(UsbLanguageDescriptor),
+	.bDescriptorType        = USB_DESCRIPTOR_TYPE_STRING,
+	.wLANGID                = USB_LANGUAGE_ID_ENGLISH_US
+};
+
+/// \brief The MAC address of the host side of the link (locally administered: 02:00:00:00:00:01).
+static const UsbMacAddressStringDescriptor mac_address_descriptor = {
+	.bLength                = sizeof(UsbMacAddressStringDescriptor),
+	.bDescriptorType        = USB_DESCRIPTOR_TYPE_STRING,
+	.wString                = { '0', '2', '0', '0', '0', '0', '0', '0', '0', '0', '0', '1' }
+};
+
+static void const * const string_descriptors[] = {
+	&language_descriptor,
+	&mac_address_descriptor
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_comm_interface_descriptor;
+	UsbCdcHeaderDescriptor usb_cdc_header_descriptor;
+	UsbCdcUnionDescriptor usb_cdc_union_descriptor;
+	UsbCdcEthernetDescriptor usb_cdc_ethernet_descriptor;
+	UsbCdcNcmDescriptor usb_cdc_ncm_descriptor;
+	UsbEndpointDescriptor usb_notification_endpoint_descriptor;
+	UsbInterfaceDescriptor usb_data_interface_descriptor;
+	UsbInterfaceDescriptor usb_data_streaming_interface_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+#define CDC_NCM_COMM_INTERFACE 0
+#define CDC_NCM_DATA_INTERFACE 1
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 2,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_comm_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = CDC_NCM_COMM_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_CDC,
+		.bInterfaceSubClass     = USB_CDC_SUBCLASS_NCM,
+		.bInterfaceProtocol     = USB_CDC_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+    .usb_cdc_header_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcHeaderDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_HEADER,
+        .bcdCDC                 = 0x0120
+    },
+    .usb_cdc_union_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcUnionDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_UNION,
+        .bMasterInterface0      = CDC_NCM_COMM_INTERFACE,
+        .bSlaveInterface0       = CDC_NCM_DATA_INTERFACE
+    },
+    .usb_cdc_ethernet_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcEthernetDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_ETHERNET,
+        .iMACAddress            = CDC_NCM_MAC_ADDRESS_STRING,
+        .bmEthernetStatistics   = 0,
+        .wMaxSegmentSize        = CDC_NCM_MAX_FRAME_SIZE,
+        .wNumberMCFilters       = 0,
+        .bNumberPowerFilters    = 0
+    },
+    .usb_cdc_ncm_descriptor = {
+        .bFunctionLength        = sizeof(UsbCdcNcmDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .bDescriptorSubType     = USB_CDC_SUBTYPE_NCM,
+        .bcdNcmVersion          = 0x0100,
+        // SET_ETHERNET_PACKET_FILTER.
+        .bmNetworkCapabilities  = 0x01
+    },
+    .usb_notification_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x82,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(UsbCdcNetworkNotification),
+        .bInterval              = 16
+    },
+	.usb_data_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = CDC_NCM_DATA_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_CDC_DATA,
+		.bInterfaceSubClass     = USB_SUBCLASS_NONE,
+		.bInterfaceProtocol     = USB_CDC_DATA_PROTOCOL_NCM,
+		.iInterface             = 0
+	},
+	.usb_data_streaming_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = CDC_NCM_DATA_INTERFACE,
+		.bAlternateSetting      = 1,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_CDC_DATA,
+		.bInterfaceSubClass     = USB_SUBCLASS_NONE,
+		.bInterfaceProtocol     = USB_CDC_DATA_PROTOCOL_NCM,
+		.iInterface             = 0
+	},
+    .usb_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = CDC_NCM_DATA_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = CDC_NCM_DATA_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+#define CDC_NCM_NOTIFICATION_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_notification_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define CDC_NCM_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define CDC_NCM_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+static const UsbCdcNtbParameters ntb_parameters = {
+	.wLength                    = sizeof(UsbCdcNtbParameters),
+	.bmNtbFormatsSupported      = 0x0001,
+	.dwNtbInMaxSize             = CDC_NCM_NTB_MAX_SIZE,
+	.wNdpInDivisor              = CDC_NCM_ALIGNMENT,
+	.wNdpInPayloadRemainder     = 0,
+	.wNdpInAlignment            = CDC_NCM_ALIGNMENT,
+	.wReserved                  = 0,
+	.dwNtbOutMaxSize            = CDC_NCM_NTB_MAX_SIZE,
+	.wNdpOutDivisor             = CDC_NCM_ALIGNMENT,
+	.wNdpOutPayloadRemainder    = 0,
+	.wNdpOutAlignment           = CDC_NCM_ALIGNMENT,
+	.wNtbOutMaxDatagrams        = 0
+};
+
+/** \brief An IN NTB being filled: the datagrams follow the NTH, the NDP is written after them when the block closes.
+ */
+typedef struct
+{
+	uint8_t data[CDC_NCM_NTB_MAX_SIZE] __attribute__((aligned(4)));
+	/// \brief Offset of the end of the last datagram.
+	uint16_t size;
+	uint16_t datagram_count;
+	uint16_t datagram_indexes[CDC_NCM_MAX_DATAGRAMS];
+	uint16_t datagram_lengths[CDC_NCM_MAX_DATAGRAMS];
+	/// \brief Cycle counter when the first datagram was added (the aggregation timeout starts).
+	uint32_t open_timestamp;
+} NcmInBlock;
+
+typedef struct
+{
+	uint32_t received_ntbs, received_datagrams, received_bytes;
+	uint32_t sent_ntbs, sent_datagrams, sent_bytes;
+	/// \brief OUT NTBs dropped because they were malformed (or larger than the buffer).
+	uint32_t malformed_ntbs;
+	/// \brief IN NTBs closed by the aggregation timeout (the others were full).
+	uint32_t timeout_ntbs;
+} NcmStatistics;
+
+/// \brief Two IN NTBs: one is filled while the other one is sent.
+static NcmInBlock in_blocks[2];
+static uint8_t filling_block, sending_block;
+/// \brief Bytes of the NTB being sent already written to the TxFIFO, and size of the transfer in the TxFIFO.
+static uint16_t sent_size, last_transfer_size;
+static bool in_busy;
+static uint16_t in_sequence;
+/// \brief Maximum size of the IN NTBs set by the host.
+static uint32_t ntb_in_max_size;
+static uint32_t received_ntb_in_max_size;
+static uint32_t aggregation_timeout_us = CDC_NCM_DEFAULT_AGGREGATION_TIMEOUT_US;
+
+/// \brief The OUT NTB: it is received whole, then its datagrams are passed to the receiver (the endpoint NAKs
+/// meanwhile).
+static uint8_t out_block[CDC_NCM_NTB_MAX_SIZE] __attribute__((aligned(4)));
+static uint16_t out_size;
+static bool out_ready, out_overflow;
+/// \brief Position of the next datagram to pass to the receiver: offset of its NDP and index of its entry.
+static uint16_t out_ndp_index, out_entry;
+/// \brief Count of NDPs of the received NTB walked so far.
+static uint16_t out_ndp_count;
+
+static bool configured;
+static uint8_t data_alternate_setting;
+/// \brief Notifications to send: the connection speed, then the connection.
+static bool speed_notification_pending, connection_notification_pending;
+static bool notification_busy;
+static UsbCdcNetworkNotification notification __attribute__((aligned(4)));
+
+static bool (*ncm_receiver)(void const *frame, uint16_t size);
+static NcmStatistics statistics;
+static uint16_t report_frames;
+
+inline static uint16_t align(uint32_t offset)
+{
+	return (offset + CDC_NCM_ALIGNMENT - 1) & ~(CDC_NCM_ALIGNMENT - 1);
+}
+
+inline static uint16_t read_16(uint8_t const *data, uint32_t offset)
+{
+	return data[offset] | (data[offset + 1] << 8);
+}
+
+inline static uint32_t read_32(uint8_t const *data, uint32_t offset)
+{
+	return read_16(data, offset) | ((uint32_t)read_16(data, offset + 2) << 16);
+}
+
+/** \brief Returns the size of the NDP of a given count of datagrams (with the terminating entry).
+ */
+inline static uint16_t ndp_size(uint16_t datagram_count)
+{
+	return sizeof(UsbCdcNdp16) + 4 * (datagram_count + 1);
+}
+
+static void open_block(NcmInBlock *block)
+{
+	block->size = sizeof(UsbCdcNth16);
+	block->datagram_count = 0;
+}
+
+/** \brief Writes the NTB being sent to the TxFIFO, in transfers of up to the depth of the TxFIFO (the host sees one
+ * bulk transfer: all but the last packet are full). An NTB shorter than the maximum size that ends with a full packet
+ * is followed by a zero length packet.
+ */
+static void transmit()
+{
+	if (in_busy || sending_block == CDC_NCM_NO_BLOCK)
+		return;
+
+	NcmInBlock *block = &in_blocks[sending_block];
+	uint16_t block_length = ((UsbCdcNth16 const *)block->data)->wBlockLength;
+
+	if (sent_size == block_length)
+	{
+		if (last_transfer_size % CDC_NCM_DATA_PACKET_SIZE != 0 || block_length == ntb_in_max_size)
+		{
+			// The NTB is complete: the block is free again.
+			sending_block = CDC_NCM_NO_BLOCK;
+			return;
+		}
+
+		usb_driver.write_packet(CDC_NCM_IN_ENDPOINT_NUMBER, NULL, 0);
+		last_transfer_size = 0;
+		in_busy = true;
+		return;
+	}
+
+	last_transfer_size = MIN(block_length - sent_size, CDC_NCM_IN_TRANSFER_SIZE);
+	usb_driver.write_transfer(CDC_NCM_IN_ENDPOINT_NUMBER, block->data + sent_size, last_transfer_size);
+	in_busy = true;
+}
+
+/** \brief Closes the block being filled (writes its NDP and its NTH) and starts sending it.
+ * \returns false if the other block is still being sent.
+ */
+static bool close_block()
+{
+	if (sending_block != CDC_NCM_NO_BLOCK)
+		return false;
+
+	NcmInBlock *block = &in_blocks[filling_block];
+	uint16_t ndp_index = align(block->size);
+	UsbCdcNdp16 *ndp = (UsbCdcNdp16 *)(block->data + ndp_index);
+	uint16_t *entries = (uint16_t *)(ndp + 1);
+
+	*ndp = (UsbCdcNdp16){
+		.dwSignature = USB_CDC_NDP16_SIGNATURE,
+		.wLength = ndp_size(block->datagram_count),
+		.wNextNdpIndex = 0
+	};
+
+	for (uint16_t i = 0; i < block->datagram_count; i++)
+	{
+		entries[i * 2] = block->datagram_indexes[i];
+		entries[i * 2 + 1] = block->datagram_lengths[i];
+	}
+
+	entries[block->datagram_count * 2] = 0;
+	entries[block->datagram_count * 2 + 1] = 0;
+
+	*(UsbCdcNth16 *)block->data = (UsbCdcNth16){
+		.dwSignature = USB_CDC_NTH16_SIGNATURE,
+		.wHeaderLength = sizeof(UsbCdcNth16),
+		.wSequence = in_sequence++,
+		.wBlockLength = ndp_index + ndp->wLength,
+		.wNdpIndex = ndp_index
+	};
+
+	statistics.sent_ntbs++;
+	statistics.sent_datagrams += block->datagram_count;
+
+	sending_block = filling_block;
+	sent_size = 0;
+	last_transfer_size = 0;
+	filling_block ^= 1;
+	open_block(&in_blocks[filling_block]);
+
+	transmit();
+	return true;
+}
+
+/** \brief Returns whether a datagram fits in the block being filled (with the NDP entry it takes).
+ */
+static bool fits(NcmInBlock const *block, uint16_t size)
+{
+	return block->datagram_count < CDC_NCM_MAX_DATAGRAMS
+		&& align(align(block->size) + size) + ndp_size(block->datagram_count + 1) <= ntb_in_max_size;
+}
+
+/** \brief Queues an Ethernet frame to send to the host.
+ * \param frame The frame (without the CRC).
+ * \param size Size of the frame in bytes (at most \ref CDC_NCM_MAX_FRAME_SIZE).
+ * \returns false if the frame does not fit (both NTBs are busy, or the data interface is not selected); the caller
+ * retries later.
+ * \details The frame joins the NTB being filled, which is sent when it is full or when its first frame waited for the
+ * aggregation timeout.
+ */
+bool usbd_cdc_ncm_send(void const *frame, uint16_t size)
+{
+	if (data_alternate_setting != 1 || size > CDC_NCM_MAX_FRAME_SIZE)
+		return false;
+
+	NcmInBlock *block = &in_blocks[filling_block];
+
+	if (!fits(block, size))
+	{
+		if (!close_block())
+			return false;
+
+		block = &in_blocks[filling_block];
+	}
+
+	uint16_t index = align(block->size);
+
+	memcpy(block->data + index, frame, size);
+	block->datagram_indexes[block->datagram_count] = index;
+	block->datagram_lengths[block->datagram_count] = size;
+	block->size = index + size;
+
+	if (block->datagram_count++ == 0)
+	{
+		block->open_timestamp = cycle_counter_now();
+	}
+
+	statistics.sent_bytes += size;
+	return true;
+}
+
+/** \brief Registers the network endpoint that takes the frames received from the host.
+ * \param receiver Returns false when it cannot take the frame now (the frame is passed again later, and the host
+ * waits).
+ * \note Without a receiver, the frames are echoed back to the host with their MAC addresses swapped.
+ */
+void usbd_cdc_ncm_set_receiver(bool (*receiver)(void const *frame, uint16_t size))
+{
+	ncm_receiver = receiver;
+}
+
+/** \brief Sets how long a frame waits for more frames to share its NTB.
+ * \param timeout_us The timeout in µs (0 sends every frame in its own NTB when the bulk IN endpoint is idle).
+ */
+void usbd_cdc_ncm_set_aggregation_timeout(uint32_t timeout_us)
+{
+	aggregation_timeout_us = timeout_us;
+}
+
+/** \brief The default network endpoint: sends the frame back as if it came from the peer.
+ */
+static bool echo(void const *frame, uint16_t size)
+{
+	static uint8_t reply[CDC_NCM_MAX_FRAME_SIZE];
+
+	if (size < 12)
+		return true;
+
+	memcpy(reply, (uint8_t const *)frame + 6, 6);
+	memcpy(reply + 6, frame, 6);
+	memcpy(reply + 12, (uint8_t const *)frame + 12, size - 12);
+	return usbd_cdc_ncm_send(reply, size);
+}
+
+/** \brief Validates the NTH of the received NTB and returns the offset of its first NDP (0 if it is malformed).
+ */
+static uint16_t first_ndp_index()
+{
+	if (out_overflow || out_size < sizeof(UsbCdcNth16)
+		|| read_32(out_block, 0) != USB_CDC_NTH16_SIGNATURE
+		|| read_16(out_block, 4) != sizeof(UsbCdcNth16)
+		|| read_16(out_block, 8) > out_size)
+		return 0;
+
+	return read_16(out_block, 10);
+}
+
+/** \brief Returns whether the NDP at an offset is valid and lies within the received NTB.
+ */
+static bool is_valid_ndp(uint16_t index)
+{
+	uint16_t block_length = read_16(out_block, 8);
+
+	return index >= sizeof(UsbCdcNth16) && index % CDC_NCM_ALIGNMENT == 0
+		&& index + ndp_size(0) <= block_length
+		&& read_32(out_block, index) == USB_CDC_NDP16_SIGNATURE
+		&& read_16(out_block, index + 4) >= ndp_size(1)
+		&& index + read_16(out_block, index + 4) <= block_length;
+}
+
+/** \brief Passes the datagrams of the received NTB to the receiver, until it cannot take more.
+ * \returns true once all the datagrams were taken (or the NTB is malformed).
+ */
+static bool process_out_block()
+{
+	uint16_t const block_length = read_16(out_block, 8);
+	bool (*receiver)(void const *frame, uint16_t size) = ncm_receiver != NULL ? ncm_receiver : &echo;
+
+	while (out_ndp_index != 0)
+	{
+		// Note: The NTB cannot hold more distinct NDPs than this; more means that the NDPs form a loop.
+		if (!is_valid_ndp(out_ndp_index) || out_ndp_count >= block_length / ndp_size(0))
+		{
+			statistics.malformed_ntbs++;
+			return true;
+		}
+
+		uint16_t const entry_count = (read_16(out_block, out_ndp_index + 4) - sizeof(UsbCdcNdp16)) / 4;
+
+		for (; out_entry < entry_count; out_entry++)
+		{
+			uint16_t entry = out_ndp_index + sizeof(UsbCdcNdp16) + out_entry * 4;
+			uint16_t index = read_16(out_block, entry);
+			uint16_t length = read_16(out_block, entry + 2);
+
+			if (index == 0 || length == 0)
+				break;
+
+			if (index + length > block_length)
+			{
+				statistics.malformed_ntbs++;
+				return true;
+			}
+
+			if (!receiver(out_block + index, length))
+				return false;
+
+			statistics.received_datagrams++;
+			statistics.received_bytes += length;
+		}
+
+		out_ndp_index = read_16(out_block, out_ndp_index + 6);
+		out_entry = 0;
+		out_ndp_count++;
+	}
+
+	return true;
+}
+
+/** \brief Sends the pending notifications: the connection speed first, then the connection.
+ */
+static void notify()
+{
+	if (notification_busy || (!speed_notification_pending && !connection_notification_pending))
+		return;
+
+	notification = (UsbCdcNetworkNotification){
+		.bmRequestType = USB_BM_REQUEST_TYPE_DIRECTION_TOHOST | USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE,
+		.wIndex = CDC_NCM_COMM_INTERFACE,
+		.dwDLBitRate = CDC_NCM_BIT_RATE,
+		.dwULBitRate = CDC_NCM_BIT_RATE
+	};
+
+	if (speed_notification_pending)
+	{
+		notification.bNotification = USB_CDC_NOTIFICATION_CONNECTION_SPEED_CHANGE;
+		notification.wLength = 8;
+		speed_notification_pending = false;
+		usb_driver.write_packet(CDC_NCM_NOTIFICATION_ENDPOINT_NUMBER, &notification, sizeof(notification));
+	}
+	else
+	{
+		notification.bNotification = USB_CDC_NOTIFICATION_NETWORK_CONNECTION;
+		notification.wValue = data_alternate_setting;
+		connection_notification_pending = false;
+		usb_driver.write_packet(CDC_NCM_NOTIFICATION_ENDPOINT_NUMBER, &notification, 8);
+	}
+
+	notification_busy = true;
+}
+
+/** \brief Resets the data path (both directions), e.g. when the host selects an alternate setting.
+ */
+static void reset_data()
+{
+	open_block(&in_blocks[0]);
+	open_block(&in_blocks[1]);
+	filling_block = 0;
+	sending_block = CDC_NCM_NO_BLOCK;
+	in_busy = false;
+	in_sequence = 0;
+	out_size = 0;
+	out_ready = false;
+	out_overflow = false;
+}
+
+/** \brief Selects the alternate setting of the data interface: 1 starts the network, 0 stops it.
+ * \note The endpoints are configured once, on SET_CONFIGURATION: resizing the TxFIFO here would move the TxFIFO of the
+ * notification endpoint, which may still hold the notification of the previous alternate setting.
+ */
+static void set_data_interface(uint8_t alternate_setting)
+{
+	usb_driver.stop_in_endpoint(CDC_NCM_IN_ENDPOINT_NUMBER);
+	reset_data();
+	data_alternate_setting = alternate_setting;
+
+	// The OUT endpoint only accepts NTBs in the alternate setting 1.
+	usb_driver.set_out_endpoint_nak(CDC_NCM_OUT_ENDPOINT_NUMBER, alternate_setting != 1);
+
+	if (alternate_setting == 1)
+	{
+		// Note: Both data endpoints restart with DATA0, as the host expects after SET_INTERFACE.
+		usb_driver.clear_in_endpoint_stall(CDC_NCM_IN_ENDPOINT_NUMBER);
+		usb_driver.clear_out_endpoint_stall(CDC_NCM_OUT_ENDPOINT_NUMBER);
+		speed_notification_pending = true;
+	}
+
+	connection_notification_pending = true;
+	notify();
+	log_info("CDC NCM network %s.", alternate_setting == 1 ? "connected" : "disconnected");
+}
+
+static void reset()
+{
+	configured = false;
+	data_alternate_setting = 0;
+	notification_busy = false;
+	speed_notification_pending = connection_notification_pending = false;
+	ntb_in_max_size = CDC_NCM_NTB_MAX_SIZE;
+	reset_data();
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		CDC_NCM_NOTIFICATION_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_notification_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_notification_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_in_endpoint(
+		CDC_NCM_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// A deeper TxFIFO: a third of an NTB goes in one transfer.
+	usb_driver.configure_txfifo_size(CDC_NCM_IN_ENDPOINT_NUMBER, CDC_NCM_IN_TRANSFER_SIZE);
+
+	usb_driver.configure_out_endpoint(
+		CDC_NCM_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// The network starts stopped (alternate setting 0).
+	usb_driver.set_out_endpoint_nak(CDC_NCM_OUT_ENDPOINT_NUMBER, true);
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+	configured = true;
+}
+
+static bool standard_interface_request(UsbRequest const *request)
+{
+	static uint8_t alternate_setting;
+
+	switch (request->bRequest)
+	{
+	case USB_STANDARD_SET_INTERFACE:
+		if ((request->wIndex & 0xFF) == CDC_NCM_DATA_INTERFACE && request->wValue <= 1)
+		{
+			set_data_interface(request->wValue);
+		}
+		else if ((request->wIndex & 0xFF) != CDC_NCM_COMM_INTERFACE || request->wValue != 0)
+			return false;
+
+		usbd_control_acknowledge();
+		return true;
+	case USB_STANDARD_GET_INTERFACE:
+		alternate_setting = (request->wIndex & 0xFF) == CDC_NCM_DATA_INTERFACE ? data_alternate_setting : 0;
+		usbd_control_send(&alternate_setting, sizeof(alternate_setting));
+		return true;
+	}
+
+	return false;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	static uint16_t ntb_format = 0;
+	uint8_t const request_type = request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK);
+
+	if (request_type == (USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE))
+		return standard_interface_request(request);
+
+	if (request_type != (USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE)
+		|| (request->wIndex & 0xFF) != CDC_NCM_COMM_INTERFACE)
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_CDC_GET_NTB_PARAMETERS:
+		usbd_control_send(&ntb_parameters, sizeof(ntb_parameters));
+		return true;
+	case USB_CDC_GET_NTB_FORMAT:
+		usbd_control_send(&ntb_format, sizeof(ntb_format));
+		return true;
+	case USB_CDC_SET_NTB_FORMAT:
+		// Only 16-bit NTBs.
+		if (request->wValue != 0)
+			return false;
+
+		usbd_control_acknowledge();
+		return true;
+	case USB_CDC_GET_NTB_INPUT_SIZE:
+		usbd_control_send(&ntb_in_max_size, sizeof(ntb_in_max_size));
+		return true;
+	case USB_CDC_SET_NTB_INPUT_SIZE:
+		usbd_control_receive(&received_ntb_in_max_size, sizeof(received_ntb_in_max_size));
+		return true;
+	case USB_CDC_SET_ETHERNET_PACKET_FILTER:
+		// Note: The device has no filter (the echo answers every frame).
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	return false;
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	if (request->bRequest != USB_CDC_SET_NTB_INPUT_SIZE)
+		return;
+
+	ntb_in_max_size = MAX(CDC_NCM_NTB_MIN_SIZE, MIN(CDC_NCM_NTB_MAX_SIZE, received_ntb_in_max_size));
+	log_info("CDC NCM IN NTB size: %lu bytes.", ntb_in_max_size);
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	uint16_t size = MIN(byte_count, sizeof(out_block) - out_size);
+
+	usb_driver.read_packet(out_block + out_size, size);
+
+	// Note: The rest of a packet that does not fit is popped and dropped (the NTB is dropped).
+	if (size < byte_count)
+	{
+		static uint8_t packet[CDC_NCM_DATA_PACKET_SIZE] __attribute__((aligned(4)));
+
+		usb_driver.read_packet(packet, byte_count - size);
+		out_overflow = true;
+	}
+
+	out_size += size;
+
+	// A short packet (or a ZLP) ends the NTB, and so does a full NTB.
+	if (byte_count < CDC_NCM_DATA_PACKET_SIZE || out_size == sizeof(out_block))
+	{
+		usb_driver.set_out_endpoint_nak(CDC_NCM_OUT_ENDPOINT_NUMBER, true);
+		out_ready = true;
+		out_ndp_index = first_ndp_index();
+		out_entry = 0;
+		out_ndp_count = 0;
+
+		if (out_ndp_index == 0)
+		{
+			statistics.malformed_ntbs++;
+		}
+		else
+		{
+			statistics.received_ntbs++;
+		}
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number == CDC_NCM_NOTIFICATION_ENDPOINT_NUMBER)
+	{
+		notification_busy = false;
+		notify();
+		return;
+	}
+
+	sent_size += last_transfer_size;
+	in_busy = false;
+	transmit();
+}
+
+static void polled()
+{
+	if (!configured || data_alternate_setting != 1)
+		return;
+
+	if (out_ready && process_out_block())
+	{
+		out_ready = false;
+		out_overflow = false;
+		out_size = 0;
+		usb_driver.set_out_endpoint_nak(CDC_NCM_OUT_ENDPOINT_NUMBER, false);
+	}
+
+	NcmInBlock const *block = &in_blocks[filling_block];
+
+	if (block->datagram_count != 0 && cycle_counter_elapsed_us(block->open_timestamp) >= aggregation_timeout_us
+		&& close_block())
+	{
+		statistics.timeout_ntbs++;
+	}
+
+	transmit();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++report_frames < CDC_NCM_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are per second.
+	if (statistics.received_ntbs != 0 || statistics.sent_ntbs != 0)
+	{
+		log_info("CDC NCM: OUT %lu NTBs, %lu datagrams, %lu B/s (%lu malformed), IN %lu NTBs (%lu at the timeout), %lu datagrams, %lu B/s.",
+			statistics.received_ntbs, statistics.received_datagrams, statistics.received_bytes, statistics.malformed_ntbs,
+			statistics.sent_ntbs, statistics.timeout_ntbs, statistics.sent_datagrams, statistics.sent_bytes);
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+}
+
+const UsbClass usbd_cdc_ncm_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.string_descriptors = string_descriptors,
+	.string_descriptor_count = sizeof(string_descriptors) / sizeof(string_descriptors[0]),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
@@ -0,0 +1,139 @@
+#include "string.h"
+#include "Dfu/dfu_lz4.h"
+#include "Helpers/math.h"
+
+#define LZ4_STATE_TOKEN 0
+#define LZ4_STATE_LITERAL_LENGTH 1
+#define LZ4_STATE_LITERALS 2
+#define LZ4_STATE_OFFSET_LOW 3
+#define LZ4_STATE_OFFSET_HIGH 4
+#define LZ4_STATE_MATCH_LENGTH 5
+#define LZ4_STATE_MATCH 6
+
+/// \brief Length coded in a nibble of the token that continues in the next bytes.
+#define LZ4_LENGTH_EXTENDED 15
+#define LZ4_MIN_MATCH_LENGTH 4
+
+/** \brief Starts decoding a new stream.
+ * \param history Where the decoded stream is stored, from its first byte.
+ */
+void dfu_lz4_reset(DfuLz4Decoder *decoder, uint8_t const *history)
+{
+	*decoder = (DfuLz4Decoder){
+		.history = history,
+		.state = LZ4_STATE_TOKEN
+	};
+}
+
+static void start_match(DfuLz4Decoder *decoder)
+{
+	decoder->length = (decoder->token & 0x0F) + LZ4_MIN_MATCH_LENGTH;
+	decoder->state = (decoder->token & 0x0F) == LZ4_LENGTH_EXTENDED ? LZ4_STATE_MATCH_LENGTH : LZ4_STATE_MATCH;
+}
+
+/** \brief Decodes a piece of the stream, until the input is consumed or the output buffer is full.
+ * \param input The next bytes of the stream.
+ * \param output Buffer of the decoded bytes from `output_start`: the bytes before were stored (see `history`).
+ * \param output_start Position in the decoded stream of the first byte of `output`.
+ * \param output_capacity Size of `output` (the decoding stops once the stream reaches its end).
+ * \returns Count of consumed input bytes.
+ */
+uint32_t dfu_lz4_decode(DfuLz4Decoder *decoder, uint8_t const *input, uint32_t input_size,
+	uint8_t *output, uint32_t output_start, uint32_t output_capacity)
+{
+	uint32_t const output_end = output_start + output_capacity;
+	uint32_t consumed = 0;
+
+	while (!decoder->failed && decoder->size < output_end)
+	{
+		if (decoder->state == LZ4_STATE_MATCH)
+		{
+			// Note: Copies byte after byte: a match can overlap what it produces (e.g. offset 1 repeats a byte).
+			for (uint32_t count = MIN(decoder->length, output_end - decoder->size); count > 0; count--)
+			{
+				uint32_t source = decoder->size - decoder->offset;
+
+				output[decoder->size - output_start] = source < output_start
+					? decoder->history[source]
+					: output[source - output_start];
+				decoder->size++;
+				decoder->length--;
+			}
+
+			if (decoder->length == 0)
+			{
+				decoder->state = LZ4_STATE_TOKEN;
+			}
+
+			continue;
+		}
+
+		if (consumed == input_size)
+			break;
+
+		if (decoder->state == LZ4_STATE_LITERALS)
+		{
+			uint32_t count = MIN(MIN(decoder->length, input_size - consumed), output_end - decoder->size);
+
+			memcpy(&output[decoder->size - output_start], &input[consumed], count);
+			consumed += count;
+			decoder->size += count;
+			decoder->length -= count;
+
+			if (decoder->length == 0)
+			{
+				decoder->state = LZ4_STATE_OFFSET_LOW;
+			}
+
+			continue;
+		}
+
+		uint8_t byte = input[consumed++];
+
+		switch (decoder->state)
+		{
+		case LZ4_STATE_TOKEN:
+			decoder->token = byte;
+			decoder->length = byte >> 4;
+			decoder->state = decoder->length == LZ4_LENGTH_EXTENDED
+				? LZ4_STATE_LITERAL_LENGTH
+				: (decoder->length > 0 ? LZ4_STATE_LITERALS : LZ4_STATE_OFFSET_LOW);
+			break;
+		case LZ4_STATE_LITERAL_LENGTH:
+			decoder->length += byte;
+
+			if (byte != 255)
+			{
+				decoder->state = LZ4_STATE_LITERALS;
+			}
+			break;
+		case LZ4_STATE_OFFSET_LOW:
+			decoder->offset = byte;
+			decoder->state = LZ4_STATE_OFFSET_HIGH;
+			break;
+		case LZ4_STATE_OFFSET_HIGH:
+			decoder->offset |= byte << 8;
+			// The match must start in what was decoded.
+			decoder->failed = decoder->offset == 0 || decoder->offset > decoder->size;
+			start_match(decoder);
+			break;
+		case LZ4_STATE_MATCH_LENGTH:
+			decoder->length += byte;
+
+			if (byte != 255)
+			{
+				decoder->state = LZ4_STATE_MATCH;
+			}
+			break;
+		}
+	}
+
+	return consumed;
+}
+
+/** \brief Returns whether the stream can end here (a LZ4 block ends with literals, so without an offset).
+ */
+bool dfu_lz4_is_complete(DfuLz4Decoder const *decoder)
+{
+	return !decoder->failed && decoder->state == LZ4_STATE_OFFSET_LOW;
+}
@@ -0,0 +1,749 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Dfu/usbd_dfu.h"
+#include "Dfu/usb_dfu_standards.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/flash.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/crc.h"
+#include "Dfu/dfu_lz4.h"
+
+/// \brief Address of the update slot.
+#define DFU_SLOT_ADDRESS 0x08100000
+/// \brief Count of bytes programmed on each poll (about 0.5 ms, so endpoint0 keeps being served).
+#define DFU_PROGRAM_CHUNK_SIZE 128
+/// \brief The slot is erased this far beyond the received data, while the host sends the next blocks.
+#define DFU_ERASE_AHEAD (2 * DFU_TRANSFER_SIZE)
+/// \brief Time between the acknowledgement of DFU_DETACH and the disconnection (the status stage goes out first).
+#define DFU_DETACH_DELAY_US 10000
+/// \brief Time the device stays disconnected before it comes back in DFU mode.
+#define DFU_RECONNECT_DELAY_US 50000
+/// \brief Typical program time of a word (datasheet, 32-bit parallelism) until it is measured.
+#define DFU_INITIAL_PROGRAM_US_PER_WORD 16
+/// \brief Typical erase time of 1 KB (datasheet: 250 ms for a 16 KB sector) until it is measured.
+#define DFU_INITIAL_ERASE_US_PER_KB 16000
+#define DFU_NO_SECTOR 0xFF
+
+_Static_assert(DFU_SLOT_SIZE % DFU_TRANSFER_SIZE == 0, "The slot holds whole blocks");
+_Static_assert(DFU_PROGRAM_CHUNK_SIZE % 4 == 0 && DFU_TRANSFER_SIZE % DFU_PROGRAM_CHUNK_SIZE == 0, "Blocks are programmed in whole chunks of words");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B4,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbDfuFunctionalDescriptor usb_dfu_functional_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+/// \note Not constant: the interface protocol tells the host whether the device is in run-time or in DFU mode.
+static UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_APP_SPEC,
+		.bInterfaceSubClass     = USB_DFU_SUBCLASS,
+		.bInterfaceProtocol     = USB_DFU_PROTOCOL_RUNTIME,
+		.iInterface             = 0
+	},
+	.usb_dfu_functional_descriptor = {
+		.bLength                = sizeof(UsbDfuFunctionalDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL,
+		.bmAttributes           = USB_DFU_ATTRIBUTE_CAN_DNLOAD | USB_DFU_ATTRIBUTE_CAN_UPLOAD |
+		                          USB_DFU_ATTRIBUTE_MANIFESTATION_TOLERANT | USB_DFU_ATTRIBUTE_WILL_DETACH,
+		.wDetachTimeOut         = 1000,
+		.wTransferSize          = DFU_TRANSFER_SIZE,
+		.bcdDFUVersion          = 0x0110
+	}
+};
+
+/** \brief A downloaded block waiting to be programmed (or being programmed).
+ */
+typedef struct
+{
+	uint8_t data[DFU_TRANSFER_SIZE] __attribute__((aligned(4)));
+	/// \brief Size of the block (a raw block is rounded up to whole words, the padding is 0xFF like erased flash).
+	uint16_t size;
+	/// \brief Bytes already programmed (raw image) or decompressed (LZ4 image).
+	uint16_t processed;
+	/// \brief Whether the buffer holds a block that is not fully programmed.
+	bool full;
+} DfuBlockBuffer;
+
+static uint8_t state;
+static uint8_t status;
+/// \brief The answers of DFU_GETSTATUS and DFU_GETSTATE.
+static UsbDfuStatus status_response;
+static uint8_t state_response;
+
+/// \brief Two blocks: the host sends block N + 1 while block N is being programmed.
+static DfuBlockBuffer block_buffers[2];
+/// \brief The buffer of the next downloaded block, and the buffer being programmed.
+static uint8_t receive_index, program_index;
+/// \brief Bytes downloaded since the start of the download.
+static uint32_t download_size;
+/// \brief Header of the download (its magic is 0 when the download has none).
+static DfuImageHeader image_header;
+/// \brief Bytes of the download after the header, and how many of them were decompressed (LZ4 image).
+static uint32_t stream_size, stream_decoded;
+/// \brief Decoder of a LZ4 image, and the decoded bytes that are not programmed yet (they start at `image_written`).
+static DfuLz4Decoder decoder;
+static uint8_t decoded_chunk[DFU_PROGRAM_CHUNK_SIZE] __attribute__((aligned(4)));
+/// \brief Bytes of the image programmed (and added to the CRC).
+static uint32_t image_written;
+/// \brief Count of sectors of the slot erased since the start of the download, and their size.
+static uint8_t erased_sector_count;
+static uint32_t erased_size;
+/// \brief The sector being erased, and the cycle counter value when its erase started.
+static uint8_t erasing_sector;
+static uint32_t erase_start;
+/// \brief Bytes uploaded since the start of the upload.
+static uint32_t upload_offset;
+
+/// \brief Measured program time of a word, and erase time of 1 KB (they give the poll timeout).
+static uint32_t program_cycles_per_word;
+static uint32_t erase_cycles_per_kb;
+
+/// \brief Cycle counter value when the download started, and count of GETSTATUS answered with dfuDNBUSY.
+static uint32_t download_start;
+static uint32_t busy_count;
+/// \brief Duration of the last raw and of the last LZ4 download in ms (the benchmark compares them).
+static uint32_t download_durations_ms[2];
+
+/// \brief Whether the device disconnects (DFU_DETACH) or reconnects soon, and when this was decided.
+static bool detach_pending, reconnect_pending;
+static uint32_t detach_time;
+
+/** \brief Fails the download (the host reads the status, then sends DFU_CLRSTATUS).
+ */
+static void fail(uint8_t error_status)
+{
+	log_error("DFU error %d in state %d.", error_status, state);
+	state = USB_DFU_STATE_ERROR;
+	status = error_status;
+	block_buffers[0].full = block_buffers[1].full = false;
+}
+
+/** \brief Rejects a request that is not allowed in the current state (the framework stalls it).
+ */
+static bool reject()
+{
+	if (configuration_descriptor_combination.usb_interface_descriptor.bInterfaceProtocol == USB_DFU_PROTOCOL_DFU_MODE)
+	{
+		fail(USB_DFU_STATUS_ERR_STALLEDPKT);
+	}
+
+	return false;
+}
+
+static void start_next_erase()
+{
+	if (erasing_sector != DFU_NO_SECTOR || erased_sector_count == DFU_SLOT_SECTOR_COUNT)
+		return;
+
+	erasing_sector = DFU_SLOT_FIRST_SECTOR + erased_sector_count;
+	erase_start = cycle_counter_now();
+	flash_start_erase(erasing_sector);
+}
+
+/** \brief Ends the erase in progress once the flash is no longer busy, and measures how long it took.
+ */
+static void complete_erase()
+{
+	if (erasing_sector == DFU_NO_SECTOR || flash_is_busy())
+		return;
+
+	uint32_t sector_size = flash_sector_size(erasing_sector);
+	bool erased = flash_complete_erase();
+
+	erase_cycles_per_kb = (erase_cycles_per_kb + (cycle_counter_now() - erase_start) / (sector_size / 1024)) / 2;
+	erasing_sector = DFU_NO_SECTOR;
+
+	if (!erased)
+	{
+		fail(USB_DFU_STATUS_ERR_ERASE);
+		return;
+	}
+
+	erased_sector_count++;
+	erased_size += sector_size;
+}
+
+/** \brief Returns whether the state is one of the download states (the blocks keep coming).
+ */
+static bool is_downloading()
+{
+	return state == USB_DFU_STATE_DNLOAD_SYNC || state == USB_DFU_STATE_DNBUSY || state == USB_DFU_STATE_DNLOAD_IDLE;
+}
+
+static bool is_compressed()
+{
+	return image_header.magic == DFU_IMAGE_MAGIC && (image_header.flags & DFU_IMAGE_FLAG_LZ4);
+}
+
+/** \brief Programs the next words of the image, and adds them to the CRC.
+ * \returns Whether the words were programmed (else the sector they need is being erased, or the download failed).
+ */
+static bool program_image(void const *data, uint16_t size)
+{
+	if (image_written + size > DFU_SLOT_SIZE)
+	{
+		fail(USB_DFU_STATUS_ERR_ADDRESS);
+		return false;
+	}
+
+	if (image_written + size > erased_size)
+	{
+		start_next_erase();
+		return false;
+	}
+
+	uint32_t start = cycle_counter_now();
+
+	if (!flash_program(DFU_SLOT_ADDRESS + image_written, data, size))
+	{
+		fail(USB_DFU_STATUS_ERR_PROG);
+		return false;
+	}
+
+	program_cycles_per_word = (3 * program_cycles_per_word + (cycle_counter_now() - start) / (size / 4)) / 4;
+
+	// Note: The CRC reads back the flash, so it also checks what was programmed.
+	crc_accumulate((void const *)(DFU_SLOT_ADDRESS + image_written), size);
+	image_written += size;
+
+	return true;
+}
+
+/** \brief Decompresses a piece of a block of a LZ4 image (up to a chunk of output).
+ */
+static void decompress_block(DfuBlockBuffer *buffer)
+{
+	uint32_t capacity = MIN(DFU_PROGRAM_CHUNK_SIZE, image_header.image_size - image_written);
+
+	// The stream goes on after the end of the image.
+	if (decoder.size == image_written + capacity)
+	{
+		fail(USB_DFU_STATUS_ERR_FILE);
+		return;
+	}
+
+	uint32_t consumed = dfu_lz4_decode(&decoder, &buffer->data[buffer->processed], buffer->size - buffer->processed,
+		decoded_chunk, image_written, capacity);
+
+	if (decoder.failed)
+	{
+		fail(USB_DFU_STATUS_ERR_FILE);
+		return;
+	}
+
+	buffer->processed += consumed;
+	stream_decoded += consumed;
+}
+
+/** \brief Programs the last decoded bytes of a LZ4 image (padded with 0xFF to whole words).
+ */
+static void program_last_chunk()
+{
+	uint16_t size = decoder.size - image_written;
+
+	for (; size % 4 != 0; size++)
+	{
+		decoded_chunk[size] = 0xFF;
+	}
+
+	program_image(decoded_chunk, size);
+}
+
+/** \brief Moves the flash work on: completes the erase, programs (or decompresses) a chunk of the oldest block, or
+ * erases ahead.
+ */
+static void process_flash()
+{
+	complete_erase();
+
+	if (erasing_sector != DFU_NO_SECTOR || state == USB_DFU_STATE_ERROR)
+		return;
+
+	DfuBlockBuffer *buffer = &block_buffers[program_index];
+	uint32_t image_limit = image_header.magic == DFU_IMAGE_MAGIC ? image_header.image_size : DFU_SLOT_SIZE;
+
+	if (is_compressed() && decoder.size == image_written + DFU_PROGRAM_CHUNK_SIZE)
+	{
+		program_image(decoded_chunk, DFU_PROGRAM_CHUNK_SIZE);
+	}
+	else if (buffer->full)
+	{
+		if (is_compressed())
+		{
+			decompress_block(buffer);
+		}
+		else
+		{
+			uint16_t size = MIN(DFU_PROGRAM_CHUNK_SIZE, buffer->size - buffer->processed);
+
+			if (program_image(&buffer->data[buffer->processed], size))
+			{
+				buffer->processed += size;
+			}
+		}
+
+		if (buffer->processed == buffer->size)
+		{
+			buffer->full = false;
+			program_index ^= 1;
+		}
+	}
+	else if (is_downloading() && erased_size < MIN(MAX(stream_size, decoder.size) + DFU_ERASE_AHEAD, image_limit))
+	{
+		// Note: The erase overlaps with the transfer of the next blocks.
+		start_next_erase();
+	}
+	else if (!is_downloading() && is_compressed() && decoder.size > image_written)
+	{
+		program_last_chunk();
+	}
+}
+
+/** \brief Returns whether blocks (or decoded bytes of a LZ4 image) still wait to be programmed.
+ */
+static bool is_programming()
+{
+	return block_buffers[0].full || block_buffers[1].full || (is_compressed() && decoder.size > image_written);
+}
+
+/** \brief Estimates the time until the buffered blocks are programmed.
+ * \param block_count Count of buffered blocks to wait for (1: the oldest, so the host can send a block; 2: all).
+ * \returns The time in milliseconds (the poll timeout of DFU_GETSTATUS).
+ */
+static uint32_t estimate_busy_time(uint8_t block_count)
+{
+	uint64_t cycles = 0;
+	uint32_t erased_end = erased_size;
+	uint8_t erase_sector = DFU_SLOT_FIRST_SECTOR + erased_sector_count;
+	uint32_t image_end = image_written;
+
+	if (erasing_sector != DFU_NO_SECTOR)
+	{
+		uint32_t expected = erase_cycles_per_kb * (flash_sector_size(erasing_sector) / 1024);
+		uint32_t elapsed = cycle_counter_now() - erase_start;
+
+		cycles += expected > elapsed ? expected - elapsed : 0;
+		erased_end += flash_sector_size(erasing_sector);
+		erase_sector++;
+	}
+
+	for (uint8_t i = 0; i <= block_count; i++)
+	{
+		uint32_t remaining;
+
+		if (i == 0)
+		{
+			// The decoded bytes of a LZ4 image that are not programmed.
+			remaining = is_compressed() && decoder.size > image_written ? decoder.size - image_written : 0;
+		}
+		else
+		{
+			DfuBlockBuffer const *buffer = &block_buffers[(program_index + i - 1) % 2];
+
+			if (!buffer->full)
+				continue;
+
+			remaining = buffer->size - buffer->processed;
+
+			// Assumes the rest of a LZ4 image expands as much as what was decompressed.
+			if (is_compressed() && stream_decoded != 0)
+			{
+				remaining = (uint64_t)remaining * decoder.size / stream_decoded;
+			}
+		}
+
+		image_end += remaining;
+		cycles += (uint64_t)remaining / 4 * program_cycles_per_word;
+
+		// Adds the erases the image still needs.
+		for (; image_end > erased_end && erase_sector < DFU_SLOT_FIRST_SECTOR + DFU_SLOT_SECTOR_COUNT; erase_sector++)
+		{
+			cycles += erase_cycles_per_kb * (flash_sector_size(erase_sector) / 1024);
+			erased_end += flash_sector_size(erase_sector);
+		}
+	}
+
+	return cycles / (SystemCoreClock / 1000) + 1;
+}
+
+/** \brief Drops the buffered blocks, the image header and the decoder, and waits for the erase in progress (a new
+ * download, or the end of an aborted one, starts from a known state).
+ */
+static void reset_download()
+{
+	if (erasing_sector != DFU_NO_SECTOR)
+	{
+		flash_wait();
+		complete_erase();
+	}
+
+	block_buffers[0].full = block_buffers[1].full = false;
+	receive_index = program_index = 0;
+	download_size = 0;
+	image_header = (DfuImageHeader){ 0 };
+	dfu_lz4_reset(&decoder, (uint8_t const *)DFU_SLOT_ADDRESS);
+	stream_size = stream_decoded = 0;
+	image_written = 0;
+	erased_sector_count = 0;
+	erased_size = 0;
+	busy_count = 0;
+	crc_reset();
+}
+
+/** \brief Returns whether the image matches its header (size, end of the LZ4 stream and CRC).
+ */
+static bool verify_image()
+{
+	if (image_header.magic != DFU_IMAGE_MAGIC)
+		return true;
+
+	uint32_t crc = crc_value();
+
+	if ((is_compressed() && !dfu_lz4_is_complete(&decoder)) || image_written != ((image_header.image_size + 3) & ~3)
+		|| crc != image_header.crc)
+	{
+		log_error("DFU image verification failed (%lu of %lu bytes, CRC 0x%08lx instead of 0x%08lx).",
+			image_written, image_header.image_size, crc, image_header.crc);
+		return false;
+	}
+
+	return true;
+}
+
+/** \brief Logs the duration of the download once the last block is programmed (the benchmark of the update).
+ */
+static void log_download()
+{
+	uint32_t elapsed_ms = cycle_counter_elapsed_us(download_start) / 1000;
+	bool compressed = is_compressed();
+
+	log_info("DFU download of %lu bytes (%s image of %lu bytes) completed in %lu ms (%lu B/s of image, %lu busy polls, program %lu us/KB, erase %lu ms/KB).",
+		download_size, compressed ? "LZ4" : "raw", image_written, elapsed_ms, elapsed_ms == 0 ? 0 : image_written * 1000 / elapsed_ms,
+		busy_count, cycle_counter_to_us(program_cycles_per_word * 256), cycle_counter_to_us(erase_cycles_per_kb) / 1000);
+
+	download_durations_ms[compressed] = elapsed_ms;
+
+	if (download_durations_ms[0] != 0 && download_durations_ms[1] != 0)
+	{
+		log_info("DFU update time: LZ4 %lu ms, raw %lu ms (%lu%%).",
+			download_durations_ms[1], download_durations_ms[0], download_durations_ms[1] * 100 / download_durations_ms[0]);
+	}
+}
+
+/** \brief Answers DFU_GETSTATUS; the state moves on from the synchronization states.
+ */
+static void send_status()
+{
+	uint32_t poll_timeout = 0;
+
+	switch (state)
+	{
+	case USB_DFU_STATE_DNLOAD_SYNC:
+	case USB_DFU_STATE_DNBUSY:
+		// The block is accepted as soon as it is buffered: the host waits only when both buffers are full.
+		if (!block_buffers[receive_index].full)
+		{
+			state = USB_DFU_STATE_DNLOAD_IDLE;
+		}
+		else
+		{
+			state = USB_DFU_STATE_DNBUSY;
+			poll_timeout = estimate_busy_time(1);
+			busy_count++;
+		}
+		break;
+	case USB_DFU_STATE_MANIFEST_SYNC:
+	case USB_DFU_STATE_MANIFEST:
+		if (is_programming())
+		{
+			state = USB_DFU_STATE_MANIFEST;
+			poll_timeout = estimate_busy_time(2);
+		}
+		else if (!verify_image())
+		{
+			fail(USB_DFU_STATUS_ERR_VERIFY);
+		}
+		else
+		{
+			log_download();
+			state = USB_DFU_STATE_IDLE;
+		}
+		break;
+	default:
+		break;
+	}
+
+	status_response = (UsbDfuStatus){
+		.bStatus = status,
+		.bwPollTimeout = { poll_timeout, poll_timeout >> 8, poll_timeout >> 16 },
+		.bState = state
+	};
+
+	usbd_control_send(&status_response, sizeof(status_response));
+}
+
+static bool process_download(UsbRequest const *request)
+{
+	if (state != USB_DFU_STATE_IDLE && state != USB_DFU_STATE_DNLOAD_IDLE)
+		return reject();
+
+	if (request->wLength == 0)
+	{
+		// A block of 0 bytes ends the download.
+		if (state != USB_DFU_STATE_DNLOAD_IDLE)
+			return reject();
+
+		state = USB_DFU_STATE_MANIFEST_SYNC;
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	if (state == USB_DFU_STATE_IDLE)
+	{
+		log_info("DFU download started.");
+		reset_download();
+		download_start = cycle_counter_now();
+	}
+
+	if (request->wLength > DFU_TRANSFER_SIZE || download_size + request->wLength > DFU_SLOT_SIZE + sizeof(DfuImageHeader))
+	{
+		fail(USB_DFU_STATUS_ERR_ADDRESS);
+		return false;
+	}
+
+	DfuBlockBuffer *buffer = &block_buffers[receive_index];
+
+	// Note: The host sends a block only after the dfuDNLOAD-IDLE state, so a buffer is free.
+	if (buffer->full)
+		return reject();
+
+	buffer->size = request->wLength;
+	buffer->processed = 0;
+	usbd_control_receive(buffer->data, request->wLength);
+
+	return true;
+}
+
+static void process_upload(UsbRequest const *request)
+{
+	if (state == USB_DFU_STATE_IDLE)
+	{
+		upload_offset = 0;
+	}
+
+	uint16_t size = MIN(request->wLength, DFU_SLOT_SIZE - upload_offset);
+
+	// Note: Reads of bank 2 wait for an erase-ahead in progress.
+	usbd_control_send((void const *)(DFU_SLOT_ADDRESS + upload_offset), size);
+	upload_offset += size;
+
+	// A short block ends the upload.
+	state = size < request->wLength ? USB_DFU_STATE_IDLE : USB_DFU_STATE_UPLOAD_IDLE;
+}
+
+static void reset()
+{
+	detach_pending = false;
+
+	// Note: The device stays in DFU mode until it is reset (a bootloader installs the downloaded image).
+	if (configuration_descriptor_combination.usb_interface_descriptor.bInterfaceProtocol == USB_DFU_PROTOCOL_DFU_MODE)
+	{
+		if (is_downloading() || state == USB_DFU_STATE_UPLOAD_IDLE || state == USB_DFU_STATE_ERROR)
+		{
+			reset_download();
+			state = USB_DFU_STATE_IDLE;
+			status = USB_DFU_STATUS_OK;
+		}
+	}
+	else
+	{
+		state = USB_DFU_STATE_APP_IDLE;
+		status = USB_DFU_STATUS_OK;
+	}
+
+	if (program_cycles_per_word == 0)
+	{
+		program_cycles_per_word = DFU_INITIAL_PROGRAM_US_PER_WORD * (SystemCoreClock / 1000000);
+		erase_cycles_per_kb = DFU_INITIAL_ERASE_US_PER_KB * (SystemCoreClock / 1000000);
+		erasing_sector = DFU_NO_SECTOR;
+	}
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE)
+		|| (request->wIndex & 0xFF) != configuration_descriptor_combination.usb_interface_descriptor.bInterfaceNumber)
+		return false;
+
+	bool dfu_mode = configuration_descriptor_combination.usb_interface_descriptor.bInterfaceProtocol == USB_DFU_PROTOCOL_DFU_MODE;
+
+	switch (request->bRequest)
+	{
+	case USB_DFU_GETSTATUS:
+		send_status();
+		return true;
+	case USB_DFU_GETSTATE:
+		state_response = state;
+		usbd_control_send(&state_response, sizeof(state_response));
+		return true;
+	case USB_DFU_DETACH:
+		if (dfu_mode || state != USB_DFU_STATE_APP_IDLE)
+			return reject();
+
+		log_info("DFU Detach request received.");
+		state = USB_DFU_STATE_APP_DETACH;
+		detach_pending = true;
+		detach_time = cycle_counter_now();
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	if (!dfu_mode)
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_DFU_DNLOAD:
+		return process_download(request);
+	case USB_DFU_UPLOAD:
+		if (state != USB_DFU_STATE_IDLE && state != USB_DFU_STATE_UPLOAD_IDLE)
+			return reject();
+
+		process_upload(request);
+		return true;
+	case USB_DFU_CLRSTATUS:
+		if (state != USB_DFU_STATE_ERROR)
+			return reject();
+
+		state = USB_DFU_STATE_IDLE;
+		status = USB_DFU_STATUS_OK;
+		usbd_control_acknowledge();
+		return true;
+	case USB_DFU_ABORT:
+		if (state != USB_DFU_STATE_IDLE && state != USB_DFU_STATE_DNLOAD_IDLE && state != USB_DFU_STATE_UPLOAD_IDLE)
+			return reject();
+
+		// Note: The download is given up: nothing of it must be programmed by a later manifestation.
+		reset_download();
+		state = USB_DFU_STATE_IDLE;
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	return reject();
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	if (request->bRequest != USB_DFU_DNLOAD)
+		return;
+
+	DfuBlockBuffer *buffer = &block_buffers[receive_index];
+	bool first_block = download_size == 0;
+
+	download_size += buffer->size;
+	state = USB_DFU_STATE_DNLOAD_SYNC;
+
+	if (first_block && buffer->size >= sizeof(DfuImageHeader) && ((DfuImageHeader const *)buffer->data)->magic == DFU_IMAGE_MAGIC)
+	{
+		memcpy(&image_header, buffer->data, sizeof(DfuImageHeader));
+		buffer->size -= sizeof(DfuImageHeader);
+		memmove(buffer->data, &buffer->data[sizeof(DfuImageHeader)], buffer->size);
+
+		log_info("DFU %s image of %lu bytes.", is_compressed() ? "LZ4" : "raw", image_header.image_size);
+
+		if (image_header.image_size > DFU_SLOT_SIZE)
+		{
+			fail(USB_DFU_STATUS_ERR_ADDRESS);
+			return;
+		}
+
+		if (is_compressed())
+		{
+			dfu_lz4_reset(&decoder, (uint8_t const *)DFU_SLOT_ADDRESS);
+		}
+	}
+
+	stream_size += buffer->size;
+
+	// Pads the blocks of a raw image to whole words (a LZ4 stream is decompressed as is).
+	for (; !is_compressed() && buffer->size % 4 != 0; buffer->size++)
+	{
+		buffer->data[buffer->size] = 0xFF;
+	}
+
+	if (buffer->size > 0)
+	{
+		buffer->full = true;
+		receive_index ^= 1;
+	}
+}
+
+static void polled()
+{
+	if (detach_pending && cycle_counter_elapsed_us(detach_time) > DFU_DETACH_DELAY_US)
+	{
+		// Comes back as a DFU mode device (the host enumerates it again).
+		usb_driver.disconnect();
+		configuration_descriptor_combination.usb_interface_descriptor.bInterfaceProtocol = USB_DFU_PROTOCOL_DFU_MODE;
+		state = USB_DFU_STATE_IDLE;
+		detach_pending = false;
+		reconnect_pending = true;
+		detach_time = cycle_counter_now();
+	}
+	else if (reconnect_pending && cycle_counter_elapsed_us(detach_time) > DFU_RECONNECT_DELAY_US)
+	{
+		log_info("DFU mode entered.");
+		reconnect_pending = false;
+		usb_driver.connect();
+	}
+
+	process_flash();
+}
+
+const UsbClass usbd_dfu_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_poll = &polled
+};
@@ -0,0 +1,33 @@
+#include "stm32f4xx.h"
+#include "Helpers/crc.h"
+
+/** \brief Starts a new CRC (and enables the clock of the CRC unit).
+ * \note The CRC unit computes CRC-32/MPEG-2: polynomial 0x04C11DB7, initial value 0xFFFFFFFF, 32-bit words (not
+ * reflected), no final XOR.
+ */
+void crc_reset()
+{
+	SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_CRCEN);
+	WRITE_REG(CRC->CR, CRC_CR_RESET);
+}
+
+/** \brief Adds words to the CRC (4 cycles per word).
+ * \param data Word aligned data.
+ * \param size Size of the data in bytes (a multiple of 4).
+ */
+void crc_accumulate(void const *data, uint32_t size)
+{
+	uint32_t const *words = data;
+
+	for (uint32_t i = 0; i < size / 4; i++)
+	{
+		WRITE_REG(CRC->DR, words[i]);
+	}
+}
+
+/** \brief Returns the CRC of the words added since the last reset.
+ */
+uint32_t crc_value()
+{
+	return READ_REG(CRC->DR);
+}
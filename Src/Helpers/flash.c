@@ -0,0 +1,124 @@
+#include "Helpers/flash.h"
+
+/** \brief Returns the size of a sector in bytes (each bank has four 16 KB, one 64 KB and seven 128 KB sectors).
+ * \param sector The sector (0 - 23).
+ */
+uint32_t flash_sector_size(uint8_t sector)
+{
+	uint8_t bank_sector = sector % 12;
+
+	return bank_sector < 4 ? 16 * 1024 : (bank_sector == 4 ? 64 * 1024 : 128 * 1024);
+}
+
+/** \brief Returns the address of the first byte of a sector.
+ * \param sector The sector (0 - 23).
+ */
+uint32_t flash_sector_address(uint8_t sector)
+{
+	uint32_t address = sector < 12 ? FLASH_BASE : FLASH_BASE + 1024 * 1024;
+
+	for (uint8_t bank_sector = sector < 12 ? 0 : 12; bank_sector < sector; bank_sector++)
+	{
+		address += flash_sector_size(bank_sector);
+	}
+
+	return address;
+}
+
+static void unlock()
+{
+	if (READ_BIT(FLASH->CR, FLASH_CR_LOCK))
+	{
+		WRITE_REG(FLASH->KEYR, 0x45670123);
+		WRITE_REG(FLASH->KEYR, 0xCDEF89AB);
+	}
+}
+
+/** \brief Returns whether the last operation succeeded, and clears the error flags.
+ */
+static bool check_errors()
+{
+	uint32_t errors = READ_REG(FLASH->SR) & (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR);
+
+	WRITE_REG(FLASH->SR, errors | FLASH_SR_EOP);
+	return errors == 0;
+}
+
+/** \brief Waits until the erase or the program in progress has completed.
+ */
+void flash_wait()
+{
+	while (flash_is_busy());
+}
+
+/** \brief Starts erasing a sector, and returns without waiting (an erase takes from 0.25 to 2 seconds).
+ * \param sector The sector (0 - 23).
+ * \note Complete the erase with `flash_complete_erase()` once `flash_is_busy()` returns false.
+ */
+void flash_start_erase(uint8_t sector)
+{
+	flash_wait();
+	unlock();
+	check_errors();
+
+	// Note: Bit 4 of the sector number selects bank 2.
+	MODIFY_REG(FLASH->CR,
+		FLASH_CR_PG | FLASH_CR_SNB | FLASH_CR_PSIZE,
+		FLASH_CR_SER | _VAL2FLD(FLASH_CR_SNB, sector < 12 ? sector : (sector - 12) | 0x10) | FLASH_CR_PSIZE_1
+	);
+	SET_BIT(FLASH->CR, FLASH_CR_STRT);
+}
+
+/** \brief Ends an erase started with `flash_start_erase()` (waits for it if it is still in progress).
+ * \returns Whether the sector was erased.
+ */
+bool flash_complete_erase()
+{
+	flash_wait();
+	CLEAR_BIT(FLASH->CR, FLASH_CR_SER);
+
+	// The data cache of the flash interface may hold what the sector contained before.
+	if (READ_BIT(FLASH->ACR, FLASH_ACR_DCEN))
+	{
+		CLEAR_BIT(FLASH->ACR, FLASH_ACR_DCEN);
+		SET_BIT(FLASH->ACR, FLASH_ACR_DCRST);
+		CLEAR_BIT(FLASH->ACR, FLASH_ACR_DCRST);
+		SET_BIT(FLASH->ACR, FLASH_ACR_DCEN);
+	}
+
+	SET_BIT(FLASH->CR, FLASH_CR_LOCK);
+	return check_errors();
+}
+
+/** \brief Programs erased flash, one word at a time (32-bit parallelism, so the supply must be above 2.7 V).
+ * \param address Word aligned address of the first byte to program.
+ * \param data Word aligned data.
+ * \param size Size of the data in bytes (a multiple of 4).
+ * \returns Whether all the words were programmed.
+ * \note Takes about 16 us per word; waits first for the operation in progress, if any.
+ */
+bool flash_program(uint32_t address, void const *data, uint32_t size)
+{
+	uint32_t const *words = data;
+	bool succeeded = true;
+
+	flash_wait();
+	unlock();
+	check_errors();
+
+	MODIFY_REG(FLASH->CR,
+		FLASH_CR_SER | FLASH_CR_PSIZE,
+		FLASH_CR_PG | FLASH_CR_PSIZE_1
+	);
+
+	for (uint32_t i = 0; i < size / 4 && succeeded; i++)
+	{
+		*(volatile uint32_t *)(address + i * 4) = words[i];
+		flash_wait();
+		succeeded = check_errors();
+	}
+
+	CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+	SET_BIT(FLASH->CR, FLASH_CR_LOCK);
+	return succeeded;
+}
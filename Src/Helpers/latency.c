@@ -0,0 +1,99 @@
+#include "Helpers/latency.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/logger.h"
+
+/** \brief Clears all the recorded samples.
+ * \param statistics The statistics to clear.
+ */
+void latency_reset(LatencyStatistics *statistics)
+{
+	*statistics = (LatencyStatistics) {
+		.min = UINT32_MAX
+	};
+}
+
+/** \brief Records one latency sample.
+ * \param statistics The statistics the sample will be added to.
+ * \param start_timestamp Cycle counter value when the measured event started.
+ * \param end_timestamp Cycle counter value when the measured event ended.
+ */
+void latency_record(LatencyStatistics *statistics, uint32_t start_timestamp, uint32_t end_timestamp)
+{
+	// Note: Unsigned subtraction gives the right result even if the counter wrapped around.
+	uint32_t cycles = end_timestamp - start_timestamp;
+	uint32_t bucket = cycle_counter_to_us(cycles) / LATENCY_BUCKET_WIDTH_US;
+
+	if (bucket >= LATENCY_BUCKET_COUNT)
+	{
+		bucket = LATENCY_BUCKET_COUNT - 1;
+	}
+
+	statistics->buckets[bucket]++;
+	statistics->count++;
+	statistics->total += cycles;
+
+	if (cycles < statistics->min)
+	{
+		statistics->min = cycles;
+	}
+
+	if (cycles > statistics->max)
+	{
+		statistics->max = cycles;
+	}
+}
+
+/** \brief Estimates a percentile of the recorded latencies from the histogram.
+ * \param statistics The recorded statistics.
+ * \param percentile The percentile to estimate (0 - 100).
+ * \returns The upper edge (in microseconds) of the bucket that contains the percentile.
+ */
+uint32_t latency_percentile_us(LatencyStatistics const *statistics, uint8_t percentile)
+{
+	uint32_t threshold = ((uint64_t)statistics->count * percentile + 99) / 100;
+	uint32_t accumulated = 0;
+
+	for (uint8_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+	{
+		accumulated += statistics->buckets[bucket];
+
+		if (accumulated >= threshold)
+		{
+			return (bucket + 1) * LATENCY_BUCKET_WIDTH_US;
+		}
+	}
+
+	return LATENCY_BUCKET_COUNT * LATENCY_BUCKET_WIDTH_US;
+}
+
+/** \brief Logs a summary and the histogram of the recorded latencies.
+ * \param label Name of the measured path.
+ * \param statistics The recorded statistics.
+ */
+void latency_log(char const * const label, LatencyStatistics const *statistics)
+{
+	if (statistics->count == 0)
+		return;
+
+	log_info("%s latency: samples = %lu, min = %lu us, mean = %lu us, max = %lu us, p50 <= %lu us, p99 <= %lu us.",
+		label,
+		statistics->count,
+		cycle_counter_to_us(statistics->min),
+		cycle_counter_to_us(statistics->total / statistics->count),
+		cycle_counter_to_us(statistics->max),
+		latency_percentile_us(statistics, 50),
+		latency_percentile_us(statistics, 99)
+	);
+
+	for (uint8_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+	{
+		if (statistics->buckets[bucket] == 0)
+			continue;
+
+		log_debug("- [%4u, %4u) us: %lu",
+			bucket * LATENCY_BUCKET_WIDTH_US,
+			(bucket + 1) * LATENCY_BUCKET_WIDTH_US,
+			statistics->buckets[bucket]
+		);
+	}
+}
@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "Helpers/logger.h"
+#include "Helpers/ring_buffer.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/math.h"
 #include "stm32f4xx.h"
 
 /** \brief Redirects `printf()` output to the serial wire out (SWO).
@@ -17,6 +22,57 @@ int _write(int file, char *ptr, int len)
   return len;
 }
 
+// Without any log compiled in, nothing below is needed.
+#if LOG_COMPILE_LEVEL >= LOG_THRESHOLD_ERROR
+
+/// \brief Size of the text of one record (the end of a longer line is cut).
+#define LOG_LINE_SIZE 512
+
+typedef enum
+{
+    LOG_RECORD_MESSAGE, ///< The arguments follow (32 bits each).
+    LOG_RECORD_ARRAY ///< The bytes of the array follow.
+} LogRecordType;
+
+/** \brief Header of a record in the ring buffer; `size` bytes follow it.
+ */
+typedef struct
+{
+    /// \brief The token: the address of the format (or of the label of an array), in flash.
+    char const *format;
+    /// \brief The cycle counter at the call.
+    uint32_t timestamp;
+    uint8_t type;
+    uint8_t level;
+    /// \brief Length of the array (it may be more than the bytes kept).
+    uint16_t length;
+    uint16_t size;
+} LogRecord;
+
+/** \brief A record as stored: the header, then the arguments or the bytes of the array.
+ */
+typedef struct
+{
+    LogRecord header;
+    union
+    {
+        uint32_t arguments[LOG_MAX_ARGUMENTS];
+        uint8_t bytes[LOG_MAX_ARRAY_SIZE];
+    };
+} LogEntry;
+
+static uint8_t log_storage[LOG_BUFFER_SIZE] __attribute__((aligned(4)));
+static RingBuffer log_buffer = { .buffer = log_storage, .size = LOG_BUFFER_SIZE };
+/// \brief Count of records that did not fit (shown by the drainer before the next record).
+static uint32_t dropped_records;
+
+/// \brief The line being sent to the SWO, and the count of characters already sent.
+static char line[LOG_LINE_SIZE];
+static uint16_t line_size;
+static uint16_t line_position;
+
+_Static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "The ring buffer needs a power of two");
+
 char const * const _get_log_level_string(LogLevel const log_level)
 {
     switch(log_level)
@@ -30,61 +86,162 @@ char const * const _get_log_level_string(LogLevel const log_level)
     }
 }
 
-static void _log(LogLevel const log_level, char const * const format, va_list args)
+/** \brief Stores a record whole (its header and its data), or drops it if the ring buffer is full.
+ */
+static void _store(LogEntry const *entry)
 {
-    if (log_level > system_log_level)
+    uint32_t const size = sizeof(LogRecord) + entry->header.size;
+
+    if (ring_buffer_free(&log_buffer) < size)
+    {
+        dropped_records++;
         return;
+    }
 
-	printf("[%s] ", _get_log_level_string(log_level));
-	vfprintf(stdout, format, args);
-	printf("\n");
+    ring_buffer_write(&log_buffer, entry, size);
 }
 
-void log_error(char const * const format, ...)
+/** \brief Stores a log (prefer the macros `log_error()`, `log_info()` and `log_debug()`, which filter the level).
+ * \param log_level The level of the log.
+ * \param argument_count Count of arguments after the format.
+ * \param format The format (the token of the log: it is not read until the log is drained).
+ */
+void log_write(LogLevel const log_level, uint8_t const argument_count, char const * const format, ...)
 {
+    LogEntry entry;
+    uint8_t const count = MIN(argument_count, LOG_MAX_ARGUMENTS);
     va_list args;
-	va_start(args, format);
-    _log(LOG_LEVEL_ERROR, format, args);
+
+    entry.header = (LogRecord){
+        .format = format,
+        .timestamp = cycle_counter_now(),
+        .type = LOG_RECORD_MESSAGE,
+        .level = log_level,
+        .size = count * sizeof(uint32_t)
+    };
+
+    va_start(args, format);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        entry.arguments[i] = va_arg(args, uint32_t);
+    }
     va_end(args);
+
+    _store(&entry);
 }
 
-void log_info(char const * const format, ...)
+/** \brief Log the content of an array (prefer the macro `log_debug_array()`, which filters the level).
+ * \param label The label of the array (it must outlive the log, e.g. a literal).
+ * \param array Pointer to the array (copied: it can change after the call).
+ * \param len The length of data in bytes (only the first \ref LOG_MAX_ARRAY_SIZE are kept).
+ */
+void log_write_array(char const * const label, void const *array, uint16_t const len)
 {
-    va_list args;
-	va_start(args, format);
-    _log(LOG_LEVEL_INFORMATION, format, args);
-    va_end(args);
+    LogEntry entry;
+
+    entry.header = (LogRecord){
+        .format = label,
+        .timestamp = cycle_counter_now(),
+        .type = LOG_RECORD_ARRAY,
+        .level = LOG_LEVEL_DEBUG,
+        .length = len,
+        .size = MIN(len, LOG_MAX_ARRAY_SIZE)
+    };
+    memcpy(entry.bytes, array, entry.header.size);
+
+    _store(&entry);
 }
 
-void log_debug(char const * const format, ...)
+/** \brief Formats the next record into the line (the work `printf` used to do at each call).
+ */
+static void _format_record()
 {
-    va_list args;
-	va_start(args, format);
-    _log(LOG_LEVEL_DEBUG, format, args);
-    va_end(args);
+    LogRecord record;
+    LogEntry entry = { 0 };
+    uint32_t const *a = entry.arguments;
+    int size;
+
+    ring_buffer_read(&log_buffer, &record, sizeof(record));
+    ring_buffer_read(&log_buffer, entry.bytes, record.size);
+
+    size = snprintf(line, sizeof(line), "[%lu us] [%s] ", cycle_counter_to_us(record.timestamp),
+        _get_log_level_string(record.level));
+
+    if (record.type == LOG_RECORD_ARRAY)
+    {
+        size += snprintf(line + size, sizeof(line) - size, "%s[%d]: {", record.format, record.length);
+        for (uint16_t i = 0; i < record.size && size < (int)sizeof(line); i++)
+        {
+            // Add ", " after all elements except the last one.
+            size += snprintf(line + size, sizeof(line) - size, i < record.length - 1 ? "0x%02X, " : "0x%02X", entry.bytes[i]);
+        }
+        if (size < (int)sizeof(line))
+        {
+            size += snprintf(line + size, sizeof(line) - size, record.size < record.length ? "...}\n" : "}\n");
+        }
+    }
+    else
+    {
+        // Note: The arguments the format does not use are ignored.
+        size += snprintf(line + size, sizeof(line) - size, record.format,
+            a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11]);
+        if (size < (int)sizeof(line))
+        {
+            size += snprintf(line + size, sizeof(line) - size, "\n");
+        }
+    }
+
+    line_size = MIN(size, (int)sizeof(line) - 1);
+    line_position = 0;
 }
 
-/** \brief Log the content of an array.
- * \param label The label of the array.
- * \param array Pointer to the array.
- * \param len The length of data in bytes.
+/** \brief Formats and sends the stored logs to the SWO, without ever waiting for it: formats at most one record per
+ * call, and returns as soon as the stimulus port is busy (it goes on at the next call). Call it from the main loop,
+ * after the work that matters.
+ * \note Without a debugger listening (ITM disabled), the logs are dropped as they are drained.
  */
-void log_debug_array(char const * const label, void const *array, uint16_t const len)
+void log_drain()
 {
-    if (LOG_LEVEL_DEBUG > system_log_level)
-        return;
-        
-	printf("[%s] %s[%d]: {", _get_log_level_string(LOG_LEVEL_DEBUG), label, len);
-    for (uint16_t i = 0; i < len; i++)
+    bool const enabled = READ_BIT(ITM->TCR, ITM_TCR_ITMENA_Msk) && READ_BIT(ITM->TER, 1UL);
+
+    if (line_position == line_size)
     {
-    	uint8_t val = *((uint8_t *)(array + i));
-    	printf("0x%02X", val);
-    	
-    	// Add ", " after all elements except the last one.
-    	if (i < len - 1)
-    	{
-    	    printf(", ");
-    	}
+        if (dropped_records != 0)
+        {
+            line_size = snprintf(line, sizeof(line), "[ERROR] %lu log records dropped (the buffer is full).\n",
+                dropped_records);
+            line_position = 0;
+            dropped_records = 0;
+        }
+        else if (ring_buffer_used(&log_buffer) != 0)
+        {
+            _format_record();
+        }
+        else
+            return;
+    }
+
+    while (line_position < line_size)
+    {
+        if (enabled && ITM->PORT[0].u32 == 0)
+            return;
+
+        if (enabled)
+        {
+            ITM->PORT[0].u8 = line[line_position];
+        }
+        line_position++;
     }
-	printf("}\n");
 }
+
+/** \brief Drains all the stored logs, waiting for the SWO (e.g. before a reset).
+ */
+void log_flush()
+{
+    while (ring_buffer_used(&log_buffer) != 0 || line_position < line_size || dropped_records != 0)
+    {
+        log_drain();
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "string.h"
+#include "Helpers/ring_buffer.h"
+#include "Helpers/math.h"
+#include "stm32f4xx.h"
+
+/** \brief Initializes an empty ring buffer.
+ * \param ring_buffer The ring buffer.
+ * \param storage The storage of the data.
+ * \param size Size of `storage` in bytes (must be a power of two).
+ */
+void ring_buffer_initialize(RingBuffer *ring_buffer, void *storage, uint32_t size)
+{
+	ring_buffer->buffer = storage;
+	ring_buffer->size = size;
+	ring_buffer_clear(ring_buffer);
+}
+
+/** \brief Drops all the data (neither side may use the ring buffer meanwhile).
+ */
+void ring_buffer_clear(RingBuffer *ring_buffer)
+{
+	ring_buffer->head = 0;
+	ring_buffer->tail = 0;
+}
+
+/** \brief Returns the contiguous free region at the head (the producer fills it, then commits it).
+ * \param ring_buffer The ring buffer.
+ * \param region Receives the start of the region.
+ * \returns The size of the region in bytes (may be less than the free space when it wraps around).
+ */
+uint32_t ring_buffer_write_region(RingBuffer const *ring_buffer, void **region)
+{
+	uint32_t offset = ring_buffer->head & (ring_buffer->size - 1);
+
+	*region = ring_buffer->buffer + offset;
+	return MIN(ring_buffer_free(ring_buffer), ring_buffer->size - offset);
+}
+
+/** \brief Publishes data written to the region returned by `ring_buffer_write_region()`.
+ * \param ring_buffer The ring buffer.
+ * \param size Count of bytes written.
+ */
+void ring_buffer_commit_write(RingBuffer *ring_buffer, uint32_t size)
+{
+	// The data must be in memory before the consumer can see the new head.
+	__DMB();
+	ring_buffer->head += size;
+}
+
+/** \brief Returns the contiguous readable region at the tail (the consumer reads it, then commits it).
+ * \param ring_buffer The ring buffer.
+ * \param region Receives the start of the region.
+ * \returns The size of the region in bytes (may be less than the used space when it wraps around).
+ */
+uint32_t ring_buffer_read_region(RingBuffer const *ring_buffer, void const **region)
+{
+	uint32_t offset = ring_buffer->tail & (ring_buffer->size - 1);
+
+	*region = ring_buffer->buffer + offset;
+	return MIN(ring_buffer_used(ring_buffer), ring_buffer->size - offset);
+}
+
+/** \brief Releases data read from the region returned by `ring_buffer_read_region()`.
+ * \param ring_buffer The ring buffer.
+ * \param size Count of bytes read.
+ */
+void ring_buffer_commit_read(RingBuffer *ring_buffer, uint32_t size)
+{
+	// The data must be read before the producer can overwrite it.
+	__DMB();
+	ring_buffer->tail += size;
+}
+
+/** \brief Copies data into the ring buffer (producer side).
+ * \param ring_buffer The ring buffer.
+ * \param data The data to write.
+ * \param size Size of the data in bytes.
+ * \returns The count of bytes written (less than `size` if the ring buffer is full).
+ */
+uint32_t ring_buffer_write(RingBuffer *ring_buffer, void const *data, uint32_t size)
+{
+	uint32_t written = 0;
+
+	// At most two regions: up to the end of the storage, then from its start.
+	while (written < size)
+	{
+		void *region;
+		uint32_t region_size = MIN(ring_buffer_write_region(ring_buffer, &region), size - written);
+
+		if (region_size == 0)
+			break;
+
+		memcpy(region, (uint8_t const *)data + written, region_size);
+		ring_buffer_commit_write(ring_buffer, region_size);
+		written += region_size;
+	}
+
+	return written;
+}
+
+/** \brief Copies data out of the ring buffer (consumer side).
+ * \param ring_buffer The ring buffer.
+ * \param data Receives the data.
+ * \param size Size of `data` in bytes.
+ * \returns The count of bytes read (less than `size` if the ring buffer has less data).
+ */
+uint32_t ring_buffer_read(RingBuffer *ring_buffer, void *data, uint32_t size)
+{
+	uint32_t read = 0;
+
+	while (read < size)
+	{
+		void const *region;
+		uint32_t region_size = MIN(ring_buffer_read_region(ring_buffer, &region), size - read);
+
+		if (region_size == 0)
+			break;
+
+		memcpy((uint8_t *)data + read, region, region_size);
+		ring_buffer_commit_read(ring_buffer, region_size);
+		read += region_size;
+	}
+
+	return read;
+}
@@ -0,0 +1,143 @@
+#include "stddef.h"
+#include "string.h"
+#include "Hid/usbd_hid.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+_Static_assert(USB_HID_MAX_REPORT_ID < 8, "A bit of idle_rate_changes per report ID");
+
+/** \brief Restores the state of a HID interface after a USB reset.
+ * \param hid The HID interface.
+ * \param default_idle_rate The idle rate of every report ID until the host sets one (4 ms units).
+ */
+void usbd_hid_reset(UsbHidInterface *hid, uint8_t default_idle_rate)
+{
+	hid->protocol = USB_HID_PROTOCOL_REPORT;
+	memset(hid->idle_rates, default_idle_rate, sizeof(hid->idle_rates));
+	hid->idle_rate_changes = (1 << (USB_HID_MAX_REPORT_ID + 1)) - 1;
+}
+
+/** \brief Processes the standard and class requests addressed to a HID interface.
+ * \param hid The HID interface.
+ * \param request The received request.
+ * \returns false if the request is not addressed to the interface or is not supported.
+ */
+bool usbd_hid_process_request(UsbHidInterface *hid, UsbRequest const *request)
+{
+	uint8_t const request_type = request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK);
+
+	if ((request->wIndex & 0xFF) != hid->interface_number)
+		return false;
+
+	if (request_type == (USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE))
+	{
+		if (request->bRequest != USB_STANDARD_GET_DESCRIPTOR)
+			return false;
+
+		switch (request->wValue >> 8)
+		{
+		case USB_DESCRIPTOR_TYPE_HID_REPORT:
+			log_info("- Get HID Report Descriptor.");
+			usbd_control_send(hid->report_descriptor, hid->report_descriptor_size);
+			return true;
+		case USB_DESCRIPTOR_TYPE_HID:
+			log_info("- Get HID Descriptor.");
+			usbd_control_send(hid->hid_descriptor, sizeof(UsbHidDescriptor));
+			return true;
+		}
+
+		return false;
+	}
+
+	if (request_type != (USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE))
+		return false;
+
+	uint8_t const report_type = request->wValue >> 8;
+	uint8_t const report_id = request->wValue & 0xFF;
+
+	switch (request->bRequest)
+	{
+	case USB_HID_GETREPORT:
+		log_info("HID Get Report request received.");
+		void const *report;
+
+		if (hid->get_report == NULL)
+			return false;
+
+		uint16_t report_size = hid->get_report(report_type - 1, report_id, &report);
+
+		if (report_size == 0)
+			return false;
+
+		usbd_control_send(report, report_size);
+		return true;
+	case USB_HID_SETREPORT:
+		log_info("HID Set Report request received.");
+
+		if (hid->set_report == NULL)
+			return false;
+
+		usbd_control_receive(hid->set_report_buffer, hid->set_report_buffer_size);
+		return true;
+	case USB_HID_GETIDLE:
+		log_info("HID Get Idle request received.");
+
+		if (report_id > USB_HID_MAX_REPORT_ID)
+			return false;
+
+		usbd_control_send(&hid->idle_rates[report_id], sizeof(hid->idle_rates[report_id]));
+		return true;
+	case USB_HID_SETIDLE:
+		log_info("HID Set Idle request received.");
+
+		if (report_id > USB_HID_MAX_REPORT_ID)
+			return false;
+
+		// Report ID 0 sets the idle rate of all the input reports (HID 1.11, 7.2.4).
+		if (report_id == 0)
+		{
+			memset(hid->idle_rates, request->wValue >> 8, sizeof(hid->idle_rates));
+			hid->idle_rate_changes = (1 << (USB_HID_MAX_REPORT_ID + 1)) - 1;
+		}
+		else
+		{
+			hid->idle_rates[report_id] = request->wValue >> 8;
+			hid->idle_rate_changes |= 1 << report_id;
+		}
+
+		usbd_control_acknowledge();
+		return true;
+	case USB_HID_GETPROTOCOL:
+		log_info("HID Get Protocol request received.");
+		usbd_control_send(&hid->protocol, sizeof(hid->protocol));
+		return true;
+	case USB_HID_SETPROTOCOL:
+		log_info("HID Set Protocol request received.");
+		hid->protocol = request->wValue & 0xFF;
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	return false;
+}
+
+/** \brief Passes the data stage of a SET_REPORT request to the interface.
+ * \param hid The HID interface.
+ * \param request The request whose data stage has completed.
+ * \returns false if the request is not a SET_REPORT addressed to the interface.
+ */
+bool usbd_hid_process_control_data(UsbHidInterface *hid, UsbRequest const *request)
+{
+	if ((request->wIndex & 0xFF) != hid->interface_number || request->bRequest != USB_HID_SETREPORT)
+		return false;
+
+	hid->set_report(
+		(request->wValue >> 8) - 1,
+		request->wValue & 0xFF,
+		hid->set_report_buffer,
+		MIN(request->wLength, hid->set_report_buffer_size)
+	);
+
+	return true;
+}
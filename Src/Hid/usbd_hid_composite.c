@@ -0,0 +1,432 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Hid/usbd_hid_composite.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usbd_hid_reports.h"
+#include "Hid/usbd_hid_scheduler.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Count of frames after which the scheduler statistics are logged.
+#define SCHEDULER_REPORT_PERIOD 10000
+/// \brief Count of frames a pending report waits to gain one priority level.
+#define SCHEDULER_AGING_FRAMES 4
+
+/**\name Report IDs
+ * @{ */
+#define REPORT_ID_MOUSE 1
+#define REPORT_ID_KEYBOARD 2
+#define REPORT_ID_CONSUMER 3
+#define REPORT_ID_VENDOR 4
+/** @} */
+
+_Static_assert(REPORT_ID_VENDOR <= USB_HID_MAX_REPORT_ID, "Each input report has an idle rate of its own");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AC,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Layout of the vendor input report (device to host).
+#define HID_VENDOR_INPUT_REPORT(FIELD) \
+	FIELD(ARRAY, data, uint8_t, HID_COMPOSITE_VENDOR_REPORT_SIZE, HID_PAGE_VENDOR, 0x01, 0x01, 0, 255, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the vendor output report (host to device).
+#define HID_VENDOR_OUTPUT_REPORT(FIELD) \
+	FIELD(ARRAY, data, uint8_t, HID_COMPOSITE_VENDOR_REPORT_SIZE, HID_PAGE_VENDOR, 0x02, 0x02, 0, 255, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+HID_REPORT_STRUCT(HidVendorReport, HID_VENDOR_INPUT_REPORT);
+HID_REPORT_ASSERTS(HidVendorReport, HID_VENDOR_INPUT_REPORT);
+HID_REPORT_ASSERTS(HidVendorReport, HID_VENDOR_OUTPUT_REPORT);
+
+HID_REPORT_WITH_ID(HidCompositeMouseReport, HidMouseReport);
+HID_REPORT_WITH_ID(HidCompositeKeyboardReport, HidKeyboardReport);
+HID_REPORT_WITH_ID(HidCompositeKeyboardLedReport, HidKeyboardLedReport);
+HID_REPORT_WITH_ID(HidCompositeConsumerReport, HidConsumerReport);
+HID_REPORT_WITH_ID(HidCompositeVendorReport, HidVendorReport);
+
+/// \brief Any of the input reports (sizes the endpoint).
+typedef union {
+	HidCompositeMouseReport mouse;
+	HidCompositeKeyboardReport keyboard;
+	HidCompositeConsumerReport consumer;
+	HidCompositeVendorReport vendor;
+} HidCompositeInputReport;
+
+/// \brief Any of the output reports (sizes the SET_REPORT buffer).
+typedef union {
+	uint8_t report_id;
+	HidCompositeKeyboardLedReport keyboard_leds;
+	HidCompositeVendorReport vendor;
+} HidCompositeOutputReport;
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_USAGE_PAGE(HID_PAGE_DESKTOP),
+	HID_USAGE(HID_DESKTOP_MOUSE),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_USAGE(HID_DESKTOP_POINTER),
+		HID_COLLECTION(HID_PHYSICAL_COLLECTION),
+			HID_REPORT_ITEMS_WITH_ID(REPORT_ID_MOUSE, HID_MOUSE_REPORT, INPUT)
+		HID_END_COLLECTION,
+	HID_END_COLLECTION,
+
+	HID_USAGE_PAGE(HID_PAGE_DESKTOP),
+	HID_USAGE(HID_DESKTOP_KEYBOARD),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS_WITH_ID(REPORT_ID_KEYBOARD, HID_KEYBOARD_REPORT, INPUT)
+		HID_REPORT_ITEMS(HID_KEYBOARD_LED_REPORT, OUTPUT)
+	HID_END_COLLECTION,
+
+	HID_USAGE_PAGE(HID_PAGE_CONSUMER),
+	HID_USAGE(HID_CONSUMER_CONTROL),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS_WITH_ID(REPORT_ID_CONSUMER, HID_CONSUMER_REPORT, INPUT)
+	HID_END_COLLECTION,
+
+	HID_RI_USAGE_PAGE(16, HID_PAGE_VENDOR),
+	HID_USAGE(0x01),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS_WITH_ID(REPORT_ID_VENDOR, HID_VENDOR_INPUT_REPORT, INPUT)
+		HID_REPORT_ITEMS(HID_VENDOR_OUTPUT_REPORT, OUTPUT)
+	HID_END_COLLECTION
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_hid_descriptor;
+	UsbEndpointDescriptor usb_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_HID,
+		// Note: Boot protocol does not allow report IDs.
+		.bInterfaceSubClass     = USB_HID_SUBCLASS_NONBOOT,
+		.bInterfaceProtocol     = USB_HID_PROTO_NONBOOT,
+		.iInterface             = 0
+	},
+    .usb_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidCompositeInputReport),
+        .bInterval              = HID_COMPOSITE_POLLING_INTERVAL
+    },
+    .usb_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0111,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    }
+};
+
+/// \brief The number of the interrupt IN endpoint shared by all the input reports.
+#define COMPOSITE_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+static HidCompositeMouseReport mouse_report = { .report_id = REPORT_ID_MOUSE };
+static HidCompositeKeyboardReport keyboard_report = { .report_id = REPORT_ID_KEYBOARD };
+static HidCompositeKeyboardLedReport keyboard_led_report = { .report_id = REPORT_ID_KEYBOARD };
+static HidCompositeConsumerReport consumer_report = { .report_id = REPORT_ID_CONSUMER };
+static HidCompositeVendorReport vendor_report = { .report_id = REPORT_ID_VENDOR };
+
+/// \brief The input reports, from the most to the least urgent one.
+static HidScheduledReport scheduled_reports[] = {
+	{ .report = &mouse_report, .size = sizeof(mouse_report), .priority = 3 },
+	{ .report = &keyboard_report, .size = sizeof(keyboard_report), .priority = 2 },
+	{ .report = &consumer_report, .size = sizeof(consumer_report), .priority = 1 },
+	{ .report = &vendor_report, .size = sizeof(vendor_report), .priority = 0 }
+};
+
+#define SCHEDULED_MOUSE_REPORT (&scheduled_reports[0])
+#define SCHEDULED_KEYBOARD_REPORT (&scheduled_reports[1])
+#define SCHEDULED_CONSUMER_REPORT (&scheduled_reports[2])
+#define SCHEDULED_VENDOR_REPORT (&scheduled_reports[3])
+
+static HidReportScheduler report_scheduler = {
+	.reports = scheduled_reports,
+	.report_count = sizeof(scheduled_reports) / sizeof(scheduled_reports[0]),
+	.aging_frames = SCHEDULER_AGING_FRAMES
+};
+
+/// \brief Whether a report is in the TxFIFO waiting for the host to collect it.
+static bool endpoint_busy;
+/// \brief Milliseconds elapsed since the keyboard report was last sent (for the idle rate).
+static uint16_t keyboard_idle_elapsed_ms;
+/// \brief Receives the payload of the vendor output reports.
+static void (*vendor_receiver)(void const *data, uint16_t size);
+/// \brief Receives the data stage of SET_REPORT.
+static HidCompositeOutputReport set_report_buffer;
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report);
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size);
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.get_report = &get_report,
+	.set_report = &set_report,
+	.set_report_buffer = &set_report_buffer,
+	.set_report_buffer_size = sizeof(set_report_buffer)
+};
+
+/** \brief Adds a relative movement to the mouse report.
+ * \param x Relative movement on the X axis.
+ * \param y Relative movement on the Y axis.
+ * \param buttons State of the mouse buttons (bit 0 is the first button).
+ */
+void usbd_hid_composite_mouse_move(int8_t x, int8_t y, uint8_t buttons)
+{
+	hid_mouse_report_move(&mouse_report.report, x, y, buttons);
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_MOUSE_REPORT);
+}
+
+/** \brief Marks a key as pressed.
+ * \param usage Usage of the key in the keyboard page.
+ */
+void usbd_hid_composite_keyboard_press(uint8_t usage)
+{
+	hid_keyboard_report_set_key(&keyboard_report.report, usage, true);
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_KEYBOARD_REPORT);
+}
+
+/** \brief Marks a key as released.
+ * \param usage Usage of the key in the keyboard page.
+ */
+void usbd_hid_composite_keyboard_release(uint8_t usage)
+{
+	hid_keyboard_report_set_key(&keyboard_report.report, usage, false);
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_KEYBOARD_REPORT);
+}
+
+/** \brief Returns the state of the keyboard LEDs set by the host (bit 0 is Num Lock).
+ */
+uint8_t usbd_hid_composite_keyboard_leds()
+{
+	return keyboard_led_report.report.leds;
+}
+
+/** \brief Sets the active consumer control.
+ * \param usage Usage of the control in the consumer page (`HID_CONSUMER_NONE` when it is released).
+ */
+void usbd_hid_composite_consumer_set(uint16_t usage)
+{
+	consumer_report.report.usage[0] = usage;
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_CONSUMER_REPORT);
+}
+
+/** \brief Queues a vendor input report.
+ * \param data The payload (padded with zeros to \ref HID_COMPOSITE_VENDOR_REPORT_SIZE bytes).
+ * \param size Size of the payload in bytes.
+ * \returns false if the previous vendor report was not sent yet.
+ */
+bool usbd_hid_composite_vendor_send(void const *data, uint16_t size)
+{
+	if (SCHEDULED_VENDOR_REPORT->pending)
+		return false;
+
+	size = MIN(size, sizeof(vendor_report.report.data));
+	memcpy(vendor_report.report.data, data, size);
+	memset(vendor_report.report.data + size, 0, sizeof(vendor_report.report.data) - size);
+
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_VENDOR_REPORT);
+	return true;
+}
+
+/** \brief Registers the callback that receives the payload of the vendor output reports.
+ */
+void usbd_hid_composite_set_vendor_receiver(void (*receiver)(void const *data, uint16_t size))
+{
+	vendor_receiver = receiver;
+}
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	if (report_type == USB_HID_REPORT_OUT && report_id == REPORT_ID_KEYBOARD)
+	{
+		*report = &keyboard_led_report;
+		return sizeof(keyboard_led_report);
+	}
+
+	if (report_type != USB_HID_REPORT_IN)
+		return 0;
+
+	for (uint8_t i = 0; i < report_scheduler.report_count; i++)
+	{
+		if (*(uint8_t const *)scheduled_reports[i].report == report_id)
+		{
+			*report = scheduled_reports[i].report;
+			return scheduled_reports[i].size;
+		}
+	}
+
+	return 0;
+}
+
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size)
+{
+	// Note: The data stage starts with the report ID, like the reports sent on the endpoint.
+	if (report_type != USB_HID_REPORT_OUT || size == 0 || set_report_buffer.report_id != report_id)
+		return;
+
+	switch (report_id)
+	{
+	case REPORT_ID_KEYBOARD:
+		keyboard_led_report.report = set_report_buffer.keyboard_leds.report;
+		log_info("Keyboard LEDs set to 0x%02X.", keyboard_led_report.report.leds);
+		break;
+	case REPORT_ID_VENDOR:
+		if (vendor_receiver != NULL)
+		{
+			vendor_receiver(set_report_buffer.vendor.report.data, size - 1);
+		}
+		break;
+	}
+}
+
+/** \brief Writes the most urgent pending report to the endpoint.
+ */
+static void write_next_report()
+{
+	HidScheduledReport *next_report = usbd_hid_scheduler_next(&report_scheduler);
+
+	if (next_report == NULL)
+		return;
+
+	usb_driver.write_packet(COMPOSITE_ENDPOINT_NUMBER, next_report->report, next_report->size);
+	endpoint_busy = true;
+
+	// The report is copied to the TxFIFO, so the producers can keep updating it.
+	if (next_report == SCHEDULED_MOUSE_REPORT)
+	{
+		mouse_report.report.x = 0;
+		mouse_report.report.y = 0;
+	}
+	else if (next_report == SCHEDULED_KEYBOARD_REPORT)
+	{
+		keyboard_idle_elapsed_ms = 0;
+	}
+}
+
+static void reset()
+{
+	endpoint_busy = false;
+	keyboard_led_report.report.leds = 0;
+	// Note: Only the keyboard report repeats by default (the default idle rate of mice is 0).
+	usbd_hid_reset(&hid_interface, 0);
+	hid_interface.idle_rates[REPORT_ID_KEYBOARD] = USB_HID_KEYBOARD_DEFAULT_IDLE_RATE;
+	usbd_hid_scheduler_reset(&report_scheduler);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		COMPOSITE_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_endpoint_descriptor.wMaxPacketSize
+	);
+
+	endpoint_busy = false;
+	keyboard_idle_elapsed_ms = 0;
+	// Sends the state of the keyboard, so the host starts from a known state.
+	usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_KEYBOARD_REPORT);
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	usbd_hid_process_control_data(&hid_interface, request);
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	usbd_hid_scheduler_frame_elapsed(&report_scheduler);
+
+	// Note: Only the idle rate of the keyboard report is applied (repeating relative mouse movement is wrong); the
+	// others are stored for GET_IDLE.
+	uint8_t const keyboard_idle_rate = hid_interface.idle_rates[REPORT_ID_KEYBOARD];
+
+	if (hid_interface.idle_rate_changes & (1 << REPORT_ID_KEYBOARD))
+	{
+		hid_interface.idle_rate_changes &= ~(1 << REPORT_ID_KEYBOARD);
+		keyboard_idle_elapsed_ms = 0;
+	}
+	else if (keyboard_idle_elapsed_ms < UINT16_MAX)
+	{
+		keyboard_idle_elapsed_ms++;
+	}
+
+	if (keyboard_idle_rate != 0 && keyboard_idle_elapsed_ms >= keyboard_idle_rate * 4)
+	{
+		usbd_hid_scheduler_mark_pending(&report_scheduler, SCHEDULED_KEYBOARD_REPORT);
+	}
+
+	if (!endpoint_busy)
+	{
+		write_next_report();
+	}
+
+	if (report_scheduler.frame % SCHEDULER_REPORT_PERIOD == 0)
+	{
+		usbd_hid_scheduler_log(&report_scheduler);
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number == COMPOSITE_ENDPOINT_NUMBER)
+	{
+		endpoint_busy = false;
+	}
+}
+
+const UsbClass usbd_hid_composite_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed
+};
@@ -0,0 +1,355 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "stdlib.h"
+#include "Hid/usbd_hid_gamepad.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usb_hid_standards.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Count of frames between two logs of the sample suppression statistics.
+#define GAMEPAD_STATISTICS_REPORT_PERIOD 10000
+/// \brief Count of fractional bits of the axis gains.
+#define GAMEPAD_GAIN_FRACTIONAL_BITS 12
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AF,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Layout of the axes (X, Y, Z, Rx, Ry and Rz have consecutive usages).
+#define HID_GAMEPAD_AXES_REPORT(FIELD) \
+	FIELD(ARRAY, axes, int16_t, HID_GAMEPAD_AXIS_COUNT, HID_PAGE_DESKTOP, HID_DESKTOP_X, HID_DESKTOP_RZ, -32767, 32767, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the hat switch (out of range values are the null state: centered).
+#define HID_GAMEPAD_HAT_REPORT(FIELD) \
+	FIELD(VALUE, hat, uint8_t, HID_PAGE_DESKTOP, HID_DESKTOP_HAT_SWITCH, 0, 7, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE | HID_IOF_NULLSTATE)
+
+/// \brief Layout of the buttons.
+#define HID_GAMEPAD_BUTTONS_REPORT(FIELD) \
+	FIELD(BITMAP, buttons, uint32_t, HID_PAGE_BUTTON, 1, HID_GAMEPAD_BUTTON_COUNT, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the gamepad input report.
+#define HID_GAMEPAD_REPORT(FIELD) \
+	HID_GAMEPAD_AXES_REPORT(FIELD) \
+	HID_GAMEPAD_HAT_REPORT(FIELD) \
+	HID_GAMEPAD_BUTTONS_REPORT(FIELD)
+
+HID_REPORT_STRUCT(HidGamepadReport, HID_GAMEPAD_REPORT);
+HID_REPORT_ASSERTS(HidGamepadReport, HID_GAMEPAD_REPORT);
+_Static_assert(HID_GAMEPAD_AXIS_COUNT % 2 == 0, "The axes are processed in pairs");
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_USAGE_PAGE(HID_PAGE_DESKTOP),
+	HID_USAGE(HID_DESKTOP_GAMEPAD),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS(HID_GAMEPAD_AXES_REPORT, INPUT)
+
+		// The hat directions are 45 degrees apart.
+		HID_UNIT(8, HID_UNIT_IMPERIAL_ROTATION | HID_UNIT_ANGLE(1)),
+		HID_PHYSICAL_MINIMUM(0),
+		HID_PHYSICAL_MAXIMUM(315),
+		HID_REPORT_ITEMS(HID_GAMEPAD_HAT_REPORT, INPUT)
+		HID_UNIT(8, HID_UNIT_NONE),
+		HID_PHYSICAL_MAXIMUM(0),
+
+		HID_REPORT_ITEMS(HID_GAMEPAD_BUTTONS_REPORT, INPUT)
+	HID_END_COLLECTION
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_hid_descriptor;
+	UsbEndpointDescriptor usb_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_HID,
+		.bInterfaceSubClass     = USB_HID_SUBCLASS_NONBOOT,
+		.bInterfaceProtocol     = USB_HID_PROTO_NONBOOT,
+		.iInterface             = 0
+	},
+    .usb_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0111,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    },
+    .usb_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidGamepadReport),
+        .bInterval              = HID_GAMEPAD_POLLING_INTERVAL
+    }
+};
+
+/// \brief The number of the gamepad interrupt IN endpoint.
+#define GAMEPAD_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/** \brief Calibration of the axes, two axes per word (even axis in the low halfword) for the SIMD instructions.
+ */
+static struct {
+	uint32_t centers[HID_GAMEPAD_AXIS_COUNT / 2];
+	uint32_t gains[HID_GAMEPAD_AXIS_COUNT / 2];
+} axis_pairs = {
+	.gains = {
+		HID_GAMEPAD_UNITY_GAIN | HID_GAMEPAD_UNITY_GAIN << 16,
+		HID_GAMEPAD_UNITY_GAIN | HID_GAMEPAD_UNITY_GAIN << 16,
+		HID_GAMEPAD_UNITY_GAIN | HID_GAMEPAD_UNITY_GAIN << 16
+	}
+};
+_Static_assert(HID_GAMEPAD_AXIS_COUNT == 6, "The default gains list 3 axis pairs");
+
+/// \brief Scaled values below which each axis reports 0.
+static uint16_t axis_deadbands[HID_GAMEPAD_AXIS_COUNT];
+/// \brief Smallest change of an axis (from the last queued report) that is worth a report.
+static uint16_t axis_threshold;
+
+/// \brief The latest report worth sending.
+static HidGamepadReport gamepad_report = { .hat = HID_GAMEPAD_HAT_CENTERED };
+/// \brief Whether `gamepad_report` was not written to the endpoint yet.
+static bool gamepad_report_pending;
+/// \brief The last report written to the endpoint (returned by GET_REPORT).
+static HidGamepadReport last_gamepad_report = { .hat = HID_GAMEPAD_HAT_CENTERED };
+/// \brief Whether a report is in the TxFIFO waiting for the host to collect it.
+static bool endpoint_busy;
+/// \brief Whether the endpoint is configured.
+static bool endpoint_configured;
+
+/// \brief Samples processed and reports sent since the statistics were last logged.
+static uint32_t processed_samples, sent_reports;
+/// \brief Cycles spent processing the samples since the statistics were last logged.
+static uint32_t processing_cycles;
+/// \brief Frames since the statistics were last logged.
+static uint16_t statistics_frames;
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	if (report_type != USB_HID_REPORT_IN)
+		return 0;
+
+	*report = &last_gamepad_report;
+	return sizeof(last_gamepad_report);
+}
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.get_report = &get_report
+};
+
+/** \brief Sets the calibration of an axis.
+ * \param axis Index of the axis (0 - 5: X, Y, Z, Rx, Ry, Rz).
+ * \param center Raw value of the axis at rest.
+ * \param gain Scale from raw to reported values in Q12 format (\ref HID_GAMEPAD_UNITY_GAIN is 1.0).
+ * \param deadband Scaled values within +/- `deadband` of the center report 0.
+ */
+void usbd_hid_gamepad_calibrate(uint8_t axis, int16_t center, int16_t gain, uint16_t deadband)
+{
+	if (axis >= HID_GAMEPAD_AXIS_COUNT)
+		return;
+
+	uint8_t shift = (axis % 2) * 16;
+	uint32_t mask = 0xFFFF << shift;
+
+	axis_pairs.centers[axis / 2] = (axis_pairs.centers[axis / 2] & ~mask) | (((uint32_t)(uint16_t)center) << shift);
+	axis_pairs.gains[axis / 2] = (axis_pairs.gains[axis / 2] & ~mask) | (((uint32_t)(uint16_t)gain) << shift);
+	axis_deadbands[axis] = deadband;
+}
+
+/** \brief Sets the smallest change of an axis that produces a new report (0 reports every change).
+ */
+void usbd_hid_gamepad_set_threshold(uint16_t threshold)
+{
+	axis_threshold = threshold;
+}
+
+/** \brief Centers and scales two axes with saturation.
+ * \param raw Two raw axis values (even axis in the low halfword).
+ * \param pair Index of the pair of axes.
+ * \returns The two scaled values, saturated to the 16-bit range.
+ */
+inline static uint32_t scale_axis_pair(uint32_t raw, uint8_t pair)
+{
+	uint32_t const gains = axis_pairs.gains[pair];
+
+	// Subtracts the centers from both halfwords at once (saturated: no wrap around at the ends of the range).
+	uint32_t centered = __QSUB16(raw, axis_pairs.centers[pair]);
+
+	// Multiplies each halfword by its gain (the other halfword of the gain operand is 0).
+	int32_t low = (int32_t)__SMUAD(centered, gains & 0x0000FFFF) >> GAMEPAD_GAIN_FRACTIONAL_BITS;
+	int32_t high = (int32_t)__SMUAD(centered, gains & 0xFFFF0000) >> GAMEPAD_GAIN_FRACTIONAL_BITS;
+
+	// Saturates both products to 16 bits and packs them back in one word.
+	return __PKHBT(__SSAT(low, 16), __SSAT(high, 16), 16);
+}
+
+/** \brief Processes one sample of the inputs; it only produces a report if the state changed noticeably.
+ * \param raw_axes Raw values of the axes (e.g. ADC samples).
+ * \param hat Direction of the hat switch (0 - 7, or \ref HID_GAMEPAD_HAT_CENTERED).
+ * \param buttons State of the buttons (bit 0 is the first button).
+ * \note Can be called much more often than the host polls: samples that do not change the state are dropped.
+ */
+void usbd_hid_gamepad_update(int16_t const raw_axes[HID_GAMEPAD_AXIS_COUNT], uint8_t hat, uint32_t buttons)
+{
+	uint32_t start = cycle_counter_now();
+	int16_t axes[HID_GAMEPAD_AXIS_COUNT];
+	bool changed = hat != gamepad_report.hat || buttons != gamepad_report.buttons;
+
+	for (uint8_t pair = 0; pair < HID_GAMEPAD_AXIS_COUNT / 2; pair++)
+	{
+		uint32_t raw;
+
+		// Note: memcpy() of a word compiles to one load (the array may not be word aligned).
+		memcpy(&raw, &raw_axes[pair * 2], sizeof(raw));
+		uint32_t scaled = scale_axis_pair(raw, pair);
+		memcpy(&axes[pair * 2], &scaled, sizeof(scaled));
+	}
+
+	for (uint8_t axis = 0; axis < HID_GAMEPAD_AXIS_COUNT; axis++)
+	{
+		if (abs(axes[axis]) <= axis_deadbands[axis])
+		{
+			axes[axis] = 0;
+		}
+
+		// -32768 is out of the logical range of the report.
+		axes[axis] = MAX(axes[axis], -32767);
+
+		if (abs(axes[axis] - gamepad_report.axes[axis]) > axis_threshold)
+		{
+			changed = true;
+		}
+	}
+
+	if (changed)
+	{
+		memcpy(gamepad_report.axes, axes, sizeof(gamepad_report.axes));
+		gamepad_report.hat = hat < HID_GAMEPAD_HAT_CENTERED ? hat : HID_GAMEPAD_HAT_CENTERED;
+		gamepad_report.buttons = buttons;
+		gamepad_report_pending = true;
+	}
+
+	processed_samples++;
+	processing_cycles += cycle_counter_now() - start;
+}
+
+static void reset()
+{
+	endpoint_configured = false;
+	endpoint_busy = false;
+	usbd_hid_reset(&hid_interface, 0);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		GAMEPAD_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_endpoint_descriptor.wMaxPacketSize
+	);
+
+	endpoint_busy = false;
+	endpoint_configured = true;
+	// Sends the current state, so the host starts from a known state.
+	gamepad_report_pending = true;
+	processed_samples = sent_reports = processing_cycles = 0;
+	statistics_frames = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	// Only the latest state is sent: the samples between two polls were merged into it.
+	if (endpoint_configured && !endpoint_busy && gamepad_report_pending)
+	{
+		last_gamepad_report = gamepad_report;
+
+		usb_driver.write_packet(
+			GAMEPAD_ENDPOINT_NUMBER,
+			&last_gamepad_report,
+			sizeof(last_gamepad_report)
+		);
+
+		gamepad_report_pending = false;
+		endpoint_busy = true;
+		sent_reports++;
+	}
+
+	if (++statistics_frames < GAMEPAD_STATISTICS_REPORT_PERIOD)
+		return;
+
+	if (processed_samples != 0)
+	{
+		log_info("Gamepad: %lu samples, %lu reports sent, %lu cycles per sample.",
+			processed_samples,
+			sent_reports,
+			processing_cycles / processed_samples
+		);
+	}
+
+	processed_samples = sent_reports = processing_cycles = 0;
+	statistics_frames = 0;
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number == GAMEPAD_ENDPOINT_NUMBER)
+	{
+		endpoint_busy = false;
+	}
+}
+
+const UsbClass usbd_hid_gamepad_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed
+};
@@ -0,0 +1,325 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Hid/usbd_hid_keyboard.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usbd_hid_reports.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AB,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Count of keys reported by the boot protocol report.
+#define KEYBOARD_BOOT_KEY_COUNT 6
+
+/** \brief Keyboard input report in boot protocol (fixed by the HID specification, appendix B.1).
+ */
+typedef struct {
+	uint8_t modifiers;
+	uint8_t reserved;
+	uint8_t keys[KEYBOARD_BOOT_KEY_COUNT];
+} __attribute__((__packed__)) HidKeyboardBootReport;
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_USAGE_PAGE(HID_PAGE_DESKTOP),
+	HID_USAGE(HID_DESKTOP_KEYBOARD),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS(HID_KEYBOARD_REPORT, INPUT)
+		HID_REPORT_ITEMS(HID_KEYBOARD_LED_REPORT, OUTPUT)
+	HID_END_COLLECTION
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_keyboard_hid_descriptor;
+	UsbEndpointDescriptor usb_keyboard_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_HID,
+		.bInterfaceSubClass     = USB_HID_SUBCLASS_BOOT,
+		.bInterfaceProtocol     = USB_HID_PROTO_KEYBOARD,
+		.iInterface             = 0
+	},
+    .usb_keyboard_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidKeyboardReport),
+        .bInterval              = HID_KEYBOARD_POLLING_INTERVAL
+    },
+    .usb_keyboard_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0111,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    }
+};
+
+/// \brief The number of the keyboard interrupt IN endpoint.
+#define KEYBOARD_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_keyboard_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/// \brief The state of all the keys (always kept in the N-key rollover format).
+static HidKeyboardReport keyboard_state;
+/// \brief The last report written to the endpoint, in the format of the protocol selected when it was written.
+static union {
+	HidKeyboardReport report;
+	HidKeyboardBootReport boot_report;
+} last_keyboard_report;
+/// \brief Size of `last_keyboard_report` (0 until a report is written).
+static uint16_t last_keyboard_report_size;
+/// \brief The state of the LEDs set by the host.
+static HidKeyboardLedReport keyboard_leds;
+/// \brief Whether a keyboard report is in the TxFIFO waiting for the host to collect it.
+static bool keyboard_endpoint_busy;
+/// \brief Milliseconds elapsed since the last report was written (for the idle rate).
+static uint16_t keyboard_idle_elapsed_ms;
+
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size);
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_keyboard_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.set_report = &set_report,
+	.set_report_buffer = &keyboard_leds,
+	.set_report_buffer_size = sizeof(keyboard_leds)
+};
+
+/** \brief Marks a key as pressed.
+ * \param usage Usage of the key in the keyboard page (e.g. `HID_KEYBOARD_A` or `HID_KEYBOARD_LEFT_SHIFT`).
+ */
+void usbd_hid_keyboard_press(uint8_t usage)
+{
+	hid_keyboard_report_set_key(&keyboard_state, usage, true);
+}
+
+/** \brief Marks a key as released.
+ * \param usage Usage of the key in the keyboard page.
+ */
+void usbd_hid_keyboard_release(uint8_t usage)
+{
+	hid_keyboard_report_set_key(&keyboard_state, usage, false);
+}
+
+/** \brief Marks all the keys as released.
+ */
+void usbd_hid_keyboard_release_all()
+{
+	keyboard_state = (HidKeyboardReport) { 0 };
+}
+
+/** \brief Returns the state of the keyboard LEDs set by the host (bit 0 is Num Lock).
+ */
+uint8_t usbd_hid_keyboard_leds()
+{
+	return keyboard_leds.leds;
+}
+
+/** \brief Converts the key state to the boot protocol report.
+ * \details The first six pressed keys are reported; if more keys are pressed, all the slots report ErrorRollOver.
+ */
+static void build_boot_report(HidKeyboardBootReport *boot_report)
+{
+	uint8_t key_count = 0;
+
+	*boot_report = (HidKeyboardBootReport) { .modifiers = keyboard_state.modifiers };
+
+	for (uint8_t i = 0; i < sizeof(keyboard_state.keys); i++)
+	{
+		// Skips the bytes without pressed keys.
+		for (uint8_t bits = keyboard_state.keys[i]; bits != 0; bits &= bits - 1)
+		{
+			if (key_count == KEYBOARD_BOOT_KEY_COUNT)
+			{
+				memset(boot_report->keys, HID_KEYBOARD_ERROR_ROLLOVER, sizeof(boot_report->keys));
+				return;
+			}
+
+			boot_report->keys[key_count++] = i * 8 + __builtin_ctz(bits);
+		}
+	}
+}
+
+/** \brief Builds the report of the selected protocol.
+ * \returns The size of the report.
+ */
+static uint16_t build_report(void *report)
+{
+	if (hid_interface.protocol == USB_HID_PROTOCOL_BOOT)
+	{
+		build_boot_report(report);
+		return sizeof(HidKeyboardBootReport);
+	}
+
+	memcpy(report, &keyboard_state, sizeof(keyboard_state));
+	return sizeof(HidKeyboardReport);
+}
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	static union {
+		HidKeyboardReport report;
+		HidKeyboardBootReport boot_report;
+	} current_report;
+
+	switch (report_type)
+	{
+	case USB_HID_REPORT_IN:
+		*report = &current_report;
+		return build_report(&current_report);
+	case USB_HID_REPORT_OUT:
+		*report = &keyboard_leds;
+		return sizeof(keyboard_leds);
+	}
+
+	return 0;
+}
+
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size)
+{
+	// Note: The report is received directly into `keyboard_leds`.
+	if (report_type == USB_HID_REPORT_OUT)
+	{
+		log_info("Keyboard LEDs set to 0x%02X.", keyboard_leds.leds);
+	}
+}
+
+/** \brief Writes the current report if the keys changed or the idle period has expired.
+ */
+static void send_keyboard_report()
+{
+	static union {
+		HidKeyboardReport report;
+		HidKeyboardBootReport boot_report;
+	} report;
+
+	uint16_t report_size = build_report(&report);
+	bool changed = report_size != last_keyboard_report_size || memcmp(&report, &last_keyboard_report, report_size) != 0;
+	uint8_t idle_rate = hid_interface.idle_rates[0];
+	bool idle_expired = idle_rate != 0 && keyboard_idle_elapsed_ms >= idle_rate * 4;
+
+	if (!changed && !idle_expired)
+		return;
+
+	log_debug("Sending USB HID keyboard report.");
+
+	memcpy(&last_keyboard_report, &report, report_size);
+	last_keyboard_report_size = report_size;
+
+	usb_driver.write_packet(
+		KEYBOARD_ENDPOINT_NUMBER,
+		&last_keyboard_report,
+		last_keyboard_report_size
+	);
+
+	keyboard_endpoint_busy = true;
+	keyboard_idle_elapsed_ms = 0;
+}
+
+static void reset()
+{
+	keyboard_endpoint_busy = false;
+	keyboard_leds.leds = 0;
+	usbd_hid_reset(&hid_interface, USB_HID_KEYBOARD_DEFAULT_IDLE_RATE);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		KEYBOARD_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_keyboard_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_keyboard_endpoint_descriptor.wMaxPacketSize
+	);
+
+	keyboard_endpoint_busy = false;
+	keyboard_idle_elapsed_ms = 0;
+	// Forces the first report, so the host starts from a known state.
+	last_keyboard_report_size = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	usbd_hid_process_control_data(&hid_interface, request);
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	// A new idle rate restarts the idle period.
+	if (hid_interface.idle_rate_changes != 0)
+	{
+		hid_interface.idle_rate_changes = 0;
+		keyboard_idle_elapsed_ms = 0;
+	}
+	else if (keyboard_idle_elapsed_ms < UINT16_MAX)
+	{
+		keyboard_idle_elapsed_ms++;
+	}
+
+	if (!keyboard_endpoint_busy)
+	{
+		send_keyboard_report();
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number == KEYBOARD_ENDPOINT_NUMBER)
+	{
+		keyboard_endpoint_busy = false;
+	}
+}
+
+const UsbClass usbd_hid_keyboard_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed
+};
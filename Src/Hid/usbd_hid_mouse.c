@@ -0,0 +1,280 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "Hid/usbd_hid_mouse.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usbd_hid_reports.h"
+#include "usbd_framework.h"
+#include "usbd_polling_phase.h"
+#include "Helpers/logger.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/latency.h"
+
+/// \brief Count of latency samples after which the mouse latency distribution is logged.
+#define MOUSE_LATENCY_REPORT_PERIOD 1000
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AA,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_USAGE_PAGE(HID_PAGE_DESKTOP),
+	HID_USAGE(HID_DESKTOP_MOUSE),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_USAGE(HID_DESKTOP_POINTER),
+		HID_COLLECTION(HID_PHYSICAL_COLLECTION),
+			HID_REPORT_ITEMS(HID_MOUSE_REPORT, INPUT)
+		HID_END_COLLECTION,
+	HID_END_COLLECTION
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_mouse_hid_descriptor;
+	UsbEndpointDescriptor usb_mouse_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_HID,
+		.bInterfaceSubClass     = USB_PROTOCOL_NONE,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+    .usb_mouse_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x83,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidMouseReport),
+        .bInterval              = HID_MOUSE_POLLING_INTERVAL
+    },
+    .usb_mouse_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0100,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    }
+};
+
+/// \brief The number of the mouse interrupt IN endpoint.
+#define MOUSE_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/// \brief The mouse report that accumulates input events until it is written to the endpoint.
+static HidMouseReport mouse_report;
+/// \brief The last report written to the endpoint (returned by GET_REPORT).
+static HidMouseReport last_mouse_report;
+/// \brief Whether `mouse_report` contains input events that were not sent yet.
+static bool mouse_report_pending;
+/// \brief Whether a mouse report is in the TxFIFO waiting for the host to collect it.
+static bool mouse_endpoint_busy;
+/// \brief Cycle counter value of the oldest input event in `mouse_report`.
+static uint32_t mouse_input_timestamp;
+/// \brief Cycle counter value of the oldest input event in the report waiting in the TxFIFO.
+static uint32_t mouse_in_flight_timestamp;
+/// \brief Distribution of the time from an input event to the completion of the IN transaction carrying it.
+static LatencyStatistics mouse_latency;
+/// \brief Learns when the host polls the mouse endpoint, so the inputs are sampled just before it.
+static PollingPhaseEstimator mouse_polling_phase;
+/// \brief Application callback that samples the inputs (by calling `usbd_hid_mouse_move()`).
+static void (*mouse_sampler)();
+/// \brief Whether the mouse report was already produced in the current frame.
+static bool mouse_sampled_in_frame;
+/// \brief Whether the device is configured (reports can be sent).
+static bool mouse_configured;
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	if (report_type != USB_HID_REPORT_IN)
+		return 0;
+
+	*report = &last_mouse_report;
+	return sizeof(last_mouse_report);
+}
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_mouse_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.get_report = &get_report
+};
+
+/** \brief Adds an input event to the mouse report that will be sent in the next frame.
+ * \param x Relative movement on the X axis.
+ * \param y Relative movement on the Y axis.
+ * \param buttons State of the mouse buttons (bit 0 is the first button).
+ */
+void usbd_hid_mouse_move(int8_t x, int8_t y, uint8_t buttons)
+{
+	if (!mouse_report_pending)
+	{
+		mouse_input_timestamp = cycle_counter_now();
+		mouse_report = (HidMouseReport) { 0 };
+	}
+
+	hid_mouse_report_move(&mouse_report, x, y, buttons);
+	mouse_report_pending = true;
+}
+
+/** \brief Registers the callback that samples the mouse inputs just before the host is predicted to poll.
+ * \param sampler Function that reads the inputs and reports them with `usbd_hid_mouse_move()`.
+ */
+void usbd_hid_mouse_set_sampler(void (*sampler)())
+{
+	mouse_sampler = sampler;
+}
+
+static void write_mouse_report()
+{
+	log_debug("Sending USB HID mouse report.");
+
+	last_mouse_report = mouse_report;
+
+    usb_driver.write_packet(
+		MOUSE_ENDPOINT_NUMBER,
+		&last_mouse_report,
+		sizeof(last_mouse_report)
+	);
+
+	mouse_in_flight_timestamp = mouse_input_timestamp;
+	mouse_report_pending = false;
+	mouse_endpoint_busy = true;
+}
+
+/** \brief Samples the inputs and writes the report, if the previous one was collected by the host.
+ */
+static void produce_mouse_report()
+{
+	mouse_sampled_in_frame = true;
+
+	if (mouse_endpoint_busy)
+		return;
+
+	if (mouse_sampler != NULL)
+	{
+		mouse_sampler();
+	}
+
+	// Produces at most one report per frame, so the report always carries the most recent input.
+	if (mouse_report_pending)
+	{
+		write_mouse_report();
+	}
+}
+
+static void reset()
+{
+	mouse_configured = false;
+	mouse_endpoint_busy = false;
+	polling_phase_reset(&mouse_polling_phase);
+	usbd_hid_reset(&hid_interface, 0);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		MOUSE_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_mouse_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// Note: Reports are written on SOF, so nothing is queued on the endpoint yet.
+	mouse_endpoint_busy = false;
+	mouse_configured = true;
+	latency_reset(&mouse_latency);
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	polling_phase_sof_received(&mouse_polling_phase, cycle_counter_now());
+	mouse_sampled_in_frame = false;
+
+	// Until the polling phase is known, the report is produced at the start of the frame.
+	if (!polling_phase_is_locked(&mouse_polling_phase))
+	{
+		produce_mouse_report();
+	}
+}
+
+static void polled()
+{
+	if (mouse_configured &&
+		!mouse_sampled_in_frame &&
+		polling_phase_is_locked(&mouse_polling_phase) &&
+		cycle_counter_now() - mouse_polling_phase.sof_timestamp >= polling_phase_sample_offset(&mouse_polling_phase))
+	{
+		produce_mouse_report();
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number != MOUSE_ENDPOINT_NUMBER)
+		return;
+
+	uint32_t timestamp = cycle_counter_now();
+
+	latency_record(&mouse_latency, mouse_in_flight_timestamp, timestamp);
+	// The IN transaction completes right after the host polled the endpoint.
+	polling_phase_poll_observed(&mouse_polling_phase, timestamp);
+	mouse_endpoint_busy = false;
+
+	if (mouse_latency.count == MOUSE_LATENCY_REPORT_PERIOD)
+	{
+		latency_log("Mouse input-to-bus", &mouse_latency);
+		log_info("Mouse polling phase: %lu us after SOF (jitter %lu us).",
+			cycle_counter_to_us(mouse_polling_phase.phase),
+			cycle_counter_to_us(mouse_polling_phase.deviation)
+		);
+		latency_reset(&mouse_latency);
+	}
+}
+
+const UsbClass usbd_hid_mouse_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_poll = &polled
+};
@@ -0,0 +1,97 @@
+#include "stddef.h"
+#include "Hid/usbd_hid_scheduler.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/** \brief Forgets the pending reports and the statistics of a scheduler (e.g. on a USB reset).
+ * \param scheduler The scheduler.
+ */
+void usbd_hid_scheduler_reset(HidReportScheduler *scheduler)
+{
+	scheduler->frame = 0;
+
+	for (uint8_t i = 0; i < scheduler->report_count; i++)
+	{
+		scheduler->reports[i].pending = false;
+		scheduler->reports[i].sent_count = 0;
+		scheduler->reports[i].max_wait_frames = 0;
+	}
+}
+
+/** \brief Marks a report as changed; it will be sent in one of the next IN transactions.
+ * \param scheduler The scheduler.
+ * \param report The report (one of the reports of the scheduler).
+ * \note The age of a report that is already pending is kept (changes merge into the pending report).
+ */
+void usbd_hid_scheduler_mark_pending(HidReportScheduler *scheduler, HidScheduledReport *report)
+{
+	if (!report->pending)
+	{
+		report->pending = true;
+		report->pending_since = scheduler->frame;
+	}
+}
+
+/** \brief Ages the pending reports by one frame (called on every SOF).
+ * \param scheduler The scheduler.
+ */
+void usbd_hid_scheduler_frame_elapsed(HidReportScheduler *scheduler)
+{
+	scheduler->frame++;
+}
+
+/** \brief Picks the next report to send and marks it as sent.
+ * \param scheduler The scheduler.
+ * \returns The report to write to the endpoint, or NULL if no report is pending.
+ */
+HidScheduledReport *usbd_hid_scheduler_next(HidReportScheduler *scheduler)
+{
+	HidScheduledReport *next_report = NULL;
+	uint32_t next_priority = 0;
+	uint32_t next_age = 0;
+
+	for (uint8_t i = 0; i < scheduler->report_count; i++)
+	{
+		HidScheduledReport *report = &scheduler->reports[i];
+
+		if (!report->pending)
+			continue;
+
+		uint32_t age = scheduler->frame - report->pending_since;
+		uint32_t priority = report->priority + age / scheduler->aging_frames;
+
+		if (next_report == NULL || priority > next_priority || (priority == next_priority && age > next_age))
+		{
+			next_report = report;
+			next_priority = priority;
+			next_age = age;
+		}
+	}
+
+	if (next_report != NULL)
+	{
+		next_report->pending = false;
+		next_report->sent_count++;
+		next_report->max_wait_frames = MAX(next_report->max_wait_frames, next_age);
+	}
+
+	return next_report;
+}
+
+/** \brief Logs how many times each report was sent and how long it waited at most.
+ * \param scheduler The scheduler.
+ */
+void usbd_hid_scheduler_log(HidReportScheduler const *scheduler)
+{
+	for (uint8_t i = 0; i < scheduler->report_count; i++)
+	{
+		HidScheduledReport const *report = &scheduler->reports[i];
+
+		log_info("Report %u (priority %u): sent %lu times, waited at most %lu frames.",
+			*(uint8_t const *)report->report,
+			report->priority,
+			report->sent_count,
+			report->max_wait_frames
+		);
+	}
+}
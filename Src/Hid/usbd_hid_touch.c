@@ -0,0 +1,377 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Hid/usbd_hid_touch.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usb_hid_standards.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Count of frames between two logs of the batching statistics.
+#define TOUCH_STATISTICS_REPORT_PERIOD 10000
+/// \brief Physical size of the surface on both axes in 0.1 mm units.
+#define TOUCH_PHYSICAL_MAXIMUM 1500
+
+/**\name Report IDs
+ * @{ */
+#define REPORT_ID_TOUCH 1
+#define REPORT_ID_CONTACT_COUNT_MAXIMUM 2
+/** @} */
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AE,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Layout of one contact (a finger logical collection).
+#define HID_TOUCH_CONTACT(FIELD) \
+	FIELD(BITMAP_PADDED, tip_switch, uint8_t, HID_PAGE_DIGITIZER, HID_DIGITIZER_TIP_SWITCH, HID_DIGITIZER_TIP_SWITCH, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE) \
+	FIELD(VALUE, contact_id, uint8_t, HID_PAGE_DIGITIZER, HID_DIGITIZER_CONTACT_ID, 0, 127, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE) \
+	FIELD(VALUE, x, uint16_t, HID_PAGE_DESKTOP, HID_DESKTOP_X, 0, HID_TOUCH_LOGICAL_MAXIMUM, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE) \
+	FIELD(VALUE, y, uint16_t, HID_PAGE_DESKTOP, HID_DESKTOP_Y, 0, HID_TOUCH_LOGICAL_MAXIMUM, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the contact count (count of contacts of the frame in its first report, 0 in the others).
+#define HID_TOUCH_CONTACT_COUNT(FIELD) \
+	FIELD(VALUE, contact_count, uint8_t, HID_PAGE_DIGITIZER, HID_DIGITIZER_CONTACT_COUNT, 0, HID_TOUCH_MAX_CONTACTS, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the scan time (time of the frame in 100 us units, wraps around).
+#define HID_TOUCH_SCAN_TIME(FIELD) \
+	FIELD(VALUE, scan_time, uint16_t, HID_PAGE_DIGITIZER, HID_DIGITIZER_SCAN_TIME, 0, 65535, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the feature report that tells the host how many contacts the device tracks.
+#define HID_TOUCH_CONTACT_COUNT_MAXIMUM(FIELD) \
+	FIELD(VALUE, contact_count_maximum, uint8_t, HID_PAGE_DIGITIZER, HID_DIGITIZER_CONTACT_COUNT_MAXIMUM, 0, HID_TOUCH_MAX_CONTACTS, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+HID_REPORT_STRUCT(HidTouchContact, HID_TOUCH_CONTACT);
+HID_REPORT_ASSERTS(HidTouchContact, HID_TOUCH_CONTACT);
+HID_REPORT_STRUCT(HidTouchContactCountMaximum, HID_TOUCH_CONTACT_COUNT_MAXIMUM);
+HID_REPORT_ASSERTS(HidTouchContactCountMaximum, HID_TOUCH_CONTACT_COUNT_MAXIMUM);
+HID_REPORT_WITH_ID(HidTouchContactCountMaximumReport, HidTouchContactCountMaximum);
+
+/** \brief The touch input report (a batch of contacts of one frame).
+ */
+typedef struct {
+	uint8_t report_id;
+	HidTouchContact contacts[HID_TOUCH_CONTACTS_PER_REPORT];
+	uint8_t contact_count;
+	uint16_t scan_time;
+} __attribute__((__packed__)) HidTouchReport;
+
+_Static_assert(sizeof(HidTouchReport) * 8 ==
+	8 + HID_TOUCH_CONTACTS_PER_REPORT * HID_REPORT_BITS(HID_TOUCH_CONTACT) +
+	HID_REPORT_BITS(HID_TOUCH_CONTACT_COUNT) + HID_REPORT_BITS(HID_TOUCH_SCAN_TIME),
+	"HidTouchReport does not match its report descriptor items");
+_Static_assert(HID_TOUCH_CONTACTS_PER_REPORT <= HID_TOUCH_MAX_CONTACTS,
+	"A report cannot carry more contacts than the device tracks");
+
+/// \brief Report descriptor items of one contact.
+#define TOUCH_CONTACT_COLLECTION \
+	HID_USAGE_PAGE(HID_PAGE_DIGITIZER), \
+	HID_USAGE(HID_DIGITIZER_FINGER), \
+	HID_COLLECTION(HID_LOGICAL_COLLECTION), \
+		HID_REPORT_ITEMS(HID_TOUCH_CONTACT, INPUT) \
+	HID_END_COLLECTION
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_USAGE_PAGE(HID_PAGE_DIGITIZER),
+	HID_USAGE(HID_DIGITIZER_TOUCH_SCREEN),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ID(REPORT_ID_TOUCH),
+
+		// The physical size applies to the coordinates of the contacts (0.1 mm units: cm with exponent -2).
+		HID_UNIT(8, HID_UNIT_CGS_LINEAR | HID_UNIT_LENGTH(1)),
+		HID_UNIT_EXPONENT(0x0E),
+		HID_PHYSICAL_MINIMUM(0),
+		HID_PHYSICAL_MAXIMUM(TOUCH_PHYSICAL_MAXIMUM),
+
+		// Note: The count of collections must match HID_TOUCH_CONTACTS_PER_REPORT.
+		TOUCH_CONTACT_COLLECTION,
+		TOUCH_CONTACT_COLLECTION,
+		TOUCH_CONTACT_COLLECTION,
+		TOUCH_CONTACT_COLLECTION,
+		TOUCH_CONTACT_COLLECTION,
+
+		HID_UNIT(8, HID_UNIT_NONE),
+		HID_UNIT_EXPONENT(0),
+		HID_PHYSICAL_MAXIMUM(0),
+		HID_REPORT_ITEMS(HID_TOUCH_CONTACT_COUNT, INPUT)
+
+		// Scan time is in seconds with exponent -4 (100 us units).
+		HID_UNIT(16, HID_UNIT_CGS_LINEAR | HID_UNIT_TIME(1)),
+		HID_UNIT_EXPONENT(0x0C),
+		HID_REPORT_ITEMS(HID_TOUCH_SCAN_TIME, INPUT)
+
+		HID_UNIT(8, HID_UNIT_NONE),
+		HID_UNIT_EXPONENT(0),
+		HID_REPORT_ITEMS_WITH_ID(REPORT_ID_CONTACT_COUNT_MAXIMUM, HID_TOUCH_CONTACT_COUNT_MAXIMUM, FEATURE)
+	HID_END_COLLECTION
+};
+
+_Static_assert(HID_TOUCH_CONTACTS_PER_REPORT == 5, "The report descriptor lists 5 contact collections");
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_hid_descriptor;
+	UsbEndpointDescriptor usb_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_HID,
+		.bInterfaceSubClass     = USB_HID_SUBCLASS_NONBOOT,
+		.bInterfaceProtocol     = USB_HID_PROTO_NONBOOT,
+		.iInterface             = 0
+	},
+    .usb_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0111,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    },
+    .usb_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidTouchReport),
+        .bInterval              = HID_TOUCH_POLLING_INTERVAL
+    }
+};
+
+/// \brief The number of the digitizer interrupt IN endpoint.
+#define TOUCH_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+static const HidTouchContactCountMaximumReport contact_count_maximum_report = {
+	.report_id = REPORT_ID_CONTACT_COUNT_MAXIMUM,
+	.report = { .contact_count_maximum = HID_TOUCH_MAX_CONTACTS }
+};
+
+/// \brief The reports waiting to be written to the endpoint (the head one may be in the TxFIFO).
+static HidTouchReport report_queue[HID_TOUCH_QUEUE_LENGTH];
+static uint8_t report_queue_head;
+static uint8_t report_queue_count;
+/// \brief The last report written to the endpoint (returned by GET_REPORT).
+static HidTouchReport last_report;
+/// \brief Whether a report is in the TxFIFO waiting for the host to collect it.
+static bool endpoint_busy;
+/// \brief Whether the endpoint is configured (reports are queued until it is).
+static bool endpoint_configured;
+
+/// \brief The scan time of the last frame (100 us units).
+static uint16_t scan_time;
+/// \brief Cycle counter value that corresponds to `scan_time`.
+static uint32_t scan_timestamp;
+
+/// \brief Frames pushed, frames dropped (queue full) and reports sent since the statistics were last logged.
+static uint32_t pushed_frames, dropped_frames, sent_reports;
+/// \brief Frames since the statistics were last logged.
+static uint16_t statistics_frames;
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	if (report_type == USB_HID_REPORT_FEATURE && report_id == REPORT_ID_CONTACT_COUNT_MAXIMUM)
+	{
+		*report = &contact_count_maximum_report;
+		return sizeof(contact_count_maximum_report);
+	}
+
+	if (report_type == USB_HID_REPORT_IN && report_id == REPORT_ID_TOUCH)
+	{
+		*report = &last_report;
+		return sizeof(last_report);
+	}
+
+	return 0;
+}
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.get_report = &get_report
+};
+
+/** \brief Writes the report at the head of the queue, if the endpoint is free.
+ */
+static void write_next_report()
+{
+	if (!endpoint_configured || endpoint_busy || report_queue_count == 0)
+		return;
+
+	last_report = report_queue[report_queue_head];
+
+	usb_driver.write_packet(
+		TOUCH_ENDPOINT_NUMBER,
+		&last_report,
+		sizeof(last_report)
+	);
+
+	endpoint_busy = true;
+}
+
+/** \brief Advances the scan time to now (in 100 us units, keeping the remainder for the next frame).
+ */
+static uint16_t update_scan_time()
+{
+	uint32_t const cycles_per_unit = SystemCoreClock / 10000;
+	uint32_t units = (cycle_counter_now() - scan_timestamp) / cycles_per_unit;
+
+	scan_time += units;
+	scan_timestamp += units * cycles_per_unit;
+
+	return scan_time;
+}
+
+/** \brief Queues the contacts of one touch frame.
+ * \details The contacts are batched into as few reports as possible (\ref HID_TOUCH_CONTACTS_PER_REPORT per
+ * report). The first report of the frame carries the count of contacts, the others a count of 0 (hybrid mode).
+ * \param contacts The contacts of the frame, including the ones lifted since the previous frame.
+ * \param contact_count Count of `contacts` (up to \ref HID_TOUCH_MAX_CONTACTS).
+ * \returns false if the queue has no room for the whole frame (the frame is dropped).
+ */
+bool usbd_hid_touch_push_frame(HidTouchContactState const *contacts, uint8_t contact_count)
+{
+	contact_count = MIN(contact_count, HID_TOUCH_MAX_CONTACTS);
+	uint8_t report_count = (contact_count + HID_TOUCH_CONTACTS_PER_REPORT - 1) / HID_TOUCH_CONTACTS_PER_REPORT;
+
+	if (report_queue_count + report_count > HID_TOUCH_QUEUE_LENGTH)
+	{
+		dropped_frames++;
+		return false;
+	}
+
+	uint16_t frame_scan_time = update_scan_time();
+
+	for (uint8_t i = 0; i < report_count; i++)
+	{
+		HidTouchReport *report = &report_queue[(report_queue_head + report_queue_count) % HID_TOUCH_QUEUE_LENGTH];
+		uint8_t batch_count = MIN(contact_count - i * HID_TOUCH_CONTACTS_PER_REPORT, HID_TOUCH_CONTACTS_PER_REPORT);
+
+		// The unused contact slots stay zeroed (tip switch released, ignored by the host).
+		*report = (HidTouchReport) {
+			.report_id = REPORT_ID_TOUCH,
+			.contact_count = i == 0 ? contact_count : 0,
+			.scan_time = frame_scan_time
+		};
+
+		for (uint8_t j = 0; j < batch_count; j++)
+		{
+			HidTouchContactState const *contact = &contacts[i * HID_TOUCH_CONTACTS_PER_REPORT + j];
+
+			report->contacts[j] = (HidTouchContact) {
+				.tip_switch = contact->touching,
+				.contact_id = contact->id,
+				.x = MIN(contact->x, HID_TOUCH_LOGICAL_MAXIMUM),
+				.y = MIN(contact->y, HID_TOUCH_LOGICAL_MAXIMUM)
+			};
+		}
+
+		report_queue_count++;
+	}
+
+	pushed_frames++;
+	write_next_report();
+	return true;
+}
+
+static void reset()
+{
+	endpoint_configured = false;
+	endpoint_busy = false;
+	report_queue_head = 0;
+	report_queue_count = 0;
+	usbd_hid_reset(&hid_interface, 0);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		TOUCH_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_endpoint_descriptor.wMaxPacketSize
+	);
+
+	endpoint_busy = false;
+	endpoint_configured = true;
+	scan_time = 0;
+	scan_timestamp = cycle_counter_now();
+	pushed_frames = dropped_frames = sent_reports = 0;
+	statistics_frames = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number != TOUCH_ENDPOINT_NUMBER)
+		return;
+
+	report_queue_head = (report_queue_head + 1) % HID_TOUCH_QUEUE_LENGTH;
+	report_queue_count--;
+	sent_reports++;
+	endpoint_busy = false;
+
+	write_next_report();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++statistics_frames < TOUCH_STATISTICS_REPORT_PERIOD)
+		return;
+
+	if (pushed_frames != 0)
+	{
+		log_info("Touch: %lu frames in %lu reports (%lu dropped).", pushed_frames, sent_reports, dropped_frames);
+	}
+
+	pushed_frames = dropped_frames = sent_reports = 0;
+	statistics_frames = 0;
+}
+
+const UsbClass usbd_hid_touch_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed
+};
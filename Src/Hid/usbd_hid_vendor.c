@@ -0,0 +1,387 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Hid/usbd_hid_vendor.h"
+#include "Hid/usbd_hid.h"
+#include "Hid/usb_hid_standards.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/latency.h"
+
+/// \brief Count of frames between two logs of the pipe throughput.
+#define VENDOR_THROUGHPUT_REPORT_PERIOD 1000
+/// \brief Count of round trips after which the turnaround distribution is logged.
+#define VENDOR_LATENCY_REPORT_PERIOD 1000
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13AD,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+/// \brief Layout of the vendor input report (device to host).
+#define HID_VENDOR_INPUT_REPORT(FIELD) \
+	FIELD(ARRAY, data, uint8_t, HID_VENDOR_REPORT_SIZE, HID_PAGE_VENDOR, 0x01, 0x01, 0, 255, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/// \brief Layout of the vendor output report (host to device).
+#define HID_VENDOR_OUTPUT_REPORT(FIELD) \
+	FIELD(ARRAY, data, uint8_t, HID_VENDOR_REPORT_SIZE, HID_PAGE_VENDOR, 0x02, 0x02, 0, 255, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+HID_REPORT_STRUCT(HidVendorPipeReport, HID_VENDOR_INPUT_REPORT);
+HID_REPORT_ASSERTS(HidVendorPipeReport, HID_VENDOR_INPUT_REPORT);
+HID_REPORT_ASSERTS(HidVendorPipeReport, HID_VENDOR_OUTPUT_REPORT);
+
+static const uint8_t hid_report_descriptor[] = {
+	HID_RI_USAGE_PAGE(16, HID_PAGE_VENDOR),
+	HID_USAGE(0x01),
+	HID_COLLECTION(HID_APPLICATION_COLLECTION),
+		HID_REPORT_ITEMS(HID_VENDOR_INPUT_REPORT, INPUT)
+		HID_REPORT_ITEMS(HID_VENDOR_OUTPUT_REPORT, OUTPUT)
+	HID_END_COLLECTION
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbHidDescriptor usb_hid_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_HID,
+		.bInterfaceSubClass     = USB_HID_SUBCLASS_NONBOOT,
+		.bInterfaceProtocol     = USB_HID_PROTO_NONBOOT,
+		.iInterface             = 0
+	},
+    .usb_hid_descriptor = {
+        .bLength                = sizeof(UsbHidDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_HID,
+        .bcdHID                 = 0x0111,
+        .bCountryCode           = USB_HID_COUNTRY_NONE,
+        .bNumDescriptors        = 1,
+        .bDescriptorType0       = USB_DESCRIPTOR_TYPE_HID_REPORT,
+        .wDescriptorLength0     = sizeof(hid_report_descriptor)
+    },
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidVendorPipeReport),
+        .bInterval              = HID_VENDOR_POLLING_INTERVAL
+    },
+    .usb_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = sizeof(HidVendorPipeReport),
+        .bInterval              = HID_VENDOR_POLLING_INTERVAL
+    }
+};
+
+/// \brief The number of the interrupt IN endpoint.
+#define VENDOR_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+/// \brief The number of the interrupt OUT endpoint.
+#define VENDOR_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/** \brief An input report waiting in the queue.
+ */
+typedef struct {
+	HidVendorPipeReport report;
+	/// \brief Whether the report answers an output report (its turnaround is measured).
+	bool is_response;
+	/// \brief Cycle counter value when the output report it answers was received.
+	uint32_t request_timestamp;
+} VendorQueuedReport;
+
+/// \brief The input reports waiting to be written to the endpoint (the head one may be in the TxFIFO).
+static VendorQueuedReport input_queue[HID_VENDOR_QUEUE_LENGTH];
+static uint8_t input_queue_head;
+static uint8_t input_queue_count;
+/// \brief The last input report written to the endpoint (returned by GET_REPORT).
+static HidVendorPipeReport last_input_report;
+/// \brief Whether an input report is in the TxFIFO waiting for the host to collect it.
+static bool endpoint_busy;
+/// \brief Whether the endpoint is configured (reports are queued until it is).
+static bool endpoint_configured;
+/// \brief Whether the OUT endpoint NAKs the host because the input queue is full.
+static bool out_nak;
+/// \brief Receives the output reports (from the interrupt OUT endpoint or SET_REPORT).
+static void (*vendor_receiver)(void const *data, uint16_t size);
+/// \brief Buffer of the output reports (also receives the data stage of SET_REPORT).
+static HidVendorPipeReport output_report __attribute__((aligned(4)));
+/// \brief Whether an output report is being processed (the input reports sent meanwhile answer it).
+static bool processing_request;
+/// \brief Cycle counter value when the output report being processed was received.
+static uint32_t request_timestamp;
+
+/// \brief Time from the reception of an output report to the collection of the input report that answers it.
+static LatencyStatistics turnaround_latency;
+/// \brief Bytes received and sent since the throughput was last logged.
+static uint32_t received_bytes, sent_bytes;
+/// \brief Frames since the throughput was last logged.
+static uint16_t throughput_frames;
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report);
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size);
+
+static UsbHidInterface hid_interface = {
+	.interface_number = 0,
+	.hid_descriptor = &configuration_descriptor_combination.usb_hid_descriptor,
+	.report_descriptor = hid_report_descriptor,
+	.report_descriptor_size = sizeof(hid_report_descriptor),
+	.get_report = &get_report,
+	.set_report = &set_report,
+	.set_report_buffer = &output_report,
+	.set_report_buffer_size = sizeof(output_report)
+};
+
+/** \brief Writes the input report at the head of the queue, if the endpoint is free.
+ */
+static void write_next_report()
+{
+	if (!endpoint_configured || endpoint_busy || input_queue_count == 0)
+		return;
+
+	last_input_report = input_queue[input_queue_head].report;
+
+	usb_driver.write_packet(
+		VENDOR_IN_ENDPOINT_NUMBER,
+		&last_input_report,
+		sizeof(last_input_report)
+	);
+
+	endpoint_busy = true;
+}
+
+/** \brief Queues an input report; it is written as soon as the endpoint is free (not on the next SOF).
+ * \param data The payload (padded with zeros to \ref HID_VENDOR_REPORT_SIZE bytes).
+ * \param size Size of the payload in bytes.
+ * \returns false if the queue is full.
+ * \note When called from the receiver, the report is the response to the received output report.
+ */
+bool usbd_hid_vendor_send(void const *data, uint16_t size)
+{
+	if (input_queue_count == HID_VENDOR_QUEUE_LENGTH)
+		return false;
+
+	VendorQueuedReport *queued_report = &input_queue[(input_queue_head + input_queue_count) % HID_VENDOR_QUEUE_LENGTH];
+
+	size = MIN(size, sizeof(queued_report->report.data));
+	memcpy(queued_report->report.data, data, size);
+	memset(queued_report->report.data + size, 0, sizeof(queued_report->report.data) - size);
+
+	queued_report->is_response = processing_request;
+	queued_report->request_timestamp = request_timestamp;
+	// Only the first report sent by the receiver answers the request.
+	processing_request = false;
+
+	input_queue_count++;
+	write_next_report();
+	return true;
+}
+
+/** \brief Registers the callback that receives the output reports.
+ * \param receiver Function that processes the payload; it can answer with `usbd_hid_vendor_send()`.
+ * \note Without a receiver, the output reports are sent back (loopback for round trip benchmarks, see
+ * host/vendor_hid_benchmark.cpp).
+ */
+void usbd_hid_vendor_set_receiver(void (*receiver)(void const *data, uint16_t size))
+{
+	vendor_receiver = receiver;
+}
+
+/** \brief Passes an output report to the receiver.
+ */
+static void process_output_report(uint16_t size)
+{
+	request_timestamp = cycle_counter_now();
+	processing_request = true;
+	received_bytes += size;
+
+	if (vendor_receiver != NULL)
+	{
+		vendor_receiver(output_report.data, size);
+	}
+	else if (!usbd_hid_vendor_send(output_report.data, size))
+	{
+		// Note: Only SET_REPORT can get here, the OUT endpoint NAKs while the queue is full.
+		log_error("Vendor loopback report dropped (queue is full).");
+	}
+
+	processing_request = false;
+}
+
+static uint16_t get_report(uint8_t report_type, uint8_t report_id, void const **report)
+{
+	if (report_type != USB_HID_REPORT_IN)
+		return 0;
+
+	*report = &last_input_report;
+	return sizeof(last_input_report);
+}
+
+static void set_report(uint8_t report_type, uint8_t report_id, void const *report, uint16_t size)
+{
+	// SET_REPORT is the fallback of the interrupt OUT endpoint (e.g. hosts that only use EP0).
+	if (report_type == USB_HID_REPORT_OUT)
+	{
+		process_output_report(size);
+	}
+}
+
+static void reset()
+{
+	endpoint_configured = false;
+	endpoint_busy = false;
+	out_nak = false;
+	input_queue_head = 0;
+	input_queue_count = 0;
+	usbd_hid_reset(&hid_interface, 0);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		VENDOR_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		VENDOR_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// Note: The queue may already be full of the reports sent before the configuration.
+	out_nak = input_queue_count == HID_VENDOR_QUEUE_LENGTH;
+	usb_driver.set_out_endpoint_nak(VENDOR_OUT_ENDPOINT_NUMBER, out_nak);
+
+	endpoint_busy = false;
+	endpoint_configured = true;
+	latency_reset(&turnaround_latency);
+	received_bytes = sent_bytes = 0;
+	throughput_frames = 0;
+
+	// Note: The reports queued before the configuration are sent now (not on the next usbd_hid_vendor_send).
+	write_next_report();
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	return usbd_hid_process_request(&hid_interface, request);
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	usbd_hid_process_control_data(&hid_interface, request);
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	if (endpoint_number != VENDOR_OUT_ENDPOINT_NUMBER)
+		return;
+
+	// Note: The packet cannot be larger than the maximum packet size of the endpoint (the size of the report).
+	usb_driver.read_packet(&output_report, byte_count);
+	process_output_report(byte_count);
+
+	// The host waits until the queue has room for the answer of its next output report.
+	if (input_queue_count == HID_VENDOR_QUEUE_LENGTH)
+	{
+		usb_driver.set_out_endpoint_nak(VENDOR_OUT_ENDPOINT_NUMBER, true);
+		out_nak = true;
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number != VENDOR_IN_ENDPOINT_NUMBER)
+		return;
+
+	VendorQueuedReport *sent_report = &input_queue[input_queue_head];
+
+	if (sent_report->is_response)
+	{
+		latency_record(&turnaround_latency, sent_report->request_timestamp, cycle_counter_now());
+
+		if (turnaround_latency.count == VENDOR_LATENCY_REPORT_PERIOD)
+		{
+			latency_log("Vendor pipe turnaround", &turnaround_latency);
+			latency_reset(&turnaround_latency);
+		}
+	}
+
+	sent_bytes += sizeof(sent_report->report);
+	input_queue_head = (input_queue_head + 1) % HID_VENDOR_QUEUE_LENGTH;
+	input_queue_count--;
+	endpoint_busy = false;
+
+	if (out_nak)
+	{
+		usb_driver.set_out_endpoint_nak(VENDOR_OUT_ENDPOINT_NUMBER, false);
+		out_nak = false;
+	}
+
+	write_next_report();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++throughput_frames < VENDOR_THROUGHPUT_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are bytes per second.
+	if (received_bytes != 0 || sent_bytes != 0)
+	{
+		log_info("Vendor pipe throughput: %lu B/s OUT, %lu B/s IN.", received_bytes, sent_bytes);
+	}
+
+	received_bytes = sent_bytes = 0;
+	throughput_frames = 0;
+}
+
+const UsbClass usbd_hid_vendor_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received
+};
@@ -0,0 +1,87 @@
+#include "stm32f4xx.h"
+#include "Logic/logic_gpio.h"
+
+_Static_assert(LOGIC_CLOCK_HZ == 72000000, "TIM1 runs at 72 MHz (APB2 is not divided)");
+
+/// \brief Count of laps of the buffer the DMA completed (written by the interrupt).
+static volatile uint32_t laps;
+static uint16_t buffer_size;
+
+/** \brief The DMA wrapped around the buffer.
+ * \note This is the only interrupt of the acquisition (one per lap, not per sample); it only counts.
+ */
+void DMA2_Stream5_IRQHandler()
+{
+	if (READ_BIT(DMA2->HISR, DMA_HISR_TCIF5))
+	{
+		WRITE_REG(DMA2->HIFCR, DMA_HIFCR_CTCIF5);
+		laps++;
+	}
+}
+
+static void start(uint8_t *buffer, uint16_t size, uint16_t sample_period)
+{
+	SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOEEN | RCC_AHB1ENR_DMA2EN);
+	SET_BIT(RCC->APB2ENR, RCC_APB2ENR_TIM1EN);
+
+	// PE0 to PE7 are inputs (the reset state), with pull-downs so that open inputs read low.
+	MODIFY_REG(GPIOE->MODER, 0xFFFF, 0);
+	MODIFY_REG(GPIOE->PUPDR, 0xFFFF, 0xAAAA);
+
+	// DMA2 stream 5 (channel 6: TIM1_UP) copies one byte per request, in circular mode.
+	CLEAR_BIT(DMA2_Stream5->CR, DMA_SxCR_EN);
+	while (READ_BIT(DMA2_Stream5->CR, DMA_SxCR_EN));
+	WRITE_REG(DMA2->HIFCR, DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5);
+	WRITE_REG(DMA2_Stream5->PAR, (uint32_t)&GPIOE->IDR);
+	WRITE_REG(DMA2_Stream5->M0AR, (uint32_t)buffer);
+	WRITE_REG(DMA2_Stream5->NDTR, size);
+	buffer_size = size;
+	laps = 0;
+	WRITE_REG(DMA2_Stream5->CR,
+		_VAL2FLD(DMA_SxCR_CHSEL, 6) | _VAL2FLD(DMA_SxCR_PL, 3) | DMA_SxCR_CIRC | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_EN
+	);
+	NVIC_EnableIRQ(DMA2_Stream5_IRQn);
+
+	// TIM1 requests a DMA transfer on each update, every `sample_period` ticks.
+	WRITE_REG(TIM1->PSC, 0);
+	WRITE_REG(TIM1->ARR, sample_period - 1);
+	WRITE_REG(TIM1->EGR, TIM_EGR_UG);
+	WRITE_REG(TIM1->DIER, TIM_DIER_UDE);
+	SET_BIT(TIM1->CR1, TIM_CR1_CEN);
+}
+
+static void stop()
+{
+	CLEAR_BIT(TIM1->CR1, TIM_CR1_CEN);
+	CLEAR_BIT(TIM1->DIER, TIM_DIER_UDE);
+	NVIC_DisableIRQ(DMA2_Stream5_IRQn);
+	CLEAR_BIT(DMA2_Stream5->CR, DMA_SxCR_EN);
+}
+
+static uint32_t written_samples()
+{
+	uint32_t count;
+	uint16_t remaining;
+
+	// Reads the two values again if the interrupt came in between.
+	do
+	{
+		count = laps;
+		remaining = READ_REG(DMA2_Stream5->NDTR);
+	} while (count != laps);
+
+	// The DMA wrapped around but the interrupt did not run yet (e.g. it is disabled by the caller).
+	if (READ_BIT(DMA2->HISR, DMA_HISR_TCIF5) && remaining > buffer_size / 2)
+	{
+		count++;
+	}
+
+	return count * buffer_size + (buffer_size - remaining);
+}
+
+const LogicSource logic_gpio = {
+	.min_sample_period = 9,
+	.start = &start,
+	.stop = &stop,
+	.written_samples = &written_samples
+};
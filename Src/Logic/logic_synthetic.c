@@ -0,0 +1,65 @@
+#include "stdbool.h"
+#include "Logic/logic_synthetic.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/math.h"
+
+_Static_assert(LOGIC_CLOCK_HZ == 72000000, "The cycle counter is the clock of the sample periods");
+
+static uint8_t *sample_buffer;
+static uint16_t buffer_size;
+static uint16_t period;
+static bool running;
+/// \brief Clock of the next sample to produce.
+static uint32_t sample_timestamp;
+/// \brief Count of samples produced since the start.
+static uint32_t sample_index;
+
+static void start(uint8_t *buffer, uint16_t size, uint16_t sample_period)
+{
+	sample_buffer = buffer;
+	buffer_size = size;
+	period = sample_period;
+	sample_timestamp = cycle_counter_now();
+	sample_index = 0;
+	running = true;
+}
+
+static void stop()
+{
+	running = false;
+}
+
+static uint32_t written_samples()
+{
+	return sample_index;
+}
+
+/** \brief Produces the samples due since the last poll.
+ * \details The clock of the next sample moves by whole samples, so the rate does not drift however often the source
+ * is polled; a late poll produces all the samples it missed (only the last lap of the buffer is written, the rest
+ * would be overwritten anyway).
+ */
+static void poll()
+{
+	if (!running)
+		return;
+
+	uint32_t due = (cycle_counter_now() - sample_timestamp) / period;
+	uint32_t skipped = due - MIN(due, buffer_size);
+
+	sample_timestamp += due * period;
+	sample_index += skipped;
+
+	for (uint32_t i = skipped; i < due; i++, sample_index++)
+	{
+		sample_buffer[sample_index % buffer_size] = logic_synthetic_sample(sample_index);
+	}
+}
+
+const LogicSource logic_synthetic = {
+	.min_sample_period = LOGIC_CLOCK_HZ / 4000000,
+	.start = &start,
+	.stop = &stop,
+	.written_samples = &written_samples,
+	.poll = &poll
+};
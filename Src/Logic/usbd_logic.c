@@ -0,0 +1,405 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Logic/usbd_logic.h"
+#include "Logic/logic_synthetic.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Count of frames between two logs of the throughput.
+#define LOGIC_REPORT_PERIOD 1000
+/// \brief Longest run counted by one record: two count bytes (so a long idle period still sends a record every
+/// 16384 samples).
+#define LOGIC_RLE_MAX_REPEATS ((1 << 14) - 1)
+/// \brief Largest record: a sample and two count bytes.
+#define LOGIC_RLE_MAX_RECORD_SIZE 3
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_VENDOR,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13BB,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_VENDOR,
+		.bInterfaceSubClass     = USB_SUBCLASS_VENDOR,
+		.bInterfaceProtocol     = USB_PROTOCOL_VENDOR,
+		.iInterface             = 0
+	},
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = LOGIC_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+#define LOGIC_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+_Static_assert((LOGIC_BUFFER_SIZE & (LOGIC_BUFFER_SIZE - 1)) == 0, "The sample counts wrap around at a multiple of the buffer");
+_Static_assert(LOGIC_BUFFER_SIZE <= 0xFFFF, "The size of the buffer fits the counter of the DMA");
+
+static const LogicVersion version = { .major = 1, .minor = 0 };
+
+static uint8_t sample_buffer[LOGIC_BUFFER_SIZE] __attribute__((aligned(4)));
+static LogicSource const *logic_source = &logic_synthetic;
+
+static bool configured;
+/// \brief The source runs; the stream lasts until the samples it took are all sent.
+static bool running;
+static bool streaming;
+static bool in_busy;
+static uint16_t last_transfer_size;
+static bool compress;
+/// \brief Count of samples taken when the source stopped.
+static uint32_t end_samples;
+
+/// \brief The compressed stream waiting for the endpoint, and the run being counted.
+static uint8_t rle_buffer[LOGIC_TRANSFER_SIZE] __attribute__((aligned(4)));
+static uint16_t rle_size;
+static bool rle_started;
+static uint8_t rle_sample;
+static uint16_t rle_repeats;
+
+static LogicStatistics statistics;
+/// \brief Statistics at the last log (the log shows the differences).
+static LogicStatistics logged_statistics;
+static uint16_t report_frames;
+static LogicStartCommand start_command;
+
+/** \brief Selects the producer of the samples (the synthetic source by default).
+ * \param source The source (e.g. `logic_gpio`); it takes effect at the next \ref LOGIC_START.
+ */
+void usbd_logic_set_source(LogicSource const *source)
+{
+	logic_source = source;
+}
+
+/** \brief Writes the count of the run (if any) after its sample.
+ */
+static void flush_repeats()
+{
+	for (uint16_t repeats = rle_repeats; repeats != 0; repeats >>= 7)
+	{
+		rle_buffer[rle_size++] = 0x80 | (repeats & 0x7F);
+	}
+
+	rle_repeats = 0;
+}
+
+/** \brief Compresses the samples from the next one to send, until `end` or until the buffer is full.
+ * \note A sample equal to the previous one only adds to the count: a long idle period costs a few bytes.
+ */
+static void compress_samples(uint32_t end)
+{
+	while (statistics.sent_samples != end)
+	{
+		uint8_t sample = sample_buffer[statistics.sent_samples % LOGIC_BUFFER_SIZE] & 0x7F;
+
+		if (rle_started && sample == rle_sample && rle_repeats < LOGIC_RLE_MAX_REPEATS)
+		{
+			rle_repeats++;
+		}
+		else
+		{
+			if (rle_size > LOGIC_TRANSFER_SIZE - LOGIC_RLE_MAX_RECORD_SIZE)
+				return;
+
+			flush_repeats();
+			rle_buffer[rle_size++] = sample;
+			rle_sample = sample;
+			rle_started = true;
+		}
+
+		statistics.sent_samples++;
+	}
+}
+
+static void write_transfer(void const *data, uint16_t size)
+{
+	usb_driver.write_transfer(LOGIC_IN_ENDPOINT_NUMBER, data, size);
+	statistics.sent_bytes += size;
+	last_transfer_size = size;
+	in_busy = true;
+}
+
+/** \brief Writes the next samples to the TxFIFO, as many as available (up to a transfer): the longer the host takes,
+ * the larger the next transfer.
+ * \note While the source runs, only whole packets are sent (the rest waits for more samples): a short packet takes a
+ * slot of the bus for a few bytes, and the bus is the bottleneck.
+ */
+static void transmit(uint32_t written)
+{
+	uint16_t size;
+
+	if (in_busy)
+		return;
+
+	if (compress)
+	{
+		compress_samples(written);
+
+		// The last run is counted once the source stopped.
+		if (!running && statistics.sent_samples == end_samples
+			&& rle_size <= LOGIC_TRANSFER_SIZE - LOGIC_RLE_MAX_RECORD_SIZE)
+		{
+			flush_repeats();
+		}
+
+		// Note: The compressed samples are in the TxFIFO when the call returns: the buffer is free again.
+		size = running ? rle_size - rle_size % LOGIC_PACKET_SIZE : rle_size;
+
+		if (size != 0)
+		{
+			write_transfer(rle_buffer, size);
+			rle_size -= size;
+			memmove(rle_buffer, rle_buffer + size, rle_size);
+			return;
+		}
+	}
+	else
+	{
+		// The transfer stops at the end of the buffer: the samples go to the TxFIFO straight from where the source
+		// put them.
+		size = MIN(MIN(written - statistics.sent_samples, LOGIC_TRANSFER_SIZE),
+			LOGIC_BUFFER_SIZE - statistics.sent_samples % LOGIC_BUFFER_SIZE);
+
+		if (running)
+		{
+			size -= size % LOGIC_PACKET_SIZE;
+		}
+
+		if (size != 0)
+		{
+			write_transfer(sample_buffer + statistics.sent_samples % LOGIC_BUFFER_SIZE, size);
+			statistics.sent_samples += size;
+			return;
+		}
+	}
+
+	if (running || statistics.sent_samples != end_samples || rle_repeats != 0)
+		return;
+
+	// Everything is sent: a short packet (a ZLP after a full one) ends the stream on the host.
+	if (last_transfer_size % LOGIC_PACKET_SIZE == 0)
+	{
+		usb_driver.write_packet(LOGIC_IN_ENDPOINT_NUMBER, NULL, 0);
+		in_busy = true;
+	}
+
+	streaming = false;
+	log_info("Logic acquisition done: %lu samples in %lu bytes.", statistics.sent_samples, statistics.sent_bytes);
+}
+
+static void stop()
+{
+	if (!running)
+		return;
+
+	logic_source->stop();
+	end_samples = statistics.written_samples = logic_source->written_samples();
+	running = false;
+}
+
+static void start(LogicStartCommand const *command)
+{
+	uint32_t sample_period = ((command->sample_delay_h << 8) | command->sample_delay_l) + 1;
+
+	if (sample_period < logic_source->min_sample_period || sample_period > 0xFFFF)
+	{
+		log_error("Logic sample rate of %lu Hz not supported.", LOGIC_CLOCK_HZ / sample_period);
+		return;
+	}
+
+	if (running)
+	{
+		logic_source->stop();
+		running = false;
+	}
+
+	if (in_busy)
+	{
+		usb_driver.stop_in_endpoint(LOGIC_IN_ENDPOINT_NUMBER);
+		in_busy = false;
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	statistics.sample_rate = LOGIC_CLOCK_HZ / sample_period;
+	logged_statistics = statistics;
+	compress = (command->flags & LOGIC_START_FLAGS_RLE) != 0;
+	rle_size = 0;
+	rle_started = false;
+	rle_repeats = 0;
+	last_transfer_size = 0;
+
+	logic_source->start(sample_buffer, LOGIC_BUFFER_SIZE, sample_period);
+	running = streaming = true;
+	log_info("Logic acquisition started (%lu samples/s%s).", statistics.sample_rate, compress ? ", compressed" : "");
+}
+
+static void reset()
+{
+	stop();
+	streaming = false;
+	configured = false;
+	in_busy = false;
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		LOGIC_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// The largest transfer goes into the TxFIFO at once.
+	usb_driver.configure_txfifo_size(LOGIC_IN_ENDPOINT_NUMBER, LOGIC_TRANSFER_SIZE);
+
+	in_busy = false;
+	report_frames = 0;
+	configured = true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIPIENT_DEVICE))
+		return false;
+
+	switch (request->bRequest)
+	{
+	case LOGIC_GET_VERSION:
+		usbd_control_send(&version, MIN(sizeof(version), request->wLength));
+		return true;
+	case LOGIC_START:
+		if (request->wLength != sizeof(start_command))
+			return false;
+
+		usbd_control_receive(&start_command, sizeof(start_command));
+		return true;
+	case LOGIC_STOP:
+		stop();
+		usbd_control_acknowledge();
+		return true;
+	case LOGIC_GET_STATISTICS:
+		if (running)
+		{
+			statistics.written_samples = logic_source->written_samples();
+		}
+
+		usbd_control_send(&statistics, MIN(sizeof(statistics), request->wLength));
+		return true;
+	}
+
+	return false;
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	if (request->bRequest == LOGIC_START)
+	{
+		start(&start_command);
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	in_busy = false;
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++report_frames < LOGIC_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the differences are per second.
+	if (running)
+	{
+		log_info("Logic: %lu samples/s sent in %lu B/s.",
+			statistics.sent_samples - logged_statistics.sent_samples, statistics.sent_bytes - logged_statistics.sent_bytes);
+	}
+
+	logged_statistics = statistics;
+	report_frames = 0;
+}
+
+static void polled()
+{
+	uint32_t written;
+
+	if (!configured || !streaming)
+		return;
+
+	if (running)
+	{
+		if (logic_source->poll != NULL)
+		{
+			logic_source->poll();
+		}
+
+		written = statistics.written_samples = logic_source->written_samples();
+
+		// The source may overwrite the samples of the next transfer while they are written to the TxFIFO: the stream
+		// ends before (at the last sample that is still intact).
+		if (written - statistics.sent_samples > LOGIC_BUFFER_SIZE - LOGIC_TRANSFER_SIZE)
+		{
+			logic_source->stop();
+			running = false;
+			end_samples = statistics.sent_samples;
+			statistics.overrun = 1;
+			log_error("Logic acquisition stopped: the host fell behind (%lu samples sent).", statistics.sent_samples);
+		}
+	}
+
+	transmit(running ? written : end_samples);
+}
+
+const UsbClass usbd_logic_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_poll = &polled
+};
@@ -0,0 +1,188 @@
+#include "stddef.h"
+#include "Midi/midi_stream.h"
+
+/// \brief Count of MIDI bytes in an event packet of each Code Index Number (0: reserved).
+static const uint8_t event_lengths[16] = { 0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1 };
+
+/** \brief Returns the length of the message that starts with a status byte (0 for the undefined ones).
+ */
+static uint8_t message_length(uint8_t status)
+{
+	if (status < 0xF0)
+		return (status & 0xE0) == 0xC0 ? 2 : 3;
+
+	switch (status)
+	{
+	case 0xF1:
+	case 0xF3:
+		return 2;
+	case 0xF2:
+		return 3;
+	case 0xF6:
+		return 1;
+	}
+
+	return 0;
+}
+
+/** \brief Returns the Code Index Number of a complete message (not a system exclusive one).
+ */
+static uint8_t message_code_index(uint8_t status, uint8_t length)
+{
+	if (status < 0xF0)
+		return status >> 4;
+
+	return length == 1 ? USB_MIDI_CIN_SYSEX_END_1 : length;
+}
+
+static void emit(MidiStreamEncoder *encoder, uint8_t code_index, UsbMidiEventPacket *event)
+{
+	event->header = (encoder->cable << 4) | code_index;
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		event->midi[i] = i < encoder->length ? encoder->message[i] : 0;
+	}
+
+	encoder->length = 0;
+}
+
+/** \brief Resets the state of the parser (a message in progress is dropped).
+ * \param cable The cable number of the events (0 - 15).
+ */
+void midi_stream_encoder_reset(MidiStreamEncoder *encoder, uint8_t cable)
+{
+	encoder->cable = cable;
+	encoder->running_status = 0;
+	encoder->length = 0;
+	encoder->expected_length = 0;
+	encoder->sysex = false;
+}
+
+/** \brief Parses the next byte of the stream.
+ * \param byte The byte.
+ * \param event Receives the event packet the byte completes.
+ * \returns true if an event packet is complete.
+ * \note Data bytes without a status (and no running status) and the undefined status bytes are ignored.
+ */
+bool midi_stream_encode(MidiStreamEncoder *encoder, uint8_t byte, UsbMidiEventPacket *event)
+{
+	// Real time messages go out at once, without touching the message in progress.
+	if (byte >= 0xF8)
+	{
+		event->header = (encoder->cable << 4) | USB_MIDI_CIN_SINGLE_BYTE;
+		event->midi[0] = byte;
+		event->midi[1] = event->midi[2] = 0;
+		return true;
+	}
+
+	if (byte == 0xF7)
+	{
+		if (!encoder->sysex)
+			return false;
+
+		encoder->message[encoder->length++] = byte;
+		encoder->sysex = false;
+		emit(encoder, USB_MIDI_CIN_SYSEX_END_1 + encoder->length - 1, event);
+		return true;
+	}
+
+	if (byte >= 0x80)
+	{
+		// Any other status byte ends a system exclusive message (its unterminated end is dropped).
+		encoder->sysex = byte == 0xF0;
+		encoder->message[0] = byte;
+		encoder->length = 1;
+		encoder->expected_length = encoder->sysex ? 0 : message_length(byte);
+
+		// System messages cancel the running status.
+		encoder->running_status = byte < 0xF0 ? byte : 0;
+
+		if (encoder->expected_length == 1)
+		{
+			emit(encoder, USB_MIDI_CIN_SYSEX_END_1, event);
+			encoder->expected_length = 0;
+			return true;
+		}
+
+		if (encoder->expected_length == 0 && !encoder->sysex)
+		{
+			encoder->length = 0;
+		}
+
+		return false;
+	}
+
+	if (encoder->sysex)
+	{
+		encoder->message[encoder->length++] = byte;
+
+		if (encoder->length < 3)
+			return false;
+
+		emit(encoder, USB_MIDI_CIN_SYSEX_START, event);
+		return true;
+	}
+
+	if (encoder->length == 0)
+	{
+		if (encoder->running_status == 0)
+			return false;
+
+		// Running status: the data bytes of another message with the same status.
+		encoder->message[0] = encoder->running_status;
+		encoder->length = 1;
+		encoder->expected_length = message_length(encoder->running_status);
+	}
+
+	encoder->message[encoder->length++] = byte;
+
+	if (encoder->length < encoder->expected_length)
+		return false;
+
+	emit(encoder, message_code_index(encoder->message[0], encoder->expected_length), event);
+	return true;
+}
+
+/** \brief Resets the state of the decoder (the next channel message is sent with its status).
+ * \param use_running_status Whether the status of channel messages is left out when it repeats (fewer bytes on a
+ * serial link).
+ */
+void midi_stream_decoder_reset(MidiStreamDecoder *decoder, bool use_running_status)
+{
+	decoder->running_status = 0;
+	decoder->use_running_status = use_running_status;
+}
+
+/** \brief Returns the MIDI bytes of an event packet.
+ * \param event The event packet.
+ * \param bytes Receives the bytes.
+ * \returns The count of bytes (0 for the reserved Code Index Numbers).
+ */
+uint8_t midi_stream_decode(MidiStreamDecoder *decoder, UsbMidiEventPacket const *event, uint8_t bytes[3])
+{
+	uint8_t const code_index = event->header & 0x0F;
+	uint8_t length = event_lengths[code_index];
+	uint8_t first = 0;
+
+	if (code_index >= 0x8 && code_index <= 0xE)
+	{
+		if (decoder->use_running_status && event->midi[0] == decoder->running_status)
+		{
+			first = 1;
+		}
+
+		decoder->running_status = event->midi[0];
+	}
+	else if (length != 0 && event->midi[0] < 0xF8)
+	{
+		decoder->running_status = 0;
+	}
+
+	for (uint8_t i = first; i < length; i++)
+	{
+		bytes[i - first] = event->midi[i];
+	}
+
+	return length - first;
+}
@@ -0,0 +1,519 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Midi/usbd_midi.h"
+#include "Midi/midi_stream.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/ring_buffer.h"
+
+/// \brief Count of frames between two logs of the statistics.
+#define MIDI_REPORT_PERIOD 1000
+
+_Static_assert(sizeof(UsbMidiEventPacket) == 4, "An event packet is 4 bytes");
+_Static_assert(MIDI_PACKET_SIZE % sizeof(UsbMidiEventPacket) == 0 && MIDI_BUFFER_SIZE % MIDI_PACKET_SIZE == 0,
+	"The packets and the ring buffers hold whole events");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B6,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbMidiStreamingHeaderDescriptor header;
+	UsbMidiInJackDescriptor embedded_in_jack;
+	UsbMidiInJackDescriptor external_in_jack;
+	UsbMidiOutJackDescriptor embedded_out_jack;
+	UsbMidiOutJackDescriptor external_out_jack;
+	UsbAudioEndpointDescriptor out_endpoint;
+	UsbMidiStreamingEndpointDescriptor out_streaming_endpoint;
+	UsbAudioEndpointDescriptor in_endpoint;
+	UsbMidiStreamingEndpointDescriptor in_streaming_endpoint;
+} __attribute__((__packed__)) UsbMidiStreamingDescriptors;
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_control_interface_descriptor;
+	UsbMidiAudioControlHeaderDescriptor usb_control_header_descriptor;
+	UsbInterfaceDescriptor usb_streaming_interface_descriptor;
+	UsbMidiStreamingDescriptors usb_streaming_descriptors;
+} UsbConfigurationDescriptorCombination;
+
+#define MIDI_CONTROL_INTERFACE 0
+#define MIDI_STREAMING_INTERFACE 1
+
+/// \brief The host sends to the embedded IN jack, which is played on the external OUT jack (the MIDI OUT connector).
+#define MIDI_EMBEDDED_IN_JACK_ID 1
+#define MIDI_EXTERNAL_IN_JACK_ID 2
+/// \brief The external IN jack (the MIDI IN connector) is sent to the host through the embedded OUT jack.
+#define MIDI_EMBEDDED_OUT_JACK_ID 3
+#define MIDI_EXTERNAL_OUT_JACK_ID 4
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 2,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_control_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = MIDI_CONTROL_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_AUDIO_SUBCLASS_AUDIOCONTROL,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_control_header_descriptor = {
+		.bLength                = sizeof(UsbMidiAudioControlHeaderDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+		.bDescriptorSubtype     = USB_AUDIO_AC_HEADER,
+		.bcdADC                 = 0x0100,
+		.wTotalLength           = sizeof(UsbMidiAudioControlHeaderDescriptor),
+		.bInCollection          = 1,
+		.baInterfaceNr          = MIDI_STREAMING_INTERFACE
+	},
+	.usb_streaming_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = MIDI_STREAMING_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_AUDIO,
+		.bInterfaceSubClass     = USB_MIDI_SUBCLASS_MIDISTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_streaming_descriptors = {
+		.header = {
+			.bLength            = sizeof(UsbMidiStreamingHeaderDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_MIDI_MS_HEADER,
+			.bcdMSC             = 0x0100,
+			.wTotalLength       = sizeof(UsbMidiStreamingDescriptors)
+		},
+		.embedded_in_jack = {
+			.bLength            = sizeof(UsbMidiInJackDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_MIDI_MS_IN_JACK,
+			.bJackType          = USB_MIDI_JACK_EMBEDDED,
+			.bJackID            = MIDI_EMBEDDED_IN_JACK_ID,
+			.iJack              = 0
+		},
+		.external_in_jack = {
+			.bLength            = sizeof(UsbMidiInJackDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_MIDI_MS_IN_JACK,
+			.bJackType          = USB_MIDI_JACK_EXTERNAL,
+			.bJackID            = MIDI_EXTERNAL_IN_JACK_ID,
+			.iJack              = 0
+		},
+		.embedded_out_jack = {
+			.bLength            = sizeof(UsbMidiOutJackDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_MIDI_MS_OUT_JACK,
+			.bJackType          = USB_MIDI_JACK_EMBEDDED,
+			.bJackID            = MIDI_EMBEDDED_OUT_JACK_ID,
+			.bNrInputPins       = 1,
+			.baSourceID         = MIDI_EXTERNAL_IN_JACK_ID,
+			.baSourcePin        = 1,
+			.iJack              = 0
+		},
+		.external_out_jack = {
+			.bLength            = sizeof(UsbMidiOutJackDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_INTERFACE,
+			.bDescriptorSubtype = USB_MIDI_MS_OUT_JACK,
+			.bJackType          = USB_MIDI_JACK_EXTERNAL,
+			.bJackID            = MIDI_EXTERNAL_OUT_JACK_ID,
+			.bNrInputPins       = 1,
+			.baSourceID         = MIDI_EMBEDDED_IN_JACK_ID,
+			.baSourcePin        = 1,
+			.iJack              = 0
+		},
+		.out_endpoint = {
+		    .bLength            = sizeof(UsbAudioEndpointDescriptor),
+		    .bDescriptorType    = USB_DESCRIPTOR_TYPE_ENDPOINT,
+		    .bEndpointAddress   = 0x01,
+		    .bmAttributes       = USB_ENDPOINT_TYPE_BULK,
+		    .wMaxPacketSize     = MIDI_PACKET_SIZE,
+		    .bInterval          = 0,
+		    .bRefresh           = 0,
+		    .bSynchAddress      = 0
+		},
+		.out_streaming_endpoint = {
+			.bLength            = sizeof(UsbMidiStreamingEndpointDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT,
+			.bDescriptorSubtype = USB_MIDI_MS_GENERAL,
+			.bNumEmbMIDIJack    = 1,
+			.baAssocJackID      = MIDI_EMBEDDED_IN_JACK_ID
+		},
+		.in_endpoint = {
+		    .bLength            = sizeof(UsbAudioEndpointDescriptor),
+		    .bDescriptorType    = USB_DESCRIPTOR_TYPE_ENDPOINT,
+		    .bEndpointAddress   = 0x81,
+		    .bmAttributes       = USB_ENDPOINT_TYPE_BULK,
+		    .wMaxPacketSize     = MIDI_PACKET_SIZE,
+		    .bInterval          = 0,
+		    .bRefresh           = 0,
+		    .bSynchAddress      = 0
+		},
+		.in_streaming_endpoint = {
+			.bLength            = sizeof(UsbMidiStreamingEndpointDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_AUDIO_ENDPOINT,
+			.bDescriptorSubtype = USB_MIDI_MS_GENERAL,
+			.bNumEmbMIDIJack    = 1,
+			.baAssocJackID      = MIDI_EMBEDDED_OUT_JACK_ID
+		}
+	}
+};
+
+#define MIDI_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_streaming_descriptors.out_endpoint.bEndpointAddress & 0x0F)
+#define MIDI_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_streaming_descriptors.in_endpoint.bEndpointAddress & 0x0F)
+
+typedef struct
+{
+	/// \brief Events received from the host, and sent to the host.
+	uint32_t received_events, sent_events;
+	/// \brief IN packets sent because they were full, and because their first event reached its deadline.
+	uint32_t full_packets, deadline_packets;
+	/// \brief Events dropped because the receive buffer was full (the host ignored the NAK).
+	uint32_t dropped_events;
+} MidiStatistics;
+
+static uint8_t rx_storage[MIDI_BUFFER_SIZE] __attribute__((aligned(4)));
+static uint8_t tx_storage[MIDI_BUFFER_SIZE] __attribute__((aligned(4)));
+/// \brief Event packets received from the host.
+static RingBuffer rx = { .buffer = rx_storage, .size = sizeof(rx_storage) };
+/// \brief Event packets to send to the host.
+static RingBuffer tx = { .buffer = tx_storage, .size = sizeof(tx_storage) };
+/// \brief Holds the IN packet, and an OUT packet that wraps around the end of `rx`.
+static uint8_t packet[MIDI_PACKET_SIZE] __attribute__((aligned(4)));
+
+static bool configured;
+static bool in_busy;
+/// \brief Whether the OUT endpoint NAKs the host because `rx` is full.
+static bool rx_nak;
+/// \brief Size of the packet in the TxFIFO.
+static uint16_t last_packet_size;
+/// \brief The last frame number, and the frame of the oldest event waiting in `tx`.
+static uint16_t current_frame, first_event_frame;
+/// \brief Whether the events waiting in `tx` go out without waiting for a full packet.
+static bool deadline_reached;
+
+/// \brief Parses the byte stream written by the application, and rebuilds the byte stream read by the application.
+static MidiStreamEncoder encoder;
+static MidiStreamDecoder decoder;
+static void (*midi_receiver)();
+
+static MidiStatistics statistics;
+static uint16_t report_frames;
+
+/** \brief Queues an event packet; the deadline starts with the first event of an empty queue.
+ */
+static bool queue_event(UsbMidiEventPacket const *event)
+{
+	if (ring_buffer_free(&tx) < sizeof(UsbMidiEventPacket))
+		return false;
+
+	if (ring_buffer_used(&tx) == 0)
+	{
+		first_event_frame = current_frame;
+	}
+
+	ring_buffer_write(&tx, event, sizeof(UsbMidiEventPacket));
+	return true;
+}
+
+/** \brief Writes the next IN packet: a full one as soon as there are 16 events, a partial one once the deadline of
+ * the first event is reached.
+ */
+static void transmit()
+{
+	if (!configured || in_busy)
+		return;
+
+	uint32_t used = ring_buffer_used(&tx);
+
+	if (used < MIDI_PACKET_SIZE && (used == 0 || !deadline_reached))
+		return;
+
+	if (used >= MIDI_PACKET_SIZE)
+	{
+		statistics.full_packets++;
+	}
+	else
+	{
+		statistics.deadline_packets++;
+	}
+
+	last_packet_size = ring_buffer_read(&tx, packet, MIN(used, MIDI_PACKET_SIZE));
+	usb_driver.write_packet(MIDI_IN_ENDPOINT_NUMBER, packet, last_packet_size);
+	in_busy = true;
+
+	// The events left waited at least as long as the ones sent (so they keep the deadline).
+	if (ring_buffer_used(&tx) == 0)
+	{
+		deadline_reached = false;
+	}
+}
+
+/** \brief Sends the received events back (the default receiver).
+ */
+static void loop_back()
+{
+	UsbMidiEventPacket event;
+
+	while (ring_buffer_used(&rx) != 0 && ring_buffer_free(&tx) >= sizeof(event))
+	{
+		ring_buffer_read(&rx, &event, sizeof(event));
+		queue_event(&event);
+	}
+}
+
+/** \brief Queues an event packet to send to the host.
+ * \returns false if the transmit buffer is full.
+ */
+bool usbd_midi_send_event(UsbMidiEventPacket const *event)
+{
+	return queue_event(event);
+}
+
+/** \brief Queues a MIDI byte stream to send to the host (e.g. the bytes received by a UART), with running status,
+ * system exclusive and real time messages.
+ * \param data The bytes.
+ * \param size Count of bytes.
+ * \returns The count of bytes taken (less than `size` if the transmit buffer is full).
+ */
+uint32_t usbd_midi_write(void const *data, uint32_t size)
+{
+	uint8_t const *bytes = data;
+	uint32_t i = 0;
+
+	// A byte is only parsed when the event it may complete fits.
+	for (; i < size && ring_buffer_free(&tx) >= sizeof(UsbMidiEventPacket); i++)
+	{
+		UsbMidiEventPacket event;
+
+		if (midi_stream_encode(&encoder, bytes[i], &event))
+		{
+			queue_event(&event);
+		}
+	}
+
+	return i;
+}
+
+/** \brief Takes an event packet received from the host.
+ * \returns false if no event was received.
+ */
+bool usbd_midi_receive_event(UsbMidiEventPacket *event)
+{
+	return ring_buffer_read(&rx, event, sizeof(UsbMidiEventPacket)) != 0;
+}
+
+/** \brief Takes the events received from the host as a MIDI byte stream (e.g. to write to a UART), with running
+ * status.
+ * \param data Receives the bytes.
+ * \param size Size of `data` (an event is only taken when its 3 bytes fit).
+ * \returns The count of bytes read.
+ */
+uint32_t usbd_midi_read(void *data, uint32_t size)
+{
+	uint8_t *bytes = data;
+	uint32_t length = 0;
+	UsbMidiEventPacket event;
+
+	while (size - length >= sizeof(event.midi) && usbd_midi_receive_event(&event))
+	{
+		length += midi_stream_decode(&decoder, &event, bytes + length);
+	}
+
+	return length;
+}
+
+/** \brief Registers the callback that processes the received events.
+ * \param receiver Function called from the main loop when there are events to read with `usbd_midi_receive_event()`
+ * or `usbd_midi_read()`.
+ * \note Without a receiver, the received events are sent back (loopback).
+ */
+void usbd_midi_set_receiver(void (*receiver)())
+{
+	midi_receiver = receiver;
+}
+
+static void reset()
+{
+	configured = false;
+	in_busy = false;
+	rx_nak = false;
+	deadline_reached = false;
+	ring_buffer_clear(&rx);
+	ring_buffer_clear(&tx);
+	midi_stream_encoder_reset(&encoder, 0);
+	midi_stream_decoder_reset(&decoder, true);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		MIDI_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_streaming_descriptors.in_endpoint.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_streaming_descriptors.in_endpoint.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		MIDI_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_streaming_descriptors.out_endpoint.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_streaming_descriptors.out_endpoint.wMaxPacketSize
+	);
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+	configured = true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	static const uint8_t alternate_setting = 0;
+
+	// The interfaces only have their default setting (some hosts select it anyway).
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE)
+		|| (request->wIndex & 0xFF) > MIDI_STREAMING_INTERFACE)
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_STANDARD_SET_INTERFACE:
+		if (request->wValue != 0)
+			return false;
+
+		usbd_control_acknowledge();
+		return true;
+	case USB_STANDARD_GET_INTERFACE:
+		usbd_control_send(&alternate_setting, sizeof(alternate_setting));
+		return true;
+	}
+
+	return false;
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	void *region;
+
+	if (ring_buffer_write_region(&rx, &region) >= byte_count)
+	{
+		usb_driver.read_packet(region, byte_count);
+		ring_buffer_commit_write(&rx, byte_count - byte_count % sizeof(UsbMidiEventPacket));
+	}
+	else
+	{
+		usb_driver.read_packet(packet, byte_count);
+		uint32_t size = byte_count - byte_count % sizeof(UsbMidiEventPacket);
+		uint32_t written = ring_buffer_write(&rx, packet, MIN(size, ring_buffer_free(&rx)));
+
+		statistics.dropped_events += (size - written) / sizeof(UsbMidiEventPacket);
+	}
+
+	statistics.received_events += byte_count / sizeof(UsbMidiEventPacket);
+
+	// The next packet would not fit: the host is NAKed until the events are processed.
+	if (!rx_nak && ring_buffer_free(&rx) < MIDI_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(MIDI_OUT_ENDPOINT_NUMBER, true);
+		rx_nak = true;
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	in_busy = false;
+	statistics.sent_events += last_packet_size / sizeof(UsbMidiEventPacket);
+	transmit();
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	current_frame = frame_number;
+
+	if (ring_buffer_used(&tx) != 0 && ((current_frame - first_event_frame) & 0x7FF) >= MIDI_FLUSH_DEADLINE_FRAMES)
+	{
+		deadline_reached = true;
+		transmit();
+	}
+
+	if (++report_frames < MIDI_REPORT_PERIOD)
+		return;
+
+	if (statistics.received_events != 0 || statistics.sent_events != 0)
+	{
+		uint32_t packets = statistics.full_packets + statistics.deadline_packets;
+
+		log_info("MIDI: %lu events received (%lu dropped), %lu events sent in %lu packets (%lu full, %lu at the deadline, %lu events per packet).",
+			statistics.received_events, statistics.dropped_events, statistics.sent_events, packets,
+			statistics.full_packets, statistics.deadline_packets, packets == 0 ? 0 : statistics.sent_events / packets);
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+}
+
+static void polled()
+{
+	if (!configured)
+		return;
+
+	if (ring_buffer_used(&rx) != 0)
+	{
+		if (midi_receiver != NULL)
+		{
+			midi_receiver();
+		}
+		else
+		{
+			loop_back();
+		}
+	}
+
+	if (rx_nak && ring_buffer_free(&rx) >= MIDI_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(MIDI_OUT_ENDPOINT_NUMBER, false);
+		rx_nak = false;
+	}
+
+	transmit();
+}
+
+const UsbClass usbd_midi_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
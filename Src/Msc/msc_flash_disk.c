@@ -0,0 +1,726 @@
+#include "stddef.h"
+#include "string.h"
+#include "Msc/msc_flash_disk.h"
+#include "Helpers/logger.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/flash.h"
+
+/// \brief Address of the first segment (sector 17, bank 2: the firmware runs from bank 1 while bank 2 is busy).
+#define FLASH_DISK_BASE_ADDRESS 0x08120000
+/// \brief The flash sector of the first segment.
+#define FLASH_DISK_FIRST_SECTOR 17
+/// \brief Count of segments (a segment is an erase sector).
+#define FLASH_DISK_SEGMENT_COUNT 7
+/// \brief Size of a segment in bytes.
+#define FLASH_DISK_SEGMENT_SIZE (128 * 1024)
+/// \brief Count of slots of \ref MSC_BLOCK_SIZE bytes of a segment.
+#define FLASH_DISK_SLOT_COUNT (FLASH_DISK_SEGMENT_SIZE / MSC_BLOCK_SIZE)
+/// \brief Count of slots holding the header of a segment.
+#define FLASH_DISK_HEADER_SLOTS 2
+/// \brief Count of slots holding blocks in a segment.
+#define FLASH_DISK_DATA_SLOTS (FLASH_DISK_SLOT_COUNT - FLASH_DISK_HEADER_SLOTS)
+/// \brief Marks a segment written by the flash disk ("FDSK").
+#define FLASH_DISK_MAGIC 0x4B534446
+/// \brief A header entry that was not programmed, or a cache entry that holds no block.
+#define FLASH_DISK_NO_BLOCK 0xFFFFFFFF
+/// \brief A logical block that was never written (it reads as zeros).
+#define FLASH_DISK_UNMAPPED 0xFFFF
+#define FLASH_DISK_NO_SEGMENT 0xFF
+/// \brief Count of blocks of the write-back cache.
+#define FLASH_DISK_CACHE_BLOCKS 8
+/// \brief Count of blocks programmed at once when the cache is full.
+#define FLASH_DISK_PAGE_BLOCKS 4
+/// \brief Segments kept erased (or about to be) for the garbage collection.
+#define FLASH_DISK_RESERVED_SEGMENTS 2
+/// \brief The cache is written to the flash once the host stops writing for this long.
+#define FLASH_DISK_IDLE_FLUSH_US 200000
+
+/** \brief The header of a segment (in its first slots).
+ * \details The sequence orders the segments of the log, and the entries give the logical block of each slot (they
+ * are programmed after the block, so a slot whose entry is programmed holds a whole block).
+ */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t sequence;
+	uint32_t blocks[FLASH_DISK_DATA_SLOTS];
+} FlashDiskSegmentHeader;
+
+_Static_assert(sizeof(FlashDiskSegmentHeader) == FLASH_DISK_HEADER_SLOTS * MSC_BLOCK_SIZE,
+	"The header fills its slots");
+// Note: The garbage collection always finds a segment with stale slots while the reserve is used.
+_Static_assert(MSC_FLASH_DISK_BLOCK_COUNT < (FLASH_DISK_SEGMENT_COUNT - FLASH_DISK_RESERVED_SEGMENTS) * FLASH_DISK_DATA_SLOTS,
+	"The log needs spare slots");
+_Static_assert(FLASH_DISK_SEGMENT_COUNT * FLASH_DISK_DATA_SLOTS < FLASH_DISK_UNMAPPED, "Slots are numbered on 16 bits");
+
+typedef enum
+{
+	FLASH_DISK_SEGMENT_FREE, ///< Erased.
+	FLASH_DISK_SEGMENT_ACTIVE, ///< The head of the log (blocks are appended to it).
+	FLASH_DISK_SEGMENT_USED, ///< Full, with at least one valid block.
+	FLASH_DISK_SEGMENT_DIRTY, ///< Holds no valid block, waits for the erase.
+	FLASH_DISK_SEGMENT_ERASING ///< Being erased.
+} FlashDiskSegmentState;
+
+/** \brief A block of the write-back cache.
+ */
+typedef struct
+{
+	uint8_t data[MSC_BLOCK_SIZE] __attribute__((aligned(4)));
+	/// \brief The logical block (\ref FLASH_DISK_NO_BLOCK if the entry is unused).
+	uint32_t block;
+	/// \brief Whether the flash holds an older version of the block.
+	bool dirty;
+	/// \brief Value of `cache_clock` when the entry was last written (the oldest entries are programmed first).
+	uint32_t age;
+} FlashDiskCacheEntry;
+
+/** \brief Counters of the flash disk (the write amplification is `programmed_blocks / host_writes`).
+ */
+typedef struct
+{
+	uint32_t host_writes;
+	/// \brief Writes to a block that was still dirty in the cache (they cost nothing in flash).
+	uint32_t coalesced_writes;
+	uint32_t programmed_blocks;
+	/// \brief Blocks moved by the garbage collection.
+	uint32_t collected_blocks;
+	uint32_t erases;
+	/// \brief Cycles spent waiting for an erase before a program.
+	uint32_t erase_wait_cycles;
+} FlashDiskStatistics;
+
+static bool mounted;
+/// \brief The slot of each logical block (`segment * FLASH_DISK_DATA_SLOTS + slot`).
+static uint16_t block_map[MSC_FLASH_DISK_BLOCK_COUNT];
+static FlashDiskSegmentState segment_states[FLASH_DISK_SEGMENT_COUNT];
+/// \brief Count of valid blocks of each segment.
+static uint16_t valid_counts[FLASH_DISK_SEGMENT_COUNT];
+/// \brief The head of the log, and its next free slot.
+static uint8_t active_segment;
+static uint16_t write_slot;
+static uint32_t next_sequence;
+static uint8_t erasing_segment;
+/// \brief The segment whose valid blocks are being moved to the head of the log, and the next slot to check.
+static uint8_t victim_segment;
+static uint16_t victim_slot;
+
+static FlashDiskCacheEntry cache[FLASH_DISK_CACHE_BLOCKS];
+static uint8_t dirty_count;
+static uint32_t cache_clock;
+/// \brief Cycle counter value of the last write of the host.
+static uint32_t last_write_time;
+
+static FlashDiskStatistics statistics;
+
+static FlashDiskSegmentHeader const *segment_header(uint8_t segment)
+{
+	return (FlashDiskSegmentHeader const *)(FLASH_DISK_BASE_ADDRESS + segment * FLASH_DISK_SEGMENT_SIZE);
+}
+
+static uint32_t slot_address(uint16_t location)
+{
+	uint8_t segment = location / FLASH_DISK_DATA_SLOTS;
+	uint16_t slot = location % FLASH_DISK_DATA_SLOTS;
+
+	return FLASH_DISK_BASE_ADDRESS + segment * FLASH_DISK_SEGMENT_SIZE + (FLASH_DISK_HEADER_SLOTS + slot) * MSC_BLOCK_SIZE;
+}
+
+static bool is_blank(uint32_t address, uint32_t size)
+{
+	for (uint32_t const *word = (uint32_t const *)address; word < (uint32_t const *)(address + size); word++)
+	{
+		if (*word != 0xFFFFFFFF)
+			return false;
+	}
+
+	return true;
+}
+
+/** \brief Ends the erase once the flash is no longer busy.
+ */
+static void complete_erase()
+{
+	if (erasing_segment == FLASH_DISK_NO_SEGMENT || flash_is_busy())
+		return;
+
+	if (flash_complete_erase())
+	{
+		segment_states[erasing_segment] = FLASH_DISK_SEGMENT_FREE;
+	}
+	else
+	{
+		log_error("Flash disk: erase of segment %d failed.", erasing_segment);
+		segment_states[erasing_segment] = FLASH_DISK_SEGMENT_DIRTY;
+	}
+
+	erasing_segment = FLASH_DISK_NO_SEGMENT;
+}
+
+/** \brief Waits for the erase in progress, if any.
+ */
+static void wait_erase()
+{
+	if (erasing_segment == FLASH_DISK_NO_SEGMENT)
+		return;
+
+	uint32_t start = cycle_counter_now();
+	flash_wait();
+	statistics.erase_wait_cycles += cycle_counter_now() - start;
+	complete_erase();
+}
+
+/** \brief Starts erasing a segment (the erase takes about a second; the firmware goes on running from bank 1).
+ */
+static void start_erase(uint8_t segment)
+{
+	wait_erase();
+	flash_start_erase(FLASH_DISK_FIRST_SECTOR + segment);
+
+	segment_states[segment] = FLASH_DISK_SEGMENT_ERASING;
+	erasing_segment = segment;
+	statistics.erases++;
+}
+
+/** \brief Programs words, once the erase in progress (if any) has completed.
+ */
+static bool program_words(uint32_t address, uint32_t const *words, uint32_t count)
+{
+	wait_erase();
+	return flash_program(address, words, count * 4);
+}
+
+static uint8_t count_segments(FlashDiskSegmentState state)
+{
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < FLASH_DISK_SEGMENT_COUNT; i++)
+	{
+		if (segment_states[i] == state)
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static uint8_t find_segment(FlashDiskSegmentState state)
+{
+	for (uint8_t i = 0; i < FLASH_DISK_SEGMENT_COUNT; i++)
+	{
+		if (segment_states[i] == state)
+			return i;
+	}
+
+	return FLASH_DISK_NO_SEGMENT;
+}
+
+/** \brief Returns the count of segments that are erased or will be without moving any block.
+ */
+static uint8_t count_reclaimable_segments()
+{
+	return count_segments(FLASH_DISK_SEGMENT_FREE) + count_segments(FLASH_DISK_SEGMENT_ERASING)
+		+ count_segments(FLASH_DISK_SEGMENT_DIRTY);
+}
+
+/** \brief Forgets the slot of a block that was rewritten.
+ */
+static void invalidate_slot(uint16_t location)
+{
+	uint8_t segment = location / FLASH_DISK_DATA_SLOTS;
+
+	if (--valid_counts[segment] == 0 && segment_states[segment] == FLASH_DISK_SEGMENT_USED)
+	{
+		segment_states[segment] = FLASH_DISK_SEGMENT_DIRTY;
+
+		if (segment == victim_segment)
+		{
+			victim_segment = FLASH_DISK_NO_SEGMENT;
+		}
+	}
+}
+
+/** \brief Makes an erased segment the head of the log.
+ */
+static bool open_segment()
+{
+	uint8_t segment;
+
+	// Note: An erase takes precedence over the writes (they wait for it).
+	while ((segment = find_segment(FLASH_DISK_SEGMENT_FREE)) == FLASH_DISK_NO_SEGMENT)
+	{
+		uint8_t dirty_segment = find_segment(FLASH_DISK_SEGMENT_DIRTY);
+
+		if (erasing_segment != FLASH_DISK_NO_SEGMENT)
+		{
+			wait_erase();
+		}
+		else if (dirty_segment != FLASH_DISK_NO_SEGMENT)
+		{
+			start_erase(dirty_segment);
+		}
+		else
+		{
+			log_error("Flash disk: no segment left.");
+			return false;
+		}
+	}
+
+	FlashDiskSegmentHeader const *header = segment_header(segment);
+	uint32_t const header_words[2] = {FLASH_DISK_MAGIC, next_sequence};
+
+	segment_states[segment] = FLASH_DISK_SEGMENT_ACTIVE;
+	active_segment = segment;
+	write_slot = 0;
+	next_sequence++;
+
+	return program_words((uint32_t)&header->magic, header_words, 2);
+}
+
+static bool collect_step();
+
+/** \brief Returns the next slot of the log (`segment * FLASH_DISK_DATA_SLOTS + slot`).
+ * \param collecting Whether the slot is for a block moved by the garbage collection (it may use the reserve).
+ */
+static bool allocate_slot(bool collecting, uint16_t *location)
+{
+	if (active_segment == FLASH_DISK_NO_SEGMENT || write_slot == FLASH_DISK_DATA_SLOTS)
+	{
+		if (active_segment != FLASH_DISK_NO_SEGMENT)
+		{
+			segment_states[active_segment] = valid_counts[active_segment] == 0 ? FLASH_DISK_SEGMENT_DIRTY : FLASH_DISK_SEGMENT_USED;
+			active_segment = FLASH_DISK_NO_SEGMENT;
+		}
+
+		// The host waits while stale slots are reclaimed (the background collection fell behind).
+		while (!collecting && count_reclaimable_segments() < FLASH_DISK_RESERVED_SEGMENTS && collect_step());
+
+		// Note: The moved blocks may have opened a segment already.
+		if (active_segment == FLASH_DISK_NO_SEGMENT && !open_segment())
+			return false;
+	}
+
+	*location = active_segment * FLASH_DISK_DATA_SLOTS + write_slot;
+	return true;
+}
+
+/** \brief Appends a block to the log.
+ */
+static bool program_block(uint32_t block, void const *data, bool collecting)
+{
+	uint16_t location;
+
+	if (!allocate_slot(collecting, &location))
+		return false;
+
+	FlashDiskSegmentHeader const *header = segment_header(active_segment);
+	uint16_t slot = write_slot++;
+
+	// Note: The entry is programmed last, so an interrupted program leaves a slot the mount ignores.
+	if (!program_words(slot_address(location), data, MSC_BLOCK_SIZE / 4)
+		|| !program_words((uint32_t)&header->blocks[slot], &block, 1))
+	{
+		log_error("Flash disk: program of block %lu failed.", block);
+		return false;
+	}
+
+	if (block_map[block] != FLASH_DISK_UNMAPPED)
+	{
+		invalidate_slot(block_map[block]);
+	}
+
+	block_map[block] = location;
+	valid_counts[active_segment]++;
+	statistics.programmed_blocks++;
+
+	return true;
+}
+
+/** \brief Selects the used segment with the fewest valid blocks.
+ */
+static uint8_t select_victim()
+{
+	uint8_t victim = FLASH_DISK_NO_SEGMENT;
+
+	for (uint8_t i = 0; i < FLASH_DISK_SEGMENT_COUNT; i++)
+	{
+		if (segment_states[i] == FLASH_DISK_SEGMENT_USED
+			&& valid_counts[i] < FLASH_DISK_DATA_SLOTS
+			&& (victim == FLASH_DISK_NO_SEGMENT || valid_counts[i] < valid_counts[victim]))
+		{
+			victim = i;
+		}
+	}
+
+	return victim;
+}
+
+/** \brief Moves one valid block of the victim segment to the head of the log (the victim becomes dirty once empty).
+ * \return Whether there was a block to move.
+ */
+static bool collect_step()
+{
+	if (victim_segment == FLASH_DISK_NO_SEGMENT)
+	{
+		victim_segment = select_victim();
+		victim_slot = 0;
+
+		if (victim_segment == FLASH_DISK_NO_SEGMENT)
+			return false;
+	}
+
+	FlashDiskSegmentHeader const *header = segment_header(victim_segment);
+
+	for (; victim_slot < FLASH_DISK_DATA_SLOTS; victim_slot++)
+	{
+		uint32_t block = header->blocks[victim_slot];
+		uint16_t location = victim_segment * FLASH_DISK_DATA_SLOTS + victim_slot;
+
+		if (block < MSC_FLASH_DISK_BLOCK_COUNT && block_map[block] == location)
+		{
+			victim_slot++;
+			statistics.collected_blocks++;
+			return program_block(block, (void const *)slot_address(location), true);
+		}
+	}
+
+	// Note: Unreachable unless the counts are wrong; the victim is given up.
+	victim_segment = FLASH_DISK_NO_SEGMENT;
+	return false;
+}
+
+static FlashDiskCacheEntry *find_cache_entry(uint32_t block)
+{
+	for (uint8_t i = 0; i < FLASH_DISK_CACHE_BLOCKS; i++)
+	{
+		if (cache[i].block == block)
+			return &cache[i];
+	}
+
+	return NULL;
+}
+
+/** \brief Programs the oldest dirty blocks of the cache (a page, or fewer when the cache holds fewer).
+ */
+static bool flush_page()
+{
+	for (uint8_t i = 0; i < FLASH_DISK_PAGE_BLOCKS && dirty_count != 0; i++)
+	{
+		FlashDiskCacheEntry *oldest = NULL;
+
+		for (uint8_t j = 0; j < FLASH_DISK_CACHE_BLOCKS; j++)
+		{
+			if (cache[j].dirty && (oldest == NULL || (int32_t)(cache[j].age - oldest->age) < 0))
+			{
+				oldest = &cache[j];
+			}
+		}
+
+		if (!program_block(oldest->block, oldest->data, false))
+			return false;
+
+		oldest->dirty = false;
+		dirty_count--;
+	}
+
+	return true;
+}
+
+/** \brief Rebuilds the block map from the segment headers (the latest sequence wins).
+ */
+static bool initialize()
+{
+	uint32_t sequences[FLASH_DISK_SEGMENT_COUNT];
+	uint8_t order[FLASH_DISK_SEGMENT_COUNT];
+	uint8_t used_count = 0;
+
+	memset(block_map, 0xFF, sizeof(block_map));
+	memset(valid_counts, 0, sizeof(valid_counts));
+	active_segment = erasing_segment = victim_segment = FLASH_DISK_NO_SEGMENT;
+	next_sequence = 0;
+
+	for (uint8_t i = 0; i < FLASH_DISK_SEGMENT_COUNT; i++)
+	{
+		FlashDiskSegmentHeader const *header = segment_header(i);
+
+		// Note: A program of the header cut short can leave the magic without the sequence (which would then wrap
+		// `next_sequence` around); such a segment holds no block, it is erased.
+		if (header->magic == FLASH_DISK_MAGIC && header->sequence != FLASH_DISK_NO_BLOCK)
+		{
+			sequences[i] = header->sequence;
+			segment_states[i] = FLASH_DISK_SEGMENT_USED;
+
+			// Inserts the segment in the sequence order.
+			uint8_t j = used_count++;
+			for (; j > 0 && sequences[order[j - 1]] > sequences[i]; j--)
+			{
+				order[j] = order[j - 1];
+			}
+			order[j] = i;
+
+			if (header->sequence >= next_sequence)
+			{
+				next_sequence = header->sequence + 1;
+			}
+		}
+		else
+		{
+			// A segment holding something else (or an interrupted erase) is erased before its use.
+			segment_states[i] = is_blank((uint32_t)header, FLASH_DISK_SEGMENT_SIZE) ? FLASH_DISK_SEGMENT_FREE : FLASH_DISK_SEGMENT_DIRTY;
+		}
+	}
+
+	for (uint8_t i = 0; i < used_count; i++)
+	{
+		FlashDiskSegmentHeader const *header = segment_header(order[i]);
+
+		for (uint16_t slot = 0; slot < FLASH_DISK_DATA_SLOTS; slot++)
+		{
+			uint32_t block = header->blocks[slot];
+
+			if (block >= MSC_FLASH_DISK_BLOCK_COUNT)
+				continue;
+
+			if (block_map[block] != FLASH_DISK_UNMAPPED)
+			{
+				valid_counts[block_map[block] / FLASH_DISK_DATA_SLOTS]--;
+			}
+
+			block_map[block] = order[i] * FLASH_DISK_DATA_SLOTS + slot;
+			valid_counts[order[i]]++;
+		}
+	}
+
+	// Appends to the latest segment, after its last programmed slot (and after the slots an interrupted program left).
+	if (used_count != 0)
+	{
+		uint8_t last = order[used_count - 1];
+		FlashDiskSegmentHeader const *header = segment_header(last);
+		uint16_t slot = FLASH_DISK_DATA_SLOTS;
+
+		while (slot > 0 && header->blocks[slot - 1] == FLASH_DISK_NO_BLOCK)
+		{
+			slot--;
+		}
+
+		while (slot < FLASH_DISK_DATA_SLOTS && !is_blank(slot_address(last * FLASH_DISK_DATA_SLOTS + slot), MSC_BLOCK_SIZE))
+		{
+			slot++;
+		}
+
+		if (slot < FLASH_DISK_DATA_SLOTS)
+		{
+			segment_states[last] = FLASH_DISK_SEGMENT_ACTIVE;
+			active_segment = last;
+			write_slot = slot;
+		}
+	}
+
+	for (uint8_t i = 0; i < FLASH_DISK_SEGMENT_COUNT; i++)
+	{
+		if (segment_states[i] == FLASH_DISK_SEGMENT_USED && valid_counts[i] == 0)
+		{
+			segment_states[i] = FLASH_DISK_SEGMENT_DIRTY;
+		}
+	}
+
+	for (uint8_t i = 0; i < FLASH_DISK_CACHE_BLOCKS; i++)
+	{
+		cache[i].block = FLASH_DISK_NO_BLOCK;
+		cache[i].dirty = false;
+	}
+
+	dirty_count = 0;
+	mounted = true;
+
+	log_info("Flash disk mounted: %d free and %d dirty segments, sequence %lu.",
+		count_segments(FLASH_DISK_SEGMENT_FREE), count_segments(FLASH_DISK_SEGMENT_DIRTY), next_sequence);
+	return true;
+}
+
+static bool is_ready()
+{
+	return mounted;
+}
+
+/** \brief Returns whether an erase of bank 2 is in progress: reading bank 2 (or programming it) would stall the bus
+ * until the erase ends, so the accesses wait for it instead.
+ */
+static bool is_busy()
+{
+	complete_erase();
+	return erasing_segment != FLASH_DISK_NO_SEGMENT;
+}
+
+static bool read_block(uint32_t block, void *buffer)
+{
+	FlashDiskCacheEntry const *entry = find_cache_entry(block);
+
+	if (entry != NULL)
+	{
+		memcpy(buffer, entry->data, MSC_BLOCK_SIZE);
+	}
+	else if (block_map[block] == FLASH_DISK_UNMAPPED)
+	{
+		memset(buffer, 0, MSC_BLOCK_SIZE);
+	}
+	else
+	{
+		memcpy(buffer, (void const *)slot_address(block_map[block]), MSC_BLOCK_SIZE);
+	}
+
+	return true;
+}
+
+/** \brief Stores a block in the cache; the cache is programmed a page at a time once it is full of dirty blocks.
+ */
+static bool write_block(uint32_t block, void const *buffer)
+{
+	FlashDiskCacheEntry *entry = find_cache_entry(block);
+
+	statistics.host_writes++;
+	last_write_time = cycle_counter_now();
+
+	if (entry == NULL)
+	{
+		// Reuses an unused entry, or the oldest clean one.
+		for (uint8_t i = 0; i < FLASH_DISK_CACHE_BLOCKS; i++)
+		{
+			if (!cache[i].dirty && (entry == NULL || cache[i].block == FLASH_DISK_NO_BLOCK
+				|| (entry->block != FLASH_DISK_NO_BLOCK && (int32_t)(cache[i].age - entry->age) < 0)))
+			{
+				entry = &cache[i];
+			}
+		}
+
+		if (entry == NULL)
+		{
+			if (!flush_page())
+				return false;
+
+			return write_block(block, buffer);
+		}
+
+		entry->block = block;
+	}
+	else if (entry->dirty)
+	{
+		statistics.coalesced_writes++;
+	}
+
+	memcpy(entry->data, buffer, MSC_BLOCK_SIZE);
+	entry->age = ++cache_clock;
+
+	if (!entry->dirty)
+	{
+		entry->dirty = true;
+		dirty_count++;
+	}
+
+	return true;
+}
+
+/** \brief Writes the cache back, page by page, until it is clean or an erase starts (the caller waits for it, then
+ * calls again; a program would wait for the erase here).
+ */
+static bool flush()
+{
+	while (dirty_count != 0 && !is_busy())
+	{
+		if (!flush_page())
+			return false;
+	}
+
+	return true;
+}
+
+/** \brief Background work: completes and starts erases, collects stale slots and writes back an idle cache.
+ * \note Each call does at most one flash operation, so the USB stack keeps being polled.
+ */
+static void poll()
+{
+	if (!mounted)
+		return;
+
+	complete_erase();
+
+	// Programs would wait for the erase.
+	if (erasing_segment != FLASH_DISK_NO_SEGMENT)
+		return;
+
+	if (dirty_count != 0 && cycle_counter_elapsed_us(last_write_time) > FLASH_DISK_IDLE_FLUSH_US)
+	{
+		flush_page();
+	}
+	else if (find_segment(FLASH_DISK_SEGMENT_DIRTY) != FLASH_DISK_NO_SEGMENT)
+	{
+		start_erase(find_segment(FLASH_DISK_SEGMENT_DIRTY));
+	}
+	else if (count_reclaimable_segments() < FLASH_DISK_RESERVED_SEGMENTS)
+	{
+		collect_step();
+	}
+}
+
+/** \brief Measures the sequential and the random write throughput of the flash disk (the writes go through the cache
+ * and include the erases and the garbage collection they cause).
+ * \param block_count Count of blocks written by each test.
+ * \warning Overwrites the content of the disk.
+ * \note `main()` runs it at startup when built with `MSC_FLASH_DISK_BENCHMARK_BLOCKS` defined (the block count).
+ */
+void msc_flash_disk_run_benchmark(uint16_t block_count)
+{
+	static uint32_t pattern[MSC_BLOCK_SIZE / 4];
+	uint32_t random = 0x12345678;
+
+	if (block_count == 0)
+		return;
+
+	if (!mounted)
+	{
+		initialize();
+	}
+
+	for (uint8_t test = 0; test < 2; test++)
+	{
+		memset(&statistics, 0, sizeof(statistics));
+		uint32_t start = cycle_counter_now();
+
+		for (uint16_t i = 0; i < block_count; i++)
+		{
+			// Sequential blocks, then blocks picked by a linear congruential generator.
+			random = random * 1664525 + 1013904223;
+			uint32_t block = test == 0 ? i % MSC_FLASH_DISK_BLOCK_COUNT : (random >> 8) % MSC_FLASH_DISK_BLOCK_COUNT;
+
+			pattern[0] = block;
+			pattern[1] = i;
+			write_block(block, pattern);
+		}
+
+		// Note: The benchmark waits for the erases (the time spent is part of the throughput).
+		while (dirty_count != 0 && flush_page());
+
+		uint32_t elapsed_us = cycle_counter_elapsed_us(start);
+		uint32_t bytes = block_count * MSC_BLOCK_SIZE;
+
+		log_info("Flash disk %s writes: %lu KB/s, write amplification %lu.%02lu, %lu coalesced, %lu collected, %lu erases (%lu ms waited).",
+			test == 0 ? "sequential" : "random",
+			elapsed_us == 0 ? 0 : (uint32_t)((uint64_t)bytes * 1000000 / 1024 / elapsed_us),
+			statistics.programmed_blocks / block_count, statistics.programmed_blocks * 100 / block_count % 100,
+			statistics.coalesced_writes, statistics.collected_blocks, statistics.erases,
+			cycle_counter_to_us(statistics.erase_wait_cycles) / 1000);
+	}
+}
+
+const MscBlockDevice msc_flash_disk = {
+	.block_count = MSC_FLASH_DISK_BLOCK_COUNT,
+	.write_protected = false,
+	.initialize = &initialize,
+	.is_ready = &is_ready,
+	.read_block = &read_block,
+	.write_block = &write_block,
+	.flush = &flush,
+	.poll = &poll,
+	.is_busy = &is_busy
+};
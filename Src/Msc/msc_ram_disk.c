@@ -0,0 +1,26 @@
+#include "string.h"
+#include "Msc/msc_ram_disk.h"
+
+/// \brief The blocks of the RAM disk (its content is lost on a reset).
+static uint8_t ram_disk_blocks[MSC_RAM_DISK_BLOCK_COUNT][MSC_BLOCK_SIZE] __attribute__((aligned(4)));
+
+static bool read_block(uint32_t block, void *buffer)
+{
+	memcpy(buffer, ram_disk_blocks[block], MSC_BLOCK_SIZE);
+	return true;
+}
+
+static bool write_block(uint32_t block, void const *buffer)
+{
+	memcpy(ram_disk_blocks[block], buffer, MSC_BLOCK_SIZE);
+	return true;
+}
+
+/** \brief A block device in RAM (backend for tests and benchmarks: it never waits for the medium).
+ */
+const MscBlockDevice msc_ram_disk = {
+	.block_count = MSC_RAM_DISK_BLOCK_COUNT,
+	.write_protected = false,
+	.read_block = &read_block,
+	.write_block = &write_block
+};
@@ -0,0 +1,930 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Msc/usbd_msc.h"
+#include "Msc/usb_msc_standards.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/cycle_counter.h"
+
+/// \brief Count of frames between two logs of the throughput.
+#define MSC_THROUGHPUT_REPORT_PERIOD 1000
+/// \brief Count of sector buffers (one is filled while the other is being transferred).
+#define MSC_SECTOR_BUFFER_COUNT 2
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_PER_INTERFACE,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B2,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+	UsbEndpointDescriptor usb_out_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 2,
+		.bInterfaceClass        = USB_CLASS_MASS_STORAGE,
+		.bInterfaceSubClass     = USB_MSC_SUBCLASS_SCSI,
+		.bInterfaceProtocol     = USB_MSC_PROTOCOL_BBB,
+		.iInterface             = 0
+	},
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = MSC_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = MSC_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+/// \brief The number of the bulk IN endpoint.
+#define MSC_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+/// \brief The number of the bulk OUT endpoint.
+#define MSC_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/** \brief States of the Bulk-Only Transport.
+ */
+typedef enum
+{
+	MSC_STATE_COMMAND, ///< Waiting for a command block wrapper.
+	MSC_STATE_DATA_IN, ///< Sending the data of the command.
+	MSC_STATE_DATA_OUT, ///< Receiving the data of the command.
+	MSC_STATE_FLUSH, ///< SYNCHRONIZE CACHE waits for the block device; the status is sent once the cache is written.
+	MSC_STATE_STATUS, ///< The command status wrapper is in the TxFIFO.
+	MSC_STATE_STALLED, ///< The bulk IN endpoint stalls; the status is sent once the host clears the halt.
+	MSC_STATE_RESET_NEEDED ///< An invalid command block wrapper was received; both endpoints stall until a reset.
+} MscState;
+
+/** \brief A sector buffer: filled by the backend and emptied by the USB side (reads), or the opposite (writes).
+ */
+typedef struct
+{
+	uint8_t data[MSC_BLOCK_SIZE] __attribute__((aligned(4)));
+	/// \brief Whether the buffer holds a sector that was not consumed yet.
+	bool full;
+} MscSectorBuffer;
+
+/// \brief The storage of the function.
+static MscBlockDevice const *block_device;
+/// \brief Whether the block device was initialized successfully.
+static bool block_device_ready;
+
+static MscState state;
+/// \brief The command being processed.
+static UsbMscCommandBlockWrapper cbw __attribute__((aligned(4)));
+/// \brief The status of the command being processed.
+static UsbMscCommandStatusWrapper csw __attribute__((aligned(4)));
+/// \brief Whether a command block wrapper arrived before the host collected the previous status (it is processed then).
+static bool cbw_pending;
+/// \brief Holds the data of the commands that answer with a few bytes.
+static uint8_t response[MSC_PACKET_SIZE] __attribute__((aligned(4)));
+/// \brief Receives the packets that are dropped (they must still be popped from the RxFIFO whole).
+static uint8_t dropped_packet[MSC_PACKET_SIZE] __attribute__((aligned(4)));
+/// \brief Whether a packet or a transfer is in the TxFIFO waiting for the host to collect it.
+static bool endpoint_busy;
+/// \brief Size of the packet or transfer in the TxFIFO.
+static uint16_t last_in_size;
+/// \brief Whether the bulk OUT endpoint NAKs the host because both sector buffers are full.
+static bool out_nak;
+
+/// \brief The sense data reported by the next REQUEST SENSE.
+static uint8_t sense_key, additional_sense_code;
+
+/// \brief The sector buffers; block `n` of a transfer uses buffer `n % MSC_SECTOR_BUFFER_COUNT`.
+static MscSectorBuffer sector_buffers[MSC_SECTOR_BUFFER_COUNT];
+/// \brief First block and count of blocks of the READ(10) or WRITE(10) being processed.
+static uint32_t transfer_block, transfer_block_count;
+/// \brief Blocks read or written by the backend.
+static uint32_t backend_block_count;
+/// \brief Blocks written to the TxFIFO or received from the host.
+static uint32_t usb_block_count;
+/// \brief Bytes of the block being received.
+static uint16_t sector_offset;
+/// \brief Whether the backend failed during the transfer (the command fails once the data stage is over).
+static bool transfer_failed;
+
+/// \brief Bytes read and written by the host since the throughput was last logged.
+static uint32_t read_bytes, written_bytes;
+/// \brief Cycles spent in the backend since the throughput was last logged.
+static uint32_t backend_cycles;
+/// \brief Frames since the throughput was last logged.
+static uint16_t throughput_frames;
+
+/** \brief Selects the storage exposed to the host, and initializes it.
+ * \param device The block device (e.g. `msc_ram_disk`).
+ */
+void usbd_msc_set_block_device(MscBlockDevice const *device)
+{
+	block_device = device;
+	block_device_ready = device != NULL && (device->initialize == NULL || device->initialize());
+
+	if (device != NULL && !block_device_ready)
+	{
+		log_error("MSC block device initialization failed.");
+	}
+}
+
+static uint32_t read_be32(uint8_t const *bytes)
+{
+	return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+static uint16_t read_be16(uint8_t const *bytes)
+{
+	return (bytes[0] << 8) | bytes[1];
+}
+
+static void set_sense(uint8_t key, uint8_t code)
+{
+	sense_key = key;
+	additional_sense_code = code;
+}
+
+/** \brief Writes the command status wrapper (the residue was updated along the data stage).
+ */
+static void send_status()
+{
+	csw.dCSWSignature = USB_MSC_CSW_SIGNATURE;
+	csw.dCSWTag = cbw.dCBWTag;
+
+	usb_driver.write_packet(MSC_IN_ENDPOINT_NUMBER, &csw, sizeof(csw));
+
+	endpoint_busy = true;
+	last_in_size = sizeof(csw);
+	state = MSC_STATE_STATUS;
+}
+
+/** \brief Ends a command whose data stage cannot go on (or does not match the direction the host expects).
+ * \param status \ref USB_MSC_CSW_STATUS_FAILED or \ref USB_MSC_CSW_STATUS_PHASE_ERROR.
+ * \details The endpoint of the expected data stage stalls: the status follows once the host clears the halt of
+ * the bulk IN endpoint, or right away when the bulk OUT endpoint stalls (the host clears it, then reads the status).
+ */
+static void end_data_stage(uint8_t status)
+{
+	csw.bCSWStatus = status;
+
+	if (cbw.dCBWDataTransferLength == 0)
+	{
+		send_status();
+	}
+	else if (cbw.bmCBWFlags & USB_MSC_CBW_DIRECTION_IN)
+	{
+		usb_driver.stall_in_endpoint(MSC_IN_ENDPOINT_NUMBER);
+		state = MSC_STATE_STALLED;
+	}
+	else
+	{
+		usb_driver.stall_out_endpoint(MSC_OUT_ENDPOINT_NUMBER);
+		send_status();
+	}
+}
+
+/** \brief Fails the command; the host learns why with REQUEST SENSE.
+ */
+static void fail_command(uint8_t key, uint8_t code)
+{
+	set_sense(key, code);
+	end_data_stage(USB_MSC_CSW_STATUS_FAILED);
+}
+
+/** \brief Sends the data of a command that answers with a few bytes (held in `response`).
+ * \param size Size of the data in bytes (it is truncated to what the host expects).
+ */
+static void send_response(uint16_t size)
+{
+	if (cbw.dCBWDataTransferLength == 0)
+	{
+		send_status();
+		return;
+	}
+
+	if (!(cbw.bmCBWFlags & USB_MSC_CBW_DIRECTION_IN))
+	{
+		end_data_stage(USB_MSC_CSW_STATUS_PHASE_ERROR);
+		return;
+	}
+
+	size = MIN(size, cbw.dCBWDataTransferLength);
+	usb_driver.write_packet(MSC_IN_ENDPOINT_NUMBER, response, size);
+
+	endpoint_busy = true;
+	last_in_size = size;
+	transfer_block_count = 0;
+	state = MSC_STATE_DATA_IN;
+}
+
+/** \brief Ends the data stage of a command that sent data.
+ * \details When the host expects more, a short packet has already told it the data is over; otherwise the
+ * endpoint stalls.
+ */
+static void end_data_in_stage()
+{
+	if (csw.dCSWDataResidue != 0 && last_in_size != 0 && last_in_size % MSC_PACKET_SIZE == 0)
+	{
+		usb_driver.stall_in_endpoint(MSC_IN_ENDPOINT_NUMBER);
+		state = MSC_STATE_STALLED;
+		return;
+	}
+
+	send_status();
+}
+
+/** \brief Ends the data stage of a WRITE(10) once the backend wrote all the blocks.
+ */
+static void end_data_out_stage()
+{
+	if (transfer_failed)
+	{
+		csw.bCSWStatus = USB_MSC_CSW_STATUS_FAILED;
+	}
+
+	// The host intends to send more than the blocks of the command.
+	if (csw.dCSWDataResidue != 0)
+	{
+		usb_driver.stall_out_endpoint(MSC_OUT_ENDPOINT_NUMBER);
+	}
+
+	send_status();
+}
+
+/** \brief Checks a READ(10) or WRITE(10) command and starts its data stage.
+ * \param is_write Whether the command is WRITE(10).
+ */
+static void start_block_transfer(bool is_write)
+{
+	uint32_t block = read_be32(&cbw.CBWCB[2]);
+	uint16_t block_count = read_be16(&cbw.CBWCB[7]);
+	bool direction_in = (cbw.bmCBWFlags & USB_MSC_CBW_DIRECTION_IN) != 0;
+
+	if (!block_device_ready)
+	{
+		fail_command(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		return;
+	}
+
+	if (block + block_count > block_device->block_count || block + block_count < block)
+	{
+		fail_command(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE);
+		return;
+	}
+
+	if (is_write && block_device->write_protected)
+	{
+		fail_command(SCSI_SENSE_DATA_PROTECT, SCSI_ASC_WRITE_PROTECTED);
+		return;
+	}
+
+	if (block_count == 0)
+	{
+		send_status();
+		return;
+	}
+
+	// The host must expect the blocks, in the direction of the command.
+	if (cbw.dCBWDataTransferLength < block_count * MSC_BLOCK_SIZE || direction_in == is_write)
+	{
+		end_data_stage(USB_MSC_CSW_STATUS_PHASE_ERROR);
+		return;
+	}
+
+	transfer_block = block;
+	transfer_block_count = block_count;
+	backend_block_count = 0;
+	usb_block_count = 0;
+	sector_offset = 0;
+	transfer_failed = false;
+
+	for (uint8_t i = 0; i < MSC_SECTOR_BUFFER_COUNT; i++)
+	{
+		sector_buffers[i].full = false;
+	}
+
+	// Note: The data moves from `polled()` (reads) or as the packets arrive (writes).
+	state = is_write ? MSC_STATE_DATA_OUT : MSC_STATE_DATA_IN;
+}
+
+static void process_inquiry()
+{
+	ScsiInquiryData *inquiry = (ScsiInquiryData *)response;
+
+	// Vital product data pages are not supported.
+	if (cbw.CBWCB[1] & 0x01)
+	{
+		fail_command(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB);
+		return;
+	}
+
+	*inquiry = (ScsiInquiryData){
+		.peripheral_device_type = 0x00,
+		.removable = 0x80,
+		.version = 0x04,
+		.response_data_format = 0x02,
+		.additional_length = sizeof(ScsiInquiryData) - 5
+	};
+	memcpy(inquiry->vendor_id, "learnUSB", sizeof(inquiry->vendor_id));
+	memcpy(inquiry->product_id, "Mass Storage    ", sizeof(inquiry->product_id));
+	memcpy(inquiry->product_revision, "1.00", sizeof(inquiry->product_revision));
+
+	send_response(MIN(sizeof(ScsiInquiryData), read_be16(&cbw.CBWCB[3])));
+}
+
+static void process_request_sense()
+{
+	ScsiSenseData *sense = (ScsiSenseData *)response;
+
+	*sense = (ScsiSenseData){
+		.response_code = 0x70,
+		.sense_key = sense_key,
+		.additional_length = sizeof(ScsiSenseData) - 8,
+		.additional_sense_code = additional_sense_code
+	};
+
+	set_sense(SCSI_SENSE_NO_SENSE, SCSI_ASC_NONE);
+	send_response(MIN(sizeof(ScsiSenseData), cbw.CBWCB[4]));
+}
+
+static void process_read_capacity()
+{
+	ScsiReadCapacity10Data *capacity = (ScsiReadCapacity10Data *)response;
+
+	if (!block_device_ready)
+	{
+		fail_command(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		return;
+	}
+
+	capacity->last_logical_block_address = __REV(block_device->block_count - 1);
+	capacity->block_length = __REV(MSC_BLOCK_SIZE);
+	send_response(sizeof(ScsiReadCapacity10Data));
+}
+
+static void process_read_format_capacities()
+{
+	ScsiReadFormatCapacitiesData *capacities = (ScsiReadFormatCapacitiesData *)response;
+
+	if (!block_device_ready)
+	{
+		fail_command(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		return;
+	}
+
+	*capacities = (ScsiReadFormatCapacitiesData){
+		.capacity_list_length = 8,
+		.block_count = __REV(block_device->block_count),
+		// Formatted media.
+		.descriptor_type_block_length = __REV((2 << 24) | MSC_BLOCK_SIZE)
+	};
+
+	send_response(MIN(sizeof(ScsiReadFormatCapacitiesData), read_be16(&cbw.CBWCB[7])));
+}
+
+/** \brief Answers MODE SENSE(6) or MODE SENSE(10) with a header only (no block descriptor, no page).
+ */
+static void process_mode_sense(bool is_10)
+{
+	uint8_t device_specific = (block_device_ready && block_device->write_protected) ? 0x80 : 0x00;
+
+	memset(response, 0, 8);
+
+	if (is_10)
+	{
+		// Mode data length (big endian), medium type, device specific parameter, reserved, block descriptor length.
+		response[1] = 6;
+		response[3] = device_specific;
+		send_response(MIN(8, read_be16(&cbw.CBWCB[7])));
+	}
+	else
+	{
+		// Mode data length, medium type, device specific parameter, block descriptor length.
+		response[0] = 3;
+		response[2] = device_specific;
+		send_response(MIN(4, cbw.CBWCB[4]));
+	}
+}
+
+/** \brief Starts SYNCHRONIZE CACHE: the cache is written from the polled path, see `process_flush()`.
+ */
+static void process_synchronize_cache()
+{
+	if (!block_device_ready || block_device->flush == NULL)
+	{
+		send_status();
+		return;
+	}
+
+	state = MSC_STATE_FLUSH;
+}
+
+/** \brief Processes a received command block wrapper.
+ */
+static void process_command()
+{
+	csw.dCSWDataResidue = cbw.dCBWDataTransferLength;
+	csw.bCSWStatus = USB_MSC_CSW_STATUS_PASSED;
+
+	switch (cbw.CBWCB[0])
+	{
+	case SCSI_TEST_UNIT_READY:
+		if (!block_device_ready || (block_device->is_ready != NULL && !block_device->is_ready()))
+		{
+			fail_command(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+			return;
+		}
+
+		send_status();
+		break;
+	case SCSI_REQUEST_SENSE:
+		process_request_sense();
+		break;
+	case SCSI_INQUIRY:
+		process_inquiry();
+		break;
+	case SCSI_MODE_SENSE_6:
+		process_mode_sense(false);
+		break;
+	case SCSI_MODE_SENSE_10:
+		process_mode_sense(true);
+		break;
+	case SCSI_READ_FORMAT_CAPACITIES:
+		process_read_format_capacities();
+		break;
+	case SCSI_READ_CAPACITY_10:
+		process_read_capacity();
+		break;
+	case SCSI_READ_10:
+		start_block_transfer(false);
+		break;
+	case SCSI_WRITE_10:
+		start_block_transfer(true);
+		break;
+	case SCSI_SYNCHRONIZE_CACHE_10:
+		process_synchronize_cache();
+		break;
+	case SCSI_START_STOP_UNIT:
+	case SCSI_PREVENT_ALLOW_MEDIUM_REMOVAL:
+	case SCSI_VERIFY_10:
+		send_status();
+		break;
+	default:
+		log_info("MSC unsupported SCSI command 0x%02X.", cbw.CBWCB[0]);
+		fail_command(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND_OPERATION_CODE);
+		break;
+	}
+}
+
+/** \brief Writes the next prepared sector of a READ(10) to the TxFIFO, if the endpoint is free.
+ */
+static void send_next_sector()
+{
+	if (endpoint_busy)
+		return;
+
+	MscSectorBuffer *buffer = &sector_buffers[usb_block_count % MSC_SECTOR_BUFFER_COUNT];
+
+	if (buffer->full)
+	{
+		// The whole sector goes to the TxFIFO at once; the buffer is free again as soon as it is copied.
+		usb_driver.write_transfer(MSC_IN_ENDPOINT_NUMBER, buffer->data, MSC_BLOCK_SIZE);
+		buffer->full = false;
+		usb_block_count++;
+		endpoint_busy = true;
+		last_in_size = MSC_BLOCK_SIZE;
+	}
+	else if (transfer_failed && backend_block_count == usb_block_count)
+	{
+		// The sectors read before the error were sent.
+		end_data_stage(USB_MSC_CSW_STATUS_FAILED);
+	}
+}
+
+/** \brief Returns whether the block device asks the transfer to wait (rather than stall the firmware).
+ */
+static bool is_backend_busy()
+{
+	return block_device->is_busy != NULL && block_device->is_busy();
+}
+
+/** \brief Writes the cache of the block device, unless it is busy; the status is held until the cache is written.
+ */
+static void process_flush()
+{
+	if (is_backend_busy())
+		return;
+
+	uint32_t start = cycle_counter_now();
+	bool flushed = block_device->flush();
+	backend_cycles += cycle_counter_now() - start;
+
+	if (!flushed)
+	{
+		fail_command(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_FAULT);
+	}
+	// Note: The flush stops when the device becomes busy (an erase started), and goes on at a later poll.
+	else if (!is_backend_busy())
+	{
+		send_status();
+	}
+}
+
+/** \brief Moves the data of a READ(10): the backend reads the next sector while the previous one is going out.
+ */
+static void process_read()
+{
+	MscSectorBuffer *buffer = &sector_buffers[backend_block_count % MSC_SECTOR_BUFFER_COUNT];
+
+	if (!transfer_failed && backend_block_count < transfer_block_count && !buffer->full && !is_backend_busy())
+	{
+		uint32_t start = cycle_counter_now();
+
+		if (block_device->read_block(transfer_block + backend_block_count, buffer->data))
+		{
+			buffer->full = true;
+			backend_block_count++;
+		}
+		else
+		{
+			transfer_failed = true;
+			set_sense(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_UNRECOVERED_READ_ERROR);
+		}
+
+		backend_cycles += cycle_counter_now() - start;
+	}
+
+	send_next_sector();
+}
+
+/** \brief Moves the data of a WRITE(10): the backend writes a received sector while the next one arrives.
+ */
+static void process_write()
+{
+	MscSectorBuffer *buffer = &sector_buffers[backend_block_count % MSC_SECTOR_BUFFER_COUNT];
+
+	if (backend_block_count < usb_block_count && buffer->full && !is_backend_busy())
+	{
+		uint32_t start = cycle_counter_now();
+
+		// Note: After an error, the rest of the data is received and dropped, then the command fails.
+		if (!transfer_failed && !block_device->write_block(transfer_block + backend_block_count, buffer->data))
+		{
+			transfer_failed = true;
+			set_sense(SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_FAULT);
+		}
+
+		backend_cycles += cycle_counter_now() - start;
+		buffer->full = false;
+		backend_block_count++;
+
+		if (out_nak)
+		{
+			usb_driver.set_out_endpoint_nak(MSC_OUT_ENDPOINT_NUMBER, false);
+			out_nak = false;
+		}
+	}
+
+	if (backend_block_count == transfer_block_count)
+	{
+		end_data_out_stage();
+	}
+}
+
+/** \brief Stores a packet of the data stage of a WRITE(10) in the current sector buffer.
+ */
+static void receive_data(uint16_t byte_count)
+{
+	MscSectorBuffer *buffer = &sector_buffers[usb_block_count % MSC_SECTOR_BUFFER_COUNT];
+
+	if (usb_block_count == transfer_block_count || buffer->full)
+	{
+		// More data than the command carries (or the host ignored the NAK): it is dropped.
+		usb_driver.read_packet(dropped_packet, byte_count);
+		return;
+	}
+
+	// A packet crossing the end of the sector follows a short packet in the middle of the data: the host and the
+	// device disagree on the data stage.
+	if (byte_count > MSC_BLOCK_SIZE - sector_offset)
+	{
+		usb_driver.read_packet(dropped_packet, byte_count);
+
+		if (out_nak)
+		{
+			usb_driver.set_out_endpoint_nak(MSC_OUT_ENDPOINT_NUMBER, false);
+			out_nak = false;
+		}
+
+		end_data_stage(USB_MSC_CSW_STATUS_PHASE_ERROR);
+		return;
+	}
+
+	usb_driver.read_packet(buffer->data + sector_offset, byte_count);
+	sector_offset += byte_count;
+	csw.dCSWDataResidue -= byte_count;
+	written_bytes += byte_count;
+
+	if (sector_offset < MSC_BLOCK_SIZE)
+		return;
+
+	buffer->full = true;
+	sector_offset = 0;
+	usb_block_count++;
+
+	// The host waits while the backend has not emptied the next buffer.
+	if (usb_block_count < transfer_block_count && sector_buffers[usb_block_count % MSC_SECTOR_BUFFER_COUNT].full)
+	{
+		usb_driver.set_out_endpoint_nak(MSC_OUT_ENDPOINT_NUMBER, true);
+		out_nak = true;
+	}
+}
+
+/** \brief Processes a command block wrapper received on the bulk OUT endpoint.
+ */
+static void receive_command(uint16_t byte_count)
+{
+	// Note: The whole packet is popped from the RxFIFO, even if it is not a command block wrapper.
+	usb_driver.read_packet(byte_count == sizeof(cbw) ? (void *)&cbw : dropped_packet, byte_count);
+
+	if (byte_count != sizeof(cbw) || cbw.dCBWSignature != USB_MSC_CBW_SIGNATURE)
+	{
+		// Note: The host must perform a reset recovery (Bulk-Only Mass Storage Reset, then clearing both halts).
+		log_error("MSC invalid command block wrapper.");
+		usb_driver.stall_in_endpoint(MSC_IN_ENDPOINT_NUMBER);
+		usb_driver.stall_out_endpoint(MSC_OUT_ENDPOINT_NUMBER);
+		state = MSC_STATE_RESET_NEEDED;
+		return;
+	}
+
+	if (state == MSC_STATE_STATUS)
+	{
+		// The host collected the status, but its completion was not handled yet.
+		cbw_pending = true;
+		return;
+	}
+
+	process_command();
+}
+
+/** \brief Restores the transport to the state it has after the configuration (no command in progress).
+ */
+static void reset_transport()
+{
+	if (endpoint_busy)
+	{
+		usb_driver.stop_in_endpoint(MSC_IN_ENDPOINT_NUMBER);
+	}
+
+	if (out_nak)
+	{
+		usb_driver.set_out_endpoint_nak(MSC_OUT_ENDPOINT_NUMBER, false);
+	}
+
+	state = MSC_STATE_COMMAND;
+	endpoint_busy = false;
+	out_nak = false;
+	cbw_pending = false;
+	transfer_block_count = 0;
+}
+
+static void reset()
+{
+	reset_transport();
+	set_sense(SCSI_SENSE_NO_SENSE, SCSI_ASC_NONE);
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		MSC_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		MSC_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// The TxFIFO holds a whole sector, so the backend prepares the next one while the host collects its packets.
+	usb_driver.configure_txfifo_size(MSC_IN_ENDPOINT_NUMBER, MSC_BLOCK_SIZE);
+
+	// Note: The endpoints were just configured, there is nothing to flush.
+	endpoint_busy = false;
+	out_nak = false;
+	reset_transport();
+	read_bytes = written_bytes = 0;
+	backend_cycles = 0;
+	throughput_frames = 0;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	uint8_t const request_type = request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK);
+
+	if (request_type == (USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_ENDPOINT))
+	{
+		if (request->bRequest != USB_STANDARD_CLEAR_FEATURE || request->wValue != USB_FEATURE_ENDPOINT_HALT)
+			return false;
+
+		uint8_t endpoint_number = request->wIndex & 0x0F;
+
+		// The endpoints keep stalling until the host resets the transport.
+		if (state != MSC_STATE_RESET_NEEDED)
+		{
+			if (request->wIndex & 0x80)
+			{
+				usb_driver.clear_in_endpoint_stall(endpoint_number);
+			}
+			else
+			{
+				usb_driver.clear_out_endpoint_stall(endpoint_number);
+			}
+		}
+
+		usbd_control_acknowledge();
+
+		if (state == MSC_STATE_STALLED && endpoint_number == MSC_IN_ENDPOINT_NUMBER && (request->wIndex & 0x80))
+		{
+			send_status();
+		}
+
+		return true;
+	}
+
+	if (request_type != (USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE)
+		|| (request->wIndex & 0xFF) != configuration_descriptor_combination.usb_interface_descriptor.bInterfaceNumber)
+		return false;
+
+	// A single logical unit.
+	static const uint8_t max_lun = 0;
+
+	switch (request->bRequest)
+	{
+	case USB_MSC_GET_MAX_LUN:
+		log_info("MSC Get Max LUN request received.");
+		usbd_control_send(&max_lun, sizeof(max_lun));
+		return true;
+	case USB_MSC_BULK_ONLY_RESET:
+		log_info("MSC Bulk-Only Mass Storage Reset request received.");
+		reset_transport();
+		usbd_control_acknowledge();
+		return true;
+	}
+
+	return false;
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	if (endpoint_number != MSC_OUT_ENDPOINT_NUMBER)
+		return;
+
+	switch (state)
+	{
+	case MSC_STATE_COMMAND:
+	case MSC_STATE_STATUS:
+		receive_command(byte_count);
+		break;
+	case MSC_STATE_DATA_OUT:
+		receive_data(byte_count);
+		break;
+	default:
+		// Note: Packets cannot stay in the RxFIFO, so the unexpected ones are dropped.
+		usb_driver.read_packet(dropped_packet, byte_count);
+		break;
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number != MSC_IN_ENDPOINT_NUMBER)
+		return;
+
+	endpoint_busy = false;
+
+	switch (state)
+	{
+	case MSC_STATE_DATA_IN:
+		csw.dCSWDataResidue -= last_in_size;
+		read_bytes += last_in_size;
+
+		if (usb_block_count < transfer_block_count)
+		{
+			send_next_sector();
+		}
+		else
+		{
+			end_data_in_stage();
+		}
+		break;
+	case MSC_STATE_STATUS:
+		state = MSC_STATE_COMMAND;
+		transfer_block_count = 0;
+
+		if (cbw_pending)
+		{
+			cbw_pending = false;
+			process_command();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void polled()
+{
+	switch (state)
+	{
+	case MSC_STATE_DATA_IN:
+		if (transfer_block_count != 0)
+		{
+			process_read();
+		}
+		break;
+	case MSC_STATE_DATA_OUT:
+		process_write();
+		break;
+	case MSC_STATE_FLUSH:
+		process_flush();
+		break;
+	case MSC_STATE_COMMAND:
+		if (block_device_ready && block_device->poll != NULL)
+		{
+			block_device->poll();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++throughput_frames < MSC_THROUGHPUT_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are bytes per second.
+	if (read_bytes != 0 || written_bytes != 0)
+	{
+		log_info("MSC throughput: %lu.%03lu MB/s read, %lu.%03lu MB/s written, backend busy %lu%% of the time.",
+			read_bytes / 1000000, read_bytes / 1000 % 1000, written_bytes / 1000000, written_bytes / 1000 % 1000,
+			backend_cycles / (SystemCoreClock / 100));
+	}
+
+	read_bytes = written_bytes = 0;
+	backend_cycles = 0;
+	throughput_frames = 0;
+}
+
+const UsbClass usbd_msc_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received,
+	.on_poll = &polled
+};
@@ -0,0 +1,106 @@
+#include "Sensor/sensor_adc.h"
+#include "Audio/audio_clock.h"
+
+/// \brief Clock of TIM3 (APB1 at 36 MHz, doubled for the timers).
+#define SENSOR_ADC_TIMER_CLOCK 72000000
+
+/// \brief Count of buffers the DMA completed, and the audio clock at the last one (both written by the interrupt).
+static volatile uint32_t blocks;
+static volatile uint32_t block_timestamp;
+
+/** \brief The DMA switched buffers: the previous one is complete.
+ * \note This is the only interrupt of the acquisition (one per buffer, not per sample); it only counts, the main loop
+ * does the rest.
+ */
+void DMA2_Stream0_IRQHandler()
+{
+	if (READ_BIT(DMA2->LISR, DMA_LISR_TCIF0))
+	{
+		WRITE_REG(DMA2->LIFCR, DMA_LIFCR_CTCIF0);
+		block_timestamp = audio_clock_now();
+		blocks++;
+	}
+}
+
+static void start(uint16_t *buffers[2], uint16_t sample_count)
+{
+	SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_DMA2EN);
+	SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM3EN);
+	SET_BIT(RCC->APB2ENR, RCC_APB2ENR_ADC1EN);
+
+	// Configures PA3 as analog input.
+	MODIFY_REG(GPIOA->MODER,
+		GPIO_MODER_MODER3,
+		_VAL2FLD(GPIO_MODER_MODER3, 3)
+	);
+
+	// ADC clock = APB2 / 4 = 18 MHz; one conversion of channel 3 (15 cycles of sampling) on each rising edge of the
+	// TRGO of TIM3, with a DMA request after each one.
+	MODIFY_REG(ADC->CCR,
+		ADC_CCR_ADCPRE,
+		_VAL2FLD(ADC_CCR_ADCPRE, 1)
+	);
+	MODIFY_REG(ADC1->SMPR2,
+		ADC_SMPR2_SMP3,
+		_VAL2FLD(ADC_SMPR2_SMP3, 1)
+	);
+	WRITE_REG(ADC1->SQR1, 0);
+	WRITE_REG(ADC1->SQR3, _VAL2FLD(ADC_SQR3_SQ1, 3));
+	WRITE_REG(ADC1->CR2,
+		_VAL2FLD(ADC_CR2_EXTEN, 1) | _VAL2FLD(ADC_CR2_EXTSEL, 8) | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_ADON
+	);
+
+	// DMA2 stream 0 (channel 0: ADC1) in double buffer mode: it fills the buffers in turn, and switches on its own.
+	CLEAR_BIT(DMA2_Stream0->CR, DMA_SxCR_EN);
+	while (READ_BIT(DMA2_Stream0->CR, DMA_SxCR_EN));
+	WRITE_REG(DMA2->LIFCR, DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0);
+	WRITE_REG(DMA2_Stream0->PAR, (uint32_t)&ADC1->DR);
+	WRITE_REG(DMA2_Stream0->M0AR, (uint32_t)buffers[0]);
+	WRITE_REG(DMA2_Stream0->M1AR, (uint32_t)buffers[1]);
+	WRITE_REG(DMA2_Stream0->NDTR, sample_count);
+	blocks = 0;
+	WRITE_REG(DMA2_Stream0->CR,
+		_VAL2FLD(DMA_SxCR_CHSEL, 0) | _VAL2FLD(DMA_SxCR_PL, 2) | _VAL2FLD(DMA_SxCR_MSIZE, 1) | _VAL2FLD(DMA_SxCR_PSIZE, 1)
+		| DMA_SxCR_DBM | DMA_SxCR_CIRC | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_EN
+	);
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+
+	// TIM3 sends its update event (TRGO) at the sampling frequency.
+	WRITE_REG(TIM3->PSC, 0);
+	WRITE_REG(TIM3->ARR, SENSOR_ADC_TIMER_CLOCK / SENSOR_ADC_SAMPLE_RATE - 1);
+	MODIFY_REG(TIM3->CR2,
+		TIM_CR2_MMS,
+		_VAL2FLD(TIM_CR2_MMS, 2)
+	);
+	WRITE_REG(TIM3->EGR, TIM_EGR_UG);
+	SET_BIT(TIM3->CR1, TIM_CR1_CEN);
+}
+
+static void stop()
+{
+	CLEAR_BIT(TIM3->CR1, TIM_CR1_CEN);
+	NVIC_DisableIRQ(DMA2_Stream0_IRQn);
+	CLEAR_BIT(DMA2_Stream0->CR, DMA_SxCR_EN);
+	CLEAR_BIT(ADC1->CR2, ADC_CR2_ADON);
+}
+
+static uint32_t completed_blocks(uint32_t *timestamp)
+{
+	uint32_t count;
+
+	// Reads the two values again if the interrupt came in between.
+	do
+	{
+		count = blocks;
+		*timestamp = block_timestamp;
+	} while (count != blocks);
+
+	return count;
+}
+
+const SensorSource sensor_adc = {
+	.sample_rate = SENSOR_ADC_SAMPLE_RATE,
+	.start = &start,
+	.stop = &stop,
+	.completed_blocks = &completed_blocks
+};
@@ -0,0 +1,87 @@
+#include "stdbool.h"
+#include "Sensor/sensor_synthetic.h"
+#include "Audio/audio_clock.h"
+#include "Helpers/math.h"
+
+/// \brief Ticks of the audio clock per sample.
+#define SENSOR_SYNTHETIC_TICKS_PER_SAMPLE (AUDIO_CLOCK_HZ / SENSOR_SYNTHETIC_SAMPLE_RATE)
+
+_Static_assert(AUDIO_CLOCK_HZ % SENSOR_SYNTHETIC_SAMPLE_RATE == 0, "The audio clock is a multiple of the sampling frequency");
+
+static uint16_t *sample_buffers[2];
+static uint16_t block_size;
+static bool running;
+/// \brief Clock of the next sample to produce.
+static uint32_t sample_timestamp;
+/// \brief Count of samples produced since the start.
+static uint32_t sample_index;
+/// \brief Count of samples in the buffer being filled.
+static uint16_t fill;
+static uint32_t blocks;
+static uint32_t block_timestamp;
+
+static void start(uint16_t *buffers[2], uint16_t sample_count)
+{
+	sample_buffers[0] = buffers[0];
+	sample_buffers[1] = buffers[1];
+	block_size = sample_count;
+	sample_timestamp = audio_clock_now();
+	sample_index = 0;
+	fill = 0;
+	blocks = 0;
+	running = true;
+}
+
+static void stop()
+{
+	running = false;
+}
+
+static uint32_t completed_blocks(uint32_t *timestamp)
+{
+	*timestamp = block_timestamp;
+	return blocks;
+}
+
+/** \brief Produces the samples due since the last poll.
+ * \details The clock of the next sample moves by whole samples, so the rate does not drift however often the source
+ * is polled; a late poll produces all the samples it missed (and overwrites the buffers as a DMA would).
+ */
+static void poll()
+{
+	if (!running)
+		return;
+
+	uint32_t due = (audio_clock_now() - sample_timestamp) / SENSOR_SYNTHETIC_TICKS_PER_SAMPLE;
+
+	sample_timestamp += due * SENSOR_SYNTHETIC_TICKS_PER_SAMPLE;
+
+	while (due != 0)
+	{
+		uint16_t count = MIN(due, (uint32_t)(block_size - fill));
+		uint16_t *samples = sample_buffers[blocks % 2] + fill;
+
+		for (uint16_t i = 0; i < count; i++)
+		{
+			samples[i] = sample_index++;
+		}
+
+		fill += count;
+		due -= count;
+
+		if (fill == block_size)
+		{
+			fill = 0;
+			blocks++;
+			block_timestamp = sample_timestamp - due * SENSOR_SYNTHETIC_TICKS_PER_SAMPLE;
+		}
+	}
+}
+
+const SensorSource sensor_synthetic = {
+	.sample_rate = SENSOR_SYNTHETIC_SAMPLE_RATE,
+	.start = &start,
+	.stop = &stop,
+	.completed_blocks = &completed_blocks,
+	.poll = &poll
+};
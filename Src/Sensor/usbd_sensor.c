@@ -0,0 +1,296 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Sensor/usbd_sensor.h"
+#include "Sensor/sensor_synthetic.h"
+#include "Audio/audio_clock.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Count of frames between two logs of the throughput.
+#define SENSOR_REPORT_PERIOD 1000
+/// \brief Ticks of the audio clock per frame of the bus.
+#define SENSOR_TICKS_PER_FRAME (AUDIO_CLOCK_HZ / 1000)
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_VENDOR,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B9,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_VENDOR,
+		.bInterfaceSubClass     = USB_SUBCLASS_VENDOR,
+		.bInterfaceProtocol     = USB_PROTOCOL_VENDOR,
+		.iInterface             = 0
+	},
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = SENSOR_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+#define SENSOR_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+/** \brief A block as sent: the source writes the samples, the function writes the header in front of them.
+ */
+typedef struct
+{
+	SensorBlockHeader header;
+	uint16_t samples[SENSOR_BLOCK_SAMPLE_COUNT];
+} SensorBlock;
+
+_Static_assert(sizeof(SensorBlock) == SENSOR_BLOCK_SIZE, "A block fills its transfer");
+_Static_assert(SENSOR_BLOCK_SIZE % SENSOR_PACKET_SIZE == 0, "A block ends with a full packet (the host reads whole blocks)");
+
+/// \brief The ping-pong blocks.
+static SensorBlock sensor_blocks[2] __attribute__((aligned(4)));
+static SensorSource const *sensor_source = &sensor_synthetic;
+
+static bool configured;
+static bool running;
+static bool in_busy;
+/// \brief Count of completed blocks seen, and whether the last one still waits for the endpoint.
+static uint32_t seen_blocks;
+static bool block_pending;
+/// \brief The clock at the last SOF, and the number of that SOF.
+static uint32_t sof_timestamp;
+static uint16_t sof_frame_number;
+
+static SensorStatistics statistics;
+/// \brief Statistics at the last log (the log shows the differences).
+static SensorStatistics logged_statistics;
+static uint16_t report_frames;
+
+/** \brief Selects the producer of the samples (the synthetic source by default).
+ * \param source The source (e.g. `sensor_adc`); it takes effect at the next \ref SENSOR_START.
+ */
+void usbd_sensor_set_source(SensorSource const *source)
+{
+	sensor_source = source;
+}
+
+/** \brief Takes the block the source completed last: its header is written, and it waits for the endpoint.
+ * \details The source never waits: each block it completes while the previous one still waits overwrites it, so the
+ * waiting block is lost (and so are the blocks completed between two calls but the last one).
+ */
+static void collect_block()
+{
+	uint32_t timestamp;
+	uint32_t completed = sensor_source->completed_blocks(&timestamp);
+
+	if (completed == seen_blocks)
+		return;
+
+	statistics.overruns += completed - seen_blocks - 1 + (block_pending ? 1 : 0);
+	statistics.completed_blocks = completed;
+	seen_blocks = completed;
+
+	// Refers the end of the block to the SOF before it (the last SOF may be a little later than the block).
+	uint32_t sof_offset = timestamp - sof_timestamp;
+	uint16_t frame_number = sof_frame_number;
+
+	if ((int32_t)sof_offset < 0)
+	{
+		sof_offset += SENSOR_TICKS_PER_FRAME;
+		frame_number = (frame_number - 1) & 0x7FF;
+	}
+
+	sensor_blocks[(completed - 1) % 2].header = (SensorBlockHeader){
+		.sequence = completed - 1,
+		.sof_frame_number = frame_number,
+		.sample_count = SENSOR_BLOCK_SAMPLE_COUNT,
+		.sof_offset = sof_offset,
+		.overruns = statistics.overruns
+	};
+	block_pending = true;
+}
+
+/** \brief Writes the waiting block to the TxFIFO, from the buffer the source filled (no copy in between).
+ */
+static void send_block()
+{
+	if (!block_pending || in_busy)
+		return;
+
+	usb_driver.write_transfer(SENSOR_IN_ENDPOINT_NUMBER, &sensor_blocks[(seen_blocks - 1) % 2], sizeof(SensorBlock));
+	in_busy = true;
+	block_pending = false;
+	statistics.sent_blocks++;
+}
+
+static void start()
+{
+	uint16_t *buffers[2] = { sensor_blocks[0].samples, sensor_blocks[1].samples };
+
+	if (running)
+	{
+		sensor_source->stop();
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	logged_statistics = statistics;
+	seen_blocks = 0;
+	block_pending = false;
+	sensor_source->start(buffers, SENSOR_BLOCK_SAMPLE_COUNT);
+	running = true;
+	log_info("Sensor streaming started (%lu samples/s).", sensor_source->sample_rate);
+}
+
+static void stop()
+{
+	if (!running)
+		return;
+
+	sensor_source->stop();
+	running = false;
+	block_pending = false;
+	log_info("Sensor streaming stopped: %lu blocks sent, %lu lost.", statistics.sent_blocks, statistics.overruns);
+}
+
+static void reset()
+{
+	stop();
+	configured = false;
+	in_busy = false;
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		SENSOR_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// A whole block goes into the TxFIFO: the buffer is free for the source as soon as it is written.
+	usb_driver.configure_txfifo_size(SENSOR_IN_ENDPOINT_NUMBER, SENSOR_BLOCK_SIZE);
+
+	// The clock of the timestamps, captured on each SOF.
+	audio_clock_initialize();
+
+	in_busy = false;
+	report_frames = 0;
+	configured = true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIPIENT_DEVICE))
+		return false;
+
+	switch (request->bRequest)
+	{
+	case SENSOR_START:
+		start();
+		usbd_control_acknowledge();
+		return true;
+	case SENSOR_STOP:
+		stop();
+		usbd_control_acknowledge();
+		return true;
+	case SENSOR_GET_STATISTICS:
+		usbd_control_send(&statistics, MIN(sizeof(statistics), request->wLength));
+		return true;
+	}
+
+	return false;
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	in_busy = false;
+
+	if (running)
+	{
+		collect_block();
+		send_block();
+	}
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	sof_timestamp = audio_clock_sof_timestamp();
+	sof_frame_number = frame_number;
+
+	if (++report_frames < SENSOR_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the differences are per second.
+	if (running)
+	{
+		uint32_t sent_blocks = statistics.sent_blocks - logged_statistics.sent_blocks;
+
+		log_info("Sensor: %lu blocks/s, %lu B/s, %lu blocks lost.",
+			sent_blocks, sent_blocks * SENSOR_BLOCK_SIZE, statistics.overruns - logged_statistics.overruns);
+	}
+
+	logged_statistics = statistics;
+	report_frames = 0;
+}
+
+static void polled()
+{
+	if (!configured || !running)
+		return;
+
+	if (sensor_source->poll != NULL)
+	{
+		sensor_source->poll();
+	}
+
+	// Note: The block is sent right after it is collected, well before the source can come back to it.
+	collect_block();
+	send_block();
+}
+
+const UsbClass usbd_sensor_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_poll = &polled
+};
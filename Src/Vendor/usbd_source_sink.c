@@ -0,0 +1,563 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Vendor/usbd_source_sink.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+#include "Helpers/latency.h"
+#include "Helpers/cycle_counter.h"
+#include "Helpers/ring_buffer.h"
+
+/// \brief Count of frames between two logs of the throughput.
+#define SOURCE_SINK_THROUGHPUT_REPORT_PERIOD 1000
+/// \brief Size of the buffer of the bulk loopback (power of two).
+#define SOURCE_SINK_LOOPBACK_BUFFER_SIZE 2048
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_VENDOR,
+    .bDeviceSubClass    = USB_SUBCLASS_NONE,
+    .bDeviceProtocol    = USB_PROTOCOL_NONE,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B3,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceDescriptor usb_interface_descriptor;
+	UsbEndpointDescriptor usb_bulk_in_endpoint_descriptor;
+	UsbEndpointDescriptor usb_bulk_out_endpoint_descriptor;
+	UsbEndpointDescriptor usb_interrupt_in_endpoint_descriptor;
+	UsbEndpointDescriptor usb_interrupt_out_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 1,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 25
+	},
+	.usb_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = 0,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 4,
+		.bInterfaceClass        = USB_CLASS_VENDOR,
+		.bInterfaceSubClass     = USB_SUBCLASS_VENDOR,
+		.bInterfaceProtocol     = USB_PROTOCOL_VENDOR,
+		.iInterface             = 0
+	},
+    .usb_bulk_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = SOURCE_SINK_BULK_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_bulk_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x01,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = SOURCE_SINK_BULK_PACKET_SIZE,
+        .bInterval              = 0
+    },
+    .usb_interrupt_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x82,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = SOURCE_SINK_INTERRUPT_PACKET_SIZE,
+        .bInterval              = 1
+    },
+    .usb_interrupt_out_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x02,
+        .bmAttributes           = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize         = SOURCE_SINK_INTERRUPT_PACKET_SIZE,
+        .bInterval              = 1
+    }
+};
+
+#define BULK_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_bulk_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define BULK_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_bulk_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define INTERRUPT_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_interrupt_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+#define INTERRUPT_OUT_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_interrupt_out_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+_Static_assert(SOURCE_SINK_BULK_TRANSFER_SIZE % SOURCE_SINK_BULK_PACKET_SIZE == 0, "Transfers are made of whole packets");
+_Static_assert((SOURCE_SINK_LOOPBACK_BUFFER_SIZE & (SOURCE_SINK_LOOPBACK_BUFFER_SIZE - 1)) == 0, "The loopback buffer size must be a power of two");
+
+/** \brief The state of the sink of an OUT endpoint.
+ */
+typedef struct
+{
+	/// \brief The counter the next packet should hold (\ref SOURCE_SINK_PATTERN_SEQUENCE).
+	uint32_t expected_sequence;
+	/// \brief Received bytes (points to a counter of `statistics`).
+	uint32_t *sunk_bytes;
+} SourceSinkSink;
+
+static SourceSinkMode mode;
+static SourceSinkPattern pattern;
+/// \brief Whether the sinks check the pattern of the received packets.
+static bool verify;
+static bool configured;
+
+/// \brief The packets the sources send (and the sinks compare with); the SEQUENCE counters are written just before.
+static uint8_t source_buffer[SOURCE_SINK_BULK_TRANSFER_SIZE] __attribute__((aligned(4)));
+/// \brief Receives the packets to verify (or to drop).
+static uint8_t packet[MAX(SOURCE_SINK_BULK_PACKET_SIZE, SOURCE_SINK_INTERRUPT_PACKET_SIZE)] __attribute__((aligned(4)));
+/// \brief The counters of the next packet of the bulk and interrupt sources.
+static uint32_t bulk_sequence, interrupt_sequence;
+static SourceSinkSink bulk_sink, interrupt_sink;
+
+/// \brief Whether a transfer is in the TxFIFO of the bulk IN and the interrupt IN endpoint.
+static bool bulk_in_busy, interrupt_in_busy;
+/// \brief Cycle counter value when the bulk transfer in the TxFIFO was written (source) or its oldest byte received (loopback).
+static uint32_t bulk_in_timestamp;
+/// \brief Size of the bulk transfer in the TxFIFO.
+static uint16_t bulk_in_size;
+
+static uint8_t loopback_storage[SOURCE_SINK_LOOPBACK_BUFFER_SIZE] __attribute__((aligned(4)));
+static RingBuffer loopback_buffer = { .buffer = loopback_storage, .size = sizeof(loopback_storage) };
+/// \brief Cycle counter value when the oldest byte of the loopback buffer was received.
+static uint32_t loopback_timestamp;
+/// \brief Whether the bulk OUT endpoint NAKs because the loopback buffer is full.
+static bool bulk_out_nak;
+/// \brief The packet of the interrupt loopback (the interrupt OUT endpoint NAKs until it is sent back).
+static uint8_t interrupt_loopback_packet[SOURCE_SINK_INTERRUPT_PACKET_SIZE] __attribute__((aligned(4)));
+static uint16_t interrupt_loopback_size;
+static bool interrupt_loopback_full;
+
+/// \brief Buffer of the control write and control read requests.
+static uint8_t control_buffer[SOURCE_SINK_CONTROL_BUFFER_SIZE] __attribute__((aligned(4)));
+static uint16_t control_size;
+
+static SourceSinkStatistics statistics;
+/// \brief The counters at the last log of the throughput.
+static SourceSinkStatistics logged_statistics;
+/// \brief Time the host takes to collect a bulk transfer (source), or to get back its data (loopback).
+static LatencyStatistics bulk_latency;
+static uint16_t throughput_frames;
+
+/** \brief Writes the pattern to the source buffer.
+ */
+static void generate_pattern()
+{
+	for (uint16_t i = 0; i < sizeof(source_buffer); i++)
+	{
+		source_buffer[i] = pattern == SOURCE_SINK_PATTERN_ZERO ? 0 : (i % SOURCE_SINK_BULK_PACKET_SIZE) % 63;
+	}
+}
+
+/** \brief Writes the packet counters to the source buffer (for the SEQUENCE pattern).
+ * \param packet_count Count of packets of the transfer.
+ * \param packet_size Size of the packets.
+ * \param sequence The counter of the source (updated).
+ */
+static void write_sequence(uint8_t packet_count, uint16_t packet_size, uint32_t *sequence)
+{
+	if (pattern != SOURCE_SINK_PATTERN_SEQUENCE)
+		return;
+
+	for (uint8_t i = 0; i < packet_count; i++)
+	{
+		*(uint32_t *)&source_buffer[i * packet_size] = (*sequence)++;
+	}
+}
+
+static void source_bulk()
+{
+	write_sequence(SOURCE_SINK_BULK_TRANSFER_SIZE / SOURCE_SINK_BULK_PACKET_SIZE, SOURCE_SINK_BULK_PACKET_SIZE, &bulk_sequence);
+	usb_driver.write_transfer(BULK_IN_ENDPOINT_NUMBER, source_buffer, SOURCE_SINK_BULK_TRANSFER_SIZE);
+
+	bulk_in_busy = true;
+	bulk_in_size = SOURCE_SINK_BULK_TRANSFER_SIZE;
+	bulk_in_timestamp = cycle_counter_now();
+}
+
+static void source_interrupt()
+{
+	write_sequence(1, SOURCE_SINK_INTERRUPT_PACKET_SIZE, &interrupt_sequence);
+	usb_driver.write_packet(INTERRUPT_IN_ENDPOINT_NUMBER, source_buffer, SOURCE_SINK_INTERRUPT_PACKET_SIZE);
+
+	interrupt_in_busy = true;
+}
+
+/** \brief Counts a received packet, and checks its pattern if asked to.
+ */
+static void sink(SourceSinkSink *sink, uint16_t byte_count)
+{
+	uint16_t size = MIN(byte_count, sizeof(packet));
+
+	usb_driver.read_packet(packet, size);
+	*sink->sunk_bytes += byte_count;
+
+	if (!verify)
+		return;
+
+	uint16_t offset = 0;
+
+	if (pattern == SOURCE_SINK_PATTERN_SEQUENCE && size >= 4)
+	{
+		uint32_t sequence = *(uint32_t *)packet;
+
+		// Note: The counter moves on from the received packet (a packet received twice counts as an error).
+		if (sequence != sink->expected_sequence)
+		{
+			if (sequence > sink->expected_sequence)
+			{
+				statistics.lost_packets += sequence - sink->expected_sequence;
+			}
+			else
+			{
+				statistics.pattern_errors++;
+			}
+		}
+
+		sink->expected_sequence = sequence + 1;
+		offset = 4;
+	}
+
+	if (memcmp(&packet[offset], &source_buffer[offset], size - offset) != 0)
+	{
+		statistics.pattern_errors++;
+	}
+}
+
+/** \brief Sends the data of the loopback buffer back to the host (the contiguous part, up to a transfer).
+ */
+static void loop_back_bulk()
+{
+	void const *region;
+	uint32_t size = MIN(ring_buffer_read_region(&loopback_buffer, &region), SOURCE_SINK_BULK_TRANSFER_SIZE);
+
+	if (bulk_in_busy || size == 0)
+		return;
+
+	// The TxFIFO is written synchronously, so the data can be released right away.
+	usb_driver.write_transfer(BULK_IN_ENDPOINT_NUMBER, region, size);
+	ring_buffer_commit_read(&loopback_buffer, size);
+
+	bulk_in_busy = true;
+	bulk_in_size = size;
+	bulk_in_timestamp = loopback_timestamp;
+	// Note: The rest of the buffer arrived later than its oldest byte; the next transfer underestimates a little.
+	loopback_timestamp = cycle_counter_now();
+
+	if (bulk_out_nak && ring_buffer_free(&loopback_buffer) >= SOURCE_SINK_BULK_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(BULK_OUT_ENDPOINT_NUMBER, false);
+		bulk_out_nak = false;
+	}
+}
+
+static void receive_bulk_loopback(uint16_t byte_count)
+{
+	void *region;
+	uint16_t size = MIN(byte_count, SOURCE_SINK_BULK_PACKET_SIZE);
+
+	if (ring_buffer_used(&loopback_buffer) == 0)
+	{
+		loopback_timestamp = cycle_counter_now();
+	}
+
+	// Reads the packet straight into the buffer when it fits in the contiguous free region.
+	if (ring_buffer_write_region(&loopback_buffer, &region) >= size)
+	{
+		usb_driver.read_packet(region, size);
+		ring_buffer_commit_write(&loopback_buffer, size);
+	}
+	else
+	{
+		usb_driver.read_packet(packet, size);
+		ring_buffer_write(&loopback_buffer, packet, size);
+	}
+
+	statistics.looped_bytes += size;
+
+	if (ring_buffer_free(&loopback_buffer) < SOURCE_SINK_BULK_PACKET_SIZE)
+	{
+		usb_driver.set_out_endpoint_nak(BULK_OUT_ENDPOINT_NUMBER, true);
+		bulk_out_nak = true;
+	}
+
+	loop_back_bulk();
+}
+
+static void loop_back_interrupt()
+{
+	if (interrupt_in_busy || !interrupt_loopback_full)
+		return;
+
+	usb_driver.write_packet(INTERRUPT_IN_ENDPOINT_NUMBER, interrupt_loopback_packet, interrupt_loopback_size);
+	interrupt_in_busy = true;
+	interrupt_loopback_full = false;
+	usb_driver.set_out_endpoint_nak(INTERRUPT_OUT_ENDPOINT_NUMBER, false);
+}
+
+static void receive_interrupt_loopback(uint16_t byte_count)
+{
+	interrupt_loopback_size = MIN(byte_count, sizeof(interrupt_loopback_packet));
+	usb_driver.read_packet(interrupt_loopback_packet, interrupt_loopback_size);
+	statistics.looped_bytes += interrupt_loopback_size;
+
+	// The host waits until the packet is sent back.
+	interrupt_loopback_full = true;
+	usb_driver.set_out_endpoint_nak(INTERRUPT_OUT_ENDPOINT_NUMBER, true);
+	loop_back_interrupt();
+}
+
+/** \brief Drops the data in flight and starts the selected mode (the sources fill their endpoints again).
+ */
+static void start_mode()
+{
+	if (!configured)
+		return;
+
+	if (bulk_in_busy)
+	{
+		usb_driver.stop_in_endpoint(BULK_IN_ENDPOINT_NUMBER);
+	}
+
+	if (interrupt_in_busy)
+	{
+		usb_driver.stop_in_endpoint(INTERRUPT_IN_ENDPOINT_NUMBER);
+	}
+
+	bulk_in_busy = interrupt_in_busy = false;
+	ring_buffer_clear(&loopback_buffer);
+	interrupt_loopback_full = false;
+	bulk_out_nak = false;
+	usb_driver.set_out_endpoint_nak(BULK_OUT_ENDPOINT_NUMBER, false);
+	usb_driver.set_out_endpoint_nak(INTERRUPT_OUT_ENDPOINT_NUMBER, false);
+
+	bulk_sequence = interrupt_sequence = 0;
+	bulk_sink.expected_sequence = interrupt_sink.expected_sequence = 0;
+	generate_pattern();
+
+	if (mode == SOURCE_SINK_MODE_SOURCE_SINK)
+	{
+		source_bulk();
+		source_interrupt();
+	}
+}
+
+static void reset_statistics()
+{
+	memset(&statistics, 0, sizeof(statistics));
+	logged_statistics = statistics;
+	latency_reset(&bulk_latency);
+	throughput_frames = 0;
+}
+
+static void reset()
+{
+	configured = false;
+	bulk_in_busy = interrupt_in_busy = false;
+	mode = SOURCE_SINK_MODE_SOURCE_SINK;
+	pattern = SOURCE_SINK_PATTERN_MOD63;
+	verify = true;
+	bulk_sink.sunk_bytes = &statistics.bulk_sunk_bytes;
+	interrupt_sink.sunk_bytes = &statistics.interrupt_sunk_bytes;
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		BULK_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_bulk_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_bulk_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		BULK_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_bulk_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_bulk_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_in_endpoint(
+		INTERRUPT_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_interrupt_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_interrupt_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	usb_driver.configure_out_endpoint(
+		INTERRUPT_OUT_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_interrupt_out_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_interrupt_out_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// A whole transfer fits in the TxFIFO, so the host reads 8 packets back to back.
+	usb_driver.configure_txfifo_size(BULK_IN_ENDPOINT_NUMBER, SOURCE_SINK_BULK_TRANSFER_SIZE);
+
+	configured = true;
+	reset_statistics();
+	start_mode();
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	if ((request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK))
+		!= (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIPIENT_DEVICE))
+		return false;
+
+	switch (request->bRequest)
+	{
+	case SOURCE_SINK_SET_MODE:
+		if (request->wValue > SOURCE_SINK_MODE_LOOPBACK)
+			return false;
+
+		log_info("Source/sink mode %d selected.", request->wValue);
+		mode = request->wValue;
+		start_mode();
+		usbd_control_acknowledge();
+		return true;
+	case SOURCE_SINK_SET_PATTERN:
+		if (request->wValue > SOURCE_SINK_PATTERN_SEQUENCE)
+			return false;
+
+		log_info("Source/sink pattern %d selected.", request->wValue);
+		pattern = request->wValue;
+		start_mode();
+		usbd_control_acknowledge();
+		return true;
+	case SOURCE_SINK_SET_VERIFY:
+		verify = request->wValue != 0;
+		usbd_control_acknowledge();
+		return true;
+	case SOURCE_SINK_GET_STATISTICS:
+		usbd_control_send(&statistics, MIN(sizeof(statistics), request->wLength));
+		return true;
+	case SOURCE_SINK_RESET_STATISTICS:
+		reset_statistics();
+		usbd_control_acknowledge();
+		return true;
+	case SOURCE_SINK_CONTROL_WRITE:
+		if (request->wLength > sizeof(control_buffer))
+			return false;
+
+		control_size = request->wLength;
+		usbd_control_receive(control_buffer, control_size);
+		return true;
+	case SOURCE_SINK_CONTROL_READ:
+		usbd_control_send(control_buffer, MIN(control_size, request->wLength));
+		return true;
+	}
+
+	return false;
+}
+
+static void out_data_received(uint8_t endpoint_number, uint16_t byte_count)
+{
+	if (endpoint_number == BULK_OUT_ENDPOINT_NUMBER)
+	{
+		if (mode == SOURCE_SINK_MODE_LOOPBACK)
+		{
+			receive_bulk_loopback(byte_count);
+		}
+		else
+		{
+			sink(&bulk_sink, byte_count);
+		}
+	}
+	else if (endpoint_number == INTERRUPT_OUT_ENDPOINT_NUMBER)
+	{
+		if (mode == SOURCE_SINK_MODE_LOOPBACK && !interrupt_loopback_full)
+		{
+			receive_interrupt_loopback(byte_count);
+		}
+		else
+		{
+			sink(&interrupt_sink, byte_count);
+		}
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	if (endpoint_number == BULK_IN_ENDPOINT_NUMBER)
+	{
+		bulk_in_busy = false;
+		latency_record(&bulk_latency, bulk_in_timestamp, cycle_counter_now());
+
+		if (mode == SOURCE_SINK_MODE_LOOPBACK)
+		{
+			loop_back_bulk();
+		}
+		else
+		{
+			statistics.bulk_sourced_bytes += bulk_in_size;
+			source_bulk();
+		}
+	}
+	else if (endpoint_number == INTERRUPT_IN_ENDPOINT_NUMBER)
+	{
+		interrupt_in_busy = false;
+
+		if (mode == SOURCE_SINK_MODE_LOOPBACK)
+		{
+			loop_back_interrupt();
+		}
+		else
+		{
+			statistics.interrupt_sourced_bytes += SOURCE_SINK_INTERRUPT_PACKET_SIZE;
+			source_interrupt();
+		}
+	}
+}
+
+static void sof_received(uint16_t frame_number)
+{
+	if (++throughput_frames < SOURCE_SINK_THROUGHPUT_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the differences are bytes per second.
+	uint32_t bulk_in = statistics.bulk_sourced_bytes - logged_statistics.bulk_sourced_bytes;
+	uint32_t bulk_out = statistics.bulk_sunk_bytes - logged_statistics.bulk_sunk_bytes;
+	uint32_t looped = statistics.looped_bytes - logged_statistics.looped_bytes;
+
+	if (bulk_in != 0 || bulk_out != 0 || looped != 0)
+	{
+		log_info("Source/sink throughput: bulk IN %lu.%03lu MB/s, bulk OUT %lu.%03lu MB/s, loopback %lu.%03lu MB/s, interrupt IN %lu B/s, interrupt OUT %lu B/s (%lu pattern errors, %lu lost packets).",
+			bulk_in / 1000000, bulk_in / 1000 % 1000, bulk_out / 1000000, bulk_out / 1000 % 1000,
+			looped / 1000000, looped / 1000 % 1000,
+			statistics.interrupt_sourced_bytes - logged_statistics.interrupt_sourced_bytes,
+			statistics.interrupt_sunk_bytes - logged_statistics.interrupt_sunk_bytes,
+			statistics.pattern_errors, statistics.lost_packets);
+		latency_log(mode == SOURCE_SINK_MODE_LOOPBACK ? "Bulk loopback" : "Bulk source", &bulk_latency);
+	}
+
+	logged_statistics = statistics;
+	latency_reset(&bulk_latency);
+	throughput_frames = 0;
+}
+
+const UsbClass usbd_source_sink_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_out_data_received = &out_data_received
+};
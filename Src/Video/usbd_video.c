@@ -0,0 +1,678 @@
+#include "stddef.h"
+#include "stdbool.h"
+#include "string.h"
+#include "Video/usbd_video.h"
+#include "Video/usb_video_standards.h"
+#include "Video/video_pattern.h"
+#include "Audio/audio_clock.h"
+#include "usbd_framework.h"
+#include "Helpers/logger.h"
+#include "Helpers/math.h"
+
+/// \brief Count of frames between two logs of the statistics.
+#define VIDEO_REPORT_PERIOD 1000
+/// \brief Maximum packet size of the bulk IN endpoint.
+#define VIDEO_PACKET_SIZE 64
+/// \brief Duration of a frame of the bus in the 100 ns units of the frame intervals.
+#define VIDEO_BUS_FRAME_INTERVAL 10000
+/// \brief The frame intervals (30, 15 and 10 frames per second) in 100 ns units.
+#define VIDEO_INTERVAL_30_FPS 333333
+#define VIDEO_INTERVAL_15_FPS 666667
+#define VIDEO_INTERVAL_10_FPS 1000000
+/// \brief Count of pixels the bars move between two frames.
+#define VIDEO_SCROLL_STEP 8
+/// \brief Size of an uncompressed frame in bytes.
+#define VIDEO_UNCOMPRESSED_FRAME_SIZE (VIDEO_UNCOMPRESSED_WIDTH * VIDEO_UNCOMPRESSED_HEIGHT * 2)
+
+_Static_assert((VIDEO_PAYLOAD_SIZE - sizeof(UsbVideoPayloadHeader)) % 4 == 0, "The payloads carry whole YUY2 pixel pairs");
+_Static_assert(VIDEO_UNCOMPRESSED_FRAME_SIZE % 4 == 0, "A frame is made of whole YUY2 pixel pairs");
+_Static_assert(VIDEO_MJPEG_WIDTH % 16 == 0 && VIDEO_MJPEG_HEIGHT % 8 == 0, "A JPEG frame is made of whole MCUs");
+
+static const UsbDeviceDescriptor device_descriptor = {
+    .bLength            = sizeof(UsbDeviceDescriptor),
+    .bDescriptorType    = USB_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB             = 0x0200, // 0xJJMN
+    .bDeviceClass       = USB_CLASS_IAD,
+    .bDeviceSubClass    = USB_SUBCLASS_IAD,
+    .bDeviceProtocol    = USB_PROTOCOL_IAD,
+    .bMaxPacketSize0    = 8,
+    .idVendor           = 0x6666,
+    .idProduct          = 0x13B8,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0,
+    .iProduct           = 0,
+    .iSerialNumber      = 0,
+    .bNumConfigurations = 1,
+};
+
+typedef struct {
+	UsbVideoControlHeaderDescriptor header;
+	UsbVideoCameraTerminalDescriptor camera_terminal;
+	UsbVideoOutputTerminalDescriptor output_terminal;
+} __attribute__((__packed__)) UsbVideoControlDescriptors;
+
+typedef struct {
+	UsbVideoStreamingInputHeaderDescriptor input_header;
+	UsbVideoUncompressedFormatDescriptor uncompressed_format;
+	UsbVideoFrameDescriptor uncompressed_frame;
+	UsbVideoMjpegFormatDescriptor mjpeg_format;
+	UsbVideoFrameDescriptor mjpeg_frame;
+} __attribute__((__packed__)) UsbVideoStreamingDescriptors;
+
+typedef struct {
+	UsbConfigurationDescriptor usb_configuration_descriptor;
+	UsbInterfaceAssociationDescriptor usb_interface_association_descriptor;
+	UsbInterfaceDescriptor usb_control_interface_descriptor;
+	UsbVideoControlDescriptors usb_video_control_descriptors;
+	UsbInterfaceDescriptor usb_streaming_interface_descriptor;
+	UsbVideoStreamingDescriptors usb_video_streaming_descriptors;
+	UsbEndpointDescriptor usb_in_endpoint_descriptor;
+} UsbConfigurationDescriptorCombination;
+
+#define VIDEO_CONTROL_INTERFACE 0
+#define VIDEO_STREAMING_INTERFACE 1
+
+#define VIDEO_CAMERA_TERMINAL_ID 1
+#define VIDEO_OUTPUT_TERMINAL_ID 2
+
+#define VIDEO_FORMAT_UNCOMPRESSED 1
+#define VIDEO_FORMAT_MJPEG 2
+
+static const UsbConfigurationDescriptorCombination configuration_descriptor_combination = {
+	.usb_configuration_descriptor = {
+		.bLength                = sizeof(UsbConfigurationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_CONFIGURATION,
+		.wTotalLength           = sizeof(UsbConfigurationDescriptorCombination),
+		.bNumInterfaces         = 2,
+		.bConfigurationValue    = 1,
+		.iConfiguration         = 0,
+		.bmAttributes           = 0x80 | 0x40,
+		.bMaxPower              = 50
+	},
+	.usb_interface_association_descriptor = {
+		.bLength                = sizeof(UsbInterfaceAssociationDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFASEASSOC,
+		.bFirstInterface        = VIDEO_CONTROL_INTERFACE,
+		.bInterfaceCount        = 2,
+		.bFunctionClass         = USB_CLASS_VIDEO,
+		.bFunctionSubClass      = USB_VIDEO_SUBCLASS_INTERFACE_COLLECTION,
+		.bFunctionProtocol      = USB_PROTOCOL_NONE,
+		.iFunction              = 0
+	},
+	.usb_control_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = VIDEO_CONTROL_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 0,
+		.bInterfaceClass        = USB_CLASS_VIDEO,
+		.bInterfaceSubClass     = USB_VIDEO_SUBCLASS_VIDEOCONTROL,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_video_control_descriptors = {
+		.header = {
+			.bLength            = sizeof(UsbVideoControlHeaderDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VC_HEADER,
+			.bcdUVC             = 0x0110,
+			.wTotalLength       = sizeof(UsbVideoControlDescriptors),
+			.dwClockFrequency   = AUDIO_CLOCK_HZ,
+			.bInCollection      = 1,
+			.baInterfaceNr      = { VIDEO_STREAMING_INTERFACE }
+		},
+		.camera_terminal = {
+			.bLength            = sizeof(UsbVideoCameraTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VC_INPUT_TERMINAL,
+			.bTerminalID        = VIDEO_CAMERA_TERMINAL_ID,
+			.wTerminalType      = USB_VIDEO_TERMINAL_CAMERA,
+			.bAssocTerminal     = 0,
+			.iTerminal          = 0,
+			.bControlSize       = 3,
+			.bmControls         = { 0, 0, 0 }
+		},
+		.output_terminal = {
+			.bLength            = sizeof(UsbVideoOutputTerminalDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VC_OUTPUT_TERMINAL,
+			.bTerminalID        = VIDEO_OUTPUT_TERMINAL_ID,
+			.wTerminalType      = USB_VIDEO_TERMINAL_STREAMING,
+			.bAssocTerminal     = 0,
+			.bSourceID          = VIDEO_CAMERA_TERMINAL_ID,
+			.iTerminal          = 0
+		}
+	},
+	.usb_streaming_interface_descriptor = {
+		.bLength                = sizeof(UsbInterfaceDescriptor),
+		.bDescriptorType        = USB_DESCRIPTOR_TYPE_INTERFACE,
+		.bInterfaceNumber       = VIDEO_STREAMING_INTERFACE,
+		.bAlternateSetting      = 0,
+		.bNumEndpoints          = 1,
+		.bInterfaceClass        = USB_CLASS_VIDEO,
+		.bInterfaceSubClass     = USB_VIDEO_SUBCLASS_VIDEOSTREAMING,
+		.bInterfaceProtocol     = USB_PROTOCOL_NONE,
+		.iInterface             = 0
+	},
+	.usb_video_streaming_descriptors = {
+		.input_header = {
+			.bLength            = sizeof(UsbVideoStreamingInputHeaderDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VS_INPUT_HEADER,
+			.bNumFormats        = 2,
+			.wTotalLength       = sizeof(UsbVideoStreamingDescriptors),
+			.bEndpointAddress   = 0x81,
+			.bmInfo             = 0,
+			.bTerminalLink      = VIDEO_OUTPUT_TERMINAL_ID,
+			.bStillCaptureMethod = 0,
+			.bTriggerSupport    = 0,
+			.bTriggerUsage      = 0,
+			.bControlSize       = 1,
+			.bmaControls        = { 0, 0 }
+		},
+		.uncompressed_format = {
+			.bLength            = sizeof(UsbVideoUncompressedFormatDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VS_FORMAT_UNCOMPRESSED,
+			.bFormatIndex       = VIDEO_FORMAT_UNCOMPRESSED,
+			.bNumFrameDescriptors = 1,
+			// YUY2: 32595559-0000-0010-8000-00AA00389B71.
+			.guidFormat         = { 'Y', 'U', 'Y', '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 },
+			.bBitsPerPixel      = 16,
+			.bDefaultFrameIndex = 1,
+			.bAspectRatioX      = 0,
+			.bAspectRatioY      = 0,
+			.bmInterlaceFlags   = 0,
+			.bCopyProtect       = 0
+		},
+		.uncompressed_frame = {
+			.bLength            = sizeof(UsbVideoFrameDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VS_FRAME_UNCOMPRESSED,
+			.bFrameIndex        = 1,
+			.bmCapabilities     = 0,
+			.wWidth             = VIDEO_UNCOMPRESSED_WIDTH,
+			.wHeight            = VIDEO_UNCOMPRESSED_HEIGHT,
+			.dwMinBitRate       = VIDEO_UNCOMPRESSED_FRAME_SIZE * 8 * 10,
+			.dwMaxBitRate       = VIDEO_UNCOMPRESSED_FRAME_SIZE * 8 * 30,
+			.dwMaxVideoFrameBufferSize = VIDEO_UNCOMPRESSED_FRAME_SIZE,
+			.dwDefaultFrameInterval = VIDEO_INTERVAL_30_FPS,
+			.bFrameIntervalType = 3,
+			.dwFrameInterval    = { VIDEO_INTERVAL_30_FPS, VIDEO_INTERVAL_15_FPS, VIDEO_INTERVAL_10_FPS }
+		},
+		.mjpeg_format = {
+			.bLength            = sizeof(UsbVideoMjpegFormatDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VS_FORMAT_MJPEG,
+			.bFormatIndex       = VIDEO_FORMAT_MJPEG,
+			.bNumFrameDescriptors = 1,
+			.bmFlags            = 0,
+			.bDefaultFrameIndex = 1,
+			.bAspectRatioX      = 0,
+			.bAspectRatioY      = 0,
+			.bmInterlaceFlags   = 0,
+			.bCopyProtect       = 0
+		},
+		.mjpeg_frame = {
+			.bLength            = sizeof(UsbVideoFrameDescriptor),
+			.bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+			.bDescriptorSubtype = USB_VIDEO_VS_FRAME_MJPEG,
+			.bFrameIndex        = 1,
+			.bmCapabilities     = 0,
+			.wWidth             = VIDEO_MJPEG_WIDTH,
+			.wHeight            = VIDEO_MJPEG_HEIGHT,
+			.dwMinBitRate       = VIDEO_MJPEG_BUFFER_SIZE * 8 * 10,
+			.dwMaxBitRate       = VIDEO_MJPEG_BUFFER_SIZE * 8 * 30,
+			.dwMaxVideoFrameBufferSize = VIDEO_MJPEG_BUFFER_SIZE,
+			.dwDefaultFrameInterval = VIDEO_INTERVAL_30_FPS,
+			.bFrameIntervalType = 3,
+			.dwFrameInterval    = { VIDEO_INTERVAL_30_FPS, VIDEO_INTERVAL_15_FPS, VIDEO_INTERVAL_10_FPS }
+		}
+	},
+    .usb_in_endpoint_descriptor = {
+        .bLength                = sizeof(UsbEndpointDescriptor),
+        .bDescriptorType        = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress       = 0x81,
+        .bmAttributes           = USB_ENDPOINT_TYPE_BULK,
+        .wMaxPacketSize         = VIDEO_PACKET_SIZE,
+        .bInterval              = 0
+    }
+};
+
+#define VIDEO_IN_ENDPOINT_NUMBER (configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress & 0x0F)
+
+typedef struct
+{
+	uint32_t frames;
+	/// \brief Frames that were due while the previous one was still being sent (they started late).
+	uint32_t late_frames;
+	/// \brief Frames that never started: the next one was due before.
+	uint32_t skipped_frames;
+	uint32_t payloads;
+	uint32_t bytes;
+} VideoStatistics;
+
+/// \brief The frame intervals of both formats, shortest first.
+static const uint32_t frame_intervals[3] = { VIDEO_INTERVAL_30_FPS, VIDEO_INTERVAL_15_FPS, VIDEO_INTERVAL_10_FPS };
+
+static bool configured;
+/// \brief The parameters under negotiation, and the ones of the stream.
+static UsbVideoProbeCommitControl probe, commit;
+static UsbVideoProbeCommitControl received_control;
+static bool streaming;
+
+/// \brief Time since the last frame was due, in 100 ns units.
+static uint32_t pacer_time;
+/// \brief Whether a frame is due, and the clock at the SOF it became due (its presentation time).
+static bool frame_due;
+static uint32_t due_timestamp;
+/// \brief The clock at the last SOF, and the number of that SOF.
+static uint32_t sof_timestamp;
+static uint16_t sof_frame_number;
+
+/// \brief The frame being sent: its size, the offset of its next payload, its FID and its presentation time.
+static bool frame_active;
+static uint32_t frame_size, frame_offset;
+static uint8_t frame_id;
+static uint32_t presentation_time;
+static uint16_t scroll;
+static uint8_t mjpeg_frame[VIDEO_MJPEG_BUFFER_SIZE];
+
+static uint8_t payload[VIDEO_PAYLOAD_SIZE] __attribute__((aligned(4)));
+static bool in_busy, zero_length_packet_pending;
+
+static VideoStatistics statistics;
+static uint16_t report_frames;
+
+/** \brief Returns the supported frame interval closest to the one asked for (the default one for 0).
+ */
+static uint32_t closest_frame_interval(uint32_t frame_interval)
+{
+	if (frame_interval == 0)
+		return VIDEO_INTERVAL_30_FPS;
+
+	uint32_t closest = frame_intervals[0];
+
+	for (uint8_t i = 1; i < sizeof(frame_intervals) / sizeof(frame_intervals[0]); i++)
+	{
+		uint32_t distance = frame_intervals[i] > frame_interval ? frame_intervals[i] - frame_interval : frame_interval - frame_intervals[i];
+		uint32_t closest_distance = closest > frame_interval ? closest - frame_interval : frame_interval - closest;
+
+		if (distance < closest_distance)
+		{
+			closest = frame_intervals[i];
+		}
+	}
+
+	return closest;
+}
+
+/** \brief Answers the parameters asked for by the host with the closest ones the device supports.
+ * \param request The parameters of the host (a format, a frame and a frame interval).
+ * \param result Receives the parameters of the device.
+ */
+static void negotiate(UsbVideoProbeCommitControl const *request, UsbVideoProbeCommitControl *result)
+{
+	uint8_t format_index = request->bFormatIndex == VIDEO_FORMAT_MJPEG ? VIDEO_FORMAT_MJPEG : VIDEO_FORMAT_UNCOMPRESSED;
+
+	*result = (UsbVideoProbeCommitControl){
+		.bmHint = request->bmHint,
+		.bFormatIndex = format_index,
+		.bFrameIndex = 1,
+		.dwFrameInterval = closest_frame_interval(request->dwFrameInterval),
+		// A frame is generated at the SOF it is due.
+		.wDelay = 1,
+		.dwMaxVideoFrameSize = format_index == VIDEO_FORMAT_MJPEG ? VIDEO_MJPEG_BUFFER_SIZE : VIDEO_UNCOMPRESSED_FRAME_SIZE,
+		.dwMaxPayloadTransferSize = VIDEO_PAYLOAD_SIZE,
+		.dwClockFrequency = AUDIO_CLOCK_HZ,
+		.bmFramingInfo = USB_VIDEO_HEADER_FID | USB_VIDEO_HEADER_EOF,
+		.bPreferedVersion = 1,
+		.bMinVersion = 1,
+		.bMaxVersion = 1
+	};
+}
+
+/** \brief Writes the next payload of the frame being sent to the TxFIFO: a header, then the data of the frame.
+ * \details A payload shorter than \ref VIDEO_PAYLOAD_SIZE ends its bulk transfer, so one made of full packets is
+ * followed by a zero length packet.
+ */
+static void send_payload()
+{
+	if (in_busy)
+		return;
+
+	if (zero_length_packet_pending)
+	{
+		usb_driver.write_packet(VIDEO_IN_ENDPOINT_NUMBER, NULL, 0);
+		zero_length_packet_pending = false;
+		in_busy = true;
+		return;
+	}
+
+	if (!frame_active)
+		return;
+
+	UsbVideoPayloadHeader *header = (UsbVideoPayloadHeader *)payload;
+	uint32_t size = MIN(frame_size - frame_offset, sizeof(payload) - sizeof(UsbVideoPayloadHeader));
+	bool end_of_frame = frame_offset + size == frame_size;
+
+	*header = (UsbVideoPayloadHeader){
+		.bHeaderLength = sizeof(UsbVideoPayloadHeader),
+		.bmHeaderInfo = USB_VIDEO_HEADER_EOH | USB_VIDEO_HEADER_PTS | USB_VIDEO_HEADER_SCR | frame_id
+			| (end_of_frame ? USB_VIDEO_HEADER_EOF : 0),
+		.dwPresentationTime = presentation_time,
+		.dwSourceTimeClock = sof_timestamp,
+		.wSofCounter = sof_frame_number
+	};
+
+	if (commit.bFormatIndex == VIDEO_FORMAT_MJPEG)
+	{
+		memcpy(header + 1, mjpeg_frame + frame_offset, size);
+	}
+	else
+	{
+		video_pattern_yuy2((uint8_t *)(header + 1), frame_offset, size, VIDEO_UNCOMPRESSED_WIDTH, scroll);
+	}
+
+	uint16_t payload_size = sizeof(UsbVideoPayloadHeader) + size;
+
+	usb_driver.write_transfer(VIDEO_IN_ENDPOINT_NUMBER, payload, payload_size);
+	in_busy = true;
+	zero_length_packet_pending = payload_size < sizeof(payload) && payload_size % VIDEO_PACKET_SIZE == 0;
+	frame_offset += size;
+	statistics.payloads++;
+	statistics.bytes += payload_size;
+
+	if (end_of_frame)
+	{
+		frame_active = false;
+		statistics.frames++;
+	}
+}
+
+/** \brief Starts the frame that is due: the pattern moves, the FID toggles.
+ */
+static void start_frame()
+{
+	frame_due = false;
+	frame_id ^= USB_VIDEO_HEADER_FID;
+	presentation_time = due_timestamp;
+
+	if (commit.bFormatIndex == VIDEO_FORMAT_MJPEG)
+	{
+		scroll = (scroll + VIDEO_SCROLL_STEP) % VIDEO_MJPEG_WIDTH;
+		frame_size = video_pattern_mjpeg(mjpeg_frame, sizeof(mjpeg_frame), VIDEO_MJPEG_WIDTH, VIDEO_MJPEG_HEIGHT, scroll);
+
+		if (frame_size == 0)
+		{
+			log_error("UVC MJPEG frame larger than %lu bytes.", (uint32_t)sizeof(mjpeg_frame));
+			statistics.skipped_frames++;
+			return;
+		}
+	}
+	else
+	{
+		scroll = (scroll + VIDEO_SCROLL_STEP) % VIDEO_UNCOMPRESSED_WIDTH;
+		frame_size = VIDEO_UNCOMPRESSED_FRAME_SIZE;
+	}
+
+	frame_offset = 0;
+	frame_active = true;
+}
+
+static void stop_streaming()
+{
+	if (in_busy)
+	{
+		usb_driver.stop_in_endpoint(VIDEO_IN_ENDPOINT_NUMBER);
+	}
+
+	streaming = false;
+	in_busy = false;
+	zero_length_packet_pending = false;
+	frame_active = false;
+	frame_due = false;
+}
+
+/** \brief Starts the stream with the committed parameters (the first frame is due at the next SOF).
+ */
+static void start_streaming()
+{
+	stop_streaming();
+
+	pacer_time = commit.dwFrameInterval;
+	frame_id = 0;
+	scroll = 0;
+	streaming = true;
+
+	log_info("UVC streaming %s, frame interval %lu us.",
+		commit.bFormatIndex == VIDEO_FORMAT_MJPEG ? "MJPEG" : "YUY2", commit.dwFrameInterval / 10);
+}
+
+static void reset()
+{
+	configured = false;
+	streaming = false;
+	in_busy = false;
+	zero_length_packet_pending = false;
+	frame_active = false;
+	frame_due = false;
+}
+
+static void configure()
+{
+	usb_driver.configure_in_endpoint(
+		VIDEO_IN_ENDPOINT_NUMBER,
+		(configuration_descriptor_combination.usb_in_endpoint_descriptor.bmAttributes & 0x03),
+		configuration_descriptor_combination.usb_in_endpoint_descriptor.wMaxPacketSize
+	);
+
+	// A payload goes into the TxFIFO at once: the next one is built while the host collects its packets.
+	usb_driver.configure_txfifo_size(VIDEO_IN_ENDPOINT_NUMBER, VIDEO_PAYLOAD_SIZE);
+
+	// The clock of the timestamps, captured on each SOF.
+	audio_clock_initialize();
+
+	negotiate(&(UsbVideoProbeCommitControl){ .bFormatIndex = VIDEO_FORMAT_UNCOMPRESSED }, &probe);
+	commit = probe;
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+	configured = true;
+}
+
+/** \brief Handles the requests of the probe and commit controls.
+ */
+static bool streaming_request(UsbRequest const *request)
+{
+	static UsbVideoProbeCommitControl control;
+	static uint16_t length = sizeof(UsbVideoProbeCommitControl);
+	static uint8_t info = USB_VIDEO_INFO_GET | USB_VIDEO_INFO_SET;
+	uint8_t const selector = request->wValue >> 8;
+
+	if (selector != USB_VIDEO_VS_PROBE_CONTROL && selector != USB_VIDEO_VS_COMMIT_CONTROL)
+		return false;
+
+	switch (request->bRequest)
+	{
+	case USB_VIDEO_SET_CUR:
+		// Note: A host of version 1.0 sends the first 26 bytes only.
+		memset(&received_control, 0, sizeof(received_control));
+		usbd_control_receive(&received_control, sizeof(received_control));
+		return true;
+	case USB_VIDEO_GET_CUR:
+		usbd_control_send(selector == USB_VIDEO_VS_PROBE_CONTROL ? &probe : &commit, sizeof(UsbVideoProbeCommitControl));
+		return true;
+	case USB_VIDEO_GET_LEN:
+		usbd_control_send(&length, sizeof(length));
+		return true;
+	case USB_VIDEO_GET_INFO:
+		usbd_control_send(&info, sizeof(info));
+		return true;
+	}
+
+	if (selector != USB_VIDEO_VS_PROBE_CONTROL)
+		return false;
+
+	// The limits of the format and frame under negotiation.
+	control = probe;
+
+	switch (request->bRequest)
+	{
+	case USB_VIDEO_GET_MIN:
+		control.dwFrameInterval = frame_intervals[0];
+		break;
+	case USB_VIDEO_GET_MAX:
+		control.dwFrameInterval = frame_intervals[sizeof(frame_intervals) / sizeof(frame_intervals[0]) - 1];
+		break;
+	case USB_VIDEO_GET_DEF:
+		negotiate(&(UsbVideoProbeCommitControl){ .bFormatIndex = VIDEO_FORMAT_UNCOMPRESSED }, &control);
+		break;
+	default:
+		return false;
+	}
+
+	usbd_control_send(&control, sizeof(control));
+	return true;
+}
+
+static bool setup_request(UsbRequest const *request)
+{
+	static uint8_t alternate_setting = 0;
+	uint8_t const request_type = request->bmRequestType & (USB_BM_REQUEST_TYPE_TYPE_MASK | USB_BM_REQUEST_TYPE_RECIPIENT_MASK);
+
+	switch (request_type)
+	{
+	case USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_ENDPOINT:
+		// The host stops a bulk stream by clearing the halt of its endpoint.
+		if (request->bRequest != USB_STANDARD_CLEAR_FEATURE || request->wValue != USB_FEATURE_ENDPOINT_HALT
+			|| request->wIndex != configuration_descriptor_combination.usb_in_endpoint_descriptor.bEndpointAddress)
+			return false;
+
+		stop_streaming();
+		usb_driver.clear_in_endpoint_stall(VIDEO_IN_ENDPOINT_NUMBER);
+		log_info("UVC streaming stopped.");
+		usbd_control_acknowledge();
+		return true;
+	case USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE:
+		switch (request->bRequest)
+		{
+		case USB_STANDARD_SET_INTERFACE:
+			if (request->wValue != 0)
+				return false;
+
+			if ((request->wIndex & 0xFF) == VIDEO_STREAMING_INTERFACE)
+			{
+				stop_streaming();
+			}
+
+			usbd_control_acknowledge();
+			return true;
+		case USB_STANDARD_GET_INTERFACE:
+			usbd_control_send(&alternate_setting, sizeof(alternate_setting));
+			return true;
+		}
+
+		return false;
+	case USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE:
+		// Note: The camera terminal has no controls.
+		if ((request->wIndex & 0xFF) != VIDEO_STREAMING_INTERFACE)
+			return false;
+
+		return streaming_request(request);
+	}
+
+	return false;
+}
+
+static void control_data_received(UsbRequest const *request)
+{
+	if (request->bRequest != USB_VIDEO_SET_CUR)
+		return;
+
+	if ((request->wValue >> 8) == USB_VIDEO_VS_PROBE_CONTROL)
+	{
+		negotiate(&received_control, &probe);
+	}
+	else
+	{
+		negotiate(&received_control, &commit);
+		start_streaming();
+	}
+}
+
+static void in_transfer_completed(uint8_t endpoint_number)
+{
+	in_busy = false;
+	send_payload();
+}
+
+/** \brief Latches the clock of the SOF for the timestamps, and paces the frames.
+ * \details The frame interval is counted in 100 ns units, so 30 frames per second alternate 33 and 34 ms apart
+ * without drifting.
+ */
+static void sof_received(uint16_t frame_number)
+{
+	sof_timestamp = audio_clock_sof_timestamp();
+	sof_frame_number = frame_number;
+
+	if (streaming)
+	{
+		pacer_time += VIDEO_BUS_FRAME_INTERVAL;
+
+		if (pacer_time >= commit.dwFrameInterval)
+		{
+			pacer_time -= commit.dwFrameInterval;
+
+			if (frame_due)
+			{
+				statistics.skipped_frames++;
+			}
+			else if (frame_active)
+			{
+				statistics.late_frames++;
+			}
+
+			frame_due = true;
+			due_timestamp = sof_timestamp;
+		}
+	}
+
+	if (++report_frames < VIDEO_REPORT_PERIOD)
+		return;
+
+	// Note: 1000 frames is one second, so the counts are per second.
+	if (streaming)
+	{
+		log_info("UVC: %lu frames/s (%lu late, %lu skipped), %lu payloads/s, %lu B/s.",
+			statistics.frames, statistics.late_frames, statistics.skipped_frames, statistics.payloads, statistics.bytes);
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	report_frames = 0;
+}
+
+static void polled()
+{
+	if (!configured || !streaming)
+		return;
+
+	if (frame_due && !frame_active)
+	{
+		start_frame();
+	}
+
+	send_payload();
+}
+
+const UsbClass usbd_video_class = {
+	.device_descriptor = &device_descriptor,
+	.configuration_descriptor = &configuration_descriptor_combination,
+	.configuration_descriptor_size = sizeof(configuration_descriptor_combination),
+	.on_reset = &reset,
+	.on_configure = &configure,
+	.on_setup_request = &setup_request,
+	.on_control_data_received = &control_data_received,
+	.on_sof = &sof_received,
+	.on_in_transfer_completed = &in_transfer_completed,
+	.on_poll = &polled
+};
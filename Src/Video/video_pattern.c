@@ -0,0 +1,195 @@
+#include "stdbool.h"
+#include "Video/video_pattern.h"
+
+/// \brief Count of bars across the picture.
+#define VIDEO_PATTERN_BAR_COUNT 8
+
+/// \brief Y, Cb, Cr of the bars (BT.601, studio range).
+static const uint8_t bar_colors[VIDEO_PATTERN_BAR_COUNT][3] = {
+	{ 235, 128, 128 }, { 210, 16, 146 }, { 170, 166, 16 }, { 145, 54, 34 },
+	{ 106, 202, 222 }, { 81, 90, 240 }, { 41, 240, 110 }, { 16, 128, 128 }
+};
+
+static uint8_t const *bar_color(uint16_t x, uint16_t width, uint16_t scroll)
+{
+	return bar_colors[((x + scroll) % width) * VIDEO_PATTERN_BAR_COUNT / width];
+}
+
+/** \brief Writes a part of an uncompressed YUY2 frame (Y0 U Y1 V for each pair of pixels).
+ * \param data Receives the bytes.
+ * \param offset Offset of the first byte in the frame (a multiple of 4).
+ * \param size Count of bytes (a multiple of 4).
+ * \param width Width of the frame in pixels (even).
+ * \param scroll Count of pixels the bars moved to the left.
+ * \details The frame is written piece by piece straight into the payloads: no frame buffer is needed.
+ */
+void video_pattern_yuy2(uint8_t *data, uint32_t offset, uint32_t size, uint16_t width, uint16_t scroll)
+{
+	uint16_t x = (offset / 2) % width;
+
+	for (uint32_t i = 0; i < size; i += 4)
+	{
+		uint8_t const *left = bar_color(x, width, scroll);
+		uint8_t const *right = bar_color(x + 1, width, scroll);
+
+		data[i] = left[0];
+		data[i + 1] = left[1];
+		data[i + 2] = right[0];
+		data[i + 3] = left[2];
+
+		x += 2;
+
+		if (x == width)
+		{
+			x = 0;
+		}
+	}
+}
+
+/** \brief Writes the bits of the entropy coded data, with the 0x00 stuffed after each 0xFF.
+ */
+typedef struct
+{
+	uint8_t *buffer;
+	uint32_t capacity;
+	uint32_t size;
+	uint32_t bits;
+	uint8_t bit_count;
+	bool overflow;
+} JpegWriter;
+
+static void put_byte(JpegWriter *writer, uint8_t byte)
+{
+	if (writer->size == writer->capacity)
+	{
+		writer->overflow = true;
+		return;
+	}
+
+	writer->buffer[writer->size++] = byte;
+}
+
+static void put_bytes(JpegWriter *writer, uint8_t const *bytes, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++)
+	{
+		put_byte(writer, bytes[i]);
+	}
+}
+
+static void put_bits(JpegWriter *writer, uint32_t value, uint8_t count)
+{
+	writer->bits = (writer->bits << count) | (value & ((1 << count) - 1));
+	writer->bit_count += count;
+
+	while (writer->bit_count >= 8)
+	{
+		uint8_t byte = writer->bits >> (writer->bit_count - 8);
+
+		writer->bit_count -= 8;
+		put_byte(writer, byte);
+
+		if (byte == 0xFF)
+		{
+			put_byte(writer, 0x00);
+		}
+	}
+}
+
+/** \brief Markers and tables before the size of the frame (SOI, DQT).
+ * \details The quantizer of the DC coefficient is 8, so a quantized DC is the mean of its block minus 128.
+ */
+static const uint8_t jpeg_start[] = {
+	0xFF, 0xD8,
+	0xFF, 0xDB, 0x00, 67, 0x00,
+	8, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1
+};
+
+/** \brief Huffman tables and the start of scan (Y: 2x1 blocks per MCU, Cb and Cr: 1 block each, YUV 4:2:2).
+ * \details The DC table is the one of luminance of the JPEG standard (annex K); the AC table only has the EOB, as
+ * every block of the pattern is flat.
+ */
+static const uint8_t jpeg_tables[] = {
+	0xFF, 0xC4, 0x00, 49,
+	0x00, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+	0x10, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+	0xFF, 0xDA, 0x00, 12, 3, 1, 0x00, 2, 0x00, 3, 0x00, 0, 63, 0
+};
+
+/// \brief Codes of the DC categories (0 - 8) in the DC table, and their lengths.
+static const uint16_t dc_codes[9] = { 0x000, 0x002, 0x003, 0x004, 0x005, 0x006, 0x00E, 0x01E, 0x03E };
+static const uint8_t dc_code_lengths[9] = { 2, 3, 3, 3, 3, 3, 4, 5, 6 };
+
+/** \brief Codes a flat block: the difference with the DC of the previous block of the component, then the EOB.
+ */
+static void put_block(JpegWriter *writer, int16_t dc, int16_t *predictor)
+{
+	int16_t difference = dc - *predictor;
+	uint16_t magnitude = difference < 0 ? -difference : difference;
+	uint8_t category = 0;
+
+	while (magnitude != 0)
+	{
+		category++;
+		magnitude >>= 1;
+	}
+
+	put_bits(writer, dc_codes[category], dc_code_lengths[category]);
+	// Negative differences are sent as their one's complement.
+	put_bits(writer, difference < 0 ? difference - 1 : difference, category);
+	// EOB: the only code of the AC table.
+	put_bits(writer, 0, 1);
+	*predictor = dc;
+}
+
+/** \brief Encodes the pattern as a baseline JPEG (YUV 4:2:2).
+ * \param buffer Receives the JPEG.
+ * \param capacity Size of the buffer in bytes.
+ * \param width Width of the frame in pixels (a multiple of 16).
+ * \param height Height of the frame in pixels (a multiple of 8).
+ * \param scroll Count of pixels the bars moved to the left.
+ * \returns The size of the JPEG in bytes, 0 if it does not fit in the buffer.
+ * \note Every 8 x 8 block takes the color of its left column, so the bars move by steps of 8 pixels.
+ */
+uint32_t video_pattern_mjpeg(uint8_t *buffer, uint32_t capacity, uint16_t width, uint16_t height, uint16_t scroll)
+{
+	JpegWriter writer = { .buffer = buffer, .capacity = capacity };
+	uint8_t const frame_header[] = {
+		0xFF, 0xC0, 0x00, 17, 8, height >> 8, height & 0xFF, width >> 8, width & 0xFF, 3,
+		1, 0x21, 0, 2, 0x11, 0, 3, 0x11, 0
+	};
+	int16_t predictors[3] = { 0, 0, 0 };
+
+	put_bytes(&writer, jpeg_start, sizeof(jpeg_start));
+	put_bytes(&writer, frame_header, sizeof(frame_header));
+	put_bytes(&writer, jpeg_tables, sizeof(jpeg_tables));
+
+	// The bars are vertical: all the rows of MCUs are the same.
+	for (uint16_t y = 0; y < height; y += 8)
+	{
+		for (uint16_t x = 0; x < width; x += 16)
+		{
+			uint8_t const *left = bar_color(x, width, scroll);
+			uint8_t const *right = bar_color(x + 8, width, scroll);
+
+			put_block(&writer, left[0] - 128, &predictors[0]);
+			put_block(&writer, right[0] - 128, &predictors[0]);
+			put_block(&writer, left[1] - 128, &predictors[1]);
+			put_block(&writer, left[2] - 128, &predictors[2]);
+		}
+	}
+
+	// Pads the last byte with 1 bits, then EOI.
+	put_bits(&writer, 0x7F, (8 - writer.bit_count) % 8);
+	put_byte(&writer, 0xFF);
+	put_byte(&writer, 0xD9);
+
+	return writer.overflow ? 0 : writer.size;
+}
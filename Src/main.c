@@ -1,20 +1,59 @@
 #include "Helpers/logger.h"
+#include "Helpers/cycle_counter.h"
 #include "usbd_framework.h"
 #include "usb_device.h"
+#include "Hid/usbd_hid_mouse.h"
+#include "Msc/msc_flash_disk.h"
+#include "Audio/audio_dsp.h"
 
 UsbDevice usb_device;
 uint32_t buffer[8];
 
+/** \brief Samples the (simulated) mouse sensor; called by the USB framework just before the host polls.
+ */
+static void sample_mouse_input()
+{
+	// Simulates an input device that moves the cursor to the right.
+	usbd_hid_mouse_move(5, 0, 0);
+}
+
 int main(void)
 {
 	log_info("Program entry point.");
 
+	// The cycle counter timestamps input events and USB transfers.
+	cycle_counter_initialize();
+
+#ifdef MSC_FLASH_DISK_BENCHMARK_BLOCKS
+	// Build option (e.g. `-DMSC_FLASH_DISK_BENCHMARK_BLOCKS=512`): logs the sequential and random write throughput and
+	// the write amplification of the flash disk, with that many blocks per test. It overwrites the disk, and runs
+	// before the USB device starts (the results are drained with the other logs).
+	msc_flash_disk_run_benchmark(MSC_FLASH_DISK_BENCHMARK_BLOCKS);
+#endif
+
+#ifdef AUDIO_DSP_BENCHMARK
+	// Build option (`-DAUDIO_DSP_BENCHMARK`): logs the cycles per frame of the audio kernels against their scalar
+	// references, and whether they return the same samples.
+	audio_dsp_run_benchmark();
+#endif
+
 	usb_device.ptr_out_buffer = &buffer;
+	// The function exposed by the device (e.g. `usbd_hid_keyboard_class`, `usbd_hid_composite_class`, `usbd_cdc_acm_class`,
+	// `usbd_cdc_composite_class`, `usbd_cdc_ncm_class`, `usbd_source_sink_class`, `usbd_dfu_class`, `usbd_audio_class`,
+	// `usbd_midi_class`, `usbd_video_class`, `usbd_sensor_class` (with `usbd_sensor_set_source(&sensor_adc)` for the
+	// ADC), `usbd_bridge_class` (with `usbd_bridge_set_bus(&bridge_peripherals)` for SPI1 and I2C1), `usbd_logic_class`
+	// (with `usbd_logic_set_source(&logic_gpio)` for PE0 to PE7) or `usbd_msc_class` with
+	// `usbd_msc_set_block_device(&msc_ram_disk)` or `&msc_flash_disk`).
+	usb_device.usb_class = &usbd_hid_mouse_class;
 
+	usbd_hid_mouse_set_sampler(&sample_mouse_input);
 	usbd_initialize(&usb_device);
 
 	for(;;)
 	{
 		usbd_poll();
+
+		// The logs are formatted and sent once the USB work is done.
+		log_drain();
 	}
 }
@@ -1,6 +1,11 @@
 #include "usbd_driver.h"
 #include "usb_standards.h"
 #include "string.h"
+#include "stdbool.h"
+#include "Helpers/logger.h"
+
+/// \brief Even/odd frame of an isochronous OUT endpoint (the CMSIS header only names the bit of the IN endpoints).
+#define USB_OTG_DOEPCTL_EONUM_DPID (1 << 16)
 
 static void initialize_gpio_pins()
 {
@@ -44,7 +49,7 @@ static void initialize_core()
 	SET_BIT(USB_OTG_HS->GINTMSK,
 		USB_OTG_GINTMSK_USBRST | USB_OTG_GINTMSK_ENUMDNEM | USB_OTG_GINTMSK_SOFM |
 		USB_OTG_GINTMSK_USBSUSPM | USB_OTG_GINTMSK_WUIM | USB_OTG_GINTMSK_IEPINT |
-		USB_OTG_GINTSTS_OEPINT | USB_OTG_GINTMSK_RXFLVLM
+		USB_OTG_GINTSTS_OEPINT | USB_OTG_GINTMSK_RXFLVLM | USB_OTG_GINTMSK_IISOIXFRM | USB_OTG_GINTMSK_PXFRM_IISOOXFRM
 	);
 
 	// Clears all pending core interrupts.
@@ -119,6 +124,41 @@ static void read_packet(void *buffer, uint16_t size)
 	}
 }
 
+/** \brief Returns whether the current frame number is odd.
+ */
+inline static bool is_odd_frame()
+{
+	return _FLD2VAL(USB_OTG_DSTS_FNSOF, USB_OTG_HS_DEVICE->DSTS) & 1;
+}
+
+/** \brief Makes an isochronous IN endpoint send its next transfer in the next frame.
+ * \note The core only sends an isochronous packet in a frame of the configured parity; the transfer is armed one
+ * frame ahead, since the host may poll right after SOF.
+ */
+static void set_in_endpoint_next_frame(USB_OTG_INEndpointTypeDef *in_endpoint)
+{
+	if (_FLD2VAL(USB_OTG_DIEPCTL_EPTYP, in_endpoint->DIEPCTL) == USB_ENDPOINT_TYPE_ISOCHRONOUS)
+	{
+		SET_BIT(in_endpoint->DIEPCTL, is_odd_frame() ? USB_OTG_DIEPCTL_SD0PID_SEVNFRM : USB_OTG_DIEPCTL_SODDFRM);
+	}
+}
+
+/** \brief Copies data into the TxFIFO of an IN endpoint (once its transmission is configured).
+ */
+static void push_txfifo(uint8_t endpoint_number, void const *buffer, uint16_t size)
+{
+	uint32_t *fifo = FIFO(endpoint_number);
+
+	// Gets the size in term of 32-bit words (to avoid integer overflow in the loop).
+	size = (size + 3) / 4;
+
+	for (; size > 0; size--, buffer += 4)
+	{
+		// Pushes the data to the TxFIFO.
+		*fifo = *((uint32_t *)buffer);
+	}
+}
+
 /** \brief Pushes a packet into the TxFIFO of an IN endpoint.
  * \param endpoint_number The number of the endpoint, to which the data will be written.
  * \param buffer Pointer to the buffer contains the data to be written to the endpoint.
@@ -126,7 +166,6 @@ static void read_packet(void *buffer, uint16_t size)
  */
 static void write_packet(uint8_t endpoint_number, void const *buffer, uint16_t size)
 {
-	uint32_t *fifo = FIFO(endpoint_number);
 	USB_OTG_INEndpointTypeDef *in_endpoint = IN_ENDPOINT(endpoint_number);
 
 	// Configures the transmission (1 packet that has `size` bytes).
@@ -135,20 +174,46 @@ static void write_packet(uint8_t endpoint_number, void const *buffer, uint16_t s
 		_VAL2FLD(USB_OTG_DIEPTSIZ_PKTCNT, 1) | _VAL2FLD(USB_OTG_DIEPTSIZ_XFRSIZ, size)
 	);
 
+	set_in_endpoint_next_frame(in_endpoint);
+
 	// Enables the transmission after clearing both STALL and NAK of the endpoint.
 	MODIFY_REG(in_endpoint->DIEPCTL,
 		USB_OTG_DIEPCTL_STALL,
 		USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA
 	);
 
-	// Gets the size in term of 32-bit words (to avoid integer overflow in the loop).
-	size = (size + 3) / 4;
+	push_txfifo(endpoint_number, buffer, size);
+}
 
-	for (; size > 0; size--, buffer += 4)
-	{
-		// Pushes the data to the TxFIFO.
-		*fifo = *((uint32_t *)buffer);
-	}
+/** \brief Pushes a transfer of several packets into the TxFIFO of an IN endpoint.
+ * \param endpoint_number The number of the IN endpoint (other than endpoint0).
+ * \param buffer Pointer to the buffer contains the data to be written to the endpoint.
+ * \param size The size of data in bytes; the TxFIFO of the endpoint must be able to hold all of it.
+ * \note The core splits the data in packets of the maximum packet size (the last one may be short), and the transfer
+ * completes once the host collected all of them.
+ */
+static void write_transfer(uint8_t endpoint_number, void const *buffer, uint16_t size)
+{
+	USB_OTG_INEndpointTypeDef *in_endpoint = IN_ENDPOINT(endpoint_number);
+	uint16_t packet_size = _FLD2VAL(USB_OTG_DIEPCTL_MPSIZ, in_endpoint->DIEPCTL);
+	// Note: A zero length packet is still one packet.
+	uint16_t packet_count = size == 0 ? 1 : (size + packet_size - 1) / packet_size;
+
+	// Configures the transmission (`packet_count` packets that have `size` bytes in total).
+	MODIFY_REG(in_endpoint->DIEPTSIZ,
+		USB_OTG_DIEPTSIZ_PKTCNT | USB_OTG_DIEPTSIZ_XFRSIZ,
+		_VAL2FLD(USB_OTG_DIEPTSIZ_PKTCNT, packet_count) | _VAL2FLD(USB_OTG_DIEPTSIZ_XFRSIZ, size)
+	);
+
+	set_in_endpoint_next_frame(in_endpoint);
+
+	// Enables the transmission after clearing both STALL and NAK of the endpoint.
+	MODIFY_REG(in_endpoint->DIEPCTL,
+		USB_OTG_DIEPCTL_STALL,
+		USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA
+	);
+
+	push_txfifo(endpoint_number, buffer, size);
 }
 
 /** \brief Updates the start addresses of all FIFOs according to the size of each FIFO.
@@ -179,12 +244,17 @@ static void refresh_fifo_start_addresses()
 	}
 }
 
+/// \brief Size of the largest packet the RxFIFO is configured for.
+static uint16_t rxfifo_packet_size;
+
 /** \brief Configures the RxFIFO of all OUT endpoints.
  * \param size The size of the largest OUT endpoint in bytes.
  * \note The RxFIFO is shared between all OUT endpoints.
  */
 static void configure_rxfifo_size(uint16_t size)
 {
+	rxfifo_packet_size = size;
+
 	// Considers the space required to save status packets in RxFIFO and gets the size in term of 32-bit words.
 	size = 10 + (2 * ((size / 4) + 1));
 
@@ -226,6 +296,25 @@ static void configure_txfifo_size(uint8_t endpoint_number, uint16_t size)
 	refresh_fifo_start_addresses();
 }
 
+/** \brief Returns the size of the FIFO memory that is not used by the RxFIFO and the TxFIFOs of the active endpoints.
+ * \returns The size in bytes; a function can share it between the TxFIFOs of its IN endpoints.
+ */
+static uint16_t get_free_fifo_size()
+{
+	uint16_t used_size = _FLD2VAL(USB_OTG_GRXFSIZ_RXFD, USB_OTG_HS->GRXFSIZ) + _FLD2VAL(USB_OTG_TX0FD, USB_OTG_HS->DIEPTXF0_HNPTXFSIZ);
+
+	// Note: The core deactivates all the endpoints (other than endpoint0) on a USB reset.
+	for (uint8_t endpoint_number = 1; endpoint_number < ENDPOINT_COUNT; endpoint_number++)
+	{
+		if (IN_ENDPOINT(endpoint_number)->DIEPCTL & USB_OTG_DIEPCTL_USBAEP)
+		{
+			used_size += _FLD2VAL(USB_OTG_NPTXFD, USB_OTG_HS->DIEPTXF[endpoint_number - 1]);
+		}
+	}
+
+	return FIFO_MEMORY_SIZE - used_size * 4;
+}
+
 /** \brief Flushes the RxFIFO of all OUT endpoints.
  */
 static void flush_rxfifo()
@@ -245,6 +334,58 @@ static void flush_txfifo(uint8_t endpoint_number)
 	);
 }
 
+/** \brief Disables an IN endpoint that is transmitting, and drops the packets left in its TxFIFO.
+ * \param endpoint_number The number of the IN endpoint (other than endpoint0).
+ * \note The endpoint must be disabled before its TxFIFO is flushed: it keeps EPENA and its DIEPTSIZ otherwise, and
+ * sends a mix of the old and the next transfer.
+ */
+static void disable_in_endpoint(uint8_t endpoint_number)
+{
+	USB_OTG_INEndpointTypeDef *in_endpoint = IN_ENDPOINT(endpoint_number);
+
+	if (in_endpoint->DIEPCTL & USB_OTG_DIEPCTL_EPENA)
+	{
+		SET_BIT(in_endpoint->DIEPCTL, USB_OTG_DIEPCTL_SNAK | USB_OTG_DIEPCTL_EPDIS);
+
+		// Waits until the endpoint is disabled.
+		while (!(in_endpoint->DIEPINT & USB_OTG_DIEPINT_EPDISD));
+		WRITE_REG(in_endpoint->DIEPINT, USB_OTG_DIEPINT_EPDISD);
+	}
+
+	flush_txfifo(endpoint_number);
+
+	// Waits until the flush is done (the TxFIFO cannot be written before).
+	while (USB_OTG_HS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH);
+}
+
+/** \brief Stops the transfer in progress on an IN endpoint (a function drops the data in flight).
+ * \param endpoint_number The number of the IN endpoint (other than endpoint0).
+ * \note No transfer completed event follows for the dropped transfer, so the next transfer can be written right away.
+ */
+static void stop_in_endpoint(uint8_t endpoint_number)
+{
+	disable_in_endpoint(endpoint_number);
+
+	// Note: A transfer that completed but was not handled yet is dropped too.
+	WRITE_REG(IN_ENDPOINT(endpoint_number)->DIEPINT, USB_OTG_DIEPINT_XFRC);
+}
+
+/** \brief Prepares endpoint0 to receive the next SETUP packets or one OUT data packet.
+ */
+static void enable_endpoint0_reception()
+{
+	// Configures the reception of up to 3 back-to-back SETUP packets, or of one OUT data packet.
+	MODIFY_REG(OUT_ENDPOINT(0)->DOEPTSIZ,
+		USB_OTG_DOEPTSIZ_STUPCNT | USB_OTG_DOEPTSIZ_PKTCNT | USB_OTG_DOEPTSIZ_XFRSIZ,
+		_VAL2FLD(USB_OTG_DOEPTSIZ_STUPCNT, 3) | _VAL2FLD(USB_OTG_DOEPTSIZ_PKTCNT, 1) | _VAL2FLD(USB_OTG_DOEPTSIZ_XFRSIZ, 64)
+	);
+
+	// Clears NAK, and enables endpoint data reception.
+	SET_BIT(OUT_ENDPOINT(0)->DOEPCTL,
+		USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK
+	);
+}
+
 static void configure_endpoint0(uint8_t endpoint_size)
 {
 	// Unmasks all interrupts of IN and OUT endpoint0.
@@ -256,10 +397,7 @@ static void configure_endpoint0(uint8_t endpoint_size)
 		USB_OTG_DIEPCTL_USBAEP | _VAL2FLD(USB_OTG_DIEPCTL_MPSIZ, endpoint_size) | USB_OTG_DIEPCTL_SNAK
 	);
 
-	// Clears NAK, and enables endpoint data transmission.
-	SET_BIT(OUT_ENDPOINT(0)->DOEPCTL,
-		USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK
-	);
+	enable_endpoint0_reception();
 
 	// Note: 64 bytes is the maximum packet size for full speed USB devices.
 	configure_rxfifo_size(64);
@@ -282,6 +420,125 @@ static void configure_in_endpoint(uint8_t endpoint_number, UsbEndpointType endpo
 	configure_txfifo_size(endpoint_number, endpoint_size);
 }
 
+/// \brief OUT endpoints that must NAK the host (one bit per endpoint), see `set_out_endpoint_nak()`.
+static uint32_t out_endpoints_nak;
+
+/** \brief Prepares an OUT endpoint to receive one packet.
+ * \param endpoint_number The number of the OUT endpoint (other than endpoint0).
+ */
+static void enable_out_endpoint_reception(uint8_t endpoint_number)
+{
+	USB_OTG_OUTEndpointTypeDef *out_endpoint = OUT_ENDPOINT(endpoint_number);
+
+	// Configures the reception of 1 packet of up to the maximum packet size of the endpoint.
+	MODIFY_REG(out_endpoint->DOEPTSIZ,
+		USB_OTG_DOEPTSIZ_PKTCNT | USB_OTG_DOEPTSIZ_XFRSIZ,
+		_VAL2FLD(USB_OTG_DOEPTSIZ_PKTCNT, 1) | _VAL2FLD(USB_OTG_DOEPTSIZ_XFRSIZ, _FLD2VAL(USB_OTG_DOEPCTL_MPSIZ, out_endpoint->DOEPCTL))
+	);
+
+	// An isochronous endpoint receives in the next frame (see `set_in_endpoint_next_frame()`).
+	if (_FLD2VAL(USB_OTG_DOEPCTL_EPTYP, out_endpoint->DOEPCTL) == USB_ENDPOINT_TYPE_ISOCHRONOUS)
+	{
+		SET_BIT(out_endpoint->DOEPCTL, is_odd_frame() ? USB_OTG_DOEPCTL_SD0PID_SEVNFRM : USB_OTG_DOEPCTL_SODDFRM);
+	}
+
+	// Enables endpoint data reception, and clears NAK unless the function cannot take more data.
+	SET_BIT(out_endpoint->DOEPCTL,
+		USB_OTG_DOEPCTL_EPENA | ((out_endpoints_nak & (1 << endpoint_number)) ? USB_OTG_DOEPCTL_SNAK : USB_OTG_DOEPCTL_CNAK)
+	);
+}
+
+/** \brief Makes an OUT endpoint NAK the host (flow control), or accept data again.
+ * \param endpoint_number The number of the OUT endpoint (other than endpoint0).
+ * \param nak Whether the endpoint must NAK the OUT packets.
+ * \note The NAK persists when the endpoint is re-armed after a packet, until it is cleared with this function.
+ */
+static void set_out_endpoint_nak(uint8_t endpoint_number, bool nak)
+{
+	if (nak)
+	{
+		out_endpoints_nak |= 1 << endpoint_number;
+		SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPCTL, USB_OTG_DOEPCTL_SNAK);
+	}
+	else
+	{
+		out_endpoints_nak &= ~(1 << endpoint_number);
+		SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPCTL, USB_OTG_DOEPCTL_CNAK);
+	}
+}
+
+static void configure_out_endpoint(uint8_t endpoint_number, UsbEndpointType endpoint_type, uint16_t endpoint_size)
+{
+	// Unmasks all interrupts of the targeted OUT endpoint.
+	SET_BIT(USB_OTG_HS_DEVICE->DAINTMSK, 1 << 16 << endpoint_number);
+	out_endpoints_nak &= ~(1 << endpoint_number);
+
+	// Activates the endpoint, sets DATA0 packet identifier, configures its type and its maximum packet size.
+	MODIFY_REG(OUT_ENDPOINT(endpoint_number)->DOEPCTL,
+		USB_OTG_DOEPCTL_MPSIZ | USB_OTG_DOEPCTL_EPTYP,
+		USB_OTG_DOEPCTL_USBAEP | _VAL2FLD(USB_OTG_DOEPCTL_MPSIZ, endpoint_size) |
+		_VAL2FLD(USB_OTG_DOEPCTL_EPTYP, endpoint_type) | USB_OTG_DOEPCTL_SD0PID_SEVNFRM
+	);
+
+	// Note: The RxFIFO is shared, and sized for 64 bytes packets when endpoint0 is configured (the largest full speed
+	// packets but isochronous ones, which need a larger RxFIFO).
+	if (endpoint_size > rxfifo_packet_size)
+	{
+		configure_rxfifo_size(endpoint_size);
+	}
+
+	enable_out_endpoint_reception(endpoint_number);
+}
+
+/** \brief Stalls an IN endpoint (the host gets a STALL handshake until the stall is cleared).
+ * \param endpoint_number The number of the IN endpoint to stall.
+ * \note The core clears the stall of endpoint0 by itself when the next SETUP packet is received.
+ */
+static void stall_in_endpoint(uint8_t endpoint_number)
+{
+	USB_OTG_INEndpointTypeDef *in_endpoint = IN_ENDPOINT(endpoint_number);
+
+	// Disables the endpoint first if it is transmitting (endpoint0 cannot be disabled).
+	if (endpoint_number != 0 && (in_endpoint->DIEPCTL & USB_OTG_DIEPCTL_EPENA))
+	{
+		SET_BIT(in_endpoint->DIEPCTL, USB_OTG_DIEPCTL_EPDIS);
+	}
+
+	SET_BIT(in_endpoint->DIEPCTL, USB_OTG_DIEPCTL_STALL);
+}
+
+/** \brief Stalls an OUT endpoint (the host gets a STALL handshake until the stall is cleared).
+ * \param endpoint_number The number of the OUT endpoint to stall.
+ */
+static void stall_out_endpoint(uint8_t endpoint_number)
+{
+	SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPCTL, USB_OTG_DOEPCTL_STALL);
+}
+
+/** \brief Clears the stall of an IN endpoint (CLEAR_FEATURE(ENDPOINT_HALT) from the host).
+ * \param endpoint_number The number of the IN endpoint (other than endpoint0).
+ * \note The data toggle restarts with DATA0, as the host expects after clearing a halt.
+ */
+static void clear_in_endpoint_stall(uint8_t endpoint_number)
+{
+	MODIFY_REG(IN_ENDPOINT(endpoint_number)->DIEPCTL,
+		USB_OTG_DIEPCTL_STALL,
+		USB_OTG_DIEPCTL_SD0PID_SEVNFRM
+	);
+}
+
+/** \brief Clears the stall of an OUT endpoint (CLEAR_FEATURE(ENDPOINT_HALT) from the host).
+ * \param endpoint_number The number of the OUT endpoint (other than endpoint0).
+ * \note The data toggle restarts with DATA0, as the host expects after clearing a halt.
+ */
+static void clear_out_endpoint_stall(uint8_t endpoint_number)
+{
+	MODIFY_REG(OUT_ENDPOINT(endpoint_number)->DOEPCTL,
+		USB_OTG_DOEPCTL_STALL,
+		USB_OTG_DOEPCTL_SD0PID_SEVNFRM
+	);
+}
+
 /** \brief Deconfigures IN and OUT endpoints of a specific endpoint number.
  * \param endpoint_number The number of the IN and OUT endpoints to deconfigure.
  */
@@ -344,6 +601,16 @@ static void enumdne_handler()
 	configure_endpoint0(8);
 }
 
+/** \brief Handles the start of frame (SOF) token sent by the host every 1 ms.
+ */
+static void sof_handler()
+{
+	// The frame number of the received SOF.
+	uint16_t frame_number = _FLD2VAL(USB_OTG_DSTS_FNSOF, USB_OTG_HS_DEVICE->DSTS);
+
+	usb_events.on_sof_received(frame_number);
+}
+
 static void rxflvl_handler()
 {
 	 // Pops the status information word from the RxFIFO.
@@ -362,17 +629,19 @@ static void rxflvl_handler()
     	usb_events.on_setup_data_received(endpoint_number, bcnt);
     	break;
     case 0x02: // OUT packet (includes data).
-    	// ToDo
+    	usb_events.on_out_data_received(endpoint_number, bcnt);
 		break;
     case 0x04: // SETUP stage has completed.
-    	// Re-enables the transmission on the endpoint.
-        SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPCTL,
-			USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA);
-    	break;
     case 0x03: // OUT transfer has completed.
-    	// Re-enables the transmission on the endpoint.
-        SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPCTL,
-			USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA);
+    	if (endpoint_number == 0)
+    	{
+    		enable_endpoint0_reception();
+    	}
+    	else
+    	{
+    		// Re-enables the reception on the endpoint.
+    		enable_out_endpoint_reception(endpoint_number);
+    	}
     	break;
 	}
 }
@@ -388,7 +657,7 @@ static void iepint_handler()
     {
         usb_events.on_in_transfer_completed(endpoint_number);
         // Clears the interrupt flag.
-        SET_BIT(IN_ENDPOINT(endpoint_number)->DIEPINT, USB_OTG_DIEPINT_XFRC);
+        WRITE_REG(IN_ENDPOINT(endpoint_number)->DIEPINT, USB_OTG_DIEPINT_XFRC);
     }
 }
 
@@ -403,10 +672,50 @@ static void oepint_handler()
     {
         usb_events.on_out_transfer_completed(endpoint_number);
         // Clears the interrupt;
-        SET_BIT(OUT_ENDPOINT(endpoint_number)->DOEPINT, USB_OTG_DOEPINT_XFRC);
+        WRITE_REG(OUT_ENDPOINT(endpoint_number)->DOEPINT, USB_OTG_DOEPINT_XFRC);
     }
 }
 
+/** \brief Handles the isochronous IN transfers that the host did not collect in their frame (e.g. it skipped a frame).
+ * \note The transfer is dropped, so the function can write the next one.
+ */
+static void iisoixfr_handler()
+{
+	for (uint8_t endpoint_number = 1; endpoint_number < ENDPOINT_COUNT; endpoint_number++)
+	{
+		USB_OTG_INEndpointTypeDef *in_endpoint = IN_ENDPOINT(endpoint_number);
+		uint32_t diepctl = in_endpoint->DIEPCTL;
+
+		// Note: A transfer armed for the next frame (the other parity) is still on time.
+		if (_FLD2VAL(USB_OTG_DIEPCTL_EPTYP, diepctl) != USB_ENDPOINT_TYPE_ISOCHRONOUS || !(diepctl & USB_OTG_DIEPCTL_EPENA)
+			|| ((diepctl & USB_OTG_DIEPCTL_EONUM_DPID) != 0) != is_odd_frame())
+			continue;
+
+		// Drops the packet from the TxFIFO.
+		disable_in_endpoint(endpoint_number);
+
+		usb_events.on_in_transfer_incomplete(endpoint_number);
+	}
+}
+
+/** \brief Handles the isochronous OUT endpoints that received nothing in their frame.
+ * \note The endpoint waits for a frame of a given parity: when the host skips a frame, it must wait for the other one.
+ */
+static void incompisoout_handler()
+{
+	for (uint8_t endpoint_number = 1; endpoint_number < ENDPOINT_COUNT; endpoint_number++)
+	{
+		USB_OTG_OUTEndpointTypeDef *out_endpoint = OUT_ENDPOINT(endpoint_number);
+		uint32_t doepctl = out_endpoint->DOEPCTL;
+
+		if (_FLD2VAL(USB_OTG_DOEPCTL_EPTYP, doepctl) == USB_ENDPOINT_TYPE_ISOCHRONOUS && (doepctl & USB_OTG_DOEPCTL_EPENA)
+			&& ((doepctl & USB_OTG_DOEPCTL_EONUM_DPID) != 0) == is_odd_frame())
+		{
+			SET_BIT(out_endpoint->DOEPCTL, is_odd_frame() ? USB_OTG_DOEPCTL_SD0PID_SEVNFRM : USB_OTG_DOEPCTL_SODDFRM);
+		}
+	}
+}
+
 /** \brief Handles the USB core interrupts.
  */
 static void gintsts_handler()
@@ -417,31 +726,49 @@ static void gintsts_handler()
 	{
 		usbrst_handler();
 		// Clears the interrupt.
-		SET_BIT(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_USBRST);
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_USBRST);
 	}
 	else if (gintsts & USB_OTG_GINTSTS_ENUMDNE)
 	{
 		enumdne_handler();
 		// Clears the interrupt.
-		SET_BIT(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_ENUMDNE);
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_ENUMDNE);
+	}
+	else if (gintsts & USB_OTG_GINTSTS_SOF)
+	{
+		sof_handler();
+		// Clears the interrupt.
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_SOF);
 	}
 	else if (gintsts & USB_OTG_GINTSTS_RXFLVL)
 	{
 		rxflvl_handler();
 		// Clears the interrupt.
-		SET_BIT(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_RXFLVL);
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_RXFLVL);
 	}
 	else if (gintsts & USB_OTG_GINTSTS_IEPINT)
 	{
 		iepint_handler();
 		// Clears the interrupt.
-		SET_BIT(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_IEPINT);
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_IEPINT);
 	}
 	else if (gintsts & USB_OTG_GINTSTS_OEPINT)
 	{
 		oepint_handler();
 		// Clears the interrupt.
-		SET_BIT(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_OEPINT);
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_OEPINT);
+	}
+	else if (gintsts & USB_OTG_GINTSTS_IISOIXFR)
+	{
+		iisoixfr_handler();
+		// Clears the interrupt.
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_IISOIXFR);
+	}
+	else if (gintsts & USB_OTG_GINTSTS_PXFR_INCOMPISOOUT)
+	{
+		incompisoout_handler();
+		// Clears the interrupt.
+		WRITE_REG(USB_OTG_HS_GLOBAL->GINTSTS, USB_OTG_GINTSTS_PXFR_INCOMPISOOUT);
 	}
 
 	usb_events.on_usb_polled();
@@ -455,8 +782,18 @@ const UsbDriver usb_driver = {
 	.disconnect = &disconnect,
 	.flush_rxfifo = &flush_rxfifo,
 	.flush_txfifo = &flush_txfifo,
+	.stop_in_endpoint = &stop_in_endpoint,
 	.configure_in_endpoint = &configure_in_endpoint,
+	.configure_out_endpoint = &configure_out_endpoint,
+	.stall_in_endpoint = &stall_in_endpoint,
+	.stall_out_endpoint = &stall_out_endpoint,
+	.clear_in_endpoint_stall = &clear_in_endpoint_stall,
+	.clear_out_endpoint_stall = &clear_out_endpoint_stall,
+	.set_out_endpoint_nak = &set_out_endpoint_nak,
 	.read_packet = &read_packet,
 	.write_packet = &write_packet,
+	.write_transfer = &write_transfer,
+	.configure_txfifo_size = &configure_txfifo_size,
+	.get_free_fifo_size = &get_free_fifo_size,
 	.poll = &gintsts_handler
 };
@@ -1,8 +1,8 @@
 #include "stddef.h"
+#include "stdbool.h"
 #include "usbd_framework.h"
 #include "usbd_driver.h"
 #include "usb_device.h"
-#include "usbd_descriptors.h"
 #include "usb_standards.h"
 #include "Helpers/logger.h"
 #include "Helpers/math.h"
@@ -22,6 +22,56 @@ void usbd_poll()
 	usb_driver.poll();
 }
 
+/** \brief Answers the current control request with data (IN data stage).
+ * \param data The data to send; it must stay valid until the transfer has completed.
+ * \param size The size of the data in bytes (it is truncated to the length requested by the host).
+ */
+void usbd_control_send(void const *data, uint16_t size)
+{
+	UsbRequest const *request = usbd_handle->ptr_out_buffer;
+
+	usbd_handle->ptr_in_buffer = data;
+	usbd_handle->in_data_size = MIN(size, request->wLength);
+	// A data stage shorter than requested ends with a short packet, so a zero length packet is needed if the last one is full.
+	usbd_handle->in_zero_length_packet = size < request->wLength;
+
+	log_info("Switching control transfer stage to IN-DATA.");
+	usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_IN;
+}
+
+/** \brief Answers the current control request by receiving its data (OUT data stage).
+ * \param buffer Where the data will be stored; the class is notified with `on_control_data_received()`.
+ * \param size The size of the buffer in bytes.
+ */
+void usbd_control_receive(void *buffer, uint16_t size)
+{
+	UsbRequest const *request = usbd_handle->ptr_out_buffer;
+
+	usbd_handle->ptr_out_data = buffer;
+	usbd_handle->out_data_size = MIN(size, request->wLength);
+
+	log_info("Switching control transfer stage to OUT-DATA.");
+	usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_OUT;
+}
+
+/** \brief Answers the current control request with a status stage only (the request has no data stage).
+ */
+void usbd_control_acknowledge()
+{
+	log_info("Switching control transfer stage to IN-STATUS.");
+	usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_STATUS_IN;
+}
+
+/** \brief Rejects the current control request (the host gets a STALL handshake).
+ */
+void usbd_control_stall()
+{
+	log_info("Control request is not supported, stalling endpoint0.");
+	usb_driver.stall_in_endpoint(0);
+	usb_driver.stall_out_endpoint(0);
+	usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_SETUP;
+}
+
 static void usb_reset_received_handler()
 {
 	usbd_handle->in_data_size = 0;
@@ -30,50 +80,58 @@ static void usb_reset_received_handler()
 	usbd_handle->device_state = USB_DEVICE_STATE_DEFAULT;
 	usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_SETUP;
 	usb_driver.set_device_address(0);
+
+	if (usbd_handle->usb_class->on_reset != NULL)
+	{
+		usbd_handle->usb_class->on_reset();
+	}
 }
 
-void usbd_configure()
+static void usbd_configure()
 {
-	usb_driver.configure_in_endpoint(
-		(configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bEndpointAddress & 0x0F),
-		(configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bmAttributes & 0x03),
-		configuration_descriptor_combination.usb_mouse_endpoint_descriptor.wMaxPacketSize
-	);
-
-	usb_driver.write_packet(
-		(configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bEndpointAddress & 0x0F),
-		NULL,
-		0
-	);
+	if (usbd_handle->usb_class->on_configure != NULL)
+	{
+		usbd_handle->usb_class->on_configure();
+	}
 }
 
 static void process_standard_device_request()
 {
 	UsbRequest const *request = usbd_handle->ptr_out_buffer;
+	UsbClass const *usb_class = usbd_handle->usb_class;
 
 	switch(request->bRequest)
 	{
 	case USB_STANDARD_GET_DESCRIPTOR:
 		log_info("Standard Get Descriptor request received.");
 		const uint8_t descriptor_type = request->wValue >> 8;
-		const uint16_t descriptor_length = request->wLength;
 
 		switch(descriptor_type)
 		{
 		case USB_DESCRIPTOR_TYPE_DEVICE:
 			log_info("- Get Device Descriptor.");
-			usbd_handle->ptr_in_buffer = &device_descriptor;
-			usbd_handle->in_data_size = descriptor_length;
-
-			log_info("Switching control transfer stage to IN-DATA.");
-			usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_IN;
+			usbd_control_send(usb_class->device_descriptor, sizeof(UsbDeviceDescriptor));
 			break;
 		case USB_DESCRIPTOR_TYPE_CONFIGURATION:
 			log_info("- Get Configuration Descriptor.");
-			usbd_handle->ptr_in_buffer = &configuration_descriptor_combination;
-			usbd_handle->in_data_size = descriptor_length;
-			log_info("Switching control transfer stage to IN-DATA.");
-			usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_IN;
+			usbd_control_send(usb_class->configuration_descriptor, usb_class->configuration_descriptor_size);
+			break;
+		case USB_DESCRIPTOR_TYPE_STRING:
+			log_info("- Get String Descriptor.");
+			const uint8_t index = request->wValue & 0xFF;
+
+			if (index < usb_class->string_descriptor_count && usb_class->string_descriptors[index] != NULL)
+			{
+				uint8_t const *string_descriptor = usb_class->string_descriptors[index];
+				usbd_control_send(string_descriptor, string_descriptor[0]);
+			}
+			else
+			{
+				usbd_control_stall();
+			}
+			break;
+		default:
+			usbd_control_stall();
 			break;
 		}
 		break;
@@ -82,46 +140,44 @@ static void process_standard_device_request()
 		const uint16_t device_address = request->wValue;
 		usb_driver.set_device_address(device_address);
 		usbd_handle->device_state = USB_DEVICE_STATE_ADDRESSED;
-		log_info("Switching control transfer stage to IN-STATUS.");
-		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_STATUS_IN;
+		usbd_control_acknowledge();
 		break;
 	case USB_STANDARD_SET_CONFIG:
 		log_info("Standard Set Configuration request received.");
     	usbd_handle->configuration_value = request->wValue;
-        usbd_configure();
-    	usbd_handle->device_state = USB_DEVICE_STATE_CONFIGURED;
-		log_info("Switching control transfer stage to IN-STATUS.");
-		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_STATUS_IN;
-		break;
-	}
-}
 
-static void process_class_interface_request()
-{
-	UsbRequest const *request = usbd_handle->ptr_out_buffer;
-
-	switch(request->bRequest)
-	{
-	case USB_HID_SETIDLE:
-        log_info("Switching control transfer stage to IN-STATUS.");
-		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_STATUS_IN;
+    	if (usbd_handle->configuration_value != 0)
+    	{
+    		usbd_configure();
+    		usbd_handle->device_state = USB_DEVICE_STATE_CONFIGURED;
+    	}
+    	else
+    	{
+    		usbd_handle->device_state = USB_DEVICE_STATE_ADDRESSED;
+    	}
+
+		usbd_control_acknowledge();
+		break;
+	case USB_STANDARD_GET_CONFIG:
+		log_info("Standard Get Configuration request received.");
+		usbd_control_send(&usbd_handle->configuration_value, sizeof(usbd_handle->configuration_value));
+		break;
+	default:
+		usbd_control_stall();
 		break;
 	}
 }
 
-static void process_standard_interface_request()
+/** \brief Passes a request the framework does not handle to the device class.
+ */
+static void process_class_request()
 {
 	UsbRequest const *request = usbd_handle->ptr_out_buffer;
+	UsbClass const *usb_class = usbd_handle->usb_class;
 
-	switch (request->wValue >> 8)
+	if (usb_class->on_setup_request == NULL || !usb_class->on_setup_request(request))
 	{
-	case USB_DESCRIPTOR_TYPE_HID_REPORT:
-		usbd_handle->ptr_in_buffer = &hid_report_descriptor;
-		usbd_handle->in_data_size = sizeof(hid_report_descriptor);
-
-		log_info("Switching control transfer stage to IN-STATUS.");
-		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_IN;
-		break;
+		usbd_control_stall();
 	}
 }
 
@@ -134,17 +190,16 @@ static void process_request()
 	case USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_DEVICE:
 		process_standard_device_request();
 	break;
-	case USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE:
-		process_class_interface_request();
-	break;
-	case USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIPIENT_INTERFACE:
-		process_standard_interface_request();
+	default:
+		process_class_request();
 	break;
 	}
 }
 
 static void process_control_transfer_stage()
 {
+	uint8_t const max_packet_size = usbd_handle->usb_class->device_descriptor->bMaxPacketSize0;
+
 	switch(usbd_handle->control_transfer_stage)
 	{
 	case USB_CONTROL_STAGE_SETUP:
@@ -152,7 +207,7 @@ static void process_control_transfer_stage()
 	case USB_CONTROL_STAGE_DATA_IN:
 		log_info("Processing IN-DATA stage.");
 
-		uint8_t data_size = MIN(usbd_handle->in_data_size, device_descriptor.bMaxPacketSize0);
+		uint8_t data_size = MIN(usbd_handle->in_data_size, max_packet_size);
 
         usb_driver.write_packet(0, usbd_handle->ptr_in_buffer, data_size);
         usbd_handle->in_data_size -= data_size;
@@ -163,7 +218,7 @@ static void process_control_transfer_stage()
 
         if (usbd_handle->in_data_size == 0)
         {
-        	if (data_size == device_descriptor.bMaxPacketSize0)
+        	if (data_size == max_packet_size && usbd_handle->in_zero_length_packet)
         	{
         		log_info("Switching control stage to IN-DATA ZERO.");
         		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_DATA_IN_ZERO;
@@ -187,31 +242,41 @@ static void process_control_transfer_stage()
 		log_info("Switching control transfer stage to SETUP.");
 		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_SETUP;
 		break;
+	default:
+		break;
 	}
 }
 
 static void usb_polled_handler()
 {
 	process_control_transfer_stage();
+
+	if (usbd_handle->usb_class->on_poll != NULL)
+	{
+		usbd_handle->usb_class->on_poll();
+	}
 }
 
-static void write_mouse_report()
+static void sof_received_handler(uint16_t frame_number)
 {
-	log_debug("Sending USB HID mouse report.");
-
-	HidReport hid_report = {
-		.x = 5
-	};
-
-    usb_driver.write_packet(
-		(configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bEndpointAddress & 0x0F),
-		&hid_report,
-		sizeof(hid_report)
-	);
+	if (usbd_handle->device_state == USB_DEVICE_STATE_CONFIGURED && usbd_handle->usb_class->on_sof != NULL)
+	{
+		usbd_handle->usb_class->on_sof(frame_number);
+	}
 }
 
 static void in_transfer_completed_handler(uint8_t endpoint_number)
 {
+	if (endpoint_number != 0)
+	{
+		if (usbd_handle->usb_class->on_in_transfer_completed != NULL)
+		{
+			usbd_handle->usb_class->on_in_transfer_completed(endpoint_number);
+		}
+
+		return;
+	}
+
 	if (usbd_handle->in_data_size)
 	{
 		log_info("Switching control stage to IN-DATA.");
@@ -223,21 +288,78 @@ static void in_transfer_completed_handler(uint8_t endpoint_number)
 		log_info("Switching control stage to OUT-STATUS.");
 		usbd_handle->control_transfer_stage = USB_CONTROL_STAGE_STATUS_OUT;
 	}
+}
 
-	if (endpoint_number == (configuration_descriptor_combination.usb_mouse_endpoint_descriptor.bEndpointAddress & 0x0F))
+static void in_transfer_incomplete_handler(uint8_t endpoint_number)
+{
+	if (usbd_handle->usb_class->on_in_transfer_incomplete != NULL)
 	{
-		write_mouse_report();
+		usbd_handle->usb_class->on_in_transfer_incomplete(endpoint_number);
+	}
+}
+
+/** \brief Stores a packet of the OUT data stage of a control request.
+ * \param byte_count The size of the received packet.
+ */
+static void control_data_received(uint16_t byte_count)
+{
+	UsbRequest const *request = usbd_handle->ptr_out_buffer;
+	uint16_t data_size = MIN(byte_count, usbd_handle->out_data_size);
+	uint32_t discarded;
+
+	usb_driver.read_packet(usbd_handle->ptr_out_data, data_size);
+	usbd_handle->ptr_out_data += data_size;
+	usbd_handle->out_data_size -= data_size;
+
+	// Pops (and drops) what the host sent beyond the requested length.
+	for (byte_count -= data_size; byte_count > 0; byte_count -= MIN(byte_count, sizeof(discarded)))
+	{
+		usb_driver.read_packet(&discarded, MIN(byte_count, sizeof(discarded)));
+	}
+
+	// The data stage ends when all the data arrived, or with a short packet.
+	if (usbd_handle->out_data_size == 0 || data_size < usbd_handle->usb_class->device_descriptor->bMaxPacketSize0)
+	{
+		log_info("OUT-DATA stage completed.");
+
+		if (usbd_handle->usb_class->on_control_data_received != NULL)
+		{
+			usbd_handle->usb_class->on_control_data_received(request);
+		}
+
+		usbd_handle->out_data_size = 0;
+		usbd_control_acknowledge();
+	}
+}
+
+static void out_data_received_handler(uint8_t endpoint_number, uint16_t byte_count)
+{
+	if (endpoint_number == 0)
+	{
+		// Note: The status stage of IN requests is a zero length OUT packet and carries nothing to store.
+		if (usbd_handle->control_transfer_stage == USB_CONTROL_STAGE_DATA_OUT)
+		{
+			control_data_received(byte_count);
+		}
+	}
+	else if (usbd_handle->usb_class->on_out_data_received != NULL)
+	{
+		usbd_handle->usb_class->on_out_data_received(endpoint_number, byte_count);
 	}
 }
 
 static void out_transfer_completed_handler(uint8_t endpoint_number)
 {
+	if (endpoint_number != 0 && usbd_handle->usb_class->on_out_transfer_completed != NULL)
+	{
+		usbd_handle->usb_class->on_out_transfer_completed(endpoint_number);
+	}
 }
 
 static void setup_data_received_handler(uint8_t endpoint_number, uint16_t byte_count)
 {
-	usb_driver.read_packet(usbd_handle->ptr_out_buffer, byte_count);
-	
+	usb_driver.read_packet((void *)usbd_handle->ptr_out_buffer, byte_count);
+
 	// Prints out the received data.
 	log_debug_array("SETUP data: ", usbd_handle->ptr_out_buffer, byte_count);
 
@@ -247,7 +369,10 @@ static void setup_data_received_handler(uint8_t endpoint_number, uint16_t byte_c
 UsbEvents usb_events = {
 	.on_usb_reset_received = &usb_reset_received_handler,
 	.on_setup_data_received = &setup_data_received_handler,
+	.on_sof_received = &sof_received_handler,
 	.on_usb_polled = &usb_polled_handler,
 	.on_in_transfer_completed = &in_transfer_completed_handler,
+	.on_in_transfer_incomplete = &in_transfer_incomplete_handler,
+	.on_out_data_received = &out_data_received_handler,
 	.on_out_transfer_completed = &out_transfer_completed_handler
 };
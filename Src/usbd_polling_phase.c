@@ -0,0 +1,102 @@
+#include "usbd_polling_phase.h"
+#include "stm32f4xx.h"
+
+/// \brief Weight of a new sample in the moving averages (1 / 2^POLLING_PHASE_AVERAGING_SHIFT).
+#define POLLING_PHASE_AVERAGING_SHIFT 3
+
+/** \brief Wraps a time difference into the range [-frame / 2, frame / 2).
+ */
+static int32_t wrap_to_half_frame(int32_t difference, int32_t frame_cycles)
+{
+	while (difference >= frame_cycles / 2)
+	{
+		difference -= frame_cycles;
+	}
+
+	while (difference < -frame_cycles / 2)
+	{
+		difference += frame_cycles;
+	}
+
+	return difference;
+}
+
+/** \brief Forgets all the observed polls (e.g., after a USB reset).
+ * \param estimator The estimator to reset.
+ */
+void polling_phase_reset(PollingPhaseEstimator *estimator)
+{
+	*estimator = (PollingPhaseEstimator) {
+		.frame_cycles = SystemCoreClock / 1000
+	};
+}
+
+/** \brief Updates the frame reference point.
+ * \param estimator The estimator to update.
+ * \param timestamp Cycle counter value when the SOF was received.
+ */
+void polling_phase_sof_received(PollingPhaseEstimator *estimator, uint32_t timestamp)
+{
+	int32_t interval = timestamp - estimator->sof_timestamp;
+	int32_t nominal = SystemCoreClock / 1000;
+
+	// Tracks the frame length in core clock cycles, ignoring intervals that contain a missed SOF.
+	if (estimator->sof_timestamp != 0 && interval > nominal / 2 && interval < nominal + nominal / 2)
+	{
+		estimator->frame_cycles += (interval - estimator->frame_cycles) >> POLLING_PHASE_AVERAGING_SHIFT;
+	}
+
+	estimator->sof_timestamp = timestamp;
+}
+
+/** \brief Feeds the time of an observed host poll (IN token) into the estimate.
+ * \param estimator The estimator to update.
+ * \param timestamp Cycle counter value when the IN transfer completed (XFRC), right after the host poll.
+ */
+void polling_phase_poll_observed(PollingPhaseEstimator *estimator, uint32_t timestamp)
+{
+	int32_t offset = (timestamp - estimator->sof_timestamp) % estimator->frame_cycles;
+
+	if (estimator->sample_count == 0)
+	{
+		estimator->phase = offset;
+	}
+	else
+	{
+		// The phase is circular, so the error is taken along the shorter way around the frame.
+		int32_t error = wrap_to_half_frame(offset - estimator->phase, estimator->frame_cycles);
+
+		estimator->phase += error >> POLLING_PHASE_AVERAGING_SHIFT;
+		estimator->phase = (estimator->phase + estimator->frame_cycles) % estimator->frame_cycles;
+		estimator->deviation += ((error < 0 ? -error : error) - estimator->deviation) >> POLLING_PHASE_AVERAGING_SHIFT;
+	}
+
+	estimator->sample_count++;
+}
+
+/** \brief Checks whether the estimate is stable enough to schedule the input sampling.
+ * \param estimator The estimator.
+ */
+bool polling_phase_is_locked(PollingPhaseEstimator const *estimator)
+{
+	return estimator->sample_count >= POLLING_PHASE_MINIMUM_SAMPLES &&
+		estimator->deviation < estimator->frame_cycles / 4;
+}
+
+/** \brief Returns when (in cycles after SOF) the inputs should be sampled to make it into the predicted poll.
+ * \param estimator The estimator.
+ * \note The lead time grows with the poll jitter; when it is longer than the phase, the sampling moves to the end
+ * of the previous frame.
+ */
+uint32_t polling_phase_sample_offset(PollingPhaseEstimator const *estimator)
+{
+	int32_t lead = (SystemCoreClock / 1000000) * POLLING_PHASE_LEAD_US + 2 * estimator->deviation;
+	int32_t offset = estimator->phase - lead;
+
+	while (offset < 0)
+	{
+		offset += estimator->frame_cycles;
+	}
+
+	return offset;
+}
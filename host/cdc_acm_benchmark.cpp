@@ -0,0 +1,206 @@
+/** \file
+ * \brief Host client of the CDC-ACM port (see Inc/Cdc/usbd_cdc_acm.h), with the device in loopback mode (no receiver
+ * registered).
+ * \details A thread streams data to the bulk OUT endpoint while another one reads it back from the bulk IN endpoint,
+ * for a given time, then reports the throughput in MB/s. The port is a byte stream (the device packs and splits the
+ * data as its ring buffers fill), so the data is checked as a stream: any lost, duplicated or corrupted byte breaks the
+ * pattern. The latency percentiles are those of the writes: a write waits while the device NAKs (its RX ring is full).
+ *
+ * The benchmark talks to the data interface with libusb, so the tty of the port (e.g. /dev/ttyACM0) goes away while
+ * it runs.
+ *
+ *     cdc_acm_benchmark [--size bytes] [--seconds seconds]
+ */
+
+#include "usb_device.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+/** \name Constants of the device (they must match Src/Cdc/usbd_cdc_acm.c)
+ * @{ */
+constexpr uint16_t VENDOR_ID = 0x6666;
+constexpr uint16_t PRODUCT_ID = 0x13B0;
+constexpr int DATA_INTERFACE_NUMBER = 1;
+
+constexpr uint8_t IN_ENDPOINT = 0x81;
+constexpr uint8_t OUT_ENDPOINT = 0x01;
+constexpr size_t PACKET_SIZE = 64;
+/** @} */
+
+/// \brief How long the reader waits for the end of the stream once the writer stopped.
+constexpr unsigned int TAIL_TIMEOUT_MS = 1000;
+/// \brief Length of the pattern (a prime, so it does not line up with the packets).
+constexpr uint64_t PATTERN_LENGTH = 251;
+
+struct Options
+{
+	/// \brief Bytes per write.
+	size_t size = 4096;
+	double seconds = 5;
+};
+
+[[noreturn]] void usage(char const *program)
+{
+	std::fprintf(stderr,
+		"Usage: %s [--size bytes] [--seconds seconds]\n"
+		"  --size  bytes per write, a multiple of %zu (default 4096)\n",
+		program, PACKET_SIZE);
+	std::exit(2);
+}
+
+Options parse_options(int argc, char **argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (argument == "--size" && has_value)
+			options.size = std::strtoul(argv[++i], nullptr, 0);
+		else if (argument == "--seconds" && has_value)
+			options.seconds = std::strtod(argv[++i], nullptr);
+		else
+			usage(argv[0]);
+	}
+
+	if (options.size == 0 || options.size % PACKET_SIZE != 0)
+		usage(argv[0]);
+
+	return options;
+}
+
+/// \brief Returns the byte of the stream at an offset.
+uint8_t pattern_byte(uint64_t offset)
+{
+	return uint8_t(offset % PATTERN_LENGTH);
+}
+
+void run(Options const &options)
+{
+	using Clock = std::chrono::steady_clock;
+
+	UsbDevice device(VENDOR_ID, PRODUCT_ID, DATA_INTERFACE_NUMBER, "CDC-ACM");
+	std::vector<uint8_t> in_data(options.size);
+	uint8_t drained[PACKET_SIZE];
+
+	// Drops the data left in the loopback by a previous run.
+	while (device.try_transfer(IN_ENDPOINT, false, in_data.data(), in_data.size(), 20) != 0);
+
+	std::atomic<uint64_t> sent(0);
+	std::atomic<bool> writing(true);
+	std::exception_ptr writer_error;
+	std::vector<double> write_latencies_us;
+	uint64_t received = 0;
+	uint64_t errors = 0;
+	Clock::time_point const start = Clock::now();
+	Clock::time_point const deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(options.seconds));
+
+	std::thread writer([&]()
+	{
+		std::vector<uint8_t> out_data(options.size);
+
+		try
+		{
+			for (Clock::time_point now = start; now < deadline; )
+			{
+				uint64_t offset = sent;
+
+				for (size_t i = 0; i < out_data.size(); i++)
+				{
+					out_data[i] = pattern_byte(offset + i);
+				}
+
+				size_t size = device.transfer(OUT_ENDPOINT, false, out_data.data(), out_data.size());
+				Clock::time_point const write_end = Clock::now();
+
+				write_latencies_us.push_back(std::chrono::duration<double, std::micro>(write_end - now).count());
+				sent += size;
+				now = write_end;
+			}
+		}
+		catch (...)
+		{
+			writer_error = std::current_exception();
+		}
+
+		writing = false;
+	});
+
+	Clock::time_point now = start;
+
+	while (writing || received < sent)
+	{
+		size_t size = writing
+			? device.transfer(IN_ENDPOINT, false, in_data.data(), in_data.size())
+			: device.try_transfer(IN_ENDPOINT, false, in_data.data(), in_data.size(), TAIL_TIMEOUT_MS);
+
+		// The rest of the stream did not come back.
+		if (size == 0 && !writing)
+			break;
+
+		// Note: A read is counted once: after a lost byte, the rest of the stream is out of the pattern anyway.
+		for (size_t i = 0; i < size; i++)
+		{
+			if (in_data[i] != pattern_byte(received + i))
+			{
+				errors++;
+				break;
+			}
+		}
+
+		received += size;
+		now = Clock::now();
+	}
+
+	writer.join();
+
+	if (writer_error)
+		std::rethrow_exception(writer_error);
+
+	// Note: Data the device sent beyond what was written is an error too.
+	while (device.try_transfer(IN_ENDPOINT, false, drained, sizeof(drained), 20) != 0)
+	{
+		errors++;
+	}
+
+	double const elapsed = std::chrono::duration<double>(now - start).count();
+
+	std::printf("CDC-ACM loopback, %zu B per write: %llu B written, %llu B read back in %.3f s = %.3f MB/s in each direction\n",
+		options.size, (unsigned long long)sent.load(), (unsigned long long)received, elapsed, received / elapsed / 1e6);
+	print_latencies("writes", write_latencies_us);
+	std::printf("Errors: %llu reads out of the pattern (or beyond the end), %llu bytes missing\n", (unsigned long long)errors,
+		(unsigned long long)(sent - std::min<uint64_t>(sent, received)));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		run(parse_options(argc, argv));
+	}
+	catch (std::exception const &error)
+	{
+		std::fprintf(stderr, "Error: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,332 @@
+/** \file
+ * \brief Packs a firmware binary into the image the DFU function downloads (see Inc/Dfu/usbd_dfu.h): a DfuImageHeader
+ * (size and CRC-32/MPEG-2 of the image), followed by the image as is, or compressed as a LZ4 block with `--lz4` (the
+ * raw block format: the lz4 command writes the frame format, which the device does not decode).
+ * \details The LZ4 stream is decoded back with the decoder of the firmware (Src/Dfu/dfu_lz4.c), in pieces of the size
+ * of the DNLOAD blocks, and compared with the binary before the image is written.
+ *
+ *     dfu_pack [--lz4] binary image
+ *
+ * To compare the update times, pack the same binary both ways and download both images (e.g. `dfu-util -D image`):
+ * once both updates ran, the device logs the duration of each ("DFU update time").
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "Dfu/dfu_lz4.h"
+}
+
+namespace
+{
+
+/** \name Constants of the device (they must match Inc/Dfu/usbd_dfu.h)
+ * @{ */
+constexpr uint32_t DFU_TRANSFER_SIZE = 1024;
+constexpr uint32_t DFU_SLOT_SIZE = 128 * 1024;
+constexpr uint32_t DFU_IMAGE_MAGIC = 0x49554644;
+constexpr uint32_t DFU_IMAGE_FLAG_LZ4 = 1 << 0;
+constexpr size_t DFU_IMAGE_HEADER_SIZE = 16;
+/** @} */
+
+/** \name LZ4 block format
+ * @{ */
+constexpr size_t LZ4_MIN_MATCH_LENGTH = 4;
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+/// \brief Length coded in a nibble of the token that continues in the next bytes.
+constexpr size_t LZ4_LENGTH_EXTENDED = 15;
+/// \brief The last 5 bytes of a block are literals.
+constexpr size_t LZ4_LAST_LITERALS = 5;
+/// \brief The last match starts at least 12 bytes before the end of the block.
+constexpr size_t LZ4_MATCH_START_LIMIT = 12;
+/** @} */
+
+/// \brief Bits of the hash of the 4 bytes at a position (the head of the chain of the positions with that hash).
+constexpr unsigned int HASH_BITS = 16;
+/// \brief Count of earlier positions compared at each position (the longest match wins).
+constexpr unsigned int CHAIN_DEPTH = 64;
+
+[[noreturn]] void usage(char const *program)
+{
+	std::fprintf(stderr,
+		"Usage: %s [--lz4] binary image\n"
+		"  --lz4  compresses the image (LZ4 block)\n",
+		program);
+	std::exit(2);
+}
+
+std::vector<uint8_t> read_file(std::string const &path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		throw std::runtime_error("cannot open " + path);
+
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write_file(std::string const &path, std::vector<uint8_t> const &data)
+{
+	std::ofstream file(path, std::ios::binary);
+
+	file.write(reinterpret_cast<char const *>(data.data()), data.size());
+
+	if (!file)
+		throw std::runtime_error("cannot write " + path);
+}
+
+void append_le32(std::vector<uint8_t> &data, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		data.push_back(uint8_t(value >> (8 * i)));
+	}
+}
+
+uint32_t read_le32(uint8_t const *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24);
+}
+
+/** \brief Returns the CRC-32/MPEG-2 of the image like the CRC unit of the device computes it: the image padded with
+ * 0xFF to whole words, the words read in little endian and shifted in from their most significant bit.
+ */
+uint32_t crc32_mpeg2(std::vector<uint8_t> image)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	image.resize((image.size() + 3) & ~size_t(3), 0xFF);
+
+	for (size_t i = 0; i < image.size(); i += 4)
+	{
+		crc ^= read_le32(&image[i]);
+
+		for (int bit = 0; bit < 32; bit++)
+		{
+			crc = crc & 0x80000000 ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+/// \brief Appends a length that does not fit in a nibble of the token (255 per byte, then the rest).
+void append_length(std::vector<uint8_t> &output, size_t length)
+{
+	for (length -= LZ4_LENGTH_EXTENDED; length >= 255; length -= 255)
+	{
+		output.push_back(255);
+	}
+
+	output.push_back(uint8_t(length));
+}
+
+/// \brief Appends a sequence: literals, then a match (no match for the last sequence, `match_length` 0).
+void append_sequence(std::vector<uint8_t> &output, uint8_t const *literals, size_t literal_count, size_t offset,
+	size_t match_length)
+{
+	size_t const match_code = match_length == 0 ? 0 : match_length - LZ4_MIN_MATCH_LENGTH;
+
+	output.push_back(uint8_t(std::min(literal_count, LZ4_LENGTH_EXTENDED) << 4 | std::min(match_code, LZ4_LENGTH_EXTENDED)));
+
+	if (literal_count >= LZ4_LENGTH_EXTENDED)
+	{
+		append_length(output, literal_count);
+	}
+
+	output.insert(output.end(), literals, literals + literal_count);
+
+	if (match_length == 0)
+		return;
+
+	output.push_back(uint8_t(offset));
+	output.push_back(uint8_t(offset >> 8));
+
+	if (match_code >= LZ4_LENGTH_EXTENDED)
+	{
+		append_length(output, match_code);
+	}
+}
+
+uint32_t hash(uint8_t const *data)
+{
+	return (read_le32(data) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/** \brief Compresses data into a LZ4 block: at each position, the longest match among the last positions with the
+ * same hash (within the 64 KB distance) is taken if it has the minimum length, else the byte is a literal.
+ */
+std::vector<uint8_t> compress_lz4(std::vector<uint8_t> const &input)
+{
+	size_t const size = input.size();
+	std::vector<uint8_t> output;
+	std::vector<int64_t> heads(size_t(1) << HASH_BITS, -1);
+	std::vector<int64_t> previous(size, -1);
+	size_t literal_start = 0;
+	size_t position = 0;
+
+	auto insert = [&](size_t at)
+	{
+		uint32_t h = hash(&input[at]);
+
+		previous[at] = heads[h];
+		heads[h] = int64_t(at);
+	};
+
+	// Note: A block shorter than the limits is only literals.
+	while (position + LZ4_MATCH_START_LIMIT < size)
+	{
+		size_t const match_end_limit = size - LZ4_LAST_LITERALS;
+		size_t best_length = 0;
+		size_t best_offset = 0;
+		int64_t candidate = heads[hash(&input[position])];
+
+		for (unsigned int depth = 0; candidate >= 0 && position - candidate <= LZ4_MAX_OFFSET && depth < CHAIN_DEPTH;
+			depth++, candidate = previous[candidate])
+		{
+			size_t length = 0;
+
+			while (position + length < match_end_limit && input[candidate + length] == input[position + length])
+			{
+				length++;
+			}
+
+			if (length > best_length)
+			{
+				best_length = length;
+				best_offset = position - candidate;
+			}
+		}
+
+		if (best_length < LZ4_MIN_MATCH_LENGTH)
+		{
+			insert(position++);
+			continue;
+		}
+
+		append_sequence(output, &input[literal_start], position - literal_start, best_offset, best_length);
+
+		// The positions in the match are added to the chains (the match ends before the last literals).
+		for (size_t end = position + best_length; position < end; position++)
+		{
+			insert(position);
+		}
+
+		literal_start = position;
+	}
+
+	append_sequence(output, input.data() + literal_start, size - literal_start, 0, 0);
+	return output;
+}
+
+/** \brief Decodes a LZ4 block with the decoder of the device, fed in DNLOAD blocks, and returns whether it gives the
+ * image back.
+ */
+bool check_lz4(std::vector<uint8_t> const &stream, std::vector<uint8_t> const &image)
+{
+	std::vector<uint8_t> decoded(image.size());
+	DfuLz4Decoder decoder;
+
+	dfu_lz4_reset(&decoder, decoded.data());
+
+	for (size_t offset = 0; offset < stream.size(); )
+	{
+		uint32_t piece = uint32_t(std::min<size_t>(DFU_TRANSFER_SIZE, stream.size() - offset));
+		uint32_t consumed = dfu_lz4_decode(&decoder, &stream[offset], piece, decoded.data(), 0, decoded.size());
+
+		// The stream goes on beyond the image, or is corrupt.
+		if (consumed == 0)
+			return false;
+
+		offset += consumed;
+	}
+
+	return dfu_lz4_is_complete(&decoder) && decoder.size == image.size() && decoded == image;
+}
+
+void run(bool lz4, std::string const &binary_path, std::string const &image_path)
+{
+	std::vector<uint8_t> const binary = read_file(binary_path);
+	std::vector<uint8_t> image;
+
+	if (binary.empty())
+		throw std::runtime_error("the binary is empty");
+
+	if (binary.size() > DFU_SLOT_SIZE)
+		throw std::runtime_error("the binary is larger than the update slot (128 KB)");
+
+	append_le32(image, DFU_IMAGE_MAGIC);
+	append_le32(image, lz4 ? DFU_IMAGE_FLAG_LZ4 : 0);
+	append_le32(image, uint32_t(binary.size()));
+	append_le32(image, crc32_mpeg2(binary));
+
+	if (lz4)
+	{
+		std::vector<uint8_t> const stream = compress_lz4(binary);
+
+		if (!check_lz4(stream, binary))
+			throw std::runtime_error("the LZ4 stream does not decode back to the binary");
+
+		// The device takes at most the slot size after the header.
+		if (stream.size() > DFU_SLOT_SIZE)
+			throw std::runtime_error("the LZ4 stream is larger than the update slot");
+
+		image.insert(image.end(), stream.begin(), stream.end());
+	}
+	else
+	{
+		image.insert(image.end(), binary.begin(), binary.end());
+	}
+
+	write_file(image_path, image);
+
+	size_t const payload_size = image.size() - DFU_IMAGE_HEADER_SIZE;
+
+	std::printf("%s image: %zu B binary, %zu B download (%zu B header + %zu B %s, %.1f%% of the binary), CRC 0x%08x\n",
+		lz4 ? "LZ4" : "Raw", binary.size(), image.size(), DFU_IMAGE_HEADER_SIZE, payload_size, lz4 ? "stream" : "image",
+		binary.empty() ? 100.0 : payload_size * 100.0 / binary.size(), crc32_mpeg2(binary));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	bool lz4 = false;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+
+		if (argument == "--lz4")
+			lz4 = true;
+		else if (argument.size() > 1 && argument[0] == '-')
+			usage(argv[0]);
+		else
+			paths.push_back(argument);
+	}
+
+	if (paths.size() != 2)
+		usage(argv[0]);
+
+	try
+	{
+		run(lz4, paths[0], paths[1]);
+	}
+	catch (std::exception const &error)
+	{
+		std::fprintf(stderr, "Error: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
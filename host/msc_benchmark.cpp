@@ -0,0 +1,325 @@
+/** \file
+ * \brief Host client of the mass storage function (see Inc/Msc/usbd_msc.h): it speaks the Bulk-Only Transport itself
+ * (CBW, data, CSW), so the throughput is the one of the function, without a file system or a page cache in between.
+ * \details Reads (READ(10)) or writes (WRITE(10)) the disk sequentially, several blocks per command, for a given time,
+ * then reports the throughput in MB/s and the latency percentiles of the commands. A write run ends with SYNCHRONIZE
+ * CACHE, whose time is reported apart (the flash disk writes its cache back then).
+ *
+ *     msc_benchmark [read|write] [--blocks count] [--seconds seconds] [--verify]
+ *
+ * \warning `write` overwrites the disk (the kernel driver is detached while the benchmark runs, remount afterwards).
+ */
+
+#include "usb_device.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** \name Constants of the device (they must match Src/Msc/usbd_msc.c)
+ * @{ */
+constexpr uint16_t VENDOR_ID = 0x6666;
+constexpr uint16_t PRODUCT_ID = 0x13B2;
+constexpr int INTERFACE_NUMBER = 0;
+
+constexpr uint8_t IN_ENDPOINT = 0x81;
+constexpr uint8_t OUT_ENDPOINT = 0x01;
+/** @} */
+
+/** \name Bulk-Only Transport and SCSI
+ * @{ */
+constexpr uint32_t CBW_SIGNATURE = 0x43425355;
+constexpr uint32_t CSW_SIGNATURE = 0x53425355;
+constexpr size_t CBW_SIZE = 31;
+constexpr size_t CSW_SIZE = 13;
+constexpr uint8_t CBW_DIRECTION_IN = 0x80;
+
+constexpr uint8_t SCSI_READ_CAPACITY_10 = 0x25;
+constexpr uint8_t SCSI_READ_10 = 0x28;
+constexpr uint8_t SCSI_WRITE_10 = 0x2A;
+constexpr uint8_t SCSI_SYNCHRONIZE_CACHE_10 = 0x35;
+/** @} */
+
+/// \brief Time SYNCHRONIZE CACHE may take: the flash disk may wait for a sector erase (1-2 s) first.
+constexpr unsigned int FLUSH_TIMEOUT_MS = 10000;
+
+enum class Test { READ, WRITE };
+
+struct Options
+{
+	Test test = Test::READ;
+	/// \brief Blocks per command.
+	uint16_t blocks = 16;
+	double seconds = 5;
+	/// \brief Whether the written blocks are read back and compared (after the timed run).
+	bool verify = false;
+};
+
+[[noreturn]] void usage(char const *program)
+{
+	std::fprintf(stderr,
+		"Usage: %s [read|write] [--blocks count] [--seconds seconds] [--verify]\n"
+		"  read      reads the disk sequentially (the default)\n"
+		"  write     writes the disk sequentially, then synchronizes the cache (overwrites the disk)\n"
+		"  --blocks  blocks per command (default 16)\n"
+		"  --verify  reads the written blocks back and compares them (after the timed run)\n",
+		program);
+	std::exit(2);
+}
+
+Options parse_options(int argc, char **argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (argument == "read")
+			options.test = Test::READ;
+		else if (argument == "write")
+			options.test = Test::WRITE;
+		else if (argument == "--verify")
+			options.verify = true;
+		else if (argument == "--blocks" && has_value)
+			options.blocks = uint16_t(std::strtoul(argv[++i], nullptr, 0));
+		else if (argument == "--seconds" && has_value)
+			options.seconds = std::strtod(argv[++i], nullptr);
+		else
+			usage(argv[0]);
+	}
+
+	if (options.blocks == 0)
+		usage(argv[0]);
+
+	return options;
+}
+
+void write_le32(uint8_t *data, uint32_t value)
+{
+	data[0] = value;
+	data[1] = value >> 8;
+	data[2] = value >> 16;
+	data[3] = value >> 24;
+}
+
+uint32_t read_le32(uint8_t const *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24);
+}
+
+uint32_t read_be32(uint8_t const *data)
+{
+	return (uint32_t(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+/** \brief The mass storage interface, driven with SCSI commands over the Bulk-Only Transport.
+ */
+class Device : public UsbDevice
+{
+public:
+	Device() : UsbDevice(VENDOR_ID, PRODUCT_ID, INTERFACE_NUMBER, "mass storage") {}
+
+	/** \brief Runs a command, and returns its CSW status (0: passed).
+	 * \param cdb The command descriptor block (up to 16 bytes).
+	 * \param data The data of the command: filled for an IN command, sent for an OUT command.
+	 */
+	uint8_t command(std::vector<uint8_t> const &cdb, bool in, uint8_t *data, uint32_t size,
+		unsigned int timeout_ms = TIMEOUT_MS)
+	{
+		uint8_t cbw[CBW_SIZE] = {};
+		uint32_t const tag = ++last_tag;
+
+		write_le32(&cbw[0], CBW_SIGNATURE);
+		write_le32(&cbw[4], tag);
+		write_le32(&cbw[8], size);
+		cbw[12] = in ? CBW_DIRECTION_IN : 0;
+		cbw[14] = uint8_t(cdb.size());
+		std::memcpy(&cbw[15], cdb.data(), cdb.size());
+
+		transfer(OUT_ENDPOINT, false, cbw, sizeof(cbw));
+
+		// Note: The device stalls the data stage of a command it fails; the CSW follows once the halt is cleared.
+		if (size != 0)
+		{
+			try
+			{
+				for (uint32_t moved = 0; moved < size; )
+				{
+					moved += transfer(in ? IN_ENDPOINT : OUT_ENDPOINT, false, data + moved, size - moved);
+				}
+			}
+			catch (std::runtime_error const &)
+			{
+				clear_halt(in ? IN_ENDPOINT : OUT_ENDPOINT);
+			}
+		}
+
+		uint8_t csw[CSW_SIZE];
+		// Note: SYNCHRONIZE CACHE holds its CSW while the cache is written back.
+		size_t received = try_transfer(IN_ENDPOINT, false, csw, sizeof(csw), timeout_ms);
+
+		if (received == 0)
+			throw std::runtime_error("no CSW");
+
+		if (received != sizeof(csw) || read_le32(&csw[0]) != CSW_SIGNATURE || read_le32(&csw[4]) != tag)
+			throw std::runtime_error("invalid CSW");
+
+		return csw[12];
+	}
+
+	/// \brief Returns the count of blocks of the disk, and their size.
+	void read_capacity(uint32_t &block_count, uint32_t &block_size)
+	{
+		uint8_t data[8];
+
+		if (command({SCSI_READ_CAPACITY_10, 0, 0, 0, 0, 0, 0, 0, 0, 0}, true, data, sizeof(data)) != 0)
+			throw std::runtime_error("READ CAPACITY failed");
+
+		block_count = read_be32(&data[0]) + 1;
+		block_size = read_be32(&data[4]);
+	}
+
+	/// \brief Runs READ(10) or WRITE(10) on `count` blocks from `block`, and returns the CSW status.
+	uint8_t read_write(bool write, uint32_t block, uint16_t count, uint8_t *data, uint32_t size)
+	{
+		return command({write ? SCSI_WRITE_10 : SCSI_READ_10, 0, uint8_t(block >> 24), uint8_t(block >> 16),
+			uint8_t(block >> 8), uint8_t(block), 0, uint8_t(count >> 8), uint8_t(count), 0}, !write, data, size);
+	}
+
+	uint8_t synchronize_cache()
+	{
+		return command({SCSI_SYNCHRONIZE_CACHE_10, 0, 0, 0, 0, 0, 0, 0, 0, 0}, false, nullptr, 0, FLUSH_TIMEOUT_MS);
+	}
+
+private:
+	uint32_t last_tag = 0;
+};
+
+/// \brief Fills the blocks of a command with a pattern that depends on the block number.
+void fill_blocks(std::vector<uint8_t> &data, uint32_t first_block, uint32_t block_size)
+{
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		uint32_t block = first_block + uint32_t(i / block_size);
+
+		data[i] = uint8_t(block * 31 + i % block_size);
+	}
+}
+
+void run(Options const &options)
+{
+	using Clock = std::chrono::steady_clock;
+
+	Device device;
+	uint32_t block_count;
+	uint32_t block_size;
+
+	device.read_capacity(block_count, block_size);
+
+	if (options.blocks > block_count)
+		throw std::runtime_error("--blocks is larger than the disk");
+
+	bool const write = options.test == Test::WRITE;
+	// Note: The commands wrap around at the end of the disk, and do not cross it.
+	uint32_t const command_count = block_count / options.blocks;
+	std::vector<uint8_t> data(size_t(options.blocks) * block_size);
+	std::vector<double> latencies_us;
+	uint64_t bytes = 0;
+	uint64_t failures = 0;
+	uint32_t commands = 0;
+	Clock::time_point const start = Clock::now();
+	Clock::time_point const deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(options.seconds));
+	Clock::time_point now = start;
+
+	std::printf("Disk: %u blocks of %u B (%.1f KB)\n", block_count, block_size, block_count * double(block_size) / 1024);
+
+	while (now < deadline)
+	{
+		uint32_t const block = commands++ % command_count * options.blocks;
+		Clock::time_point const command_start = now;
+
+		if (write)
+		{
+			fill_blocks(data, block, block_size);
+		}
+
+		if (device.read_write(write, block, options.blocks, data.data(), data.size()) != 0)
+		{
+			failures++;
+		}
+
+		now = Clock::now();
+		latencies_us.push_back(std::chrono::duration<double, std::micro>(now - command_start).count());
+		bytes += data.size();
+	}
+
+	double const elapsed = std::chrono::duration<double>(now - start).count();
+
+	std::printf("%s, %u blocks per command: %llu B in %.3f s = %.3f MB/s\n", write ? "Write" : "Read",
+		options.blocks, (unsigned long long)bytes, elapsed, bytes / elapsed / 1e6);
+	print_latencies("commands", latencies_us);
+
+	if (write)
+	{
+		Clock::time_point const flush_start = Clock::now();
+
+		if (device.synchronize_cache() != 0)
+		{
+			failures++;
+		}
+
+		std::printf("SYNCHRONIZE CACHE: %.1f ms\n",
+			std::chrono::duration<double, std::milli>(Clock::now() - flush_start).count());
+	}
+
+	uint64_t mismatches = 0;
+
+	if (write && options.verify)
+	{
+		std::vector<uint8_t> expected(data.size());
+
+		for (uint32_t i = 0; i < std::min(commands, command_count); i++)
+		{
+			uint32_t const block = i * options.blocks;
+
+			fill_blocks(expected, block, block_size);
+
+			if (device.read_write(false, block, options.blocks, data.data(), data.size()) != 0 || data != expected)
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	std::printf("Errors: %llu failed commands, %llu commands read back different\n", (unsigned long long)failures,
+		(unsigned long long)mismatches);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		run(parse_options(argc, argv));
+	}
+	catch (std::exception const &error)
+	{
+		std::fprintf(stderr, "Error: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
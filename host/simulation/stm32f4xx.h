@@ -0,0 +1,33 @@
+/** \file
+ * \brief Stand-in of the device header for the firmware sources built into the host simulations: only the cycle
+ * counter, which is a variable the simulation moves forward.
+ */
+#ifndef HOST_SIMULATION_STM32F4XX_H_
+#define HOST_SIMULATION_STM32F4XX_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} SimulationDwt;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+} SimulationCoreDebug;
+
+extern SimulationDwt simulation_dwt;
+extern SimulationCoreDebug simulation_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT (&simulation_dwt)
+#define CoreDebug (&simulation_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 1
+#define CoreDebug_DEMCR_TRCENA_Msk (1 << 24)
+
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define WRITE_REG(REG, VAL) ((REG) = (VAL))
+
+#endif /* HOST_SIMULATION_STM32F4XX_H_ */
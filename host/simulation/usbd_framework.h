@@ -0,0 +1,28 @@
+/** \file
+ * \brief Stand-in of the USB framework for the firmware sources built into the host simulations: the driver functions
+ * the functions call, implemented by the simulation (the members are a subset of the real `UsbDriver`).
+ */
+#ifndef HOST_SIMULATION_USBD_FRAMEWORK_H_
+#define HOST_SIMULATION_USBD_FRAMEWORK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "usb_standards.h"
+
+typedef struct
+{
+	void (*stop_in_endpoint)(uint8_t endpoint_number);
+	void (*configure_in_endpoint)(uint8_t endpoint_number, enum UsbEndpointType endpoint_type, uint16_t endpoint_size);
+	void (*write_packet)(uint8_t endpoint_number, void const *buffer, uint16_t size);
+	void (*write_transfer)(uint8_t endpoint_number, void const *buffer, uint16_t size);
+	void (*configure_txfifo_size)(uint8_t endpoint_number, uint16_t size);
+} UsbDriver;
+
+extern const UsbDriver usb_driver;
+
+void usbd_control_send(void const *data, uint16_t size);
+void usbd_control_receive(void *buffer, uint16_t size);
+void usbd_control_acknowledge();
+void usbd_control_stall();
+
+#endif /* HOST_SIMULATION_USBD_FRAMEWORK_H_ */
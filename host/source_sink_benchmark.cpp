@@ -0,0 +1,363 @@
+/** \file
+ * \brief Host client of the source/sink test function (see Inc/Vendor/usbd_source_sink.h).
+ * \details Selects the mode and the pattern of the device, moves data for a given time, then reports the throughput
+ * in MB/s and the latency percentiles of the transfers. The transfers are synchronous, so the latency of a transfer is
+ * the time from its submission to its completion (for the loopback: the write and the read back).
+ *
+ *     source_sink_benchmark [source|sink|loopback] [--interrupt] [--pattern zero|mod63|sequence] [--no-verify]
+ *                           [--size bytes] [--seconds seconds]
+ */
+
+#include "usb_device.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** \name Constants of the device (they must match Inc/Vendor/usbd_source_sink.h)
+ * @{ */
+constexpr uint16_t VENDOR_ID = 0x6666;
+constexpr uint16_t PRODUCT_ID = 0x13B3;
+constexpr int INTERFACE_NUMBER = 0;
+
+constexpr uint8_t BULK_IN_ENDPOINT = 0x81;
+constexpr uint8_t BULK_OUT_ENDPOINT = 0x01;
+constexpr uint8_t INTERRUPT_IN_ENDPOINT = 0x82;
+constexpr uint8_t INTERRUPT_OUT_ENDPOINT = 0x02;
+
+constexpr size_t BULK_PACKET_SIZE = 64;
+constexpr size_t INTERRUPT_PACKET_SIZE = 64;
+/// \brief Size of the loopback buffer of the device: a larger write would wait for a read that never comes.
+constexpr size_t LOOPBACK_BUFFER_SIZE = 2048;
+
+constexpr uint8_t SET_MODE = 0x01;
+constexpr uint8_t SET_PATTERN = 0x02;
+constexpr uint8_t SET_VERIFY = 0x03;
+constexpr uint8_t GET_STATISTICS = 0x04;
+constexpr uint8_t RESET_STATISTICS = 0x05;
+
+enum class Mode : uint16_t { SOURCE_SINK = 0, LOOPBACK = 1 };
+enum class Pattern : uint16_t { ZERO = 0, MOD63 = 1, SEQUENCE = 2 };
+
+/// \brief `SourceSinkStatistics` of the device (little endian).
+struct DeviceStatistics
+{
+	uint32_t bulk_sourced_bytes;
+	uint32_t bulk_sunk_bytes;
+	uint32_t interrupt_sourced_bytes;
+	uint32_t interrupt_sunk_bytes;
+	uint32_t looped_bytes;
+	uint32_t pattern_errors;
+	uint32_t lost_packets;
+};
+
+static_assert(sizeof(DeviceStatistics) == 7 * 4, "The statistics are received as they are stored");
+/** @} */
+
+enum class Test { SOURCE, SINK, LOOPBACK };
+
+struct Options
+{
+	Test test = Test::SOURCE;
+	bool interrupt = false;
+	Pattern pattern = Pattern::MOD63;
+	bool verify = true;
+	/// \brief Bytes per transfer (0: the default of the test).
+	size_t size = 0;
+	double seconds = 5;
+};
+
+[[noreturn]] void usage(char const *program)
+{
+	std::fprintf(stderr,
+		"Usage: %s [source|sink|loopback] [--interrupt] [--pattern zero|mod63|sequence] [--no-verify]\n"
+		"          [--size bytes] [--seconds seconds]\n"
+		"  source     reads from the IN endpoint (the default)\n"
+		"  sink       writes to the OUT endpoint\n"
+		"  loopback   writes to the OUT endpoint and reads the data back\n"
+		"  --interrupt  uses the interrupt endpoints (one packet per transfer) instead of the bulk ones\n"
+		"  --size       bytes per bulk transfer, a multiple of %zu (default 4096, at most and by default %zu for\n"
+		"               the loopback)\n",
+		program, BULK_PACKET_SIZE, LOOPBACK_BUFFER_SIZE);
+	std::exit(2);
+}
+
+Options parse_options(int argc, char **argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (argument == "source")
+			options.test = Test::SOURCE;
+		else if (argument == "sink")
+			options.test = Test::SINK;
+		else if (argument == "loopback")
+			options.test = Test::LOOPBACK;
+		else if (argument == "--interrupt")
+			options.interrupt = true;
+		else if (argument == "--no-verify")
+			options.verify = false;
+		else if (argument == "--pattern" && has_value)
+		{
+			std::string pattern = argv[++i];
+
+			if (pattern == "zero")
+				options.pattern = Pattern::ZERO;
+			else if (pattern == "mod63")
+				options.pattern = Pattern::MOD63;
+			else if (pattern == "sequence")
+				options.pattern = Pattern::SEQUENCE;
+			else
+				usage(argv[0]);
+		}
+		else if (argument == "--size" && has_value)
+			options.size = std::strtoul(argv[++i], nullptr, 0);
+		else if (argument == "--seconds" && has_value)
+			options.seconds = std::strtod(argv[++i], nullptr);
+		else
+			usage(argv[0]);
+	}
+
+	if (options.interrupt)
+	{
+		options.size = INTERRUPT_PACKET_SIZE;
+	}
+	else if (options.size == 0)
+	{
+		options.size = options.test == Test::LOOPBACK ? LOOPBACK_BUFFER_SIZE : 4096;
+	}
+	else if (options.size == 0 || options.size % BULK_PACKET_SIZE != 0
+		|| (options.test == Test::LOOPBACK && options.size > LOOPBACK_BUFFER_SIZE))
+	{
+		usage(argv[0]);
+	}
+
+	return options;
+}
+
+/** \brief Generates and checks the pattern of the device: it restarts with every packet, and with the SEQUENCE
+ * pattern, the first 4 bytes of a packet hold a packet counter.
+ */
+class PatternChecker
+{
+public:
+	PatternChecker(Pattern pattern, size_t packet_size) : pattern(pattern), packet_size(packet_size) {}
+
+	void fill(std::vector<uint8_t> &data)
+	{
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = pattern == Pattern::ZERO ? 0 : (i % packet_size) % 63;
+		}
+
+		if (pattern != Pattern::SEQUENCE)
+			return;
+
+		for (size_t offset = 0; offset + 4 <= data.size(); offset += packet_size)
+		{
+			write_le32(&data[offset], sequence++);
+		}
+	}
+
+	/// \brief Checks received data, and returns the count of packets that did not match (lost ones included).
+	uint64_t check(std::vector<uint8_t> const &data, size_t size)
+	{
+		uint64_t errors = 0;
+
+		for (size_t offset = 0; offset < size; offset += packet_size)
+		{
+			size_t end = std::min(offset + packet_size, size);
+			size_t start = offset;
+
+			if (pattern == Pattern::SEQUENCE && end - offset >= 4)
+			{
+				uint32_t received = read_le32(&data[offset]);
+
+				if (received != sequence)
+				{
+					errors += received > sequence ? received - sequence : 1;
+				}
+
+				sequence = received + 1;
+				start += 4;
+			}
+
+			for (size_t i = start; i < end; i++)
+			{
+				uint8_t expected = pattern == Pattern::ZERO ? 0 : ((i - offset) % 63);
+
+				if (data[i] != expected)
+				{
+					errors++;
+					break;
+				}
+			}
+		}
+
+		return errors;
+	}
+
+private:
+	static void write_le32(uint8_t *data, uint32_t value)
+	{
+		data[0] = value;
+		data[1] = value >> 8;
+		data[2] = value >> 16;
+		data[3] = value >> 24;
+	}
+
+	static uint32_t read_le32(uint8_t const *data)
+	{
+		return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24);
+	}
+
+	Pattern pattern;
+	size_t packet_size;
+	uint32_t sequence = 0;
+};
+
+/** \brief The interface of the source/sink function, and its vendor requests.
+ */
+class Device : public UsbDevice
+{
+public:
+	Device() : UsbDevice(VENDOR_ID, PRODUCT_ID, INTERFACE_NUMBER, "source/sink") {}
+
+	void request(uint8_t request, uint16_t value)
+	{
+		control_out(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE, request, value, 0, nullptr, 0, "vendor request");
+	}
+
+	DeviceStatistics statistics()
+	{
+		uint8_t data[sizeof(DeviceStatistics)];
+		DeviceStatistics statistics;
+		uint32_t *fields = &statistics.bulk_sourced_bytes;
+
+		if (control_in(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE, GET_STATISTICS, 0, 0, data, sizeof(data),
+			"GET_STATISTICS") != sizeof(data))
+			throw std::runtime_error("GET_STATISTICS: short answer");
+
+		for (size_t i = 0; i < sizeof(data) / 4; i++)
+		{
+			fields[i] = data[4 * i] | (data[4 * i + 1] << 8) | (data[4 * i + 2] << 16) | (uint32_t(data[4 * i + 3]) << 24);
+		}
+
+		return statistics;
+	}
+};
+
+void run(Options const &options)
+{
+	using Clock = std::chrono::steady_clock;
+
+	Device device;
+	uint8_t in_endpoint = options.interrupt ? INTERRUPT_IN_ENDPOINT : BULK_IN_ENDPOINT;
+	uint8_t out_endpoint = options.interrupt ? INTERRUPT_OUT_ENDPOINT : BULK_OUT_ENDPOINT;
+	size_t packet_size = options.interrupt ? INTERRUPT_PACKET_SIZE : BULK_PACKET_SIZE;
+	PatternChecker generator(options.pattern, packet_size);
+	PatternChecker checker(options.pattern, packet_size);
+	std::vector<uint8_t> out_data(options.size);
+	std::vector<uint8_t> in_data(options.size);
+	std::vector<double> latencies_us;
+	uint64_t bytes = 0;
+	uint64_t errors = 0;
+
+	// Setting the mode restarts the sources and the packet counters of the device.
+	device.request(SET_PATTERN, uint16_t(options.pattern));
+	device.request(SET_VERIFY, options.verify);
+	device.request(SET_MODE, uint16_t(options.test == Test::LOOPBACK ? Mode::LOOPBACK : Mode::SOURCE_SINK));
+	device.request(RESET_STATISTICS, 0);
+
+	Clock::time_point const start = Clock::now();
+	Clock::time_point const deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(options.seconds));
+	Clock::time_point now = start;
+
+	while (now < deadline)
+	{
+		Clock::time_point const transfer_start = now;
+		size_t size;
+
+		if (options.test == Test::SOURCE)
+		{
+			size = device.transfer(in_endpoint, options.interrupt, in_data.data(), in_data.size());
+
+			if (options.verify)
+			{
+				errors += checker.check(in_data, size);
+			}
+		}
+		else
+		{
+			generator.fill(out_data);
+			size = device.transfer(out_endpoint, options.interrupt, out_data.data(), out_data.size());
+
+			if (options.test == Test::LOOPBACK)
+			{
+				size_t received = 0;
+
+				// The device sends the data back in transfers of its own size.
+				while (received < size)
+				{
+					received += device.transfer(in_endpoint, options.interrupt, in_data.data() + received, size - received);
+				}
+
+				if (options.verify && std::memcmp(in_data.data(), out_data.data(), size) != 0)
+				{
+					errors++;
+				}
+			}
+		}
+
+		now = Clock::now();
+		latencies_us.push_back(std::chrono::duration<double, std::micro>(now - transfer_start).count());
+		bytes += size;
+	}
+
+	double const elapsed = std::chrono::duration<double>(now - start).count();
+	DeviceStatistics const statistics = device.statistics();
+
+	std::printf("%s %s, %zu B per transfer: %llu B in %.3f s = %.3f MB/s\n",
+		options.interrupt ? "Interrupt" : "Bulk",
+		options.test == Test::SOURCE ? "source" : options.test == Test::SINK ? "sink" : "loopback",
+		options.size, (unsigned long long)bytes, elapsed, bytes / elapsed / 1e6);
+
+	print_latencies("transfers", latencies_us);
+
+	if (options.verify)
+	{
+		std::printf("Errors: %llu seen by the host, %u pattern errors and %u lost packets seen by the device\n",
+			(unsigned long long)errors, statistics.pattern_errors, statistics.lost_packets);
+	}
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		run(parse_options(argc, argv));
+	}
+	catch (std::exception const &error)
+	{
+		std::fprintf(stderr, "Error: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
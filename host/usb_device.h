@@ -0,0 +1,149 @@
+/** \file
+ * \brief Helpers shared by the host tools: a claimed interface of a device of this firmware (libusb, synchronous
+ * transfers), and the latency percentiles the benchmarks report.
+ */
+#ifndef HOST_USB_DEVICE_H_
+#define HOST_USB_DEVICE_H_
+
+#include <libusb.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+inline void check(int result, char const *what)
+{
+	if (result < 0)
+		throw std::runtime_error(std::string(what) + ": " + libusb_error_name(result));
+}
+
+/** \brief A device opened by its vendor and product IDs, with one interface claimed (the kernel driver of the
+ * interface, if any, is detached while the tool runs).
+ */
+class UsbDevice
+{
+public:
+	static constexpr unsigned int TIMEOUT_MS = 1000;
+
+	UsbDevice(uint16_t vendor_id, uint16_t product_id, int interface_number, char const *name)
+		: interface_number(interface_number)
+	{
+		check(libusb_init(&context), "libusb_init");
+		handle = libusb_open_device_with_vid_pid(context, vendor_id, product_id);
+
+		if (handle == nullptr)
+		{
+			libusb_exit(context);
+
+			char message[128];
+			std::snprintf(message, sizeof(message), "%s device %04x:%04x not found (or no permission to open it)",
+				name, vendor_id, product_id);
+			throw std::runtime_error(message);
+		}
+
+		libusb_set_auto_detach_kernel_driver(handle, 1);
+
+		int result = libusb_claim_interface(handle, interface_number);
+
+		if (result < 0)
+		{
+			libusb_close(handle);
+			libusb_exit(context);
+			check(result, "libusb_claim_interface");
+		}
+	}
+
+	~UsbDevice()
+	{
+		libusb_release_interface(handle, interface_number);
+		libusb_close(handle);
+		libusb_exit(context);
+	}
+
+	UsbDevice(UsbDevice const &) = delete;
+	UsbDevice &operator=(UsbDevice const &) = delete;
+
+	/// \brief Sends a control request with an optional data stage (`request_type` without the direction bit).
+	void control_out(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, uint8_t *data = nullptr,
+		uint16_t size = 0, char const *what = "control request")
+	{
+		check(libusb_control_transfer(handle, LIBUSB_ENDPOINT_OUT | request_type, request, value, index, data, size,
+			TIMEOUT_MS), what);
+	}
+
+	/// \brief Sends a control request that reads data, and returns the count of bytes received.
+	size_t control_in(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, uint8_t *data,
+		uint16_t size, char const *what = "control request")
+	{
+		int result = libusb_control_transfer(handle, LIBUSB_ENDPOINT_IN | request_type, request, value, index, data,
+			size, TIMEOUT_MS);
+
+		check(result, what);
+		return result;
+	}
+
+	/// \brief Moves one bulk or interrupt transfer, and returns the count of bytes moved.
+	size_t transfer(uint8_t endpoint, bool interrupt, uint8_t *data, size_t size)
+	{
+		return run_transfer(endpoint, interrupt, data, size, TIMEOUT_MS, false);
+	}
+
+	/// \brief Like `transfer()`, but a timeout is not an error: it returns what was moved until then (maybe 0).
+	size_t try_transfer(uint8_t endpoint, bool interrupt, uint8_t *data, size_t size, unsigned int timeout_ms)
+	{
+		return run_transfer(endpoint, interrupt, data, size, timeout_ms, true);
+	}
+
+	/// \brief Clears the halt of an endpoint (CLEAR_FEATURE(ENDPOINT_HALT)).
+	void clear_halt(uint8_t endpoint)
+	{
+		check(libusb_clear_halt(handle, endpoint), "libusb_clear_halt");
+	}
+
+private:
+	size_t run_transfer(uint8_t endpoint, bool interrupt, uint8_t *data, size_t size, unsigned int timeout_ms,
+		bool timeout_allowed)
+	{
+		int transferred = 0;
+		int result = interrupt
+			? libusb_interrupt_transfer(handle, endpoint, data, size, &transferred, timeout_ms)
+			: libusb_bulk_transfer(handle, endpoint, data, size, &transferred, timeout_ms);
+
+		if (!(timeout_allowed && result == LIBUSB_ERROR_TIMEOUT))
+		{
+			check(result, endpoint & LIBUSB_ENDPOINT_IN ? "IN transfer" : "OUT transfer");
+		}
+
+		return transferred;
+	}
+
+	libusb_context *context = nullptr;
+	libusb_device_handle *handle = nullptr;
+	int interface_number;
+};
+
+/// \brief Returns the `percent` percentile of sorted values (nearest rank).
+inline double percentile(std::vector<double> const &sorted, double percent)
+{
+	size_t rank = size_t(std::ceil(percent / 100 * sorted.size()));
+
+	return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+/// \brief Sorts latencies (in us) and prints their distribution.
+inline void print_latencies(char const *what, std::vector<double> &latencies_us)
+{
+	if (latencies_us.empty())
+		return;
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	std::printf("Latency of %zu %s (us): min %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+		latencies_us.size(), what, latencies_us.front(), percentile(latencies_us, 50), percentile(latencies_us, 90),
+		percentile(latencies_us, 99), percentile(latencies_us, 99.9), latencies_us.back());
+}
+
+#endif /* HOST_USB_DEVICE_H_ */
@@ -0,0 +1,293 @@
+/** \file
+ * \brief Host client of the vendor HID pipe (see Inc/Hid/usbd_hid_vendor.h), with the device in loopback mode (no
+ * receiver registered).
+ * \details Two measurements:
+ * - roundtrip: writes one output report and waits for its input report; the latency is the round trip seen by the
+ *   host (the 1 ms polling of both endpoints included).
+ * - throughput: a thread writes output reports while another one reads the input reports back, for a given time.
+ *
+ * Each report carries a sequence number, so lost, duplicated and reordered reports are counted. With `--set-report`,
+ * the output reports go through SET_REPORT on endpoint0 (the fallback of the interrupt OUT endpoint).
+ *
+ *     vendor_hid_benchmark [roundtrip|throughput] [--set-report] [--seconds seconds]
+ */
+
+#include "usb_device.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+/** \name Constants of the device (they must match Src/Hid/usbd_hid_vendor.c)
+ * @{ */
+constexpr uint16_t VENDOR_ID = 0x6666;
+constexpr uint16_t PRODUCT_ID = 0x13AD;
+constexpr int INTERFACE_NUMBER = 0;
+
+constexpr uint8_t IN_ENDPOINT = 0x81;
+constexpr uint8_t OUT_ENDPOINT = 0x01;
+constexpr size_t REPORT_SIZE = 64;
+
+constexpr uint8_t HID_SET_REPORT = 0x09;
+constexpr uint8_t HID_REPORT_TYPE_OUTPUT = 0x02;
+/** @} */
+
+/// \brief How long the input reports left from a previous run are drained for.
+constexpr unsigned int DRAIN_TIMEOUT_MS = 20;
+
+enum class Test { ROUNDTRIP, THROUGHPUT };
+
+struct Options
+{
+	Test test = Test::ROUNDTRIP;
+	bool set_report = false;
+	double seconds = 5;
+};
+
+[[noreturn]] void usage(char const *program)
+{
+	std::fprintf(stderr,
+		"Usage: %s [roundtrip|throughput] [--set-report] [--seconds seconds]\n"
+		"  roundtrip    one report at a time, measures the round trip latency (the default)\n"
+		"  throughput   writes and reads reports from two threads, measures the throughput\n"
+		"  --set-report sends the output reports with SET_REPORT on endpoint0 instead of the interrupt OUT endpoint\n",
+		program);
+	std::exit(2);
+}
+
+Options parse_options(int argc, char **argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+
+		if (argument == "roundtrip")
+			options.test = Test::ROUNDTRIP;
+		else if (argument == "throughput")
+			options.test = Test::THROUGHPUT;
+		else if (argument == "--set-report")
+			options.set_report = true;
+		else if (argument == "--seconds" && i + 1 < argc)
+			options.seconds = std::strtod(argv[++i], nullptr);
+		else
+			usage(argv[0]);
+	}
+
+	return options;
+}
+
+void write_le32(uint8_t *data, uint32_t value)
+{
+	data[0] = value;
+	data[1] = value >> 8;
+	data[2] = value >> 16;
+	data[3] = value >> 24;
+}
+
+uint32_t read_le32(uint8_t const *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t(data[3]) << 24);
+}
+
+/** \brief The interface of the vendor pipe.
+ */
+class Device : public UsbDevice
+{
+public:
+	Device(bool set_report) : UsbDevice(VENDOR_ID, PRODUCT_ID, INTERFACE_NUMBER, "vendor HID"), set_report(set_report) {}
+
+	/// \brief Drops the input reports queued before the run (e.g. by an interrupted run).
+	void drain()
+	{
+		uint8_t report[REPORT_SIZE];
+
+		while (try_transfer(IN_ENDPOINT, true, report, sizeof(report), DRAIN_TIMEOUT_MS) != 0);
+	}
+
+	/// \brief Writes an output report whose first 4 bytes hold a sequence number (the rest is a pattern).
+	void send(uint32_t sequence)
+	{
+		uint8_t report[REPORT_SIZE];
+
+		for (size_t i = 4; i < sizeof(report); i++)
+		{
+			report[i] = uint8_t(sequence + i);
+		}
+
+		write_le32(report, sequence);
+
+		if (set_report)
+		{
+			control_out(LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE, HID_SET_REPORT,
+				HID_REPORT_TYPE_OUTPUT << 8, INTERFACE_NUMBER, report, sizeof(report), "SET_REPORT");
+		}
+		else
+		{
+			transfer(OUT_ENDPOINT, true, report, sizeof(report));
+		}
+	}
+
+	/// \brief Reads an input report, counts it in `errors` if its pattern is wrong, and returns its sequence number.
+	uint32_t receive(uint64_t &errors)
+	{
+		uint8_t report[REPORT_SIZE];
+
+		if (transfer(IN_ENDPOINT, true, report, sizeof(report)) != sizeof(report))
+			throw std::runtime_error("short input report");
+
+		uint32_t sequence = read_le32(report);
+
+		for (size_t i = 4; i < sizeof(report); i++)
+		{
+			if (report[i] != uint8_t(sequence + i))
+			{
+				errors++;
+				break;
+			}
+		}
+
+		return sequence;
+	}
+
+private:
+	bool set_report;
+};
+
+void run_roundtrip(Device &device, double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<double> latencies_us;
+	uint64_t errors = 0;
+	uint32_t sequence = 0;
+	Clock::time_point const start = Clock::now();
+	Clock::time_point const deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(seconds));
+	Clock::time_point now = start;
+
+	while (now < deadline)
+	{
+		Clock::time_point const request_start = now;
+
+		device.send(sequence);
+
+		if (device.receive(errors) != sequence)
+		{
+			errors++;
+		}
+
+		sequence++;
+		now = Clock::now();
+		latencies_us.push_back(std::chrono::duration<double, std::micro>(now - request_start).count());
+	}
+
+	double const elapsed = std::chrono::duration<double>(now - start).count();
+
+	std::printf("Round trips: %u in %.3f s = %.1f per second\n", sequence, elapsed, sequence / elapsed);
+	print_latencies("round trips", latencies_us);
+	std::printf("Errors: %llu (wrong sequence number or pattern)\n", (unsigned long long)errors);
+}
+
+void run_throughput(Device &device, double seconds)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::atomic<uint32_t> sent(0);
+	std::atomic<bool> writing(true);
+	std::exception_ptr writer_error;
+	uint32_t received = 0;
+	uint64_t errors = 0;
+	uint64_t lost = 0;
+	Clock::time_point const start = Clock::now();
+	Clock::time_point const deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(seconds));
+
+	// Note: The device NAKs the output reports while its input queue is full, so the writer follows the reader.
+	std::thread writer([&]()
+	{
+		try
+		{
+			while (Clock::now() < deadline)
+			{
+				device.send(sent);
+				sent++;
+			}
+		}
+		catch (...)
+		{
+			writer_error = std::current_exception();
+		}
+
+		writing = false;
+	});
+
+	Clock::time_point now = start;
+
+	while (writing || received < sent)
+	{
+		uint32_t sequence = device.receive(errors);
+
+		if (sequence != received)
+		{
+			lost += sequence > received ? sequence - received : 1;
+		}
+
+		received = sequence + 1;
+		now = Clock::now();
+	}
+
+	writer.join();
+
+	if (writer_error)
+		std::rethrow_exception(writer_error);
+
+	double const elapsed = std::chrono::duration<double>(now - start).count();
+	uint64_t const bytes = uint64_t(received) * REPORT_SIZE;
+
+	std::printf("Reports: %u sent, %u received in %.3f s = %.1f reports/s, %.3f KB/s in each direction\n",
+		sent.load(), received, elapsed, received / elapsed, bytes / elapsed / 1e3);
+	std::printf("Errors: %llu lost or reordered reports, %llu pattern errors\n", (unsigned long long)lost,
+		(unsigned long long)errors);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		Options const options = parse_options(argc, argv);
+		Device device(options.set_report);
+
+		device.drain();
+
+		if (options.test == Test::ROUNDTRIP)
+		{
+			run_roundtrip(device, options.seconds);
+		}
+		else
+		{
+			run_throughput(device, options.seconds);
+		}
+	}
+	catch (std::exception const &error)
+	{
+		std::fprintf(stderr, "Error: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}